@@ -32,6 +32,11 @@ ln -s ../../src/common/config.cpp src/$DESTDIR/config.cpp
 rm -f src/$DESTDIR/config.h
 ln -s ../../src/common/config.h src/$DESTDIR/config.h
 
+rm -f src/$DESTDIR/dcodec.cpp
+ln -s ../../src/common/dcodec.cpp src/$DESTDIR/dcodec.cpp
+rm -f src/$DESTDIR/dcodec.h
+ln -s ../../src/common/dcodec.h src/$DESTDIR/dcodec.h
+
 rm -f src/$DESTDIR/dparser.cpp
 ln -s ../../src/common/dparser.cpp src/$DESTDIR/dparser.cpp
 rm -f src/$DESTDIR/dparser.h
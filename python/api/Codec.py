@@ -0,0 +1,155 @@
+# Codec.py
+#
+# Decoder for Protocol D binary frames
+#
+#   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+#
+#   This program is free software; you can redistribute it and/or modify
+#   it under the terms of the GNU General Public License version 2 as
+#   published by the Free Software Foundation.
+#
+#   This program is distributed in the hope that it will be useful,
+#   but WITHOUT ANY WARRANTY; without even the implied warranty of
+#   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#   GNU General Public License for more details.
+#
+#   You should have received a copy of the GNU General Public
+#   License along with this program; if not, write to the Free Software
+#   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+#
+
+TEXT_FRAME=0
+RECORD_FRAME=1
+TABLE_FRAME=2
+MAX_FRAME_SIZE=16777216
+MAX_TABLE_ROWS=4096
+
+#
+# Must match the tables in 'src/common/dcodec.cpp'
+#
+KEYWORDS=("SRC","SRCADD","SRCDEL","DST","DSTADD","DSTDEL","GPI","GPIADD",
+          "GPIDEL","GPO","GPOADD","GPODEL","NODE","NODEADD","NODEDEL")
+COLUMNS=("AISASIII","AISASIII","AI","AISASI","AISASI","AI","AISS","AISS","AI",
+         "AISSSAI","AISSSAI","AI","ASSIIII","ASSIIII","A")
+
+class Codec(object):
+    """
+       Turns the frames sent on a Protocol D connection that has issued
+       the 'Binary' command back into records, each a list of fields
+       just as if the text record had been split on tabs.
+    """
+    def __init__(self):
+        self.__buffer=b""
+        self.__records=[]
+
+    def append(self,data):
+        """
+           Add data (bytes) received from the Drouter service.
+        """
+        self.__buffer+=data
+
+    def takeRecord(self):
+        """
+           Return the next record (list of strings), or None if no complete
+           record has been received yet. Raises ValueError if the data is
+           not valid.
+        """
+        while len(self.__records)==0:
+            if len(self.__buffer)==0:
+                return None
+            try:
+                (length,pos)=self.__readVarint(self.__buffer,1)
+            except IndexError:
+                if len(self.__buffer)>11:
+                    raise ValueError("invalid frame header")
+                return None
+            if length>MAX_FRAME_SIZE:
+                raise ValueError("frame too large")
+            if (len(self.__buffer)-pos)<length:
+                return None
+            frame_type=self.__buffer[0]
+            payload=self.__buffer[pos:pos+length]
+            self.__buffer=self.__buffer[pos+length:]
+            try:
+                self.__decodeFrame(frame_type,payload)
+            except IndexError:
+                raise ValueError("truncated frame")
+        return self.__records.pop(0)
+
+    def __decodeFrame(self,frame_type,payload):
+        if frame_type==TEXT_FRAME:
+            self.__records.append(payload.decode('latin-1').split("\t"))
+            return
+        if frame_type!=RECORD_FRAME and frame_type!=TABLE_FRAME:
+            raise ValueError("unknown frame type "+str(frame_type))
+        if payload[0]>=len(KEYWORDS):
+            raise ValueError("unknown record type "+str(payload[0]))
+        keyword=KEYWORDS[payload[0]]
+        columns=COLUMNS[payload[0]]
+        pos=1
+
+        if frame_type==RECORD_FRAME:
+            row=[keyword]
+            for column in columns:
+                if column=="S":
+                    (value,pos)=self.__readString(payload,pos)
+                    row.append(value)
+                else:
+                    (value,pos)=self.__readVarint(payload,pos)
+                    row.append(self.__field(column,self.__fromZigzag(value)))
+            rows=[row]
+        else:
+            (nrows,pos)=self.__readVarint(payload,pos)
+            if nrows==0 or nrows>MAX_TABLE_ROWS:
+                raise ValueError("invalid table size")
+            rows=[[keyword] for i in range(0,nrows)]
+            for column in columns:
+                count=0
+                prev=0
+                while count<nrows:
+                    if column=="S":
+                        (value,pos)=self.__readString(payload,pos)
+                    else:
+                        (value,pos)=self.__readVarint(payload,pos)
+                    (run,pos)=self.__readVarint(payload,pos)
+                    if run==0 or run>(nrows-count):
+                        raise ValueError("invalid run length")
+                    for i in range(0,run):
+                        if column=="S":
+                            rows[count].append(value)
+                        else:
+                            prev+=self.__fromZigzag(value)
+                            rows[count].append(self.__field(column,prev))
+                        count+=1
+        if pos!=len(payload):
+            raise ValueError("trailing data in frame")
+        self.__records+=rows
+
+    def __readVarint(self,data,pos):
+        value=0
+        shift=0
+        while shift<64:
+            b=data[pos]
+            pos+=1
+            value|=(b&0x7F)<<shift
+            if (b&0x80)==0:
+                return (value,pos)
+            shift+=7
+        raise ValueError("invalid varint")
+
+    def __readString(self,data,pos):
+        (length,pos)=self.__readVarint(data,pos)
+        if length>(len(data)-pos):
+            raise IndexError("string overruns frame")
+        return (data[pos:pos+length].decode('latin-1'),pos+length)
+
+    def __fromZigzag(self,value):
+        return (value>>1)^-(value&1)
+
+    def __field(self,column,value):
+        if column=="I":
+            return str(value)
+        if value<=0:
+            return ""
+        value-=1
+        return str((value>>24)&0xFF)+"."+str((value>>16)&0xFF)+"."+str((value>>8)&0xFF)+"."+str(value&0xFF)
@@ -21,6 +21,7 @@
 import socket
 
 import Drouter.Alarm
+import Drouter.Codec
 import Drouter.Destination
 import Drouter.Gpi
 import Drouter.Gpo
@@ -55,6 +56,10 @@ class StateEngine(object):
         self.__tether_loaded=False
         self.__tether_active=False
         self.__loaded=False
+        self.__binary_requested=False
+        self.__binary_accepted=False
+        self.__binary=False
+        self.__codec=Drouter.Codec.Codec()
 
     def Destination(self,host_addr,slot):
         """
@@ -278,6 +283,20 @@ class StateEngine(object):
         """
         self.__sock.send(("SetCrosspoint "+out_host_addr+" "+str(out_slot)+" "+in_host_addr+" "+str(in_slot)+"\r\n").encode('latin-1'))
 
+    def setCrosspoints(self,xpoints):
+        """
+           Set the multicast source addresses of multiple audio
+           destinations as a single salvo. Takes the following argument:
+
+                 xpoints: A list of tuples, each of the form
+                          (out_host_addr,out_slot,in_host_addr,in_slot)
+                          with the same meanings as for setCrosspoint().
+        """
+        cmd="SetCrosspoints"
+        for xpt in xpoints:
+            cmd+=" "+xpt[0]+" "+str(xpt[1])+" "+xpt[2]+" "+str(xpt[3])
+        self.__sock.send((cmd+"\r\n").encode('latin-1'))
+
     def clearGpioCrosspoint(self,out_host_addr,out_slot):
         """
            Clear the multicast source address ("SRCA" attribute) of a
@@ -374,35 +393,57 @@ class StateEngine(object):
         """
         self.setGpiCode(host_addr,slot,self.__bitStateCode(bit,state))
 
-    def start(self,hostname):
+    def start(self,hostname,binary=False):
         """
            Connect to a specified Drouter service and begin dispatching
            callbacks. Once started, a StateEngine can be interacted with
            only within one of its callback functions.
-           Takes the following argument:
+           Takes the following arguments:
 
            hostname: The hostname or IP address of the system running
                      the Drouter service.
+
+             binary: Ask the service to send updates as binary frames,
+                     which take much less bandwidth on slow links
+                     (boolean, default False). Services that do not
+                     support them continue to send text.
         """
         self.__conn=self.__sock.connect((hostname,23883))
         self.__accum=""
         c=""
+        if binary:
+            self.__binary_requested=True
+            self.__sock.send(("Binary\r\n").encode('latin-1'))
         self.__sock.send(("SubscribeNodes\r\n").encode('latin-1'))
         while 1<2:
+            if self.__binary:
+                self.__codec.append(self.__sock.recv(4096))
+                cmds=self.__codec.takeRecord()
+                while cmds!=None:
+                    self.__processMessage(cmds)
+                    cmds=self.__codec.takeRecord()
+                continue
             c=self.__sock.recv(1).decode('latin-1')
             if c[0]=="\r":
-                self.__processMessage()
+                self.__processMessage(self.__accum.split("\t"))
                 self.__accum=""
             else:
                 if c[0]!="\n":
                     self.__accum+=c
+                else:
+                    # The reply to 'Binary' is the last text sent
+                    self.__binary=self.__binary_accepted
 
     def __key(self,host_addr,slot):
         return host_addr+":"+str(slot)
 
-    def __processMessage(self):
-        #print(self.__accum)
-        cmds=self.__accum.split("\t")
+    def __processMessage(self,cmds):
+        #print(cmds)
+        if self.__binary_requested:
+            self.__binary_requested=False
+            self.__binary_accepted=cmds[0]=="ok"
+            return
+
         if cmds[0]=="NODEADD":
             self.__nodes[cmds[1]]=Drouter.Node.Node(cmds)
             if(self.__add_callback!=None) and self.__loaded:
@@ -123,6 +123,102 @@ int Config::fileDescriptorLimit() const
 }
 
 
+int Config::nodeStartupWindow() const
+{
+  return conf_node_startup_window;
+}
+
+
+int Config::stateSnapshotNodes() const
+{
+  return conf_state_snapshot_nodes;
+}
+
+
+int Config::stateSnapshotSlots() const
+{
+  return conf_state_snapshot_slots;
+}
+
+
+bool Config::protocolSingleProcess() const
+{
+  return conf_protocol_single_process;
+}
+
+
+int Config::dbWriterQueueSize() const
+{
+  return conf_db_writer_queue_size;
+}
+
+
+int Config::dbWriterStatsInterval() const
+{
+  return conf_db_writer_stats_interval;
+}
+
+
+int Config::routeConfirmTimeout() const
+{
+  return conf_route_confirm_timeout;
+}
+
+
+int Config::eventPurgeChunkSize() const
+{
+  return conf_event_purge_chunk_size;
+}
+
+
+int Config::eventPurgeBudget() const
+{
+  return conf_event_purge_budget;
+}
+
+
+bool Config::eventPartitioning() const
+{
+  return conf_event_partitioning;
+}
+
+
+bool Config::compactSchema() const
+{
+  return conf_compact_schema;
+}
+
+
+int Config::hostnameCacheTimeout() const
+{
+  return conf_hostname_cache_timeout;
+}
+
+
+int Config::clientQueueHighWater() const
+{
+  return conf_client_queue_high_water;
+}
+
+
+int Config::clientQueueLowWater() const
+{
+  return conf_client_queue_low_water;
+}
+
+
+int Config::slowClientTimeout() const
+{
+  return conf_slow_client_timeout;
+}
+
+
+int Config::changeJournalSize() const
+{
+  return conf_change_journal_size;
+}
+
+
 QStringList Config::nodesStartupLwrp(const QHostAddress &addr) const
 {
   return conf_nodes_startup_lwrps.value(addr.toIPv4Address(),QStringList());
@@ -270,6 +366,53 @@ void Config::load()
 				       DROUTER_DEFAULT_MAX_HEAP_TABLE_SIZE);
   conf_file_descriptor_limit=p->intValue("Drouterd","FileDescriptorLimit",
 					 DROUTER_DEFAULT_FILE_DESCRIPTOR_LIMIT);
+  conf_node_startup_window=p->intValue("Drouterd","NodeStartupWindow",
+				       DROUTER_DEFAULT_NODE_STARTUP_WINDOW);
+  conf_state_snapshot_nodes=p->intValue("Drouterd","StateSnapshotNodes",
+					DROUTER_DEFAULT_STATE_SNAPSHOT_NODES);
+  conf_state_snapshot_slots=p->intValue("Drouterd","StateSnapshotSlots",
+					DROUTER_DEFAULT_STATE_SNAPSHOT_SLOTS);
+  conf_protocol_single_process=
+    p->boolValue("Drouterd","ProtocolSingleProcess",
+		 DROUTER_DEFAULT_PROTOCOL_SINGLE_PROCESS);
+  conf_db_writer_queue_size=
+    p->intValue("Drouterd","DbWriterQueueSize",
+		DROUTER_DEFAULT_DB_WRITER_QUEUE_SIZE);
+  conf_db_writer_stats_interval=
+    p->intValue("Drouterd","DbWriterStatsInterval",
+		DROUTER_DEFAULT_DB_WRITER_STATS_INTERVAL);
+  conf_route_confirm_timeout=
+    p->intValue("Drouterd","RouteConfirmTimeout",
+		DROUTER_DEFAULT_ROUTE_CONFIRM_TIMEOUT);
+  conf_event_purge_chunk_size=
+    p->intValue("Drouterd","EventPurgeChunkSize",
+		DROUTER_DEFAULT_EVENT_PURGE_CHUNK_SIZE);
+  conf_event_purge_budget=
+    p->intValue("Drouterd","EventPurgeBudget",
+		DROUTER_DEFAULT_EVENT_PURGE_BUDGET);
+  conf_event_partitioning=
+    p->boolValue("Drouterd","EventPartitioning",
+		 DROUTER_DEFAULT_EVENT_PARTITIONING);
+  conf_compact_schema=
+    p->boolValue("Drouterd","CompactSchema",DROUTER_DEFAULT_COMPACT_SCHEMA);
+  conf_hostname_cache_timeout=
+    p->intValue("Drouterd","HostnameCacheTimeout",
+		DROUTER_DEFAULT_HOSTNAME_CACHE_TIMEOUT);
+  conf_client_queue_high_water=
+    p->intValue("Drouterd","ClientQueueHighWater",
+		DROUTER_DEFAULT_CLIENT_QUEUE_HIGH_WATER);
+  conf_client_queue_low_water=
+    p->intValue("Drouterd","ClientQueueLowWater",
+		DROUTER_DEFAULT_CLIENT_QUEUE_LOW_WATER);
+  if(conf_client_queue_low_water>conf_client_queue_high_water) {
+    conf_client_queue_low_water=conf_client_queue_high_water;
+  }
+  conf_slow_client_timeout=
+    p->intValue("Drouterd","SlowClientTimeout",
+		DROUTER_DEFAULT_SLOW_CLIENT_TIMEOUT);
+  conf_change_journal_size=
+    p->intValue("Drouterd","ChangeJournalSize",
+		DROUTER_DEFAULT_CHANGE_JOURNAL_SIZE);
 
   //
   // [Nodes] Section
@@ -40,6 +40,22 @@
 #define DROUTER_DEFAULT_NODE_LOG_PRIORITY -1
 #define DROUTER_DEFAULT_MAX_HEAP_TABLE_SIZE 33554432
 #define DROUTER_DEFAULT_FILE_DESCRIPTOR_LIMIT 1024
+#define DROUTER_DEFAULT_NODE_STARTUP_WINDOW 0
+#define DROUTER_DEFAULT_STATE_SNAPSHOT_NODES 1024
+#define DROUTER_DEFAULT_STATE_SNAPSHOT_SLOTS 16384
+#define DROUTER_DEFAULT_PROTOCOL_SINGLE_PROCESS false
+#define DROUTER_DEFAULT_DB_WRITER_QUEUE_SIZE 100000
+#define DROUTER_DEFAULT_DB_WRITER_STATS_INTERVAL 300
+#define DROUTER_DEFAULT_ROUTE_CONFIRM_TIMEOUT 2000
+#define DROUTER_DEFAULT_EVENT_PURGE_CHUNK_SIZE 1000
+#define DROUTER_DEFAULT_EVENT_PURGE_BUDGET 200
+#define DROUTER_DEFAULT_EVENT_PARTITIONING false
+#define DROUTER_DEFAULT_COMPACT_SCHEMA false
+#define DROUTER_DEFAULT_HOSTNAME_CACHE_TIMEOUT 300
+#define DROUTER_DEFAULT_CLIENT_QUEUE_HIGH_WATER 1048576
+#define DROUTER_DEFAULT_CLIENT_QUEUE_LOW_WATER 262144
+#define DROUTER_DEFAULT_SLOW_CLIENT_TIMEOUT 30
+#define DROUTER_DEFAULT_CHANGE_JOURNAL_SIZE 4194304
 #define DROUTER_TETHER_UDP_PORT 6245
 #define DROUTER_TETHER_TTY_SPEED 9600
 #define DROUTER_TETHER_TTY_PARITY TTYDevice::None
@@ -68,6 +84,22 @@ class Config
   QString lwrpPassword() const;
   int maxHeapTableSize() const;
   int fileDescriptorLimit() const;
+  int nodeStartupWindow() const;
+  int stateSnapshotNodes() const;
+  int stateSnapshotSlots() const;
+  bool protocolSingleProcess() const;
+  int dbWriterQueueSize() const;
+  int dbWriterStatsInterval() const;
+  int routeConfirmTimeout() const;
+  int eventPurgeChunkSize() const;
+  int eventPurgeBudget() const;
+  bool eventPartitioning() const;
+  bool compactSchema() const;
+  int hostnameCacheTimeout() const;
+  int clientQueueHighWater() const;
+  int clientQueueLowWater() const;
+  int slowClientTimeout() const;
+  int changeJournalSize() const;
   QStringList nodesStartupLwrp(const QHostAddress &addr) const;
 
   int matrixQuantity() const;
@@ -109,6 +141,22 @@ class Config
   QStringList conf_no_audio_alarm_devices;
   int conf_max_heap_table_size;
   int conf_file_descriptor_limit;
+  int conf_node_startup_window;
+  int conf_state_snapshot_nodes;
+  int conf_state_snapshot_slots;
+  bool conf_protocol_single_process;
+  int conf_db_writer_queue_size;
+  int conf_db_writer_stats_interval;
+  int conf_route_confirm_timeout;
+  int conf_event_purge_chunk_size;
+  int conf_event_purge_budget;
+  bool conf_event_partitioning;
+  bool conf_compact_schema;
+  int conf_hostname_cache_timeout;
+  int conf_client_queue_high_water;
+  int conf_client_queue_low_water;
+  int conf_slow_client_timeout;
+  int conf_change_journal_size;
   QMap<uint32_t,QStringList> conf_nodes_startup_lwrps;
   QList<Config::MatrixType> conf_matrix_types;
   QList<QHostAddress> conf_matrix_host_addresses;
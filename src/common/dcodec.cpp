@@ -0,0 +1,476 @@
+// dcodec.cpp
+//
+// Binary framing for Protocol D
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <string.h>
+
+#include "dcodec.h"
+
+//
+// The record types with a fixed layout, indexed by the type byte of
+// record and table frames. Columns are 'A' (IPv4 address, or empty),
+// 'I' (integer) and 'S' (string).
+//
+static const char *dcodec_keywords[]=
+  {"SRC","SRCADD","SRCDEL","DST","DSTADD","DSTDEL","GPI","GPIADD","GPIDEL",
+   "GPO","GPOADD","GPODEL","NODE","NODEADD","NODEDEL",NULL};
+static const char *dcodec_columns[]=
+  {"AISASIII","AISASIII","AI","AISASI","AISASI","AI","AISS","AISS","AI",
+   "AISSSAI","AISSSAI","AI","ASSIIII","ASSIIII","A",NULL};
+
+DCodec::DCodec()
+{
+  codec_pos=0;
+  codec_valid=true;
+}
+
+
+QByteArray DCodec::encode(const QByteArray &text) const
+{
+  QByteArray ret;
+  QList<QList<QByteArray> > rows;
+  int run_type=-1;
+  int type;
+  int start=0;
+  int end;
+
+  while(start<text.size()) {
+    if((end=text.indexOf("\r\n",start))<0) {
+      end=text.size();
+    }
+    QByteArray line=text.mid(start,end-start);
+    QList<QByteArray> fields=line.split('\t');
+    start=end+2;
+
+    //
+    // Gather consecutive records of the same type into one table
+    //
+    if((type=RecordType(fields))!=run_type) {
+      AppendRecords(&ret,run_type,rows);
+      rows.clear();
+      run_type=type;
+    }
+    if(type<0) {
+      AppendFrame(&ret,TextFrame,line);
+    }
+    else {
+      rows.push_back(fields);
+    }
+  }
+  AppendRecords(&ret,run_type,rows);
+
+  return ret;
+}
+
+
+void DCodec::append(const QByteArray &data)
+{
+  if(codec_pos>0) {
+    codec_buffer.remove(0,codec_pos);
+    codec_pos=0;
+  }
+  codec_buffer.append(data);
+}
+
+
+bool DCodec::takeRecord(QList<QByteArray> *fields)
+{
+  uint64_t len;
+  int pos;
+  FrameType type;
+
+  while(codec_records.size()==0) {
+    if((!codec_valid)||(codec_pos>=codec_buffer.size())) {
+      return false;
+    }
+    pos=codec_pos;
+    type=(FrameType)(0xFF&codec_buffer.at(pos++));
+    if(!ReadVarint(codec_buffer,&pos,&len)) {
+      if((codec_buffer.size()-codec_pos)>10) {
+	codec_valid=false;
+      }
+      return false;
+    }
+    if(len>DCODEC_MAX_FRAME_SIZE) {
+      codec_valid=false;
+      return false;
+    }
+    if((uint64_t)(codec_buffer.size()-pos)<len) {
+      return false;
+    }
+    codec_pos=pos+len;
+    if(!DecodeFrame(type,codec_buffer.mid(pos,len))) {
+      codec_records.clear();
+      codec_valid=false;
+      return false;
+    }
+  }
+  *fields=codec_records.takeFirst();
+
+  return true;
+}
+
+
+bool DCodec::isValid() const
+{
+  return codec_valid;
+}
+
+
+void DCodec::clear()
+{
+  codec_buffer.clear();
+  codec_pos=0;
+  codec_records.clear();
+  codec_valid=true;
+}
+
+
+int DCodec::RecordType(const QList<QByteArray> &fields) const
+{
+  int64_t value;
+
+  for(int i=0;dcodec_keywords[i]!=NULL;i++) {
+    if(fields.at(0)==dcodec_keywords[i]) {
+      if(fields.size()!=(1+(int)strlen(dcodec_columns[i]))) {
+	return -1;
+      }
+      for(int j=1;j<fields.size();j++) {
+	if((dcodec_columns[i][j-1]!='S')&&
+	   (!ToValue(dcodec_columns[i][j-1],fields.at(j),&value))) {
+	  return -1;
+	}
+      }
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+
+void DCodec::AppendFrame(QByteArray *data,FrameType type,
+			 const QByteArray &payload) const
+{
+  data->append((char)type);
+  AppendVarint(data,payload.size());
+  data->append(payload);
+}
+
+
+void DCodec::AppendRecords(QByteArray *data,int type,
+			   const QList<QList<QByteArray> > &rows) const
+{
+  const char *columns=NULL;
+  QByteArray payload;
+  int64_t value;
+  int64_t prev;
+  int64_t delta;
+  int64_t run_delta;
+  int run;
+
+  if((type<0)||(rows.size()==0)) {
+    return;
+  }
+  columns=dcodec_columns[type];
+
+  //
+  // A lone record is sent as it stands
+  //
+  if(rows.size()==1) {
+    payload.append((char)type);
+    for(int i=0;columns[i]!=0;i++) {
+      if(columns[i]=='S') {
+	AppendString(&payload,rows.at(0).at(i+1));
+      }
+      else {
+	ToValue(columns[i],rows.at(0).at(i+1),&value);
+	AppendVarint(&payload,ToZigzag(value));
+      }
+    }
+    AppendFrame(data,RecordFrame,payload);
+    return;
+  }
+
+  //
+  // Otherwise, one column at a time as (value, run length) pairs
+  //
+  for(int first=0;first<rows.size();first+=DCODEC_MAX_TABLE_ROWS) {
+    int last=first+DCODEC_MAX_TABLE_ROWS;
+    if(last>rows.size()) {
+      last=rows.size();
+    }
+    payload.clear();
+    payload.append((char)type);
+    AppendVarint(&payload,last-first);
+    for(int i=0;columns[i]!=0;i++) {
+      run=0;
+      if(columns[i]=='S') {
+	for(int j=first;j<last;j++) {
+	  if((run>0)&&(rows.at(j).at(i+1)!=rows.at(j-1).at(i+1))) {
+	    AppendString(&payload,rows.at(j-1).at(i+1));
+	    AppendVarint(&payload,run);
+	    run=0;
+	  }
+	  run++;
+	}
+	AppendString(&payload,rows.at(last-1).at(i+1));
+	AppendVarint(&payload,run);
+      }
+      else {
+	prev=0;
+	run_delta=0;
+	for(int j=first;j<last;j++) {
+	  ToValue(columns[i],rows.at(j).at(i+1),&value);
+	  delta=value-prev;
+	  prev=value;
+	  if((run>0)&&(delta!=run_delta)) {
+	    AppendVarint(&payload,ToZigzag(run_delta));
+	    AppendVarint(&payload,run);
+	    run=0;
+	  }
+	  run_delta=delta;
+	  run++;
+	}
+	AppendVarint(&payload,ToZigzag(run_delta));
+	AppendVarint(&payload,run);
+      }
+    }
+    AppendFrame(data,TableFrame,payload);
+  }
+}
+
+
+bool DCodec::DecodeFrame(FrameType type,const QByteArray &payload)
+{
+  const char *columns=NULL;
+  QList<QList<QByteArray> > rows;
+  QByteArray str;
+  uint64_t nrows;
+  uint64_t value;
+  uint64_t run;
+  int64_t prev;
+  int pos=1;
+  int count;
+
+  switch(type) {
+  case DCodec::TextFrame:
+    codec_records.push_back(payload.split('\t'));
+    return true;
+
+  case DCodec::RecordFrame:
+  case DCodec::TableFrame:
+    break;
+
+  default:
+    return false;
+  }
+  if((payload.size()<1)||((0xFF&payload.at(0))>=
+			  (int)(sizeof(dcodec_columns)/sizeof(char *)-1))) {
+    return false;
+  }
+  columns=dcodec_columns[0xFF&payload.at(0)];
+
+  if(type==DCodec::RecordFrame) {
+    rows.push_back(QList<QByteArray>());
+    rows.back().push_back(dcodec_keywords[0xFF&payload.at(0)]);
+    for(int i=0;columns[i]!=0;i++) {
+      if(columns[i]=='S') {
+	if(!ReadString(payload,&pos,&str)) {
+	  return false;
+	}
+	rows.back().push_back(str);
+      }
+      else {
+	if(!ReadVarint(payload,&pos,&value)) {
+	  return false;
+	}
+	rows.back().push_back(ToField(columns[i],FromZigzag(value)));
+      }
+    }
+  }
+  else {
+    if((!ReadVarint(payload,&pos,&nrows))||(nrows==0)||
+       (nrows>DCODEC_MAX_TABLE_ROWS)) {
+      return false;
+    }
+    for(uint64_t i=0;i<nrows;i++) {
+      rows.push_back(QList<QByteArray>());
+      rows.back().push_back(dcodec_keywords[0xFF&payload.at(0)]);
+    }
+    for(int i=0;columns[i]!=0;i++) {
+      count=0;
+      prev=0;
+      while(count<(int)nrows) {
+	if(columns[i]=='S') {
+	  if(!ReadString(payload,&pos,&str)) {
+	    return false;
+	  }
+	}
+	else {
+	  if(!ReadVarint(payload,&pos,&value)) {
+	    return false;
+	  }
+	}
+	if((!ReadVarint(payload,&pos,&run))||(run==0)||
+	   (run>(nrows-count))) {
+	  return false;
+	}
+	for(uint64_t j=0;j<run;j++) {
+	  if(columns[i]=='S') {
+	    rows[count++].push_back(str);
+	  }
+	  else {
+	    prev=(int64_t)((uint64_t)prev+(uint64_t)FromZigzag(value));
+	    rows[count++].push_back(ToField(columns[i],prev));
+	  }
+	}
+      }
+    }
+  }
+  if(pos!=payload.size()) {
+    return false;
+  }
+  codec_records.append(rows);
+
+  return true;
+}
+
+
+void DCodec::AppendVarint(QByteArray *data,uint64_t value)
+{
+  while(value>=0x80) {
+    data->append((char)(0x80|(value&0x7F)));
+    value=value>>7;
+  }
+  data->append((char)value);
+}
+
+
+bool DCodec::ReadVarint(const QByteArray &data,int *pos,uint64_t *value)
+{
+  uint64_t ret=0;
+
+  for(int shift=0;shift<64;shift+=7) {
+    if(*pos>=data.size()) {
+      return false;
+    }
+    uint8_t b=0xFF&data.at((*pos)++);
+    ret|=(uint64_t)(b&0x7F)<<shift;
+    if((b&0x80)==0) {
+      *value=ret;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+void DCodec::AppendString(QByteArray *data,const QByteArray &str)
+{
+  AppendVarint(data,str.size());
+  data->append(str);
+}
+
+
+bool DCodec::ReadString(const QByteArray &data,int *pos,QByteArray *str)
+{
+  uint64_t len;
+
+  if((!ReadVarint(data,pos,&len))||(len>(uint64_t)(data.size()-*pos))) {
+    return false;
+  }
+  *str=data.mid(*pos,len);
+  *pos+=len;
+
+  return true;
+}
+
+
+uint64_t DCodec::ToZigzag(int64_t value)
+{
+  return ((uint64_t)value<<1)^(uint64_t)(value>>63);
+}
+
+
+int64_t DCodec::FromZigzag(uint64_t value)
+{
+  return (int64_t)(value>>1)^-(int64_t)(value&1);
+}
+
+
+bool DCodec::ToValue(char column,const QByteArray &field,int64_t *value)
+{
+  //
+  // Only fields that come back unchanged from ToField() are accepted
+  //
+  QList<QByteArray> octets;
+  bool ok=false;
+  int n;
+
+  if(column=='I') {
+    *value=field.toLongLong(&ok);
+    return ok&&(*value>=-2147483648LL)&&(*value<=2147483647LL)&&
+      (QByteArray::number((qlonglong)*value)==field);
+  }
+
+  //
+  // Addresses go as one more than their 32 bit value, zero being empty
+  //
+  *value=0;
+  if(field.isEmpty()) {
+    return true;
+  }
+  if((octets=field.split('.')).size()!=4) {
+    return false;
+  }
+  for(int i=0;i<4;i++) {
+    n=octets.at(i).toInt(&ok);
+    if((!ok)||(n<0)||(n>255)||(QByteArray::number(n)!=octets.at(i))) {
+      return false;
+    }
+    *value=(*value<<8)|n;
+  }
+  *value+=1;
+
+  return true;
+}
+
+
+QByteArray DCodec::ToField(char column,int64_t value)
+{
+  QByteArray ret;
+
+  if(column=='I') {
+    return QByteArray::number((qlonglong)value);
+  }
+  if((value<=0)||(value>0x100000000LL)) {
+    return ret;
+  }
+  value-=1;
+  for(int i=3;i>=0;i--) {
+    ret+=QByteArray::number((int)(0xFF&(value>>(8*i))));
+    if(i>0) {
+      ret+=".";
+    }
+  }
+
+  return ret;
+}
@@ -0,0 +1,77 @@
+// dcodec.h
+//
+// Binary framing for Protocol D
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef DCODEC_H
+#define DCODEC_H
+
+#include <stdint.h>
+
+#include <QByteArray>
+#include <QList>
+
+#define DCODEC_MAX_FRAME_SIZE 16777216
+#define DCODEC_MAX_TABLE_ROWS 4096
+
+//
+// Converts between Protocol D text records and the binary frames sent
+// on connections that have issued the 'Binary' command. Each frame is a
+// type byte, a varint payload length and the payload.
+//
+// A run of records of the same type is sent as a table frame, holding
+// each field as a column of run-length encoded values (numbers and
+// addresses as deltas from the row before). A lone record is sent as a
+// record frame, and anything without a fixed layout (including replies
+// such as 'ok') as a text frame. Decoding gives back the same fields as
+// splitting the text record on tabs would.
+//
+class DCodec
+{
+ public:
+  enum FrameType {TextFrame=0,RecordFrame=1,TableFrame=2};
+  DCodec();
+  QByteArray encode(const QByteArray &text) const;
+  void append(const QByteArray &data);
+  bool takeRecord(QList<QByteArray> *fields);
+  bool isValid() const;
+  void clear();
+
+ private:
+  int RecordType(const QList<QByteArray> &fields) const;
+  void AppendFrame(QByteArray *data,FrameType type,
+		   const QByteArray &payload) const;
+  void AppendRecords(QByteArray *data,int type,
+		     const QList<QList<QByteArray> > &rows) const;
+  bool DecodeFrame(FrameType type,const QByteArray &payload);
+  static void AppendVarint(QByteArray *data,uint64_t value);
+  static bool ReadVarint(const QByteArray &data,int *pos,uint64_t *value);
+  static void AppendString(QByteArray *data,const QByteArray &str);
+  static bool ReadString(const QByteArray &data,int *pos,QByteArray *str);
+  static uint64_t ToZigzag(int64_t value);
+  static int64_t FromZigzag(uint64_t value);
+  static bool ToValue(char column,const QByteArray &field,int64_t *value);
+  static QByteArray ToField(char column,int64_t value);
+  QByteArray codec_buffer;
+  int codec_pos;
+  QList<QList<QByteArray> > codec_records;
+  bool codec_valid;
+};
+
+
+#endif  // DCODEC_H
@@ -27,6 +27,9 @@ DParser::DParser(QObject *parent)
 {
   d_socket=NULL;
   d_connected=false;
+  d_sequence=0;
+  d_binary_framing=false;
+  d_framing_state=DParser::TextState;
 
   d_poll_timer=new QTimer(this);
   d_poll_timer->setSingleShot(true);
@@ -38,6 +41,29 @@ DParser::DParser(QObject *parent)
 }
 
 
+DParser::~DParser()
+{
+  for(QHash<uint64_t,SyDestination *>::const_iterator
+	it=d_destinations.begin();it!=d_destinations.end();it++) {
+    delete it.value();
+  }
+  for(QHash<uint64_t,SySource *>::const_iterator it=d_sources.begin();
+      it!=d_sources.end();it++) {
+    delete it.value();
+  }
+  for(QMap<unsigned,SyNode *>::const_iterator it=d_nodes.begin();
+      it!=d_nodes.end();it++) {
+    delete it.value();
+  }
+  for(int i=0;i<d_free_destinations.size();i++) {
+    delete d_free_destinations.at(i);
+  }
+  for(int i=0;i<d_free_sources.size();i++) {
+    delete d_free_sources.at(i);
+  }
+}
+
+
 QList<QHostAddress> DParser::nodeHostAddresses() const
 {
   QList<QHostAddress> addrs;
@@ -64,7 +90,7 @@ SyNode *DParser::node(const QHostAddress &hostaddr)
 SySource *DParser::src(const QHostAddress &hostaddr,int slot) const
 {
   try {
-    return d_sources[ToIndex(hostaddr,slot)];
+    return d_sources.value(ToIndex(hostaddr,slot));
   }
   catch(...) {
   }
@@ -75,7 +101,7 @@ SySource *DParser::src(const QHostAddress &hostaddr,int slot) const
 SyDestination *DParser::dst(const QHostAddress &hostaddr,int slot) const
 {
   try {
-    return d_destinations[ToIndex(hostaddr,slot)];
+    return d_destinations.value(ToIndex(hostaddr,slot));
   }
   catch(...) {
   }
@@ -83,6 +109,17 @@ SyDestination *DParser::dst(const QHostAddress &hostaddr,int slot) const
 }
 
 
+void DParser::setBinaryFraming(bool state)
+{
+  //
+  // Off by default. When on, binary framing is asked for with the
+  // 'Binary' command on each connect, and text is kept if the server
+  // turns it down. Takes effect from the next connect.
+  //
+  d_binary_framing=state;
+}
+
+
 void DParser::connectToHost(const QString &hostname,uint16_t port)
 {
   d_hostname=hostname;
@@ -99,9 +136,22 @@ void DParser::connectToHost(const QString &hostname,uint16_t port)
 
 void DParser::connectedData()
 {
-  SendCommand("SubscribeDestinations");
-  SendCommand("SubscribeNodes");
-  SendCommand("SubscribeSources");
+  //
+  // Ask for just what we missed, if anything
+  //
+  QString since=QString::asprintf(" since %llu",
+				  (unsigned long long)d_sequence);
+
+  d_accum="";
+  d_codec.clear();
+  d_framing_state=DParser::TextState;
+  if(d_binary_framing) {
+    d_framing_state=DParser::RequestedState;
+    SendCommand("Binary");
+  }
+  SendCommand("SubscribeDestinations"+since);
+  SendCommand("SubscribeNodes"+since);
+  SendCommand("SubscribeSources"+since);
   SendCommand("Ping");
 }
 
@@ -113,13 +163,23 @@ void DParser::readyReadData()
   
   while((n=d_socket->read(data,1500))>0) {
     for(int i=0;i<n;i++) {
+      if(d_framing_state==DParser::BinaryState) {
+	ProcessFrames(data+i,n-i);
+	break;
+      }
       switch(0xFF&data[i]) {
       case 13:
-	ProcessCommand(d_accum);
+	ProcessCommand(d_accum.split("\t"));
 	d_accum="";
 	break;
 
       case 10:
+	//
+	// The line ending of the reply to 'Binary' is the last text sent
+	//
+	if(d_framing_state==DParser::AcceptedState) {
+	  d_framing_state=DParser::BinaryState;
+	}
 	break;
 
       default:
@@ -179,24 +239,14 @@ void DParser::pollTimerData()
 
 void DParser::watchdogTimerData()
 {
-  for(QMap<uint64_t,SyDestination *>::const_iterator it=d_destinations.begin();
-      it!=d_destinations.end();it++) {
-    emit destinationRemoved(ToAddress(it.key()),ToSlot(it.key()));
-    delete it.value();
-  }
-  d_destinations.clear();
-  for(QMap<uint64_t,SySource *>::const_iterator it=d_sources.begin();
-      it!=d_sources.end();it++) {
-    emit sourceRemoved(ToAddress(it.key()),ToSlot(it.key()));
-    delete it.value();
-  }
-  d_sources.clear();
-  for(QMap<unsigned,SyNode *>::const_iterator it=d_nodes.begin();
-      it!=d_nodes.end();it++) {
-    emit nodeRemoved(QHostAddress(it.key()));
-    delete it.value();
+  //
+  // Hang on to what we have if the service can bring it up to date
+  //
+  if(d_sequence==0) {
+    ClearDestinations();
+    ClearSources();
+    ClearNodes();
   }
-  d_nodes.clear();
 
   delete d_socket;
   d_socket=NULL;
@@ -208,9 +258,28 @@ void DParser::watchdogTimerData()
 }
 
 
-void DParser::ProcessCommand(const QString &cmd)
+void DParser::ProcessFrames(const char *data,int len)
+{
+  QList<QByteArray> fields;
+  QStringList cmds;
+
+  d_codec.append(QByteArray(data,len));
+  while(d_codec.takeRecord(&fields)) {
+    cmds.clear();
+    for(int i=0;i<fields.size();i++) {
+      cmds.push_back(QString::fromLatin1(fields.at(i)));
+    }
+    ProcessCommand(cmds);
+  }
+  if(!d_codec.isValid()) {
+    d_watchdog_timer->stop();
+    d_watchdog_timer->start(1);
+  }
+}
+
+
+void DParser::ProcessCommand(const QStringList &cmds)
 {
-  QStringList cmds=cmd.split("\t");  
   QHostAddress addr;
   SyNode *node;
   SyDestination *dst;
@@ -226,7 +295,7 @@ void DParser::ProcessCommand(const QString &cmd)
       slot=cmds.at(2).toInt(&ok);
       if(ok) {
 	if((dindex=ToIndex(addr,slot))>=0) {
-	  if((dst=d_destinations[dindex])!=NULL) {
+	  if((dst=d_destinations.value(dindex))!=NULL) {
 	    QHostAddress saddr(cmds.at(4));
 	    if(dst->name()!=cmds.at(5)) {
 	      dst->setName(cmds.at(5));
@@ -261,8 +330,8 @@ void DParser::ProcessCommand(const QString &cmd)
       slot=cmds.at(2).toInt(&ok);
       if(ok) {
 	if((dindex=ToIndex(addr,slot))>=0) {
-	  if(d_destinations[dindex]==NULL) {
-	    dst=new SyDestination();
+	  if(!d_destinations.contains(dindex)) {
+	    dst=NewDestination();
 	    dst->setStreamAddress(cmds.at(4));
 	    dst->setName(cmds.at(5));
 	    dst->setChannels(cmds.at(6).toInt());
@@ -279,9 +348,8 @@ void DParser::ProcessCommand(const QString &cmd)
       slot=cmds.at(2).toInt(&ok);
       if(ok) {
 	if((dindex=ToIndex(addr,slot))>=0) {
-	  if((dst=d_destinations[dindex])!=NULL) {
-	    delete dst;
-	    d_destinations.erase(d_destinations.find(dindex));
+	  if((dst=d_destinations.take(dindex))!=NULL) {
+	    d_free_destinations.push_back(dst);
 	    emit destinationRemoved(addr,slot);
 	  }
 	}
@@ -318,6 +386,23 @@ void DParser::ProcessCommand(const QString &cmd)
     }
   }
 
+  if(d_framing_state==DParser::RequestedState) {
+    if(cmds.at(0).toLower()=="ok") {
+      d_framing_state=DParser::AcceptedState;
+    }
+    if(cmds.at(0).toLower()=="error") {
+      d_framing_state=DParser::TextState;
+    }
+  }
+
+  if(cmds.at(0).toLower()=="dstreset") {
+    ClearDestinations();
+  }
+
+  if(cmds.at(0).toLower()=="nodereset") {
+    ClearNodes();
+  }
+
   if(cmds.at(0).toLower()=="pong") {
     if(!d_connected) {
       d_connected=true;
@@ -328,15 +413,21 @@ void DParser::ProcessCommand(const QString &cmd)
     d_poll_timer->start(DPARSER_WATCHDOG_POLL_INTERVAL);
   }
 
+  if((cmds.at(0).toLower()=="seq")&&(cmds.size()==2)) {
+    d_sequence=cmds.at(1).toULongLong();
+  }
+
   if((cmds.at(0).toLower()=="src")&&(cmds.size()==9)) {
     if(addr.setAddress(cmds.at(1))) {
       slot=cmds.at(2).toInt(&ok);
       if(ok) {
 	if((sindex=ToIndex(addr,slot))>=0) {
-	  if((src=d_sources[sindex])!=NULL) {
+	  if((src=d_sources.value(sindex))!=NULL) {
 	    QHostAddress saddr(cmds.at(4));
 	    if(src->streamAddress()!=saddr) {
+	      UnindexSource(sindex,src->streamAddress());
 	      src->setStreamAddress(saddr);
+	      IndexSource(sindex,saddr);
 	      changed=true;
 	    }
 	    if(src->name()!=cmds.at(5)) {
@@ -369,14 +460,15 @@ void DParser::ProcessCommand(const QString &cmd)
       slot=cmds.at(2).toInt(&ok);
       if(ok) {
 	if((sindex=ToIndex(addr,slot))>=0) {
-	  if(d_sources[sindex]==NULL) {
-	    src=new SySource();
+	  if(!d_sources.contains(sindex)) {
+	    src=NewSource();
 	    src->setStreamAddress(QHostAddress(cmds.at(4)));
 	    src->setName(cmds.at(5));
 	    src->setEnabled(cmds.at(6)!="0");
 	    src->setChannels(cmds.at(7).toInt());
 	    src->setPacketSize(cmds.at(8).toInt());
 	    d_sources[sindex]=src;
+	    IndexSource(sindex,src->streamAddress());
 	    emit sourceAdded(addr,slot);
 	  }
 	}
@@ -384,14 +476,18 @@ void DParser::ProcessCommand(const QString &cmd)
     }
   }
 
+  if(cmds.at(0).toLower()=="srcreset") {
+    ClearSources();
+  }
+
   if((cmds.at(0).toLower()=="srcdel")&&(cmds.size()==3)) {
     if(addr.setAddress(cmds.at(1))) {
       slot=cmds.at(2).toInt(&ok);
       if(ok) {
 	if((sindex=ToIndex(addr,slot))>=0) {
-	  if((src=d_sources[sindex])!=NULL) {
-	    delete src;
-	    d_sources.erase(d_sources.find(sindex));
+	  if((src=d_sources.take(sindex))!=NULL) {
+	    UnindexSource(sindex,src->streamAddress());
+	    d_free_sources.push_back(src);
 	    emit sourceRemoved(addr,slot);
 	  }
 	}
@@ -409,15 +505,108 @@ void DParser::SendCommand(const QString &cmd)
 }
 
 
-uint64_t DParser::IndexByStreamAddress(const QHostAddress &saddr) const
+void DParser::ClearDestinations()
+{
+  for(QHash<uint64_t,SyDestination *>::const_iterator
+	it=d_destinations.begin();it!=d_destinations.end();it++) {
+    emit destinationRemoved(ToAddress(it.key()),ToSlot(it.key()));
+    d_free_destinations.push_back(it.value());
+  }
+  d_destinations.clear();
+}
+
+
+void DParser::ClearNodes()
 {
-  for(QMap<uint64_t,SySource *>::const_iterator it=d_sources.begin();
+  for(QMap<unsigned,SyNode *>::const_iterator it=d_nodes.begin();
+      it!=d_nodes.end();it++) {
+    emit nodeRemoved(QHostAddress(it.key()));
+    delete it.value();
+  }
+  d_nodes.clear();
+}
+
+
+void DParser::ClearSources()
+{
+  for(QHash<uint64_t,SySource *>::const_iterator it=d_sources.begin();
       it!=d_sources.end();it++) {
-    if(it.value()->streamAddress()==saddr) {
-      return it.key();
+    emit sourceRemoved(ToAddress(it.key()),ToSlot(it.key()));
+    d_free_sources.push_back(it.value());
+  }
+  d_sources.clear();
+  d_stream_index.clear();
+}
+
+
+SyDestination *DParser::NewDestination()
+{
+  //
+  // Reuse the objects of removed slots, so that a resync of a large
+  // plant does not go back to the allocator for every one
+  //
+  SyDestination *dst=NULL;
+
+  if(d_free_destinations.size()==0) {
+    return new SyDestination();
+  }
+  dst=d_free_destinations.takeLast();
+  *dst=SyDestination();
+
+  return dst;
+}
+
+
+SySource *DParser::NewSource()
+{
+  SySource *src=NULL;
+
+  if(d_free_sources.size()==0) {
+    return new SySource();
+  }
+  src=d_free_sources.takeLast();
+  *src=SySource();
+
+  return src;
+}
+
+
+void DParser::IndexSource(uint64_t sindex,const QHostAddress &saddr)
+{
+  if(!saddr.isNull()) {
+    d_stream_index.insert(saddr.toIPv4Address(),sindex);
+  }
+}
+
+
+void DParser::UnindexSource(uint64_t sindex,const QHostAddress &saddr)
+{
+  if(!saddr.isNull()) {
+    d_stream_index.remove(saddr.toIPv4Address(),sindex);
+  }
+}
+
+
+uint64_t DParser::IndexByStreamAddress(const QHostAddress &saddr) const
+{
+  //
+  // Duplicate addresses resolve to the lowest node/slot, as the old
+  // ordered walk of the sources did
+  //
+  uint64_t ret=0;
+
+  if(saddr.isNull()) {
+    return 0;
+  }
+  for(QMultiHash<uint32_t,uint64_t>::const_iterator
+	it=d_stream_index.find(saddr.toIPv4Address());
+      (it!=d_stream_index.end())&&(it.key()==saddr.toIPv4Address());it++) {
+    if((ret==0)||(it.value()<ret)) {
+      ret=it.value();
     }
   }
-  return 0;
+
+  return ret;
 }
 
 
@@ -23,11 +23,13 @@
 
 #include <stdint.h>
 
+#include <QHash>
 #include <QHostAddress>
 #include <QList>
 #include <QMap>
 #include <QObject>
 #include <QString>
+#include <QStringList>
 #include <QTcpSocket>
 #include <QTimer>
 
@@ -35,6 +37,8 @@
 #include <sy5/synode.h>
 #include <sy5/sysource.h>
 
+#include "dcodec.h"
+
 #define DPARSER_WATCHDOG_POLL_INTERVAL 1000
 #define DPARSER_WATCHDOG_TIMEOUT_INTERVAL 3000
 
@@ -43,10 +47,12 @@ class DParser : public QObject
   Q_OBJECT;
  public:
   DParser(QObject *parent=0);
+  ~DParser();
   QList<QHostAddress> nodeHostAddresses() const;
   SyNode *node(const QHostAddress &hostaddr);
   SySource *src(const QHostAddress &hostaddr,int slot) const;
   SyDestination *dst(const QHostAddress &hostaddr,int slot) const;
+  void setBinaryFraming(bool state);
   void connectToHost(const QString &hostname,uint16_t port);
 
  signals:
@@ -73,8 +79,18 @@ class DParser : public QObject
   void watchdogTimerData();
 
  private:
-  void ProcessCommand(const QString &cmd);
+  enum FramingState {TextState=0,RequestedState=1,AcceptedState=2,
+		     BinaryState=3};
+  void ProcessFrames(const char *data,int len);
+  void ProcessCommand(const QStringList &cmds);
   void SendCommand(const QString &cmd);
+  void ClearDestinations();
+  void ClearNodes();
+  void ClearSources();
+  SyDestination *NewDestination();
+  SySource *NewSource();
+  void IndexSource(uint64_t sindex,const QHostAddress &saddr);
+  void UnindexSource(uint64_t sindex,const QHostAddress &saddr);
   uint64_t IndexByStreamAddress(const QHostAddress &saddr) const;
   uint64_t ToIndex(const QHostAddress &addr,int slot) const;
   QHostAddress ToAddress(uint64_t index) const;
@@ -83,10 +99,17 @@ class DParser : public QObject
   uint16_t d_port;
   QTcpSocket *d_socket;
   QMap<unsigned,SyNode *> d_nodes;
-  QMap<uint64_t,SyDestination *> d_destinations;
-  QMap<uint64_t,SySource *> d_sources;
+  QHash<uint64_t,SyDestination *> d_destinations;
+  QHash<uint64_t,SySource *> d_sources;
+  QMultiHash<uint32_t,uint64_t> d_stream_index;
+  QList<SyDestination *> d_free_destinations;
+  QList<SySource *> d_free_sources;
   QString d_accum;
+  bool d_binary_framing;
+  FramingState d_framing_state;
+  DCodec d_codec;
   bool d_connected;
+  uint64_t d_sequence;
   QTimer *d_poll_timer;
   QTimer *d_watchdog_timer;
 };
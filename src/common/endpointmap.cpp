@@ -118,14 +118,14 @@ void EndPointMap::setRouterNumber(int num)
 
 int EndPointMap::quantity(EndPointMap::Type type) const
 {
-  return map_host_addresses[type].size();
+  return map_endpoints[type].host_addresses.size();
 }
 
 
 QHostAddress EndPointMap::hostAddress(EndPointMap::Type type,int n) const
 {
-  if(n<map_host_addresses[type].size()) {
-    return map_host_addresses[type].at(n);
+  if(n<map_endpoints[type].host_addresses.size()) {
+    return map_endpoints[type].host_addresses.at(n);
   }
   return QHostAddress();
 }
@@ -133,20 +133,22 @@ QHostAddress EndPointMap::hostAddress(EndPointMap::Type type,int n) const
 
 void EndPointMap::setHostAddress(EndPointMap::Type type,int n,const QHostAddress &addr)
 {
-  map_host_addresses[type][n]=addr;
+  map_endpoints[type].host_addresses[n]=addr;
+  Reindex(type);
 }
 
 
 void EndPointMap::setHostAddress(EndPointMap::Type type,int n,const QString &addr)
 {
-  map_host_addresses[type][n].setAddress(addr);
+  map_endpoints[type].host_addresses[n].setAddress(addr);
+  Reindex(type);
 }
 
 
 int EndPointMap::slot(EndPointMap::Type type,int n) const
 {
-  if(n<map_slots[type].size()) {
-    return map_slots[type].at(n);
+  if(n<map_endpoints[type].slot_numbers.size()) {
+    return map_endpoints[type].slot_numbers.at(n);
   }
   return -1;
 }
@@ -154,7 +156,8 @@ int EndPointMap::slot(EndPointMap::Type type,int n) const
 
 void EndPointMap::setSlot(EndPointMap::Type type,int n,int slot)
 {
-  map_slots[type][n]=slot;
+  map_endpoints[type].slot_numbers[n]=slot;
+  Reindex(type);
 }
 
 
@@ -166,8 +169,8 @@ QString EndPointMap::name(EndPointMap::Type type,int n,const QString &orig_name)
     ret=QObject::tr("OFF");
   }
   else {
-    if(n<map_names[type].size()) {
-      ret=map_names[type].at(n);
+    if(n<map_endpoints[type].names.size()) {
+      ret=map_endpoints[type].names.at(n);
     }
     if(ret.isEmpty()) {
       ret=orig_name;
@@ -183,8 +186,8 @@ bool EndPointMap::nameIsCustom(Type type,int n) const
   if(n<0) {
     return true;
   }
-  if(n<map_name_is_customs[type].size()) {
-    return map_name_is_customs[type].at(n);
+  if(n<map_endpoints[type].name_is_customs.size()) {
+    return map_endpoints[type].name_is_customs.at(n);
   }
   return false;
 }
@@ -192,19 +195,13 @@ bool EndPointMap::nameIsCustom(Type type,int n) const
 
 void EndPointMap::setName(EndPointMap::Type type,int n,const QString &str)
 {
-  map_names[type][n]=str;
+  map_endpoints[type].names[n]=str;
 }
 
 
 int EndPointMap::endPoint(Type type,const QHostAddress &hostaddr,int slot) const
 {
-  for(int i=0;i<map_host_addresses[type].size();i++) {
-    if((map_host_addresses[type].at(i)==hostaddr)&&
-       (map_slots[type].at(i)==slot)) {
-      return i;
-    }
-  }
-  return -1;
+  return map_endpoints[type].index.value(IndexKey(hostaddr,slot),-1);
 }
 
 
@@ -217,27 +214,36 @@ int EndPointMap::endPoint(Type type,const QString &hostaddr,int slot) const
 void EndPointMap::insert(EndPointMap::Type type,int n,const QHostAddress &host_addr,int slot,
 			 const QString &name)
 {
-  map_host_addresses[type].insert(n,host_addr);
-  map_slots[type].insert(n,slot);
-  map_names[type].insert(n,name);
-  map_name_is_customs[type].insert(n,true);
+  EndPoints *e=&map_endpoints[type];
+
+  if(n>=e->host_addresses.size()) {
+    Append(type,host_addr,slot,name,true);
+    return;
+  }
+  e->host_addresses.insert(n,host_addr);
+  e->slot_numbers.insert(n,slot);
+  e->names.insert(n,name);
+  e->name_is_customs.insert(n,true);
+  Reindex(type);
 }
 
 
 void EndPointMap::insert(EndPointMap::Type type,int n,const QString &host_addr,int slot,
 			 const QString &name)
 {
-  map_host_addresses[type].insert(n,QHostAddress(host_addr));
-  map_slots[type].insert(n,slot);
-  map_names[type].insert(n,name);
-  map_name_is_customs[type].insert(n,true);
+  insert(type,n,QHostAddress(host_addr),slot,name);
 }
 
 
 void EndPointMap::erase(EndPointMap::Type type,int n)
 {
-  map_host_addresses[type].erase(map_host_addresses[type].begin()+n);
-  map_slots[type].erase(map_slots[type].begin()+n);
+  EndPoints *e=&map_endpoints[type];
+
+  e->host_addresses.remove(n);
+  e->slot_numbers.remove(n);
+  e->names.remove(n);
+  e->name_is_customs.remove(n);
+  Reindex(type);
 }
 
 
@@ -279,8 +285,7 @@ bool EndPointMap::load(const QString &filename,QStringList *unused_lines)
     int count=0;
     QHostAddress addr;
     bool ok=false;
-    map_host_addresses[type].clear();
-    map_slots[type].clear();
+    map_endpoints[type]=EndPoints();
 
     QString name=p->stringValue("Global","RouterType").toLower();
     map_router_type=EndPointMap::AudioRouter;
@@ -296,12 +301,11 @@ bool EndPointMap::load(const QString &filename,QStringList *unused_lines)
     addr=p->addressValue(EndPointMap::typeString(type)+
 	     QString::asprintf("%d",count+1),"HostAddress",QHostAddress(),&ok);
     while(ok) {
-      map_host_addresses[type].push_back(addr);
-      map_slots[type].push_back(p->intValue(EndPointMap::typeString(type)+
-	       QString::asprintf("%d",count+1),"Slot")-1);
-      map_names[type].push_back(p->stringValue(EndPointMap::typeString(type)+
-	       QString::asprintf("%d",count+1),"Name","",&ok));
-      map_name_is_customs[type].push_back(ok);
+      int slot=p->intValue(EndPointMap::typeString(type)+
+			   QString::asprintf("%d",count+1),"Slot")-1;
+      QString ep_name=p->stringValue(EndPointMap::typeString(type)+
+			QString::asprintf("%d",count+1),"Name","",&ok);
+      Append(type,addr,slot,ep_name,ok);
       count++;
       addr=p->addressValue(EndPointMap::typeString(type)+
 	       QString::asprintf("%d",count+1),"HostAddress",QHostAddress(),&ok);
@@ -375,24 +379,25 @@ void EndPointMap::save(FILE *f,bool incl_names) const
   fprintf(f,"\n");
   for(int i=0;i<EndPointMap::LastType;i++) {
     EndPointMap::Type type=(EndPointMap::Type)i;
-    for(int j=0;j<map_host_addresses[type].size();j++) {
+    const EndPoints *e=&map_endpoints[type];
+    for(int j=0;j<e->host_addresses.size();j++) {
       fprintf(f,"[%s%d]\n",
 	      (const char *)EndPointMap::typeString(type).toUtf8(),j+1);
-      if(map_host_addresses[type].at(j).isNull()) {
+      if(e->host_addresses.at(j).isNull()) {
 	fprintf(f,"HostAddress=0.0.0.0\n");
       }
       else {
 	fprintf(f,"HostAddress=%s\n",
-	      (const char *)map_host_addresses[type].at(j).toString().toUtf8());
+	      (const char *)e->host_addresses.at(j).toString().toUtf8());
       }
-      fprintf(f,"Slot=%d\n",map_slots[type].at(j)+1);
+      fprintf(f,"Slot=%d\n",e->slot_numbers.at(j)+1);
       if(incl_names) {
 	fprintf(f,"Name=%s\n",
-		(const char *)map_names[type].at(j).toUtf8());
+		(const char *)e->names.at(j).toUtf8());
       }
       else {
 	fprintf(f,"; Name=%s\n",
-		(const char *)map_names[type].at(j).toUtf8());
+		(const char *)e->names.at(j).toUtf8());
       }
       fprintf(f,"\n");
     }
@@ -527,3 +532,37 @@ QString EndPointMap::typeString(Type type)
 
   return ret;
 }
+
+
+void EndPointMap::Append(Type type,const QHostAddress &host_addr,int slot,
+			 const QString &name,bool name_is_custom)
+{
+  EndPoints *e=&map_endpoints[type];
+  quint64 key=IndexKey(host_addr,slot);
+
+  if(!e->index.contains(key)) {
+    e->index[key]=e->host_addresses.size();
+  }
+  e->host_addresses.push_back(host_addr);
+  e->slot_numbers.push_back(slot);
+  e->names.push_back(name);
+  e->name_is_customs.push_back(name_is_custom);
+}
+
+
+void EndPointMap::Reindex(Type type)
+{
+  EndPoints *e=&map_endpoints[type];
+
+  e->index.clear();
+  e->index.reserve(e->host_addresses.size());
+  for(int i=e->host_addresses.size()-1;i>=0;i--) {
+    e->index[IndexKey(e->host_addresses.at(i),e->slot_numbers.at(i))]=i;
+  }
+}
+
+
+quint64 EndPointMap::IndexKey(const QHostAddress &host_addr,int slot)
+{
+  return ((quint64)host_addr.toIPv4Address()<<32)|(0xFFFFFFFF&(quint64)slot);
+}
@@ -23,10 +23,12 @@
 
 #include <stdio.h>
 
+#include <QHash>
 #include <QHostAddress>
 #include <QList>
 #include <QString>
 #include <QStringList>
+#include <QVector>
 
 #define ENDPOINTMAP_MAP_DIRECTORY "/etc/drouter/maps.d"
 #define ENDPOINTMAP_MAP_FILTER QString("*.map")
@@ -90,13 +92,25 @@ class EndPointMap
   static QString typeString(Type type);
 
  private:
+  //
+  // One column per attribute, plus an index from (IPv4,slot) to the
+  // lowest endpoint number having that address
+  //
+  struct EndPoints {
+    QVector<QHostAddress> host_addresses;
+    QVector<int> slot_numbers;
+    QVector<QString> names;
+    QVector<bool> name_is_customs;
+    QHash<quint64,int> index;
+  };
+  void Append(Type type,const QHostAddress &host_addr,int slot,
+	      const QString &name,bool name_is_custom);
+  void Reindex(Type type);
+  static quint64 IndexKey(const QHostAddress &host_addr,int slot);
   QString map_router_name;
   int map_router_number;
   RouterType map_router_type;
-  QList<QHostAddress> map_host_addresses[EndPointMap::LastType];
-  QList<int> map_slots[EndPointMap::LastType];
-  QStringList map_names[EndPointMap::LastType];
-  QList<bool> map_name_is_customs[EndPointMap::LastType];
+  EndPoints map_endpoints[EndPointMap::LastType];
   QList<Snapshot *> map_snapshots;
 };
 
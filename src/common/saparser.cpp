@@ -33,8 +33,6 @@ SaParser::SaParser(QObject *parent)
   sa_reading_snapshots=false;
   sa_current_router=-1;
   sa_last_router=-1;
-  sa_prev_input=0;
-  sa_prev_output=0;
   sa_last_xpoint_router=-1;
   sa_last_xpoint_output=-1;
 
@@ -79,109 +77,109 @@ bool SaParser::isConnected() const
 
 bool SaParser::gpioSupported(int router) const
 {
-  return sa_gpio_supporteds.value(router);
+  return RouterAt(router).gpio_supported;
 }
 
 
 int SaParser::inputQuantity(int router) const
 {
-  return sa_input_is_reals[router].size();
+  return RouterAt(router).input_quantity;
 }
 
 
 bool SaParser::inputIsReal(int router,int input) const
 {
-  return sa_input_is_reals[router][input];
+  return EndpointAt(RouterAt(router).inputs,input).is_real;
 }
 
 
 QString SaParser::inputNodeName(int router,int input) const
 {
-  return sa_input_node_names[router][input];
+  return EndpointAt(RouterAt(router).inputs,input).node_name;
 }
 
 
 QHostAddress SaParser::inputNodeAddress(int router,int input) const
 {
-  return sa_input_node_addresses[router][input];
+  return EndpointAt(RouterAt(router).inputs,input).node_address;
 }
 
 
 int SaParser::inputNodeSlotNumber(int router,int input) const
 {
-  return sa_input_node_slot_numbers[router][input];
+  return EndpointAt(RouterAt(router).inputs,input).node_slot_number;
 }
 
 
 QString SaParser::inputName(int router,int input) const
 {
-  return sa_input_names[router][input];
+  return EndpointAt(RouterAt(router).inputs,input).name;
 }
 
 
 QString SaParser::inputLongName(int router,int input) const
 {
-  return sa_input_long_names[router][input];
+  return EndpointAt(RouterAt(router).inputs,input).long_name;
 }
 
 
 int SaParser::inputSourceNumber(int router,int input) const
 {
-  return sa_input_source_numbers[router][input];
+  return EndpointAt(RouterAt(router).inputs,input).source_number;
 }
 
 
 QHostAddress SaParser::inputStreamAddress(int router,int input) const
 {
-  return sa_input_stream_addresses[router][input];
+  return EndpointAt(RouterAt(router).inputs,input).stream_address;
 }
 
 
 int SaParser::outputQuantity(int router) const
 {
-  return sa_output_names[router].size();
+  return RouterAt(router).output_quantity;
 }
 
 
 bool SaParser::outputIsReal(int router,int output) const
 {
-  return sa_output_is_reals[router][output];
+  return EndpointAt(RouterAt(router).outputs,output).is_real;
 }
 
 
 QString SaParser::outputNodeName(int router,int output) const
 {
-  return sa_output_node_names[router][output];
+  return EndpointAt(RouterAt(router).outputs,output).node_name;
 }
 
 
 QHostAddress SaParser::outputNodeAddress(int router,int output) const
 {
-  return sa_output_node_addresses[router][output];
+  return EndpointAt(RouterAt(router).outputs,output).node_address;
 }
 
 
 int SaParser::outputNodeSlotNumber(int router,int output) const
 {
-  return sa_output_node_slot_numbers[router][output];
+  return EndpointAt(RouterAt(router).outputs,output).node_slot_number;
 }
 
 
 QString SaParser::outputName(int router,int output) const
 {
-  return sa_output_names[router][output];
+  return EndpointAt(RouterAt(router).outputs,output).name;
 }
 
 
 QString SaParser::outputLongName(int router,int output) const
 {
-  return sa_output_long_names[router][output];
+  return EndpointAt(RouterAt(router).outputs,output).long_name;
 }
 
 
 int SaParser::outputCrosspoint(int router,int output) const
 {
-  return sa_output_xpoints[router][output];
+  return EndpointAt(RouterAt(router).outputs,output).xpoint;
 }
 
 
@@ -193,7 +191,7 @@ void SaParser::setOutputCrosspoint(int router,int output,int input)
 
 QString SaParser::gpiState(int router,int input) const
 {
-  return sa_gpi_states[router][input];
+  return EndpointAt(RouterAt(router).inputs,input).gpio_state;
 }
 
 
@@ -212,7 +210,7 @@ void SaParser::setGpiState(int router,int input,const QString &code,int msec)
 
 QString SaParser::gpoState(int router,int output) const
 {
-  return sa_gpo_states[router][output];
+  return EndpointAt(RouterAt(router).outputs,output).gpio_state;
 }
 
 
@@ -231,13 +229,13 @@ void SaParser::setGpoState(int router,int output,const QString &code,int msec)
 
 int SaParser::snapshotQuantity(int router) const
 {
-  return sa_snapshot_names[router].size();
+  return RouterAt(router).snapshot_names.size();
 }
 
 
 QString SaParser::snapshotName(int router,int n) const
 {
-  return sa_snapshot_names[router].at(n);
+  return RouterAt(router).snapshot_names.at(n);
 }
 
 
@@ -345,26 +343,61 @@ void SaParser::errorData(QAbstractSocket::SocketError err)
 }
 
 
+SaParser::Endpoint::Endpoint()
+{
+  is_real=false;
+  node_slot_number=0;
+  source_number=0;
+  xpoint=0;
+}
+
+
+SaParser::Router::Router()
+{
+  gpio_supported=false;
+  input_quantity=0;
+  output_quantity=0;
+  last_output=0;
+}
+
+
+const SaParser::Router &SaParser::RouterAt(int router) const
+{
+  QMap<int,Router>::const_iterator it=sa_routers.constFind(router);
+
+  if(it==sa_routers.constEnd()) {
+    return sa_null_router;
+  }
+  return it.value();
+}
+
+
+const SaParser::Endpoint &SaParser::EndpointAt(const QVector<Endpoint> &endpts,
+					       int n) const
+{
+  if((n<0)||(n>=endpts.size())) {
+    return sa_null_endpoint;
+  }
+  return endpts.at(n);
+}
+
+
+SaParser::Endpoint *SaParser::EditEndpoint(QVector<Endpoint> *endpts,int n)
+{
+  if((n<0)||(n>=SAPARSER_MAX_ENDPOINTS)) {
+    return NULL;
+  }
+  if(n>=endpts->size()) {
+    endpts->resize(n+1);
+  }
+  return endpts->data()+n;
+}
+
+
 void SaParser::Clear()
 {
   sa_router_names.clear();
-  sa_input_node_names.clear();
-  sa_input_node_slot_numbers.clear();
-  sa_input_node_addresses.clear();
-  sa_input_names.clear();
-  sa_input_long_names.clear();
-  sa_input_source_numbers.clear();
-  sa_input_stream_addresses.clear();
-  sa_output_node_names.clear();
-  sa_output_node_addresses.clear();
-  sa_output_node_slot_numbers.clear();
-  sa_output_names.clear();
-  sa_output_long_names.clear();
-  sa_output_xpoints.clear();
-  sa_gpi_states.clear();
-  sa_gpo_states.clear();
-  sa_gpio_supporteds.clear();
-  sa_snapshot_names.clear();
+  sa_routers.clear();
 }
 
 
@@ -407,21 +440,20 @@ void SaParser::DispatchCommand(QString cmd)
       sa_current_router=f0[3].toInt(&ok);
       if(ok) {
 	if(f0[1]=="sourcenames") {
-	  sa_input_names[sa_current_router].clear();
-	  sa_input_long_names[sa_current_router].clear();
-	  sa_input_source_numbers[sa_current_router].clear();
-	  sa_input_stream_addresses[sa_current_router].clear();
-	  sa_prev_input=0;
+	  Router *rtr=&sa_routers[sa_current_router];
+	  rtr->inputs.clear();
+	  rtr->input_quantity=0;
 	  sa_reading_sources=true;
 	}
 	if(f0[1]=="destnames") {
-	  sa_output_names[sa_current_router].clear();
-	  sa_output_long_names[sa_current_router].clear();
-	  sa_prev_output=0;
+	  Router *rtr=&sa_routers[sa_current_router];
+	  rtr->outputs.clear();
+	  rtr->output_quantity=0;
+	  rtr->last_output=0;
 	  sa_reading_dests=true;
 	}
 	if(f0[1]=="snapshotnames") {
-	  sa_snapshot_names[sa_current_router].clear();
+	  sa_routers[sa_current_router].snapshot_names.clear();
 	  sa_reading_snapshots=true;
 	}
       }
@@ -462,13 +494,11 @@ void SaParser::DispatchCommand(QString cmd)
 	if((f0[1]=="snapshotnames")&&(sa_current_router==sa_last_router)) {
 	  for(QMap<int,QString>::const_iterator it=sa_router_names.begin();
 	      it!=sa_router_names.end();it++) {
-	    if(sa_output_names[it.key()].size()>0) {
+	    const Router &rtr=RouterAt(it.key());
+	    if(rtr.output_quantity>0) {
 	      SendCommand(QString::asprintf("RouteStat %u\r\n",it.key()));
 	      sa_last_xpoint_router=it.key();
-	      QMap<int,QString>::const_iterator it2=
-		sa_output_names[it.key()].end();
-	      it2--;
-	      sa_last_xpoint_output=it2.key();
+	      sa_last_xpoint_output=rtr.last_output;
 	    }
 	  }
 	  sa_reading_snapshots=false;
@@ -509,7 +539,10 @@ void SaParser::DispatchCommand(QString cmd)
       if(ok) {
 	int input=f0[3].toInt(&ok);
 	if(ok) {
-	  sa_output_xpoints[router][output]=input;
+	  Endpoint *endpt=EditEndpoint(&sa_routers[router].outputs,output);
+	  if(endpt!=NULL) {
+	    endpt->xpoint=input;
+	  }
 	  emit outputCrosspointChanged(router,output,input);
 	  if((router==sa_last_xpoint_router)&&(output==sa_last_xpoint_output)) {
 	    sa_last_xpoint_router=-1;
@@ -532,11 +565,14 @@ void SaParser::DispatchCommand(QString cmd)
   //
   if((f0[0]=="gpistat")&&(f0.size()==4)) {
     int router=f0[1].toUInt(&ok);
-    sa_gpio_supporteds[router]=true;
+    sa_routers[router].gpio_supported=true;
     if(ok) {
       int input=f0[2].toInt(&ok);
       if(ok) {
-	sa_gpi_states[router][input]=f0[3];
+	Endpoint *endpt=EditEndpoint(&sa_routers[router].inputs,input);
+	if(endpt!=NULL) {
+	  endpt->gpio_state=f0[3];
+	}
 	emit gpiStateChanged(router,input,f0[3]);
       }
     }
@@ -550,7 +586,10 @@ void SaParser::DispatchCommand(QString cmd)
     if(ok) {
       int output=f0[2].toInt(&ok);
       if(ok) {
-	sa_gpo_states[router][output]=f0[3];
+	Endpoint *endpt=EditEndpoint(&sa_routers[router].outputs,output);
+	if(endpt!=NULL) {
+	  endpt->gpio_state=f0[3];
+	}
 	emit gpoStateChanged(router,output,f0[3]);
       }
     }
@@ -583,68 +622,63 @@ void SaParser::ReadSourceName(const QString &cmd)
   int srcnum=0;
   int input=f0.at(0).toInt(&ok);
   QHostAddress addr;
+  Router *rtr=&sa_routers[sa_current_router];
+  Endpoint *endpt=NULL;
 
   if(ok) {
-    for(int i=sa_prev_input+1;i<input;i++) {
-      sa_input_is_reals[sa_current_router][i]=false;
-    }
     if(f0.size()==8) {
       srcnum=f0[6].toInt(&ok);
     }
-    if(f0.size()>=3) {
+    if((f0.size()>=3)&&((endpt=EditEndpoint(&rtr->inputs,input))!=NULL)) {
       QStringList f1=f0.at(2).split("ON");
-      sa_input_node_names[sa_current_router][input]=f1.back().trimmed();
+      endpt->node_name=f1.back().trimmed();
       if(addr.setAddress(f0.at(3))) {
-	sa_input_node_addresses[sa_current_router][input]=addr;
+	endpt->node_address=addr;
       }
       int slot=f0.at(5).toUInt(&ok);
       if(ok) {
-	sa_input_node_slot_numbers[sa_current_router][input]=slot-1;
+	endpt->node_slot_number=slot-1;
       }
       if(f0[1].trimmed().isEmpty()) {
-	if(sa_gpio_supporteds[sa_current_router]) {
-	  sa_input_names[sa_current_router][input]=
-	    tr("GPI")+QString::asprintf(" %d",input);
-	  sa_input_long_names[sa_current_router][input]=
-	    tr("GPI")+QString::asprintf(" %d",input)+f0[2];
+	if(rtr->gpio_supported) {
+	  endpt->name=tr("GPI")+QString::asprintf(" %d",input);
+	  endpt->long_name=tr("GPI")+QString::asprintf(" %d",input)+f0[2];
 	}
 	else {
-	  sa_input_names[sa_current_router][input]=
-	    tr("Input")+QString::asprintf(" %d",input);
-	  sa_input_long_names[sa_current_router][input]=
-	    tr("Input")+QString::asprintf(" %d",input)+f0[2];
+	  endpt->name=tr("Input")+QString::asprintf(" %d",input);
+	  endpt->long_name=tr("Input")+QString::asprintf(" %d",input)+f0[2];
 	}
       }
       else {
-	sa_input_names[sa_current_router][input]=f0[1];
-	sa_input_long_names[sa_current_router][input]=f0[2];
+	endpt->name=f0[1];
+	endpt->long_name=f0[2];
       }
-      sa_input_is_reals[sa_current_router][input]=true;
+      endpt->is_real=true;
       if(ok) {
 	if(srcnum<=0) {
-	  //	  sa_input_long_names[sa_current_router][input]=f0[2];
-	  sa_input_source_numbers[sa_current_router][input]=-1;
-	  sa_input_stream_addresses[sa_current_router][input]=QHostAddress();
+	  endpt->source_number=-1;
+	  endpt->stream_address=QHostAddress();
 	}
 	else {
-	  //	  sa_input_long_names[sa_current_router][input]=f0[2];
-	  sa_input_source_numbers[sa_current_router][input]=f0.at(6).toInt();
+	  endpt->source_number=f0.at(6).toInt();
 	  QHostAddress addr;
 	  if(addr.setAddress(f0.at(7))) {
-	    sa_input_stream_addresses[sa_current_router][input]=addr;
+	    endpt->stream_address=addr;
 	  }
 	  else {
-	    sa_input_stream_addresses[sa_current_router][input]=QHostAddress();
+	    endpt->stream_address=QHostAddress();
 	  }
 	}
       }
       else {
-	sa_input_long_names[sa_current_router][input]=f0[2];
-	sa_input_source_numbers[sa_current_router][input]=-1;
-	sa_input_stream_addresses[sa_current_router][input]=QHostAddress();
+	endpt->long_name=f0[2];
+	endpt->source_number=-1;
+	endpt->stream_address=QHostAddress();
+      }
+      if(input>rtr->input_quantity) {
+	rtr->input_quantity=input;
       }
     }
-    sa_prev_input=input;
   }
 }
 
@@ -655,66 +689,41 @@ void SaParser::ReadDestName(const QString &cmd)
   bool ok=false;
   int output=f0.at(0).toInt(&ok);
   QHostAddress addr;
+  Router *rtr=&sa_routers[sa_current_router];
+  Endpoint *endpt=NULL;
 
   if(f0.size()>=3) {
-    for(int i=sa_prev_output+1;i<output;i++) {
-      sa_output_is_reals[sa_current_router][i]=false;
-    }
-    if(ok) {
+    if(ok&&((endpt=EditEndpoint(&rtr->outputs,output))!=NULL)) {
       QStringList f1=f0.at(2).split("ON");
-      sa_output_node_names[sa_current_router][output]=f1.back().trimmed();
-      sa_output_names[sa_current_router][output]=f0.at(1);
-      sa_output_is_reals[sa_current_router][output]=true;
-      sa_output_long_names[sa_current_router][output]=f0.at(2);
+      endpt->node_name=f1.back().trimmed();
+      endpt->name=f0.at(1);
+      if(!endpt->is_real) {
+	endpt->is_real=true;
+	rtr->output_quantity++;
+      }
+      if(output>rtr->last_output) {
+	rtr->last_output=output;
+      }
+      endpt->long_name=f0.at(2);
       if(f0.size()>=4) {
 	if(addr.setAddress(f0.at(3))) {
-	  sa_output_node_addresses[sa_current_router][output]=addr;
+	  endpt->node_address=addr;
 	}
 	if(f0.size()>=6) {
 	  int slot=f0.at(5).toUInt(&ok);
 	  if(ok) {
-	    sa_output_node_slot_numbers[sa_current_router][output]=slot-1;
+	    endpt->node_slot_number=slot-1;
 	  }
 	}
       }
     }
-    sa_prev_output=output;
   }
 }
 
 
 void SaParser::ReadSnapshotName(const QString &cmd)
 {
-  sa_snapshot_names[sa_current_router].push_back(cmd.trimmed());
-}
-
-
-void SaParser::BubbleSort(std::map<unsigned,QString> *names,
-			    std::vector<unsigned> *ptrs)
-{
-  //
-  // Reset Pointer Table
-  //
-  ptrs->clear();
-  for(unsigned i=0;i<names->size();i++) {
-    ptrs->push_back(i);
-  }
-
-  //
-  // Sort
-  //
-  bool changed=true;
-  while(changed) {
-    changed=false;
-    for(unsigned i=1;i<names->size();i++) {
-      if((*names)[ptrs->at(i-1)]>(*names)[ptrs->at(i)]) {
-	unsigned ptr=ptrs->at(i-1);
-	ptrs->at(i-1)=ptrs->at(i);
-	ptrs->at(i)=ptr;
-	changed=true;
-      }
-    }
-  }
+  sa_routers[sa_current_router].snapshot_names.push_back(cmd.trimmed());
 }
 
 
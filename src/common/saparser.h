@@ -24,9 +24,6 @@
 
 #include <stdint.h>
 
-#include <map>
-#include <vector>
-
 #include <QHostAddress>
 #include <QList>
 #include <QMap>
@@ -34,9 +31,11 @@
 #include <QStringList>
 #include <QTcpSocket>
 #include <QTimer>
+#include <QVector>
 
 #define SAPARSER_STARTUP_INTERVAL 1000
 #define SAPARSER_HOLDOFF_INTERVAL 5000
+#define SAPARSER_MAX_ENDPOINTS 65536
 
 class SaParser : public QObject
 {
@@ -96,14 +95,41 @@ class SaParser : public QObject
   void errorData(QAbstractSocket::SocketError err);
 
  private:
+  //
+  // One input or output, stored at the index of its endpoint number
+  //
+  struct Endpoint {
+    Endpoint();
+    bool is_real;
+    QString node_name;
+    QHostAddress node_address;
+    int node_slot_number;
+    QString name;
+    QString long_name;
+    int source_number;
+    QHostAddress stream_address;
+    int xpoint;
+    QString gpio_state;
+  };
+  struct Router {
+    Router();
+    bool gpio_supported;
+    int input_quantity;
+    int output_quantity;
+    int last_output;
+    QVector<Endpoint> inputs;
+    QVector<Endpoint> outputs;
+    QStringList snapshot_names;
+  };
+  const Router &RouterAt(int router) const;
+  const Endpoint &EndpointAt(const QVector<Endpoint> &endpts,int n) const;
+  Endpoint *EditEndpoint(QVector<Endpoint> *endpts,int n);
   void Clear();
   void DispatchCommand(QString cmd);
   void ReadRouterName(const QString &cmd);
   void ReadSourceName(const QString &cmd);
   void ReadDestName(const QString &cmd);
   void ReadSnapshotName(const QString &cmd);
-  void BubbleSort(std::map<unsigned,QString> *names,
-		  std::vector<unsigned> *ptrs);
   void SendCommand(const QString &cmd);
   void MakeSocket();
   QTcpSocket *sa_socket;
@@ -123,27 +149,9 @@ class SaParser : public QObject
   QMap<int,QString> sa_router_names;
   int sa_current_router;
   int sa_last_router;
-  int sa_prev_input;
-  int sa_prev_output;
-  QMap<int,QMap<int,QString> > sa_input_node_names;
-  QMap<int,QMap<int,QHostAddress> > sa_input_node_addresses;
-  QMap<int,QMap<int,int> > sa_input_node_slot_numbers;
-  QMap<int,QMap<int,bool> > sa_input_is_reals;
-  QMap<int,QMap<int,QString> > sa_input_names;
-  QMap<int,QMap<int,QString> > sa_input_long_names;
-  QMap<int,QMap<int,int> > sa_input_source_numbers;
-  QMap<int,QMap<int,QHostAddress> > sa_input_stream_addresses;
-  QMap<int,QMap<int,QString> > sa_output_node_names;
-  QMap<int,QMap<int,QHostAddress> > sa_output_node_addresses;
-  QMap<int,QMap<int,int> > sa_output_node_slot_numbers;
-  QMap<int,QMap<int,bool> > sa_output_is_reals;
-  QMap<int,QMap<int,QString> > sa_output_names;
-  QMap<int,QMap<int,QString> > sa_output_long_names;
-  QMap<int,QMap<int,int> > sa_output_xpoints;
-  QMap<int,QMap<int,QString> > sa_gpi_states;
-  QMap<int,QMap<int,QString> > sa_gpo_states;
-  QMap<int,bool> sa_gpio_supporteds;
-  QMap<int,QStringList> sa_snapshot_names;
+  QMap<int,Router> sa_routers;
+  Router sa_null_router;
+  Endpoint sa_null_endpoint;
   QTimer *sa_startup_timer;
   QTimer *sa_holdoff_timer;
 };
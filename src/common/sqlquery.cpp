@@ -30,18 +30,23 @@
 #include <QString>
 #include <QTextCodec>
 #include <QTranslator>
+#include <QSqlDatabase>
 #include <QSqlError>
 #include <QStringList>
 #include <QVariant>
 
 #include "sqlquery.h"
 
+SqlStatementCache *SqlQuery::sql_statements=NULL;
+
 SqlQuery::SqlQuery (const QString &query):
   QSqlQuery(query)
 {
   QSqlDatabase db;
   QString err_msg;
-  sql_columns=0;
+  sql_query=query;
+  sql_cacheable=false;
+  sql_columns=-1;
   /*
   if (!isActive() && reconnect) {
     db = QSqlDatabase::database();
@@ -62,25 +67,35 @@ SqlQuery::SqlQuery (const QString &query):
     }
   }
   */
-  if(isActive()) {
-    //printf("QUERY: %s\n",(const char *)query.toUtf8());
-    QStringList f0=query.split(" ");
-    if(f0[0].toLower()=="select") {
-      for(int i=1;i<f0.size();i++) {
-	if(f0[i].toLower()=="from") {
-	  QString fields;
-	  for(int j=1;j<i;j++) {
-	    fields+=f0[j];
-	  }
-	  QStringList f1=fields.split(",");
-	  sql_columns=f1.size();
-	  continue;
-	}
-      }
-    }
+  if(!isActive()) {
+    err_msg=QObject::tr("invalid SQL or failed DB connection")+
+      +"["+lastError().text()+"]: "+query;
+
+    syslog(LOG_WARNING,"%s",err_msg.toUtf8().constData());
+  }
+}
+
+
+SqlQuery::SqlQuery(const QString &query,const QVariantList &values)
+  : QSqlQuery(Statements()->take(query))
+{
+  sql_query=query;
+  sql_cacheable=false;
+  sql_columns=-1;
+
+  //
+  // 'query' is the statement shape, with a '?' placeholder for each
+  // entry in 'values'. The prepared handle is checked out of the cache
+  // for the lifetime of this object and handed back by the destructor.
+  //
+  for(int i=0;i<values.size();i++) {
+    bindValue(i,values.at(i));
+  }
+  if(exec()) {
+    sql_cacheable=true;
   }
   else {
-    err_msg=QObject::tr("invalid SQL or failed DB connection")+
+    QString err_msg=QObject::tr("invalid SQL or failed DB connection")+
       +"["+lastError().text()+"]: "+query;
 
     syslog(LOG_WARNING,"%s",err_msg.toUtf8().constData());
@@ -88,8 +103,23 @@ SqlQuery::SqlQuery (const QString &query):
 }
 
 
+SqlQuery::~SqlQuery()
+{
+  if(sql_cacheable) {
+    finish();
+    Statements()->release(sql_query,*this);
+  }
+}
+
+
 int SqlQuery::columns() const
 {
+  if(sql_columns<0) {
+    sql_columns=0;
+    if(isActive()) {
+      sql_columns=ColumnCount(sql_query);
+    }
+  }
   return sql_columns;
 }
 
@@ -121,6 +151,21 @@ QVariant SqlQuery::run(const QString &sql,bool *ok)
 }
 
 
+QVariant SqlQuery::run(const QString &sql,const QVariantList &values,bool *ok)
+{
+  QVariant ret;
+
+  SqlQuery *q=new SqlQuery(sql,values);
+  if(ok!=NULL) {
+    *ok=q->isActive();
+  }
+  ret=q->lastInsertId();
+  delete q;
+
+  return ret;
+}
+
+
 bool SqlQuery::apply(const QString &sql,QString *err_msg)
 {
   bool ret=false;
@@ -136,6 +181,22 @@ bool SqlQuery::apply(const QString &sql,QString *err_msg)
 }
 
 
+bool SqlQuery::apply(const QString &sql,const QVariantList &values,
+		     QString *err_msg)
+{
+  bool ret=false;
+
+  SqlQuery *q=new SqlQuery(sql,values);
+  ret=q->isActive();
+  if((err_msg!=NULL)&&(!ret)) {
+    *err_msg="sql error: "+q->lastError().text()+" query: "+sql;
+  }
+  delete q;
+
+  return ret;
+}
+
+
 int SqlQuery::rows(const QString &sql)
 {
   int ret=0;
@@ -182,3 +243,138 @@ QString SqlQuery::escape(const QString &str)
 
   return res;
 }
+
+
+bool SqlQuery::isConnectionError(const QSqlError &err)
+{
+  //
+  // CR_CONNECTION_ERROR, CR_CONN_HOST_ERROR, CR_SERVER_GONE_ERROR and
+  // CR_SERVER_LOST from the MySQL client library
+  //
+  QString code=err.nativeErrorCode();
+
+  return (err.type()==QSqlError::ConnectionError)||
+    (code=="2002")||(code=="2003")||(code=="2006")||(code=="2013");
+}
+
+
+int SqlQuery::cachedStatements()
+{
+  if(sql_statements==NULL) {
+    return 0;
+  }
+  return sql_statements->size();
+}
+
+
+void SqlQuery::clearStatementCache()
+{
+  if(sql_statements!=NULL) {
+    sql_statements->clear();
+  }
+}
+
+
+SqlStatementCache *SqlQuery::Statements()
+{
+  if(sql_statements==NULL) {
+    sql_statements=new SqlStatementCache(QSqlDatabase::defaultConnection);
+  }
+  return sql_statements;
+}
+
+
+int SqlQuery::ColumnCount(const QString &sql)
+{
+  QStringList f0=sql.split(" ");
+  int ret=0;
+
+  if(f0[0].toLower()=="select") {
+    for(int i=1;i<f0.size();i++) {
+      if(f0[i].toLower()=="from") {
+	QString fields;
+	for(int j=1;j<i;j++) {
+	  fields+=f0[j];
+	}
+	QStringList f1=fields.split(",");
+	ret=f1.size();
+	continue;
+      }
+    }
+  }
+
+  return ret;
+}
+
+
+SqlStatementCache::SqlStatementCache(const QString &conn_name,
+				     int max_statements)
+{
+  cache_connection_name=conn_name;
+  cache_max_statements=max_statements;
+  cache_clock=0;
+  cache_thread=QThread::currentThread();
+}
+
+
+QSqlQuery SqlStatementCache::take(const QString &sql)
+{
+  Q_ASSERT(QThread::currentThread()==cache_thread);
+  QHash<QString,QSqlQuery>::iterator it=cache_statements.find(sql);
+
+  if(it!=cache_statements.end()) {
+    QSqlQuery ret=it.value();
+    cache_statements.erase(it);
+    cache_lru.remove(cache_stamps.take(sql));
+    return ret;
+  }
+
+  //
+  // Not cached, or already checked out by an outer query of the same shape
+  //
+  QSqlQuery ret(QSqlDatabase::database(cache_connection_name,false));
+  ret.setForwardOnly(true);
+  if(!ret.prepare(sql)) {
+    syslog(LOG_WARNING,"unable to prepare statement [%s]: %s",
+	   ret.lastError().text().toUtf8().constData(),
+	   sql.toUtf8().constData());
+  }
+  return ret;
+}
+
+
+void SqlStatementCache::release(const QString &sql,const QSqlQuery &query)
+{
+  Q_ASSERT(QThread::currentThread()==cache_thread);
+
+  if(cache_statements.contains(sql)) {
+    cache_lru.remove(cache_stamps.value(sql));
+  }
+  else {
+    while((!cache_lru.isEmpty())&&
+	  (cache_statements.size()>=cache_max_statements)) {
+      QString oldest=cache_lru.take(cache_lru.firstKey());
+      cache_statements.remove(oldest);
+      cache_stamps.remove(oldest);
+    }
+  }
+  cache_statements[sql]=query;
+  cache_stamps[sql]=++cache_clock;
+  cache_lru[cache_clock]=sql;
+}
+
+
+int SqlStatementCache::size() const
+{
+  return cache_statements.size();
+}
+
+
+void SqlStatementCache::clear()
+{
+  Q_ASSERT(QThread::currentThread()==cache_thread);
+
+  cache_statements.clear();
+  cache_stamps.clear();
+  cache_lru.clear();
+}
@@ -22,23 +22,81 @@
 #ifndef SQLQUERY_H
 #define SQLQUERY_H
 
+#include <QHash>
+#include <QMap>
+#include <QSqlError>
 #include <QString>
 #include <QSqlQuery>
+#include <QThread>
 #include <QVariant>
 
+//
+// Default maximum number of prepared statements kept per connection
+//
+#define SQLQUERY_MAX_STATEMENTS 256
+
+//
+// Prepared statements for one database connection, keyed by their SQL
+// text. A statement is checked out with take() and handed back with
+// release() once finished; when full, the least recently used one is
+// dropped. Like the connection itself, a cache may only be used from
+// the thread that created it, and must be cleared whenever the
+// connection is re-opened.
+//
+class SqlStatementCache
+{
+ public:
+  SqlStatementCache(const QString &conn_name,
+		    int max_statements=SQLQUERY_MAX_STATEMENTS);
+  QSqlQuery take(const QString &sql);
+  void release(const QString &sql,const QSqlQuery &query);
+  int size() const;
+  void clear();
+
+ private:
+  QString cache_connection_name;
+  int cache_max_statements;
+  QHash<QString,QSqlQuery> cache_statements;
+  QHash<QString,quint64> cache_stamps;
+  QMap<quint64,QString> cache_lru;
+  quint64 cache_clock;
+  QThread *cache_thread;
+};
+
+
+//
+// Queries with bound values are prepared through a statement cache on
+// the default connection. That cache belongs to the thread that first
+// runs such a query; other threads must use their own connection (and,
+// if they need one, their own SqlStatementCache).
+//
 class SqlQuery : public QSqlQuery
 {
  public:
   SqlQuery(const QString &query);
+  SqlQuery(const QString &query,const QVariantList &values);
+  ~SqlQuery();
   int columns() const;
   QVariant value(int index) const;
   static QVariant run(const QString &sql,bool *ok=NULL);
+  static QVariant run(const QString &sql,const QVariantList &values,
+		      bool *ok=NULL);
   static bool apply(const QString &sql,QString *err_msg=NULL);
+  static bool apply(const QString &sql,const QVariantList &values,
+		    QString *err_msg=NULL);
   static int rows(const QString &sql);
   static QString escape(const QString &str);
+  static bool isConnectionError(const QSqlError &err);
+  static int cachedStatements();
+  static void clearStatementCache();
 
  private:
-  int sql_columns;
+  static SqlStatementCache *Statements();
+  static int ColumnCount(const QString &sql);
+  QString sql_query;
+  bool sql_cacheable;
+  mutable int sql_columns;
+  static SqlStatementCache *sql_statements;
 };
 
 
@@ -0,0 +1,333 @@
+// changejournal.cpp
+//
+// Shared memory journal of Drouter change notifications
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "changejournal.h"
+
+ChangeJournal::ChangeJournal()
+{
+  journal_base=NULL;
+  journal_size=0;
+  journal_writeable=false;
+  journal_header=NULL;
+  journal_ring=NULL;
+
+  uint32_t epoch=0xFFFFFFFF&(time(NULL)^(getpid()<<16));
+  if(epoch==0) {
+    epoch=1;
+  }
+  journal_sequence=(quint64)epoch<<32;
+}
+
+
+ChangeJournal::~ChangeJournal()
+{
+  if(journal_writeable&&(journal_header!=NULL)) {
+    journal_header->valid=0;
+    shm_unlink(DROUTER_JOURNAL_NAME);
+  }
+  Unmap();
+}
+
+
+bool ChangeJournal::create(int size,QString *err_msg)
+{
+  int fd=-1;
+
+  //
+  // Start from a fresh object, so that processes still mapping a
+  // previous instance keep their (now invalid) copy.
+  //
+  shm_unlink(DROUTER_JOURNAL_NAME);
+  if((fd=shm_open(DROUTER_JOURNAL_NAME,O_CREAT|O_EXCL|O_RDWR,
+		  S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH))<0) {
+    *err_msg=QString("unable to create change journal [")+
+      strerror(errno)+"]";
+    return false;
+  }
+  journal_size=sizeof(Header)+size;
+  if(ftruncate(fd,journal_size)<0) {
+    *err_msg=QString("unable to size change journal [")+strerror(errno)+"]";
+    close(fd);
+    shm_unlink(DROUTER_JOURNAL_NAME);
+    return false;
+  }
+  if(!Map(fd,true,err_msg)) {
+    close(fd);
+    shm_unlink(DROUTER_JOURNAL_NAME);
+    return false;
+  }
+  close(fd);
+
+  memset(journal_header,0,sizeof(Header));
+  journal_header->magic=DROUTER_JOURNAL_MAGIC;
+  journal_header->version=DROUTER_JOURNAL_VERSION;
+  journal_header->size=size;
+  journal_header->first_sequence=journal_sequence+1;
+  journal_header->last_sequence=journal_sequence;
+  __atomic_store_n(&journal_header->valid,1,__ATOMIC_RELEASE);
+
+  return true;
+}
+
+
+bool ChangeJournal::attach(QString *err_msg)
+{
+  int fd=-1;
+  struct stat st;
+
+  if((fd=shm_open(DROUTER_JOURNAL_NAME,O_RDONLY,0))<0) {
+    *err_msg=QString("unable to open change journal [")+strerror(errno)+"]";
+    return false;
+  }
+  if(fstat(fd,&st)<0) {
+    *err_msg=QString("unable to stat change journal [")+strerror(errno)+"]";
+    close(fd);
+    return false;
+  }
+  if((size_t)st.st_size<sizeof(Header)) {
+    *err_msg="change journal is truncated";
+    close(fd);
+    return false;
+  }
+  journal_size=st.st_size;
+  if(!Map(fd,false,err_msg)) {
+    close(fd);
+    return false;
+  }
+  close(fd);
+  if((journal_header->magic!=DROUTER_JOURNAL_MAGIC)||
+     (journal_header->version!=DROUTER_JOURNAL_VERSION)||
+     (journal_header->size==0)) {
+    *err_msg="change journal has an unknown format";
+    Unmap();
+    return false;
+  }
+  if((sizeof(Header)+journal_header->size)>journal_size) {
+    *err_msg="change journal is truncated";
+    Unmap();
+    return false;
+  }
+
+  return true;
+}
+
+
+bool ChangeJournal::isValid() const
+{
+  return (journal_header!=NULL)&&
+    (__atomic_load_n(&journal_header->valid,__ATOMIC_ACQUIRE)!=0);
+}
+
+
+quint64 ChangeJournal::sequence() const
+{
+  return journal_sequence;
+}
+
+
+QByteArray ChangeJournal::append(ProtoIpcMessage *msg)
+{
+  msg->setSequence(++journal_sequence);
+  QByteArray data=msg->frame();
+
+  if((!journal_writeable)||(journal_header==NULL)) {
+    return data;
+  }
+  Header *hdr=journal_header;
+  uint64_t len=data.size();
+
+  __atomic_store_n(&hdr->seq,hdr->seq+1,__ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  if(len>hdr->size) {
+    //
+    // Too big to keep, so nothing up to here can be replayed
+    //
+    hdr->tail=hdr->head;
+    hdr->first_sequence=journal_sequence+1;
+  }
+  else {
+    while((hdr->head+len-hdr->tail)>hdr->size) {
+      hdr->tail+=FrameLength(hdr->tail);
+    }
+    if(hdr->tail==hdr->head) {
+      hdr->first_sequence=journal_sequence;
+    }
+    else {
+      hdr->first_sequence=FrameSequence(hdr->tail);
+    }
+    Write(hdr->head,data.constData(),len);
+    hdr->head+=len;
+  }
+  hdr->last_sequence=journal_sequence;
+  __atomic_store_n(&hdr->seq,hdr->seq+1,__ATOMIC_RELEASE);
+
+  return data;
+}
+
+
+bool ChangeJournal::changes(quint64 since,quint64 last,
+			    QList<ProtoIpcMessage> *msgs) const
+{
+  //
+  // Returns false if any of the changes after 'since' are no longer
+  // held, in which case the caller must fall back to a full dump
+  //
+  uint32_t seq;
+  uint64_t head;
+  uint64_t tail;
+  uint64_t first;
+  uint64_t newest;
+  QByteArray data;
+  ProtoIpcMessage msg;
+
+  msgs->clear();
+  if(!isValid()) {
+    return false;
+  }
+  for(int i=0;i<DROUTER_JOURNAL_MAX_RETRIES;i++) {
+    seq=__atomic_load_n(&journal_header->seq,__ATOMIC_ACQUIRE);
+    if((seq&1)!=0) {
+      continue;
+    }
+    head=journal_header->head;
+    tail=journal_header->tail;
+    first=journal_header->first_sequence;
+    newest=journal_header->last_sequence;
+    if((head<tail)||((head-tail)>journal_header->size)) {
+      continue;
+    }
+    if(((since>>32)==(newest>>32))&&(since<=last)&&(last<=newest)&&
+       ((since+1)>=first)) {
+      data.resize(head-tail);
+      Read(tail,data.data(),head-tail);
+    }
+    else {
+      data.clear();
+      first=0;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&journal_header->seq,__ATOMIC_RELAXED)!=seq) {
+      continue;
+    }
+    if(first==0) {
+      return false;
+    }
+    while(msg.takeFrame(&data)) {
+      if((msg.sequence()>since)&&(msg.sequence()<=last)) {
+	msgs->push_back(msg);
+      }
+    }
+    return true;
+  }
+
+  return false;
+}
+
+
+bool ChangeJournal::Map(int fd,bool writeable,QString *err_msg)
+{
+  int prot=PROT_READ;
+
+  if(writeable) {
+    prot|=PROT_WRITE;
+  }
+  if((journal_base=mmap(NULL,journal_size,prot,MAP_SHARED,fd,0))==
+     MAP_FAILED) {
+    *err_msg=QString("unable to map change journal [")+strerror(errno)+"]";
+    journal_base=NULL;
+    return false;
+  }
+  journal_writeable=writeable;
+  journal_header=(Header *)journal_base;
+  journal_ring=(char *)journal_base+sizeof(Header);
+
+  return true;
+}
+
+
+void ChangeJournal::Unmap()
+{
+  if(journal_base!=NULL) {
+    munmap(journal_base,journal_size);
+  }
+  journal_base=NULL;
+  journal_size=0;
+  journal_header=NULL;
+  journal_ring=NULL;
+}
+
+
+void ChangeJournal::Read(uint64_t pos,char *data,uint64_t len) const
+{
+  uint64_t offset=pos%journal_header->size;
+  uint64_t n=journal_header->size-offset;
+
+  if(n>len) {
+    n=len;
+  }
+  memcpy(data,journal_ring+offset,n);
+  memcpy(data+n,journal_ring,len-n);
+}
+
+
+void ChangeJournal::Write(uint64_t pos,const char *data,uint64_t len)
+{
+  uint64_t offset=pos%journal_header->size;
+  uint64_t n=journal_header->size-offset;
+
+  if(n>len) {
+    n=len;
+  }
+  memcpy(journal_ring+offset,data,n);
+  memcpy(journal_ring,data+n,len-n);
+}
+
+
+uint32_t ChangeJournal::FrameLength(uint64_t pos) const
+{
+  unsigned char hdr[4];
+
+  Read(pos,(char *)hdr,4);
+
+  return 4+(((uint32_t)hdr[0]<<24)|((uint32_t)hdr[1]<<16)|
+	    ((uint32_t)hdr[2]<<8)|(uint32_t)hdr[3]);
+}
+
+
+uint64_t ChangeJournal::FrameSequence(uint64_t pos) const
+{
+  unsigned char hdr[8];
+  uint64_t ret=0;
+
+  Read(pos+5,(char *)hdr,8);
+  for(int i=0;i<8;i++) {
+    ret=(ret<<8)|hdr[i];
+  }
+
+  return ret;
+}
@@ -0,0 +1,92 @@
+// changejournal.h
+//
+// Shared memory journal of Drouter change notifications
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef CHANGEJOURNAL_H
+#define CHANGEJOURNAL_H
+
+#include <stdint.h>
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include "protoipc.h"
+
+/*
+ * The POSIX shared memory object name
+ */
+#define DROUTER_JOURNAL_NAME "/drouter-journal"
+#define DROUTER_JOURNAL_MAGIC 0x44524a4e
+#define DROUTER_JOURNAL_VERSION 1
+#define DROUTER_JOURNAL_MAX_RETRIES 100
+
+//
+// Ring of the most recent core->protocol change notifications, written
+// by drouterd(8) and mapped read-only by the protocol processes so that
+// a reconnecting client can be sent just the changes it missed.
+//
+// Each change is stamped with a sequence number whose upper 32 bits
+// identify this instance of the journal and whose lower 32 bits count
+// the changes made, so that numbers handed out by an earlier instance
+// (or by the other member of a tethered pair) are never mistaken for
+// ones from this one. When the ring is full, the oldest frames are
+// dropped to make room. A header sequence counter guards the ring
+// bounds in the same way as in StateSnapshot.
+//
+class ChangeJournal
+{
+ public:
+  ChangeJournal();
+  ~ChangeJournal();
+  bool create(int size,QString *err_msg);
+  bool attach(QString *err_msg);
+  bool isValid() const;
+  quint64 sequence() const;
+  QByteArray append(ProtoIpcMessage *msg);
+  bool changes(quint64 since,quint64 last,QList<ProtoIpcMessage> *msgs) const;
+
+ private:
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t valid;
+    uint32_t seq;
+    uint64_t size;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t first_sequence;
+    uint64_t last_sequence;
+  };
+  bool Map(int fd,bool writeable,QString *err_msg);
+  void Unmap();
+  void Read(uint64_t pos,char *data,uint64_t len) const;
+  void Write(uint64_t pos,const char *data,uint64_t len);
+  uint32_t FrameLength(uint64_t pos) const;
+  uint64_t FrameSequence(uint64_t pos) const;
+  void *journal_base;
+  size_t journal_size;
+  bool journal_writeable;
+  Header *journal_header;
+  char *journal_ring;
+  quint64 journal_sequence;
+};
+
+
+#endif  // CHANGEJOURNAL_H
@@ -0,0 +1,171 @@
+// clientqueue.cpp
+//
+// Bounded output queue for a protocol client connection
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <syslog.h>
+
+#include "clientqueue.h"
+
+ClientQueue::ClientQueue(QTcpSocket *socket,int sock,qint64 high_water,
+			 qint64 low_water,int stall_timeout,QObject *parent)
+  : QObject(parent)
+{
+  queue_socket=socket;
+  queue_sock=sock;
+  queue_high_water=high_water;
+  queue_low_water=low_water;
+  queue_stall_timeout=stall_timeout;
+  queue_congested=false;
+  queue_overflowed=false;
+  queue_seq=0;
+  queue_pending_bytes=0;
+
+  connect(queue_socket,SIGNAL(bytesWritten(qint64)),
+	  this,SLOT(bytesWrittenData(qint64)));
+
+  queue_stall_timer=new QTimer(this);
+  queue_stall_timer->setSingleShot(true);
+  connect(queue_stall_timer,SIGNAL(timeout()),this,SLOT(stallTimerData()));
+}
+
+
+qint64 ClientQueue::depth() const
+{
+  return queue_socket->bytesToWrite()+queue_pending_bytes;
+}
+
+
+int ClientQueue::conflated() const
+{
+  return queue_pending.size();
+}
+
+
+bool ClientQueue::isCongested() const
+{
+  return queue_congested;
+}
+
+
+void ClientQueue::update(const QByteArray &key,const QByteArray &data)
+{
+  if(queue_overflowed||data.isEmpty()) {
+    return;
+  }
+  if(!queue_congested) {
+    queue_socket->write(data);
+    if(queue_socket->bytesToWrite()>queue_high_water) {
+      SetCongested(true);
+    }
+    return;
+  }
+
+  //
+  // Hold only the latest update for each key, in the order last updated
+  //
+  QHash<QByteArray,Pending>::iterator it=queue_pending.find(key);
+  if(it==queue_pending.end()) {
+    it=queue_pending.insert(key,Pending());
+  }
+  else {
+    queue_order.remove(it.value().seq);
+    queue_pending_bytes-=it.value().data.size();
+  }
+  it.value().seq=queue_seq++;
+  it.value().data=data;
+  queue_order[it.value().seq]=key;
+  queue_pending_bytes+=data.size();
+
+  if(queue_pending_bytes>queue_high_water) {
+    Overflow("update queue overflow");
+  }
+}
+
+
+void ClientQueue::flush()
+{
+  QByteArray data;
+
+  if(queue_pending.size()==0) {
+    return;
+  }
+  for(QMap<quint64,QByteArray>::const_iterator it=queue_order.constBegin();
+      it!=queue_order.constEnd();it++) {
+    data+=queue_pending.value(it.value()).data;
+  }
+  queue_pending.clear();
+  queue_order.clear();
+  queue_pending_bytes=0;
+  queue_socket->write(data);
+}
+
+
+void ClientQueue::bytesWrittenData(qint64)
+{
+  if(queue_congested&&(queue_socket->bytesToWrite()<=queue_low_water)) {
+    flush();
+    SetCongested(queue_socket->bytesToWrite()>queue_high_water);
+  }
+}
+
+
+void ClientQueue::stallTimerData()
+{
+  Overflow("slow client");
+}
+
+
+void ClientQueue::SetCongested(bool state)
+{
+  if(state==queue_congested) {
+    return;
+  }
+  queue_congested=state;
+  if(state) {
+    syslog(LOG_INFO,"client %s:%u congested, %lld bytes queued",
+	   queue_socket->peerAddress().toString().toUtf8().constData(),
+	   0xFFFF&queue_socket->peerPort(),depth());
+    if(queue_stall_timeout>0) {
+      queue_stall_timer->start(1000*queue_stall_timeout);
+    }
+  }
+  else {
+    syslog(LOG_INFO,"client %s:%u recovered",
+	   queue_socket->peerAddress().toString().toUtf8().constData(),
+	   0xFFFF&queue_socket->peerPort());
+    queue_stall_timer->stop();
+  }
+}
+
+
+void ClientQueue::Overflow(const char *reason)
+{
+  //
+  // Nothing more is sent; the client resynchronizes when it reconnects
+  //
+  syslog(LOG_WARNING,"%s at %s:%u, %lld bytes queued, disconnecting",reason,
+	 queue_socket->peerAddress().toString().toUtf8().constData(),
+	 0xFFFF&queue_socket->peerPort(),depth());
+  queue_overflowed=true;
+  queue_stall_timer->stop();
+  queue_pending.clear();
+  queue_order.clear();
+  queue_pending_bytes=0;
+  emit overflowed(queue_sock);
+}
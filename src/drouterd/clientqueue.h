@@ -0,0 +1,81 @@
+// clientqueue.h
+//
+// Bounded output queue for a protocol client connection
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef CLIENTQUEUE_H
+#define CLIENTQUEUE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+#include <QObject>
+#include <QTcpSocket>
+#include <QTimer>
+
+//
+// Unsolicited updates are written straight to the socket until more than
+// 'high_water' bytes are waiting to be sent. From then on, only the latest
+// update for each key is held, and the held updates are written once the
+// socket has drained below 'low_water'. Should the held updates grow past
+// 'high_water' themselves, or the client stay congested for longer than
+// 'stall_timeout' seconds, overflowed() is emitted so that the connection
+// can be dropped and the client left to resynchronize.
+//
+class ClientQueue : public QObject
+{
+  Q_OBJECT;
+ public:
+  ClientQueue(QTcpSocket *socket,int sock,qint64 high_water,
+	      qint64 low_water,int stall_timeout,QObject *parent=0);
+  qint64 depth() const;
+  int conflated() const;
+  bool isCongested() const;
+  void update(const QByteArray &key,const QByteArray &data);
+  void flush();
+
+ signals:
+  void overflowed(int sock);
+
+ private slots:
+  void bytesWrittenData(qint64);
+  void stallTimerData();
+
+ private:
+  struct Pending {
+    quint64 seq;
+    QByteArray data;
+  };
+  void SetCongested(bool state);
+  void Overflow(const char *reason);
+  QTcpSocket *queue_socket;
+  int queue_sock;
+  qint64 queue_high_water;
+  qint64 queue_low_water;
+  int queue_stall_timeout;
+  bool queue_congested;
+  bool queue_overflowed;
+  QHash<QByteArray,Pending> queue_pending;
+  QMap<quint64,QByteArray> queue_order;
+  quint64 queue_seq;
+  qint64 queue_pending_bytes;
+  QTimer *queue_stall_timer;
+};
+
+
+#endif  // CLIENTQUEUE_H
@@ -0,0 +1,480 @@
+// dbwriter.cpp
+//
+// Background database writer for drouterd(8)
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <syslog.h>
+
+#include <QMutexLocker>
+
+#include "dbwriter.h"
+
+DbWriter::DbWriter(int max_queue,QObject *parent)
+  : QThread(parent)
+{
+  writer_max_queue=max_queue;
+  writer_statements=NULL;
+  writer_head=0;
+  writer_barrier=-1;
+  writer_unkeyed=0;
+  writer_max_depth=0;
+  writer_in_flight=0;
+  writer_connected=false;
+  writer_overflowed=false;
+  writer_quit=false;
+  writer_writes=0;
+  writer_coalesced=0;
+  writer_dropped=0;
+  writer_flushes=0;
+  writer_last_flush_msecs=0;
+  writer_max_flush_msecs=0;
+}
+
+
+DbWriter::~DbWriter()
+{
+  if(isRunning()) {
+    stop();
+  }
+}
+
+
+void DbWriter::enqueue(const QString &key,const QString &sql,
+		       const QVariantList &values)
+{
+  QMutexLocker locker(&writer_mutex);
+
+  if(!key.isEmpty()) {
+    QHash<QString,qint64>::const_iterator it=writer_keys.find(key);
+    if((it!=writer_keys.end())&&(it.value()>writer_barrier)) {
+      Write &w=writer_queue[it.value()-writer_head];
+      w.sql=sql;
+      w.values=values;
+      writer_coalesced++;
+      return;
+    }
+  }
+  else {
+    //
+    // Only unkeyed writes are bounded. Keyed writes are never discarded,
+    // as the mirrored row would otherwise stay stale, and are bounded
+    // anyway by the number of rows they update.
+    //
+    if(writer_unkeyed>=writer_max_queue) {
+      if(!writer_overflowed) {
+	syslog(LOG_WARNING,"database write queue full (%d unkeyed writes), "
+	       "discarding new unkeyed writes",writer_unkeyed);
+	writer_overflowed=true;
+      }
+      writer_dropped++;
+      return;
+    }
+  }
+  Write w;
+  w.key=key;
+  w.sql=sql;
+  w.values=values;
+  w.barrier=false;
+  if(key.isEmpty()) {
+    writer_unkeyed++;
+  }
+  else {
+    writer_keys[key]=writer_head+writer_queue.size();
+  }
+  writer_queue.push_back(w);
+  if(writer_queue.size()>writer_max_depth) {
+    writer_max_depth=writer_queue.size();
+  }
+  writer_queued.wakeOne();
+}
+
+
+void DbWriter::enqueueBarrier(const QString &sql,const QVariantList &values)
+{
+  QMutexLocker locker(&writer_mutex);
+  Write w;
+
+  w.sql=sql;
+  w.values=values;
+  w.barrier=true;
+  writer_barrier=writer_head+writer_queue.size();
+  writer_queue.push_back(w);
+  if(writer_queue.size()>writer_max_depth) {
+    writer_max_depth=writer_queue.size();
+  }
+  writer_queued.wakeOne();
+}
+
+
+bool DbWriter::flush(int msecs)
+{
+  QMutexLocker locker(&writer_mutex);
+  QElapsedTimer timer;
+
+  timer.start();
+  while((!writer_queue.isEmpty())||(writer_in_flight>0)) {
+    qint64 remaining=msecs-timer.elapsed();
+    if(remaining<=0) {
+      return false;
+    }
+    writer_drained.wait(&writer_mutex,remaining);
+  }
+
+  return true;
+}
+
+
+void DbWriter::stop(unsigned long msecs)
+{
+  writer_mutex.lock();
+  writer_quit=true;
+  writer_queued.wakeAll();
+  writer_mutex.unlock();
+  if(!wait(msecs)) {
+    syslog(LOG_WARNING,"timed out waiting for the database writer to stop");
+  }
+}
+
+
+bool DbWriter::isConnected() const
+{
+  QMutexLocker locker(&writer_mutex);
+
+  return writer_connected;
+}
+
+
+int DbWriter::queueDepth() const
+{
+  QMutexLocker locker(&writer_mutex);
+
+  return writer_queue.size()+writer_in_flight;
+}
+
+
+int DbWriter::maxQueueDepth() const
+{
+  QMutexLocker locker(&writer_mutex);
+
+  return writer_max_depth;
+}
+
+
+qint64 DbWriter::writes() const
+{
+  QMutexLocker locker(&writer_mutex);
+
+  return writer_writes;
+}
+
+
+qint64 DbWriter::coalesced() const
+{
+  QMutexLocker locker(&writer_mutex);
+
+  return writer_coalesced;
+}
+
+
+qint64 DbWriter::dropped() const
+{
+  QMutexLocker locker(&writer_mutex);
+
+  return writer_dropped;
+}
+
+
+qint64 DbWriter::flushes() const
+{
+  QMutexLocker locker(&writer_mutex);
+
+  return writer_flushes;
+}
+
+
+qint64 DbWriter::lastFlushMsecs() const
+{
+  QMutexLocker locker(&writer_mutex);
+
+  return writer_last_flush_msecs;
+}
+
+
+qint64 DbWriter::maxFlushMsecs() const
+{
+  QMutexLocker locker(&writer_mutex);
+
+  return writer_max_flush_msecs;
+}
+
+
+QString DbWriter::statistics() const
+{
+  QMutexLocker locker(&writer_mutex);
+  QString ret=
+    QString::asprintf("queue=%d max_queue=%d ",
+		      writer_queue.size()+writer_in_flight,writer_max_depth)+
+    QString::asprintf("writes=%lld coalesced=%lld dropped=%lld ",
+		      writer_writes,writer_coalesced,writer_dropped)+
+    QString::asprintf("flushes=%lld last_flush_ms=%lld max_flush_ms=%lld ",
+		      writer_flushes,writer_last_flush_msecs,
+		      writer_max_flush_msecs);
+  if(writer_connected) {
+    ret+="connected=yes";
+  }
+  else {
+    ret+="connected=no";
+  }
+
+  return ret;
+}
+
+
+void DbWriter::run()
+{
+  QList<Write> batch;
+  QElapsedTimer timer;
+  int retry_interval=DBWRITER_MIN_RETRY_INTERVAL;
+  int applied=0;
+  bool ok=false;
+
+  //
+  // Statements are prepared on the writer connection, and so belong to
+  // this thread
+  //
+  writer_statements=
+    new SqlStatementCache(DBWRITER_CONNECTION_NAME,DBWRITER_MAX_STATEMENTS);
+  writer_mutex.lock();
+  while(true) {
+    while(writer_queue.isEmpty()&&(!writer_quit)) {
+      writer_drained.wakeAll();
+      writer_queued.wait(&writer_mutex);
+    }
+    if(writer_queue.isEmpty()) {
+      break;
+    }
+
+    //
+    // Take the next batch. Its keys are released, so a write queued from
+    // here on starts a new entry rather than modifying one in flight.
+    //
+    batch=writer_queue.mid(0,DBWRITER_MAX_BATCH);
+    writer_queue.erase(writer_queue.begin(),
+		       writer_queue.begin()+batch.size());
+    for(int i=0;i<batch.size();i++) {
+      const QString &key=batch.at(i).key;
+      if(key.isEmpty()) {
+	if(!batch.at(i).barrier) {
+	  writer_unkeyed--;
+	}
+      }
+      else {
+	if(writer_keys.value(key,-1)==(writer_head+i)) {
+	  writer_keys.remove(key);
+	}
+      }
+    }
+    writer_head+=batch.size();
+    writer_in_flight=batch.size();
+    writer_mutex.unlock();
+
+    timer.start();
+    applied=0;
+    ok=Connect()&&Apply(batch,&applied);
+
+    writer_mutex.lock();
+    writer_in_flight=0;
+    writer_writes+=applied;
+    if(ok) {
+      writer_flushes++;
+      writer_last_flush_msecs=timer.elapsed();
+      if(writer_last_flush_msecs>writer_max_flush_msecs) {
+	writer_max_flush_msecs=writer_last_flush_msecs;
+      }
+      if(writer_overflowed&&(writer_unkeyed<writer_max_queue)) {
+	syslog(LOG_WARNING,"database write queue recovered, %lld write(s) lost",
+	       writer_dropped);
+	writer_overflowed=false;
+      }
+      retry_interval=DBWRITER_MIN_RETRY_INTERVAL;
+      continue;
+    }
+
+    //
+    // Put back whatever was not applied, ahead of anything queued since.
+    // A keyed write that has been superseded in the meantime is dropped,
+    // as the newer one updates the same row.
+    //
+    for(int i=batch.size()-1;i>=applied;i--) {
+      const Write &w=batch.at(i);
+      if(w.key.isEmpty()) {
+	if(w.barrier) {
+	  if((writer_head-1)>writer_barrier) {
+	    writer_barrier=writer_head-1;
+	  }
+	}
+	else {
+	  writer_unkeyed++;
+	}
+      }
+      else {
+	if(writer_keys.contains(w.key)) {
+	  continue;
+	}
+	writer_keys[w.key]=writer_head-1;
+      }
+      writer_queue.push_front(w);
+      writer_head--;
+    }
+    if(writer_quit) {
+      syslog(LOG_WARNING,
+	     "database unavailable at shutdown, %d write(s) lost",
+	     writer_queue.size());
+      break;
+    }
+
+    //
+    // Back off before trying the connection again
+    //
+    timer.start();
+    while((!writer_quit)&&(timer.elapsed()<retry_interval)) {
+      writer_queued.wait(&writer_mutex,retry_interval-timer.elapsed());
+    }
+    retry_interval*=2;
+    if(retry_interval>DBWRITER_MAX_RETRY_INTERVAL) {
+      retry_interval=DBWRITER_MAX_RETRY_INTERVAL;
+    }
+  }
+  writer_drained.wakeAll();
+  writer_mutex.unlock();
+
+  Disconnect();
+  delete writer_statements;
+  writer_statements=NULL;
+  QSqlDatabase::removeDatabase(DBWRITER_CONNECTION_NAME);
+}
+
+
+bool DbWriter::Connect()
+{
+  if(writer_connected) {
+    return true;
+  }
+
+  //
+  // Scoped so that no QSqlDatabase copy outlives a later removeDatabase()
+  //
+  {
+    QSqlDatabase db;
+    if(QSqlDatabase::contains(DBWRITER_CONNECTION_NAME)) {
+      db=QSqlDatabase::database(DBWRITER_CONNECTION_NAME,false);
+    }
+    else {
+      db=QSqlDatabase::addDatabase("QMYSQL3",DBWRITER_CONNECTION_NAME);
+      db.setHostName("localhost");
+      db.setDatabaseName("drouter");
+      db.setUserName("drouter");
+      db.setPassword("drouter");
+    }
+    if(!db.open()) {
+      syslog(LOG_WARNING,"database writer unable to connect [%s]",
+	     db.lastError().driverText().toUtf8().constData());
+      return false;
+    }
+  }
+  writer_mutex.lock();
+  writer_connected=true;
+  writer_mutex.unlock();
+  syslog(LOG_DEBUG,"database writer connected");
+
+  return true;
+}
+
+
+void DbWriter::Disconnect()
+{
+  writer_statements->clear();
+  if(QSqlDatabase::contains(DBWRITER_CONNECTION_NAME)) {
+    QSqlDatabase::database(DBWRITER_CONNECTION_NAME,false).close();
+  }
+  writer_mutex.lock();
+  writer_connected=false;
+  writer_mutex.unlock();
+}
+
+
+bool DbWriter::Apply(const QList<Write> &batch,int *applied)
+{
+  QSqlDatabase db=QSqlDatabase::database(DBWRITER_CONNECTION_NAME,false);
+  bool txn=db.transaction();
+
+  *applied=0;
+  for(int i=0;i<batch.size();i++) {
+    const Write &w=batch.at(i);
+    QSqlQuery q(db);
+    bool ok=false;
+
+    //
+    // Literal barrier statements are one-offs, so not worth preparing
+    //
+    bool cached=!(w.barrier&&w.values.isEmpty());
+    if(!cached) {
+      ok=q.exec(w.sql);
+    }
+    else {
+      q=writer_statements->take(w.sql);
+      for(int j=0;j<w.values.size();j++) {
+	q.bindValue(j,w.values.at(j));
+      }
+      ok=q.exec();
+    }
+    if(!ok) {
+      if(SqlQuery::isConnectionError(q.lastError())) {
+	syslog(LOG_WARNING,"database writer lost connection [%s]",
+	       q.lastError().text().toUtf8().constData());
+	if(txn) {
+	  db.rollback();
+	}
+	else {
+	  *applied=i;
+	}
+	Disconnect();
+	return false;
+      }
+      syslog(LOG_WARNING,"database writer sql error [%s]: %s",
+	     q.lastError().text().toUtf8().constData(),
+	     w.sql.toUtf8().constData());
+      continue;
+    }
+    q.finish();
+    if(cached) {
+      writer_statements->release(w.sql,q);
+    }
+  }
+  if(txn&&(!db.commit())) {
+    syslog(LOG_WARNING,"database writer unable to commit [%s]",
+	   db.lastError().text().toUtf8().constData());
+    if(SqlQuery::isConnectionError(db.lastError())) {
+      Disconnect();
+      return false;
+    }
+  }
+  *applied=batch.size();
+
+  return true;
+}
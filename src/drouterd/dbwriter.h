@@ -0,0 +1,121 @@
+// dbwriter.h
+//
+// Background database writer for drouterd(8)
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef DBWRITER_H
+#define DBWRITER_H
+
+#include <limits.h>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QString>
+#include <QThread>
+#include <QVariant>
+#include <QWaitCondition>
+
+#include "sqlquery.h"
+
+#define DBWRITER_CONNECTION_NAME "dbwriter"
+#define DBWRITER_MAX_BATCH 500
+#define DBWRITER_MAX_STATEMENTS 256
+#define DBWRITER_MIN_RETRY_INTERVAL 1000
+#define DBWRITER_MAX_RETRY_INTERVAL 30000
+
+//
+// Applies database writes from its own thread and connection, so that a
+// slow or unreachable server never stalls the main event loop.
+//
+// Writes queued with the same non-empty key replace one another in place
+// (later values win, queue position is kept) and are never discarded.
+// At most 'max_queue' unkeyed writes are held; beyond that, new unkeyed
+// writes are discarded and counted by dropped(). A write queued with
+// enqueueBarrier() is never discarded either, and a keyed write queued
+// after it is never coalesced into one queued before it, so is applied
+// after it. Writes are applied in queue order, up to DBWRITER_MAX_BATCH
+// at a time in a single transaction. If the connection fails, the batch
+// is put back at the head of the queue and replayed once the connection
+// is re-established.
+//
+class DbWriter : public QThread
+{
+  Q_OBJECT;
+ public:
+  DbWriter(int max_queue,QObject *parent=0);
+  ~DbWriter();
+  void enqueue(const QString &key,const QString &sql,
+	       const QVariantList &values);
+  void enqueueBarrier(const QString &sql,
+		      const QVariantList &values=QVariantList());
+  bool flush(int msecs);
+  void stop(unsigned long msecs=ULONG_MAX);
+  bool isConnected() const;
+  int queueDepth() const;
+  int maxQueueDepth() const;
+  qint64 writes() const;
+  qint64 coalesced() const;
+  qint64 dropped() const;
+  qint64 flushes() const;
+  qint64 lastFlushMsecs() const;
+  qint64 maxFlushMsecs() const;
+  QString statistics() const;
+
+ protected:
+  void run();
+
+ private:
+  struct Write {
+    QString key;
+    QString sql;
+    QVariantList values;
+    bool barrier;
+  };
+  bool Connect();
+  void Disconnect();
+  bool Apply(const QList<Write> &batch,int *applied);
+  QList<Write> writer_queue;
+  QHash<QString,qint64> writer_keys;
+  qint64 writer_head;
+  qint64 writer_barrier;
+  int writer_unkeyed;
+  SqlStatementCache *writer_statements;
+  int writer_max_queue;
+  int writer_max_depth;
+  int writer_in_flight;
+  bool writer_connected;
+  bool writer_overflowed;
+  bool writer_quit;
+  qint64 writer_writes;
+  qint64 writer_coalesced;
+  qint64 writer_dropped;
+  qint64 writer_flushes;
+  qint64 writer_last_flush_msecs;
+  qint64 writer_max_flush_msecs;
+  mutable QMutex writer_mutex;
+  QWaitCondition writer_queued;
+  QWaitCondition writer_drained;
+};
+
+
+#endif  // DBWRITER_H
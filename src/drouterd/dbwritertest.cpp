@@ -0,0 +1,199 @@
+// dbwritertest.cpp
+//
+// Test that the database writer converges after overflowing its queue
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <QCoreApplication>
+#include <QSqlDatabase>
+#include <QSqlError>
+
+#include <sy5/sycmdswitch.h>
+
+#include "dbwritertest.h"
+#include "sqlquery.h"
+
+MainObject::MainObject(QObject *parent)
+  : QObject(parent)
+{
+  bool ok=false;
+  bool result=true;
+
+  test_queue_size=10;
+  test_rows=1000;
+  test_passes=5;
+  test_timeout=10000;
+
+  SyCmdSwitch *cmd=new SyCmdSwitch("dbwritertest",VERSION,DBWRITERTEST_USAGE);
+  for(int i=0;i<cmd->keys();i++) {
+    if(cmd->key(i)=="--queue-size") {
+      test_queue_size=cmd->value(i).toInt(&ok);
+      if((!ok)||(test_queue_size<1)) {
+	fprintf(stderr,"dbwritertest: invalid --queue-size value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--rows") {
+      test_rows=cmd->value(i).toInt(&ok);
+      if((!ok)||(test_rows<1)) {
+	fprintf(stderr,"dbwritertest: invalid --rows value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--passes") {
+      test_passes=cmd->value(i).toInt(&ok);
+      if((!ok)||(test_passes<2)) {
+	fprintf(stderr,"dbwritertest: invalid --passes value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--timeout") {
+      test_timeout=cmd->value(i).toInt(&ok);
+      if((!ok)||(test_timeout<1)) {
+	fprintf(stderr,"dbwritertest: invalid --timeout value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(!cmd->processed(i)) {
+      fprintf(stderr,"dbwritertest: unknown option \"%s\"\n",
+	      cmd->key(i).toUtf8().constData());
+      exit(1);
+    }
+  }
+
+  //
+  // Open Database
+  //
+  // The writer uses a connection of its own, so the scratch table must
+  // be a real one rather than TEMPORARY.
+  //
+  QSqlDatabase db=QSqlDatabase::addDatabase("QMYSQL3");
+  db.setHostName("localhost");
+  db.setDatabaseName("drouter");
+  db.setUserName("drouter");
+  db.setPassword("drouter");
+  if(!db.open()) {
+    fprintf(stderr,"dbwritertest: unable to open database [%s]\n",
+	    db.lastError().driverText().toUtf8().constData());
+    exit(1);
+  }
+  SqlQuery::apply("drop table if exists `" DBWRITERTEST_TABLE "`");
+  if(!SqlQuery::apply("create table `" DBWRITERTEST_TABLE "` ("
+		      "ID int not null primary key,"
+		      "VALUE int not null,"
+		      "HITS int not null default 0)")) {
+    fprintf(stderr,"dbwritertest: unable to create scratch table\n");
+    exit(1);
+  }
+
+  //
+  // Overflow the queue before the writer starts, with far more keyed
+  // rows than it is sized for, followed by twice its size of unkeyed
+  // writes
+  //
+  DbWriter *writer=new DbWriter(test_queue_size,this);
+  for(int i=0;i<(test_passes-1);i++) {
+    EnqueuePass(writer,i);
+  }
+  for(int i=0;i<(2*test_queue_size);i++) {
+    writer->enqueue("","update `" DBWRITERTEST_TABLE "` set HITS=HITS+1 "
+		    "where ID=?",QVariantList()<<0);
+  }
+
+  //
+  // The last pass goes in while the writer is draining
+  //
+  writer->start();
+  EnqueuePass(writer,test_passes-1);
+  if(!writer->flush(test_timeout)) {
+    fprintf(stderr,"dbwritertest: timed out waiting for the writer\n");
+    result=false;
+  }
+  result=Check(writer,test_passes-1)&&result;
+  printf("%s\n",writer->statistics().toUtf8().constData());
+  writer->stop();
+  delete writer;
+
+  SqlQuery::apply("drop table if exists `" DBWRITERTEST_TABLE "`");
+
+  printf("dbwritertest: %s\n",result ? "PASSED" : "FAILED");
+  exit(!result);
+}
+
+
+void MainObject::EnqueuePass(DbWriter *writer,int pass) const
+{
+  for(int i=0;i<test_rows;i++) {
+    writer->enqueue(QString::asprintf(DBWRITERTEST_TABLE ":%d",i),
+		    "insert into `" DBWRITERTEST_TABLE "` set "
+		    "ID=?,VALUE=? on duplicate key update VALUE=?",
+		    QVariantList()<<i<<pass<<pass);
+  }
+}
+
+
+bool MainObject::Check(DbWriter *writer,int pass) const
+{
+  bool ret=true;
+  SqlQuery *q=NULL;
+
+  //
+  // Every keyed row holds its final value
+  //
+  q=new SqlQuery(QString::asprintf("select count(*) from `"
+				   DBWRITERTEST_TABLE "` where VALUE=%d",
+				   pass));
+  if((!q->first())||(q->value(0).toInt()!=test_rows)) {
+    fprintf(stderr,"dbwritertest: %d of %d keyed rows converged\n",
+	    q->value(0).toInt(),test_rows);
+    ret=false;
+  }
+  delete q;
+
+  //
+  // Only the unkeyed writes beyond the queue size were discarded
+  //
+  q=new SqlQuery("select HITS from `" DBWRITERTEST_TABLE "` where ID=0");
+  if((!q->first())||(q->value(0).toInt()!=test_queue_size)) {
+    fprintf(stderr,"dbwritertest: %d of %d unkeyed writes applied\n",
+	    q->value(0).toInt(),test_queue_size);
+    ret=false;
+  }
+  delete q;
+  if(writer->dropped()!=test_queue_size) {
+    fprintf(stderr,"dbwritertest: %lld writes dropped, expected %d\n",
+	    writer->dropped(),test_queue_size);
+    ret=false;
+  }
+
+  return ret;
+}
+
+
+int main(int argc,char *argv[])
+{
+  QCoreApplication a(argc,argv);
+  new MainObject();
+  return a.exec();
+}
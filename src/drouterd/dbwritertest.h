@@ -0,0 +1,47 @@
+// dbwritertest.h
+//
+// Test that the database writer converges after overflowing its queue
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef DBWRITERTEST_H
+#define DBWRITERTEST_H
+
+#include <QObject>
+
+#include "dbwriter.h"
+
+#define DBWRITERTEST_TABLE "DBWRITERTEST"
+#define DBWRITERTEST_USAGE "[options]\n\nOverflow the queue of the drouterd(8) database writer with keyed and\nunkeyed writes, and check that every keyed write still reaches the\ndatabase while only the excess unkeyed writes are discarded. Uses a\nscratch table called \"DBWRITERTEST\" in the local \"drouter\" database,\nwhich is dropped afterwards.\n\nOptions are:\n--queue-size=<num>\n     Writer queue size (default 10)\n\n--rows=<num>\n     Number of keyed rows to update (default 1000)\n\n--passes=<num>\n     Number of updates to each row (default 5)\n\n--timeout=<msecs>\n     Maximum time to wait for the database to converge (default 10000)\n\n"
+
+class MainObject : public QObject
+{
+ Q_OBJECT;
+ public:
+  MainObject(QObject *parent=0);
+
+ private:
+  void EnqueuePass(DbWriter *writer,int pass) const;
+  bool Check(DbWriter *writer,int pass) const;
+  int test_queue_size;
+  int test_rows;
+  int test_passes;
+  int test_timeout;
+};
+
+
+#endif  // DBWRITERTEST_H
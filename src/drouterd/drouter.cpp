@@ -42,6 +42,22 @@
 #include "protoipc.h"
 #include "sqlquery.h"
 
+DRouter::PendingTake::PendingTake()
+{
+  event_id=-1;
+  router=-1;
+  output=-1;
+  input=-1;
+  router_type=EndPointMap::LastRouter;
+  dst_id=0;
+  dst_slot=-1;
+  src_id=0;
+  src_slot=-1;
+  deadline=0;
+  started=0;
+}
+
+
 DRouter::DRouter(int *proto_socks,QObject *parent)
   : QObject(parent)
 {
@@ -53,29 +69,59 @@ DRouter::DRouter(int *proto_socks,QObject *parent)
 
   drouter_flasher=new GpioFlasher(this);
 
-  drouter_finalize_timer=new QTimer(this);
-  drouter_finalize_timer->setSingleShot(false);
-  connect(drouter_finalize_timer,SIGNAL(timeout()),
+  drouter_take_timer=new QTimer(this);
+  drouter_take_timer->setSingleShot(true);
+  connect(drouter_take_timer,SIGNAL(timeout()),this,SLOT(takeTimeoutData()));
+  drouter_take_clock.start();
+
+  drouter_finalize_events_timer=new QTimer(this);
+  connect(drouter_finalize_events_timer,SIGNAL(timeout()),
 	  this,SLOT(finalizeEventsData()));
 
   drouter_purge_events_timer=new QTimer(this);
   connect(drouter_purge_events_timer,SIGNAL(timeout()),
 	  this,SLOT(purgeEventsData()));
-  if(drouter_config->retainEventRecordsDuration()>0) {
-    drouter_purge_events_timer->
-      start(drouter_config->retainEventRecordsDuration());
-  }
+  drouter_purger=new EventPurger(drouter_config->eventPurgeChunkSize(),
+				 drouter_config->eventPurgeBudget(),
+				 drouter_config->eventPartitioning(),this);
 
   drouter_db_keepalive_timer=new QTimer(this);
   drouter_db_keepalive_timer->setSingleShot(true);
   connect(drouter_db_keepalive_timer,SIGNAL(timeout()),
 	  this,SLOT(dbKeepaliveData()));
+
+  drouter_state=new StateStore();
+  drouter_snapshot=new StateSnapshot();
+  drouter_journal=new ChangeJournal();
+
+  drouter_ingest_startup=false;
+  drouter_ingest_timer=new QTimer(this);
+  drouter_ingest_timer->setSingleShot(true);
+  connect(drouter_ingest_timer,SIGNAL(timeout()),this,SLOT(ingestData()));
+
+  drouter_writer=new DbWriter(drouter_config->dbWriterQueueSize(),this);
+  drouter_tables=new NodeTables(drouter_state,&drouter_maps,drouter_writer,
+				drouter_config->compactSchema());
+  drouter_writer_stats_timer=new QTimer(this);
+  connect(drouter_writer_stats_timer,SIGNAL(timeout()),
+	  this,SLOT(writerStatsData()));
+  drouter_purge_names_timer=new QTimer(this);
+  connect(drouter_purge_names_timer,SIGNAL(timeout()),
+	  this,SLOT(purgeNamesData()));
 }
 
 
 DRouter::~DRouter()
 {
   WriteCommentEvent(tr("Stopping Drouter service"));
+  drouter_writer->stop(DROUTER_WRITER_FLUSH_TIMEOUT);
+  drouter_purger->stop();
+  delete drouter_purger;
+  delete drouter_tables;
+  delete drouter_writer;
+  delete drouter_journal;
+  delete drouter_snapshot;
+  delete drouter_state;
 }
 
 
@@ -107,33 +153,29 @@ Matrix *DRouter::node(const QHostAddress &hostaddr)
 Matrix *DRouter::nodeBySrcStream(const QHostAddress &strmaddress,
 				       int *slot)
 {
+  unsigned id=0;
+
   if((0xFFFF&strmaddress.toIPv4Address())==0) {
     return NULL;
   }
-  for(QMap<unsigned,Matrix *>::const_iterator it=drouter_nodes.begin();
-      it!=drouter_nodes.end();it++) {
-    for(unsigned i=0;i<it.value()->srcSlots();i++) {
-      if(it.value()->srcAddress(i)==strmaddress) {
-	*slot=i;
-	return it.value();
-      }
-    }
+  if(!drouter_state->
+     sourceByStream(Config::normalizedStreamAddress(strmaddress).
+		    toIPv4Address(),&id,slot)) {
+    return NULL;
   }
-  return NULL;
+  return drouter_nodes.value(id);
 }
 
 
 SySource *DRouter::src(int srcnum) const
 {
-  for(QMap<unsigned,Matrix *>::const_iterator it=drouter_nodes.constBegin();
-      it!=drouter_nodes.constEnd();it++) {
-    for(unsigned i=0;i<it.value()->srcSlots();i++) {
-      if(it.value()->srcNumber(i)==srcnum) {
-	return it.value()->src(i);
-      }
-    }
+  unsigned id=0;
+  int slot=-1;
+
+  if(!drouter_state->sourceByNumber(srcnum,&id,&slot)) {
+    return NULL;
   }
-  return NULL;
+  return src(QHostAddress(id),slot);
 }
 
 
@@ -213,6 +255,43 @@ bool DRouter::start(QString *err_msg)
   if(!StartDb(err_msg)) {
     return false;
   }
+  drouter_writer->start();
+  drouter_purger->start();
+  if(drouter_config->retainEventRecordsDuration()>0) {
+    purgeEventsData();
+    drouter_purge_events_timer->start(DROUTER_PURGE_EVENTS_INTERVAL);
+  }
+  if(drouter_config->dbWriterStatsInterval()>0) {
+    drouter_writer_stats_timer->
+      start(1000*drouter_config->dbWriterStatsInterval());
+  }
+  if(drouter_tables->compactSchema()) {
+    drouter_purge_names_timer->start(DROUTER_PURGE_NAMES_INTERVAL);
+  }
+  if(drouter_config->stateSnapshotSlots()>0) {
+    QString snap_err;
+    if(!drouter_snapshot->create(drouter_config->stateSnapshotNodes(),
+				 drouter_config->stateSnapshotSlots(),
+				 drouter_writeable,&snap_err)) {
+      syslog(LOG_WARNING,"%s, protocols will use the database",
+	     snap_err.toUtf8().constData());
+    }
+  }
+  if(drouter_config->changeJournalSize()>0) {
+    QString journal_err;
+    if(!drouter_journal->create(drouter_config->changeJournalSize(),
+				&journal_err)) {
+      syslog(LOG_WARNING,"%s, reconnecting clients will get full dumps",
+	     journal_err.toUtf8().constData());
+    }
+  }
+  if(drouter_config->nodeStartupWindow()>0) {
+    //
+    // Collect the initial flood of node connections into a single batch
+    //
+    drouter_ingest_startup=true;
+    drouter_ingest_timer->start(drouter_config->nodeStartupWindow());
+  }
   if(!StartProtocolIpc(err_msg)) {
     return false;
   }
@@ -248,18 +327,24 @@ void DRouter::setWriteable(bool state)
     QString letter;
     if(state) {
       letter="Y";
-      drouter_finalize_timer->start(1000);
+      QTimer::singleShot(drouter_config->routeConfirmTimeout(),
+			 this,SLOT(finalizeEventsData()));
+      drouter_finalize_events_timer->start(DROUTER_FINALIZE_EVENTS_INTERVAL);
       comment=tr("This instance is now active.");
     }
     else {
       letter="N";
-      drouter_finalize_timer->stop();
+      drouter_finalize_events_timer->stop();
+      ClearPendingTakes();
       comment=tr("This instance is no longer active.");
     }
-    sql=QString("update `TETHER` set `IS_ACTIVE`='"+letter+"'");
-    SqlQuery::apply(sql);
+    sql=QString("update `TETHER` set `IS_ACTIVE`=?");
+    drouter_writer->enqueue("TETHER",sql,QVariantList()<<letter);
     drouter_writeable=state;
-    NotifyProtocols("TETHER",letter);
+    drouter_snapshot->setTetherState(state);
+    ProtoIpcMessage msg(ProtoIpcMessage::TypeTether);
+    msg.writeBool(state);
+    NotifyProtocols(msg);
 
     WriteCommentEvent(comment);
   }
@@ -268,10 +353,7 @@ void DRouter::setWriteable(bool state)
 
 void DRouter::nodeConnectedData(unsigned id,bool state)
 {
-  QString sql;
-  SqlQuery *q;
-  int endpt;
-  int last_id=0;
+  int index=-1;
 
   if(state) {
     if(node(QHostAddress(id))==NULL) {
@@ -316,145 +398,6 @@ void DRouter::nodeConnectedData(unsigned id,bool state)
 	}
       }
     }
-    LockTables();
-    sql=QString("insert into `NODES` set ")+
-      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"',"+
-      "`HOST_NAME`='"+SqlQuery::escape(mtx->hostName())+"',"+
-      "`DEVICE_NAME`='"+SqlQuery::escape(mtx->deviceName())+"',"+
-      QString::asprintf("`MATRIX_TYPE`=%u,",mtx->matrixType())+
-      QString::asprintf("`SOURCE_SLOTS`=%u,",mtx->srcSlots())+
-      QString::asprintf("`DESTINATION_SLOTS`=%u,",mtx->dstSlots())+
-      QString::asprintf("`GPI_SLOTS`=%u,",mtx->gpis())+
-      QString::asprintf("`GPO_SLOTS`=%u",mtx->gpos());
-    SqlQuery::apply(sql);
-    for(unsigned i=0;i<mtx->srcSlots();i++) {
-      sql=QString("insert into `SOURCES` set ")+
-	"`HOST_ADDRESS`='"+QHostAddress(id).toString()+"',"+
-	QString::asprintf("`SLOT`=%u,",i)+
-	"`HOST_NAME`='"+SqlQuery::escape(mtx->hostName())+"',"+
-	"`STREAM_ADDRESS`='"+
-	Config::normalizedStreamAddress(mtx->srcAddress(i)).toString()+"',"+
-	"`NAME`='"+SqlQuery::escape(mtx->srcName(i))+"',"+
-	QString::asprintf("`STREAM_ENABLED`=%u,",mtx->srcEnabled(i))+
-	QString::asprintf("`CHANNELS`=%u,",mtx->srcChannels(i))+
-	QString::asprintf("`BLOCK_SIZE`=%u",mtx->srcPacketSize(i));
-      last_id=SqlQuery::run(sql).toInt();
-      for(QMap<int,EndPointMap *>::const_iterator it=drouter_maps.begin();it!=drouter_maps.end();it++) {
-	if(it.value()->routerType()==EndPointMap::AudioRouter) {
-	  if((endpt=it.value()->endPoint(EndPointMap::Input,QHostAddress(id).toString(),i))>=0) {
-	    sql=QString("insert into `SA_SOURCES` set ")+
-	      QString::asprintf("`ROUTER_NUMBER`=%d,",it.value()->routerNumber())+
-	      QString::asprintf("`SOURCE_NUMBER`=%d,",endpt)+
-	      QString::asprintf("`SOURCE_ID`=%d,",last_id)+
-	      "`STREAM_ADDRESS`='"+
-	      Config::normalizedStreamAddress(mtx->srcAddress(i)).toString()+"',"+
-	      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"',"+
-	      QString::asprintf("SLOT=%d",i);
-	    // *************************
-	    if(!it.value()->nameIsCustom(EndPointMap::Input,endpt)) {
-	      it.value()->setName(EndPointMap::Input,endpt,mtx->srcName(i));
-	    }
-	    // *************************
-	    sql+=",`NAME`='"+
-	      SqlQuery::escape(it.value()->name(EndPointMap::Input,endpt))+"'";
-	    SqlQuery::apply(sql);
-	  }
-	}
-      }
-    }
-    for(unsigned i=0;i<mtx->dstSlots();i++) {
-      sql=QString("insert into `DESTINATIONS` set ")+
-	"`HOST_ADDRESS`='"+QHostAddress(id).toString()+"',"+
-	QString::asprintf("`SLOT`=%u,",i)+
-	"`HOST_NAME`='"+SqlQuery::escape(mtx->hostName())+"',"+
-	"`STREAM_ADDRESS`='"+
-	Config::normalizedStreamAddress(mtx->dstAddress(i)).toString()+"',"+
-	"`NAME`='"+SqlQuery::escape(mtx->dstName(i))+"',"+
-	QString::asprintf("`CHANNELS`=%u",mtx->dstChannels(i));
-      last_id=SqlQuery::run(sql).toInt();
-      for(QMap<int,EndPointMap *>::const_iterator it=drouter_maps.begin();it!=drouter_maps.end();it++) {
-	if(it.value()->routerType()==EndPointMap::AudioRouter) {
-	  if((endpt=it.value()->endPoint(EndPointMap::Output,QHostAddress(id).toString(),i))>=0) {
-	    sql=QString("insert into `SA_DESTINATIONS` set ")+
-	      QString::asprintf("`ROUTER_NUMBER`=%d,",it.value()->routerNumber())+
-	      QString::asprintf("`SOURCE_NUMBER`=%d,",endpt)+
-	      QString::asprintf("`DESTINATION_ID`=%d,",last_id)+
-	      "`STREAM_ADDRESS`='"+
-	      Config::normalizedStreamAddress(mtx->dstAddress(i)).toString()+"',"+
-	      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"',"+
-	      QString::asprintf("`SLOT`=%d",i);
-	    if(!it.value()->nameIsCustom(EndPointMap::Output,endpt)) {
-	      it.value()->setName(EndPointMap::Output,endpt,mtx->dstName(i));
-	    }
-	    sql+=",`NAME`='"+
-	      SqlQuery::escape(it.value()->name(EndPointMap::Output,endpt))+"'";
-	    SqlQuery::apply(sql);
-	  }
-	}
-      }
-    }
-    for(unsigned i=0;i<mtx->gpis();i++) {
-      sql=QString("insert into `GPIS` set ")+
-	"`HOST_ADDRESS`='"+QHostAddress(id).toString()+"',"+
-	QString::asprintf("`SLOT`=%u,",i)+
-	"`HOST_NAME`='"+SqlQuery::escape(mtx->hostName())+"',"+
-	"`CODE`='"+mtx->gpiBundle(i)->code()+"'";
-      last_id=SqlQuery::run(sql).toInt();
-      for(QMap<int,EndPointMap *>::const_iterator it=drouter_maps.begin();it!=drouter_maps.end();it++) {
-	if(it.value()->routerType()==EndPointMap::GpioRouter) {
-	  if((endpt=it.value()->endPoint(EndPointMap::Input,QHostAddress(id).toString(),i))>=0) {
-	    sql=QString("insert into `SA_GPIS` set ")+
-	      QString::asprintf("`ROUTER_NUMBER`=%d,",it.value()->routerNumber())+
-	      QString::asprintf("`SOURCE_NUMBER`=%d,",endpt)+
-	      QString::asprintf("`GPI_ID`=%d,",last_id)+
-	      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"',"+
-	      QString::asprintf("`SLOT`=%d",i);
-	    if(!it.value()->nameIsCustom(EndPointMap::Input,endpt)) {
-	      it.value()->setName(EndPointMap::Input,endpt,QString::asprintf("GPI-%d",i+1));
-	    }
-	    sql+=",`NAME`='"+
-	      SqlQuery::escape(it.value()->name(EndPointMap::Input,endpt))+"'";
-	    SqlQuery::run(sql);
-	  }
-	}
-      }
-    }
-    for(unsigned i=0;i<mtx->gpos();i++) {
-      QString name=mtx->gpo(i)->name();
-      if(name.isEmpty()) {
-	name=QString::asprintf("GPO %d",i+1);
-      }
-      sql=QString("insert into `GPOS` set ")+
-	"`HOST_ADDRESS`='"+QHostAddress(id).toString()+"',"+
-	QString::asprintf("`SLOT`=%u,",i)+
-	"`HOST_NAME`='"+SqlQuery::escape(mtx->hostName())+"',"+
-	"`CODE`='"+mtx->gpiBundle(i)->code()+"',"+
-	"`NAME`='"+SqlQuery::escape(name)+"',"+
-	"`SOURCE_ADDRESS`='"+mtx->gpo(i)->sourceAddress().toString()+"',"+
-	QString::asprintf("`SOURCE_SLOT`=%d",mtx->gpo(i)->sourceSlot());
-      last_id=SqlQuery::run(sql).toInt();
-      for(QMap<int,EndPointMap *>::const_iterator it=drouter_maps.begin();it!=drouter_maps.end();it++) {
-	if(it.value()->routerType()==EndPointMap::GpioRouter) {
-	  if((endpt=it.value()->endPoint(EndPointMap::Output,QHostAddress(id).toString(),i))>=0) {
-	    sql=QString("insert into `SA_GPOS` set ")+
-	      QString::asprintf("`ROUTER_NUMBER`=%d,",it.value()->routerNumber())+
-	      QString::asprintf("`SOURCE_NUMBER`=%d,",endpt)+
-	      QString::asprintf("`GPO_ID`=%d,",last_id)+
-	      "`SOURCE_ADDRESS`='"+mtx->gpo(i)->sourceAddress().toString()+"',"+
-	      QString::asprintf("`SOURCE_SLOT`=%d,",mtx->gpo(i)->sourceSlot())+
-	      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"',"+
-	      QString::asprintf("`SLOT`=%d",i);
-	    if(!it.value()->nameIsCustom(EndPointMap::Output,endpt)) {
-	      it.value()->
-		setName(EndPointMap::Output,endpt,mtx->gpo(i)->name());
-	    }
-	    sql+=",`NAME`='"+
-	      SqlQuery::escape(it.value()->name(EndPointMap::Output,endpt))+"'";
-	    SqlQuery::apply(sql);
-	  }
-	}
-      }
-    }
 
     for(int i=0;i<2;i++) {
       Config::TetherRole role=(Config::TetherRole)i;
@@ -468,8 +411,6 @@ void DRouter::nodeConnectedData(unsigned id,bool state)
       }
     }
 
-    UnlockTables();
-
     //
     // Send Startup LWRP
     //
@@ -482,7 +423,13 @@ void DRouter::nodeConnectedData(unsigned id,bool state)
 	     mtx->hostAddress().toString().toUtf8().constData());
     }
 
-    NotifyProtocols("NODEADD",QHostAddress(id).toString());
+    //
+    // The DB rows and NODEADD notification are written by ingestData()
+    //
+    drouter_state->addNode(mtx);
+    if(!drouter_ingest_connects.contains(id)) {
+      drouter_ingest_connects.push_back(id);
+    }
   }
   else {
     Matrix *mtx=node(QHostAddress(id));
@@ -493,49 +440,21 @@ void DRouter::nodeConnectedData(unsigned id,bool state)
     Log(drouter_config->nodeLogPriority(),
 	"node disconnected from "+QHostAddress(id).toString()+
 	" ["+mtx->hostName()+" / "+mtx->deviceName()+"]");
-    LockTables();
-    sql=QString("select ")+
-      "`SOURCE_SLOTS`,"+       // 00
-      "`DESTINATION_SLOTS`,"+  // 01
-      "`GPI_SLOTS`,"+          // 02
-      "`GPO_SLOTS` "+          // 03
-      "from `NODES` where "+
-      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"'";
-    q=new SqlQuery(sql);
-    if(q->first()) {
-      NotifyProtocols("NODEDEL",QHostAddress(id).toString(),
-		      q->value(0).toInt(),q->value(1).toInt(),
-		      q->value(2).toInt(),q->value(3).toInt());
+    if((index=drouter_ingest_connects.indexOf(id))>=0) {
+      //
+      // Never made it into the DB, so nothing to remove
+      //
+      drouter_ingest_connects.removeAt(index);
+      drouter_state->removeNode(id);
+      return;
     }
-    delete q;
-    sql=QString("delete from `SA_SOURCES` where ")+
-      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"'";
-    SqlQuery::apply(sql);
-    sql=QString("delete from `SOURCES` where ")+
-      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"'";
-    SqlQuery::apply(sql);
-    sql=QString("delete from `SA_DESTINATIONS` where ")+
-      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"'";
-    SqlQuery::apply(sql);
-    sql=QString("delete from `DESTINATIONS` where ")+
-      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"'";
-    SqlQuery::apply(sql);
-    sql=QString("delete from `SA_GPIS` where ")+
-      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"'";
-    SqlQuery::apply(sql);
-    sql=QString("delete from `GPIS` where ")+
-      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"'";
-    SqlQuery::apply(sql);
-    sql=QString("delete from `SA_GPOS` where ")+
-      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"'";
-    SqlQuery::apply(sql);
-    sql=QString("delete from `GPOS` where ")+
-      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"'";
-    SqlQuery::apply(sql);
-    sql=QString("delete from `NODES` where ")+
-      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"'";
-    SqlQuery::apply(sql);
-    UnlockTables();
+    if(drouter_state->node(id)!=NULL) {
+      drouter_ingest_disconnects[id]=NodeRecord(id);
+    }
+    drouter_state->removeNode(id);
+  }
+  if((!drouter_ingest_timer->isActive())&&(!drouter_ingest_startup)) {
+    drouter_ingest_timer->start(0);
   }
 }
 
@@ -544,26 +463,45 @@ void DRouter::sourceChangedData(unsigned id,int slotnum,const SyNode &node,
 				const SySource &src)
 {
   QString sql;
+  QString key=QHostAddress(id).toString()+QString::asprintf(":%u",slotnum);
+  Matrix *mtx=drouter_nodes.value(id);
 
-  sql=QString("update `SOURCES` set ")+
-    "`HOST_NAME`='"+SqlQuery::escape(node.hostName())+"',"+
-    "`STREAM_ADDRESS`='"+
-    Config::normalizedStreamAddress(src.streamAddress()).toString()+"',"+
-    "`NAME`='"+SqlQuery::escape(src.name())+"',"+
-    QString::asprintf("`STREAM_ENABLED`=%u,",src.enabled())+
-    QString::asprintf("`CHANNELS`=%u,",src.channels())+
-    QString::asprintf("`BLOCK_SIZE`=%u where ",src.packetSize())+
-    "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"' && "+
-    QString::asprintf("`SLOT`=%u",slotnum);
-  SqlQuery::apply(sql);
-  sql=QString("update `SA_SOURCES` set ")+
-    "`STREAM_ADDRESS`='"+
-    Config::normalizedStreamAddress(src.streamAddress()).toString()+"' where "+
-    "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"' && "+
-    QString::asprintf("`SLOT`=%u",slotnum);
-  SqlQuery::apply(sql);
-  NotifyProtocols("SRC",QHostAddress(id).toString()+
-		  QString::asprintf(":%u",slotnum));
+  if((mtx==NULL)||
+     (!drouter_state->
+      updateSource(id,slotnum,node,src,mtx->srcNumber(slotnum)))||
+     drouter_ingest_connects.contains(id)) {
+    return;
+  }
+  QVariant host_addr=drouter_tables->addressValue(QHostAddress(id));
+  QVariant stream_addr=
+    drouter_tables->
+    addressValue(Config::normalizedStreamAddress(src.streamAddress()));
+  sql=QString("update `")+drouter_tables->tableName("SOURCES")+"` set "+
+    "`HOST_NAME`=?,"+
+    "`STREAM_ADDRESS`=?,"+
+    "`NAME`=?,"+
+    "`STREAM_ENABLED`=?,"+
+    "`CHANNELS`=?,"+
+    "`BLOCK_SIZE`=? where "+
+    "`HOST_ADDRESS`=? && "+
+    "`SLOT`=?";
+  QueueMirrorUpdate("SOURCES:"+key,sql,QVariantList()<<
+		    drouter_tables->nameValue(node.hostName())<<stream_addr<<
+		    drouter_tables->nameValue(src.name())<<
+		    (int)src.enabled()<<src.channels()<<src.packetSize()<<
+		    host_addr<<slotnum);
+  sql=QString("update `")+drouter_tables->tableName("SA_SOURCES")+"` set "+
+    "`STREAM_ADDRESS`=? where "+
+    "`HOST_ADDRESS`=? && "+
+    "`SLOT`=?";
+  QueueMirrorUpdate("SA_SOURCES:"+key,sql,QVariantList()<<
+		    stream_addr<<host_addr<<slotnum);
+
+  ProtoIpcMessage::Source rec=SourceRecord(id,slotnum);
+  drouter_snapshot->updateSource(rec);
+  ProtoIpcMessage msg(ProtoIpcMessage::TypeSource);
+  msg.writeSource(rec);
+  NotifyProtocols(msg);
 }
 
 
@@ -571,40 +509,69 @@ void DRouter::destinationChangedData(unsigned id,int slotnum,const SyNode &node,
 				     const SyDestination &dst)
 {
   QString sql;
-  SqlQuery *q;
+  QString key=QHostAddress(id).toString()+QString::asprintf(":%u",slotnum);
   bool xpoint_changed=false;
+  QHostAddress old_stream_addr;
+  const StateStore::Destination *sdst=NULL;
 
-  sql=QString("select ")+
-    "`STREAM_ADDRESS` from `DESTINATIONS` where "
-    "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"' && "+
-    QString::asprintf("`SLOT`=%d",slotnum);
-  q=new SqlQuery(sql);
-  if(q->first()) {
-    xpoint_changed=QHostAddress(q->value(0).toString())!=dst.streamAddress();
+  if((sdst=drouter_state->destination(id,slotnum))!=NULL) {
+    old_stream_addr.setAddress(sdst->stream_address);
   }
-  delete q;
-
-  sql=QString("update `DESTINATIONS` set ")+
-    "`HOST_NAME`='"+SqlQuery::escape(node.hostName())+"',"+
-    "`STREAM_ADDRESS`='"+
-    Config::normalizedStreamAddress(dst.streamAddress()).toString()+"',"+
-    "`NAME`='"+SqlQuery::escape(dst.name())+"',"+
-    QString::asprintf("`CHANNELS`=%u where ",dst.channels())+
-    "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"' && "+
-    QString::asprintf("`SLOT`=%u",slotnum);
-  SqlQuery::apply(sql);
-  sql=QString("update `SA_DESTINATIONS` set ")+
-    "`STREAM_ADDRESS`='"+
-    Config::normalizedStreamAddress(dst.streamAddress()).toString()+"' where "+
-    "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"' && "+
-    QString::asprintf("`SLOT`=%u",slotnum);
-  SqlQuery::apply(sql);
+  if((!drouter_state->
+      updateDestination(id,slotnum,node,dst,&xpoint_changed))||
+     drouter_ingest_connects.contains(id)) {
+    return;
+  }
+  QVariant host_addr=drouter_tables->addressValue(QHostAddress(id));
+  QVariant stream_addr=
+    drouter_tables->
+    addressValue(Config::normalizedStreamAddress(dst.streamAddress()));
+  sql=QString("update `")+drouter_tables->tableName("DESTINATIONS")+"` set "+
+    "`HOST_NAME`=?,"+
+    "`STREAM_ADDRESS`=?,"+
+    "`NAME`=?,"+
+    "`CHANNELS`=? where "+
+    "`HOST_ADDRESS`=? && "+
+    "`SLOT`=?";
+  QueueMirrorUpdate("DESTINATIONS:"+key,sql,QVariantList()<<
+		    drouter_tables->nameValue(node.hostName())<<stream_addr<<
+		    drouter_tables->nameValue(dst.name())<<dst.channels()<<
+		    host_addr<<slotnum);
+  sql=QString("update `")+drouter_tables->tableName("SA_DESTINATIONS")+"` set "+
+    "`STREAM_ADDRESS`=? where "+
+    "`HOST_ADDRESS`=? && "+
+    "`SLOT`=?";
+  QueueMirrorUpdate("SA_DESTINATIONS:"+key,sql,QVariantList()<<
+		    stream_addr<<host_addr<<slotnum);
+
+  ProtoIpcMessage::Destination rec=DestinationRecord(id,slotnum);
+  drouter_snapshot->updateDestination(rec);
   if(xpoint_changed) {
-    NotifyProtocols("DSTX",QHostAddress(id).toString()+
-		    QString::asprintf(":%u",slotnum));
+    //
+    // Include the previous crosspoint and the source now feeding us
+    //
+    int src_slot=-1;
+    QHostAddress src_addr;
+    Matrix *src_mtx=nodeBySrcStream(rec.stream_address,&src_slot);
+    if(src_mtx!=NULL) {
+      src_addr=src_mtx->hostAddress();
+    }
+    else {
+      src_slot=-1;
+    }
+    ProtoIpcMessage xmsg(ProtoIpcMessage::TypeDestinationCrosspoint);
+    xmsg.writeDestination(rec);
+    xmsg.writeAddress(old_stream_addr);
+    xmsg.writeAddress(src_addr);
+    xmsg.writeInt(src_slot);
+    NotifyProtocols(xmsg);
+  }
+  ProtoIpcMessage msg(ProtoIpcMessage::TypeDestination);
+  msg.writeDestination(rec);
+  NotifyProtocols(msg);
+  if(xpoint_changed) {
+    ConfirmPendingTakes(id,slotnum);
   }
-  NotifyProtocols("DST",QHostAddress(id).toString()+
-		  QString::asprintf(":%u",slotnum));
 }
 
 
@@ -612,31 +579,30 @@ void DRouter::gpiChangedData(unsigned id,int slotnum,const SyNode &node,
 			     const SyGpioBundle &gpi)
 {
   QString sql;
-  SqlQuery *q;
+  QString key=QHostAddress(id).toString()+QString::asprintf(":%u",slotnum);
   bool code_changed=false;
 
-  sql=QString("select ")+
-    "`CODE` "+            // 00
-    "from `GPIS` where "+
-    "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"' && "+
-    QString::asprintf("`SLOT`=%d",slotnum);
-  q=new SqlQuery(sql);
-  if(q->first()) {
-    code_changed=q->value(0).toString().toLower()!=gpi.code().toLower();
+  if((!drouter_state->updateGpi(id,slotnum,gpi,&code_changed))||
+     drouter_ingest_connects.contains(id)) {
+    return;
   }
-  delete q;
-
-  sql=QString("update `GPIS` set ")+
-    "`CODE`='"+gpi.code().toLower()+"' where "+
-    "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"' && "+
-    QString::asprintf("`SLOT`=%u",slotnum);
-  SqlQuery::apply(sql);
+  ProtoIpcMessage::Gpi rec=GpiRecord(id,slotnum);
   if(code_changed) {
-    NotifyProtocols("GPICODE",QHostAddress(id).toString()+
-		    QString::asprintf(":%u",slotnum));
-  }
-  NotifyProtocols("GPI",QHostAddress(id).toString()+
-		  QString::asprintf(":%u",slotnum));
+    sql=QString("update `")+drouter_tables->tableName("GPIS")+"` set "+
+      "`CODE`=? where "+
+      "`HOST_ADDRESS`=? && "+
+      "`SLOT`=?";
+    QueueMirrorUpdate("GPIS:"+key,sql,QVariantList()<<
+		      gpi.code().toLower()<<
+		      drouter_tables->addressValue(QHostAddress(id))<<slotnum);
+    drouter_snapshot->updateGpi(rec);
+    ProtoIpcMessage cmsg(ProtoIpcMessage::TypeGpiCode);
+    cmsg.writeGpi(rec);
+    NotifyProtocols(cmsg);
+  }
+  ProtoIpcMessage msg(ProtoIpcMessage::TypeGpi);
+  msg.writeGpi(rec);
+  NotifyProtocols(msg);
 }
 
 
@@ -644,49 +610,65 @@ void DRouter::gpoChangedData(unsigned id,int slotnum,const SyNode &node,
 			     const SyGpo &gpo)
 {
   QString sql;
-  SqlQuery *q;
+  QString key=QHostAddress(id).toString()+QString::asprintf(":%u",slotnum);
   bool xpoint_changed=false;
   bool code_changed=false;
+  QHostAddress old_src_addr;
+  int old_src_slot=-1;
+  const StateStore::Gpo *sgpo=NULL;
 
-  sql=QString("select ")+
-    "`SOURCE_ADDRESS`,"+  // 00
-    "`SOURCE_SLOT`,"+     // 01
-    "`CODE` "+            // 02
-    "from `GPOS` where "+
-    "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"' && "+
-    QString::asprintf("`SLOT`=%d",slotnum);
-  q=new SqlQuery(sql);
-  if(q->first()) {
-    xpoint_changed=(QHostAddress(q->value(0).toString())!=gpo.sourceAddress()||
-		    q->value(1).toInt()!=gpo.sourceSlot());
-    code_changed=q->value(2).toString().toLower()!=gpo.bundle()->code().toLower();
+  if((sgpo=drouter_state->gpo(id,slotnum))!=NULL) {
+    if(sgpo->source_address!=0) {
+      old_src_addr.setAddress(sgpo->source_address);
+    }
+    old_src_slot=sgpo->source_slot;
   }
-  delete q;
-
-  sql=QString("update `GPOS` set ")+
-    "`CODE`='"+gpo.bundle()->code().toLower()+"',"+
-    "`NAME`='"+SqlQuery::escape(gpo.name())+"',"+
-    "`SOURCE_ADDRESS`='"+gpo.sourceAddress().toString()+"',"+
-    QString::asprintf("`SOURCE_SLOT`=%d where ",gpo.sourceSlot())+
-    "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"' && "+
-    QString::asprintf("`SLOT`=%u",slotnum);
-  SqlQuery::apply(sql);
-  sql=QString("update `SA_GPOS` set ")+
-    "`SOURCE_ADDRESS`='"+gpo.sourceAddress().toString()+"',"+
-    QString::asprintf("`SOURCE_SLOT`=%d where ",gpo.sourceSlot())+
-    "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"' && "+
-    QString::asprintf("`SLOT`=%u",slotnum);
-  SqlQuery::apply(sql);
+  if((!drouter_state->
+      updateGpo(id,slotnum,gpo,&xpoint_changed,&code_changed))||
+     drouter_ingest_connects.contains(id)) {
+    return;
+  }
+  QVariant host_addr=drouter_tables->addressValue(QHostAddress(id));
+  QVariant src_addr=drouter_tables->addressValue(gpo.sourceAddress());
+  sql=QString("update `")+drouter_tables->tableName("GPOS")+"` set "+
+    "`CODE`=?,"+
+    "`NAME`=?,"+
+    "`SOURCE_ADDRESS`=?,"+
+    "`SOURCE_SLOT`=? where "+
+    "`HOST_ADDRESS`=? && "+
+    "`SLOT`=?";
+  QueueMirrorUpdate("GPOS:"+key,sql,QVariantList()<<
+		    gpo.bundle()->code().toLower()<<
+		    drouter_tables->nameValue(gpo.name())<<
+		    src_addr<<gpo.sourceSlot()<<host_addr<<slotnum);
+  sql=QString("update `")+drouter_tables->tableName("SA_GPOS")+"` set "+
+    "`SOURCE_ADDRESS`=?,"+
+    "`SOURCE_SLOT`=? where "+
+    "`HOST_ADDRESS`=? && "+
+    "`SLOT`=?";
+  QueueMirrorUpdate("SA_GPOS:"+key,sql,QVariantList()<<
+		    src_addr<<gpo.sourceSlot()<<host_addr<<slotnum);
+
+  ProtoIpcMessage::Gpo rec=GpoRecord(id,slotnum);
+  drouter_snapshot->updateGpo(rec);
   if(xpoint_changed) {
-    NotifyProtocols("GPOX",QHostAddress(id).toString()+
-		    QString::asprintf(":%u",slotnum));
+    ProtoIpcMessage xmsg(ProtoIpcMessage::TypeGpoCrosspoint);
+    xmsg.writeGpo(rec);
+    xmsg.writeAddress(old_src_addr);
+    xmsg.writeInt(old_src_slot);
+    NotifyProtocols(xmsg);
   }
   if(code_changed) {
-    NotifyProtocols("GPOCODE",QHostAddress(id).toString()+
-		    QString::asprintf(":%u",slotnum));
+    ProtoIpcMessage cmsg(ProtoIpcMessage::TypeGpoCode);
+    cmsg.writeGpo(rec);
+    NotifyProtocols(cmsg);
+  }
+  ProtoIpcMessage msg(ProtoIpcMessage::TypeGpo);
+  msg.writeGpo(rec);
+  NotifyProtocols(msg);
+  if(xpoint_changed) {
+    ConfirmPendingTakes(id,slotnum);
   }
-  NotifyProtocols("GPO",QHostAddress(id).toString()+
-		  QString::asprintf(":%u",slotnum));
 }
 
 
@@ -705,13 +687,26 @@ void DRouter::audioClipAlarmData(unsigned id,SyLwrpClient::MeterType type,
     chan_name="RIGHT";
   }
   if((lwrp=drouter_nodes[id])!=NULL) {
-    sql=QString("update `")+table+"` set "+
-      "`"+chan_name+"_CLIP`="+QString::asprintf("%d where ",state)+
-      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"' && "+
-      QString::asprintf("`SLOT`=%d",slotnum);
-    SqlQuery::apply(sql);
-    NotifyProtocols("CLIP",QString::asprintf("%d:%d:",type,chan)+QHostAddress(id).toString()+QString::asprintf(":%d",slotnum));
-    //    emit clipAlarmChanged(*(lwrp->node()),(int)slotnum,type,chan,state);
+    sql=QString("update `")+drouter_tables->tableName(table)+"` set "+
+      "`"+chan_name+"_CLIP`=? where "+
+      "`HOST_ADDRESS`=? && "+
+      "`SLOT`=?";
+    QueueMirrorUpdate(table+":"+chan_name+"_CLIP:"+
+		      QHostAddress(id).toString()+
+		      QString::asprintf(":%u",slotnum),sql,QVariantList()<<
+		      (int)state<<
+		      drouter_tables->addressValue(QHostAddress(id))<<slotnum);
+
+    ProtoIpcMessage::Alarm rec;
+    rec.host_address=QHostAddress(id);
+    rec.slot=slotnum;
+    rec.meter_type=type;
+    rec.chan=chan;
+    rec.state=state;
+    drouter_snapshot->setAlarm(rec,StateSnapshot::ClipAlarm);
+    ProtoIpcMessage msg(ProtoIpcMessage::TypeClip);
+    msg.writeAlarm(rec);
+    NotifyProtocols(msg);
   }
 }
 
@@ -732,12 +727,26 @@ void DRouter::audioSilenceAlarmData(unsigned id,SyLwrpClient::MeterType type,
   }
 
   if((lwrp=drouter_nodes[id])!=NULL) {
-    sql=QString("update `")+table+"` set "+
-      "`"+chan_name+"_SILENCE`="+QString::asprintf("%d where ",state)+
-      "`HOST_ADDRESS`='"+QHostAddress(id).toString()+"' && "+
-      QString::asprintf("`SLOT`=%d",slotnum);
-    SqlQuery::apply(sql);
-    NotifyProtocols("SILENCE",QString::asprintf("%d:%d:",type,chan)+QHostAddress(id).toString()+QString::asprintf(":%d",slotnum));
+    sql=QString("update `")+drouter_tables->tableName(table)+"` set "+
+      "`"+chan_name+"_SILENCE`=? where "+
+      "`HOST_ADDRESS`=? && "+
+      "`SLOT`=?";
+    QueueMirrorUpdate(table+":"+chan_name+"_SILENCE:"+
+		      QHostAddress(id).toString()+
+		      QString::asprintf(":%u",slotnum),sql,QVariantList()<<
+		      (int)state<<
+		      drouter_tables->addressValue(QHostAddress(id))<<slotnum);
+
+    ProtoIpcMessage::Alarm rec;
+    rec.host_address=QHostAddress(id);
+    rec.slot=slotnum;
+    rec.meter_type=type;
+    rec.chan=chan;
+    rec.state=state;
+    drouter_snapshot->setAlarm(rec,StateSnapshot::SilenceAlarm);
+    ProtoIpcMessage msg(ProtoIpcMessage::TypeSilence);
+    msg.writeAlarm(rec);
+    NotifyProtocols(msg);
   }
 }
 
@@ -781,6 +790,13 @@ void DRouter::newIpcConnectionData(int listen_sock)
 	  drouter_ipc_ready_mapper,SLOT(map()));
   drouter_ipc_ready_mapper->
     setMapping(drouter_ipc_sockets[sock],sock);
+
+  //
+  // Tell the protocol where its change notifications start
+  //
+  ProtoIpcMessage msg(ProtoIpcMessage::TypeSequence);
+  msg.setSequence(drouter_journal->sequence());
+  drouter_ipc_sockets[sock]->write(msg.frame());
   syslog(LOG_DEBUG,"opened new IPC connection %d", sock);
 }
 
@@ -814,10 +830,20 @@ void DRouter::ipcReadyReadData(int sock)
 
 void DRouter::finalizeEventsData()
 {
+  //
+  // Settle any route events left open, e.g. by a previously active
+  // instance or by a confirmation that never reached the database. Only
+  // events older than the confirm timeout are touched, so that takes
+  // still being confirmed (here or elsewhere) are left alone. Runs
+  // periodically while active.
+  //
   QString sql;
   SqlQuery *q;
-  EndPointMap *map=NULL;
+  int age=(drouter_config->routeConfirmTimeout()+999)/1000+1;
 
+  if(!drouter_writeable) {
+    return;
+  }
   sql=QString("select ")+
     "`ID`,"+                  // 00
     "`ROUTER_NUMBER`,"+       // 01
@@ -825,41 +851,43 @@ void DRouter::finalizeEventsData()
     "`SOURCE_NUMBER` "+       // 03
     "from `PERM_SA_EVENTS` where "+
     "`STATUS`='O' && "+
-    "`DATETIME`<'"+QDateTime::currentDateTime().addSecs(-1).
-    toString("yyyy-MM-dd hh:mm:ss")+"'";
+    QString::asprintf("`DATETIME`<date_sub(now(),interval %d second)",age);
   q=new SqlQuery(sql);
   while(q->next()) {
-    if((map=drouter_maps.value(q->value(1).toInt()))==NULL) {
-      FinalizeSARouteEvent(q->value(0).toInt(),false);
+    PendingTake take;
+    take.event_id=q->value(0).toInt();
+    take.router=q->value(1).toInt();
+    take.output=q->value(2).toInt();
+    take.input=q->value(3).toInt();
+    if(!drouter_pending_takes.contains(take.event_id)) {
+      FinalizeSARouteEvent(take.event_id,take.router,take.output,take.input,
+			   ResolveTake(&take)&&TakeIsComplete(take),-1);
     }
-    else {
-      switch(drouter_maps.value(q->value(1).toInt())->routerType()) {
-      case EndPointMap::AudioRouter:
-	FinalizeSAAudioRoute(q->value(0).toInt(),q->value(1).toInt(),
-			     q->value(2).toInt(),q->value(3).toInt());
-	break;
+  }
+  delete q;
+}
 
-      case EndPointMap::GpioRouter:
-	FinalizeSAGpioRoute(q->value(0).toInt(),q->value(1).toInt(),
-			    q->value(2).toInt(),q->value(3).toInt());
-	break;
 
-      case EndPointMap::LastRouter:
-	break;
-      }
-    }
+void DRouter::takeTimeoutData()
+{
+  qint64 now=drouter_take_clock.elapsed();
+
+  while((!drouter_pending_deadlines.isEmpty())&&
+	(drouter_pending_deadlines.firstKey()<=now)) {
+    int event_id=drouter_pending_deadlines.first();
+    syslog(LOG_DEBUG,"route event %d not confirmed within %d mS",
+	   event_id,drouter_config->routeConfirmTimeout());
+    FinishPendingTake(event_id,false);
   }
-  delete q;
+  ScheduleTakeTimeout();
 }
 
 
 void DRouter::purgeEventsData()
 {
-  QString sql=QString("delete from `PERM_SA_EVENTS` where ")+
-    "`DATETIME`<'"+QDateTime::currentDateTime().
-    addSecs(-3600*drouter_config->retainEventRecordsDuration()).
-    toString("yyyy-MM-dd hh:mm:ss")+"'";
-  SqlQuery::apply(sql);
+  drouter_purger->purge(QDateTime::currentDateTime().
+			addSecs(-3600*drouter_config->
+				retainEventRecordsDuration()));
 }
 
 
@@ -877,20 +905,259 @@ void DRouter::dbKeepaliveData()
 }
 
 
-void DRouter::NotifyProtocols(const QString &type,const QString &id,
-			      int srcs,int dsts,int gpis,int gpos)
+void DRouter::ingestData()
 {
+  QList<unsigned> connects=drouter_ingest_connects;
+  QMap<unsigned,ProtoIpcMessage::Node> disconnects=
+    drouter_ingest_disconnects;
+
+  drouter_ingest_startup=false;
+  drouter_ingest_connects.clear();
+  drouter_ingest_disconnects.clear();
+
+  //
+  // Disconnected Nodes
+  //
+  if(disconnects.size()>0) {
+    drouter_tables->deleteNodeRows(disconnects.keys());
+    for(QMap<unsigned,ProtoIpcMessage::Node>::const_iterator
+	  it=disconnects.constBegin();it!=disconnects.constEnd();it++) {
+      drouter_snapshot->clearAlarms(QHostAddress(it.key()));
+    }
+  }
+
+  //
+  // Connected Nodes
+  //
+  if(connects.size()>0) {
+    QDateTime now=QDateTime::currentDateTime();
+    drouter_tables->insertNodeRows(connects);
+    syslog(LOG_DEBUG,"queued %d node(s) for the database in %lld mS",
+	   connects.size(),now.msecsTo(QDateTime::currentDateTime()));
+  }
+
+  //
+  // Notify Protocols
+  //
+  RebuildSnapshot();
+  for(QMap<unsigned,ProtoIpcMessage::Node>::const_iterator
+	it=disconnects.constBegin();it!=disconnects.constEnd();it++) {
+    ProtoIpcMessage msg(ProtoIpcMessage::TypeNodeDel);
+    msg.writeNode(it.value());
+    NotifyProtocols(msg);
+  }
+  for(int i=0;i<connects.size();i++) {
+    const StateStore::Node *n=drouter_state->node(connects.at(i));
+    if(n!=NULL) {
+      ProtoIpcMessage msg(ProtoIpcMessage::TypeNodeAdd);
+      msg.writeNode(NodeRecord(n->id));
+      for(int j=0;j<n->sources.size();j++) {
+	msg.writeSource(SourceRecord(n->id,j));
+      }
+      for(int j=0;j<n->destinations.size();j++) {
+	msg.writeDestination(DestinationRecord(n->id,j));
+      }
+      for(int j=0;j<n->gpis.size();j++) {
+	msg.writeGpi(GpiRecord(n->id,j));
+      }
+      for(int j=0;j<n->gpos.size();j++) {
+	msg.writeGpo(GpoRecord(n->id,j));
+      }
+      NotifyProtocols(msg);
+    }
+  }
+}
+
+
+void DRouter::RebuildSnapshot()
+{
+  QList<unsigned> ids=drouter_state->nodeIds();
+  QMap<QString,unsigned> sorted;
+  QList<ProtoIpcMessage::Node> nodes;
+  QList<ProtoIpcMessage::Source> srcs;
+  QList<ProtoIpcMessage::Destination> dsts;
+  QList<ProtoIpcMessage::Gpi> gpis;
+  QList<ProtoIpcMessage::Gpo> gpos;
+
+  //
+  // Nodes are laid out in the same order as the database dumps
+  // (HOST_ADDRESS as a string)
+  //
+  for(int i=0;i<ids.size();i++) {
+    sorted[QHostAddress(ids.at(i)).toString()]=ids.at(i);
+  }
+  for(QMap<QString,unsigned>::const_iterator it=sorted.constBegin();
+      it!=sorted.constEnd();it++) {
+    const StateStore::Node *n=drouter_state->node(it.value());
+    nodes.push_back(NodeRecord(n->id));
+    for(int j=0;j<n->sources.size();j++) {
+      srcs.push_back(SourceRecord(n->id,j));
+    }
+    for(int j=0;j<n->destinations.size();j++) {
+      dsts.push_back(DestinationRecord(n->id,j));
+    }
+    for(int j=0;j<n->gpis.size();j++) {
+      gpis.push_back(GpiRecord(n->id,j));
+    }
+    for(int j=0;j<n->gpos.size();j++) {
+      gpos.push_back(GpoRecord(n->id,j));
+    }
+  }
+  drouter_snapshot->rebuild(nodes,srcs,dsts,gpis,gpos);
+}
+
+
+void DRouter::writerStatsData()
+{
+  syslog(LOG_DEBUG,"database writer: %s",
+	 drouter_writer->statistics().toUtf8().constData());
+}
+
+
+void DRouter::purgeNamesData()
+{
+  int purged=0;
+
+  //
+  // Nodes waiting to be ingested still have rows (or soon will) that
+  // refer to names no longer in the StateStore
+  //
+  if((!drouter_ingest_connects.isEmpty())||
+     (!drouter_ingest_disconnects.isEmpty())) {
+    return;
+  }
+  if((purged=drouter_tables->purgeNames())>0) {
+    syslog(LOG_DEBUG,"purged %d unused name(s)",purged);
+  }
+}
+
+
+void DRouter::NotifyProtocols(const ProtoIpcMessage &msg)
+{
+  ProtoIpcMessage change=msg;
+  QByteArray data=drouter_journal->append(&change);
+
   for(QMap<int,QTcpSocket *>::iterator it=drouter_ipc_sockets.begin();
       it!=drouter_ipc_sockets.end();it++) {
-    if(gpos<0) {
-      it.value()->write((type+":"+id+"\r\n").toUtf8());
+    it.value()->write(data);
+  }
+}
+
+
+void DRouter::QueueMirrorUpdate(const QString &key,const QString &sql,
+				const QVariantList &values)
+{
+  //
+  // Later updates to the same row supersede earlier ones
+  //
+  drouter_writer->enqueue(key,sql,values);
+}
+
+
+ProtoIpcMessage::Node DRouter::NodeRecord(unsigned id) const
+{
+  ProtoIpcMessage::Node ret;
+  const StateStore::Node *n=drouter_state->node(id);
+
+  ret.host_address=QHostAddress(id);
+  if(n!=NULL) {
+    ret.host_name=n->host_name;
+    ret.device_name=n->device_name;
+    ret.matrix_type=n->matrix_type;
+    ret.sources=n->sources.size();
+    ret.destinations=n->destinations.size();
+    ret.gpis=n->gpis.size();
+    ret.gpos=n->gpos.size();
+  }
+
+  return ret;
+}
+
+
+ProtoIpcMessage::Source DRouter::SourceRecord(unsigned id,int slot) const
+{
+  ProtoIpcMessage::Source ret;
+  const StateStore::Node *n=drouter_state->node(id);
+  const StateStore::Source *src=drouter_state->source(id,slot);
+
+  ret.host_address=QHostAddress(id);
+  ret.slot=slot;
+  if((n!=NULL)&&(src!=NULL)) {
+    ret.matrix_type=n->matrix_type;
+    ret.host_name=n->host_name;
+    ret.stream_address=QHostAddress(src->stream_address);
+    ret.name=src->name;
+    ret.enabled=src->enabled;
+    ret.channels=src->channels;
+    ret.block_size=src->packet_size;
+  }
+
+  return ret;
+}
+
+
+ProtoIpcMessage::Destination DRouter::DestinationRecord(unsigned id,
+							int slot) const
+{
+  ProtoIpcMessage::Destination ret;
+  const StateStore::Node *n=drouter_state->node(id);
+  const StateStore::Destination *dst=drouter_state->destination(id,slot);
+
+  ret.host_address=QHostAddress(id);
+  ret.slot=slot;
+  if((n!=NULL)&&(dst!=NULL)) {
+    ret.matrix_type=n->matrix_type;
+    ret.host_name=n->host_name;
+    ret.stream_address=QHostAddress(dst->stream_address);
+    ret.name=dst->name;
+    ret.channels=dst->channels;
+  }
+
+  return ret;
+}
+
+
+ProtoIpcMessage::Gpi DRouter::GpiRecord(unsigned id,int slot) const
+{
+  ProtoIpcMessage::Gpi ret;
+  const StateStore::Node *n=drouter_state->node(id);
+  const StateStore::Gpi *gpi=drouter_state->gpi(id,slot);
+
+  ret.host_address=QHostAddress(id);
+  ret.slot=slot;
+  if((n!=NULL)&&(gpi!=NULL)) {
+    ret.matrix_type=n->matrix_type;
+    ret.host_name=n->host_name;
+    ret.code=gpi->code;
+  }
+
+  return ret;
+}
+
+
+ProtoIpcMessage::Gpo DRouter::GpoRecord(unsigned id,int slot) const
+{
+  ProtoIpcMessage::Gpo ret;
+  const StateStore::Node *n=drouter_state->node(id);
+  const StateStore::Gpo *gpo=drouter_state->gpo(id,slot);
+
+  ret.host_address=QHostAddress(id);
+  ret.slot=slot;
+  if((n!=NULL)&&(gpo!=NULL)) {
+    ret.matrix_type=n->matrix_type;
+    ret.host_name=n->host_name;
+    ret.code=gpo->code;
+    ret.name=gpo->name;
+    if(ret.name.isEmpty()) {
+      ret.name=QString::asprintf("GPO %d",slot+1);
     }
-    else {
-      it.value()->write((type+":"+id+
-			 QString::asprintf(":%d:%d:%d:%d\r\n",
-					   srcs,dsts,gpis,gpos)).toUtf8());
+    if(gpo->source_address!=0) {
+      ret.source_address.setAddress(gpo->source_address);
     }
+    ret.source_slot=gpo->source_slot;
   }
+
+  return ret;
 }
 
 
@@ -1012,6 +1279,38 @@ bool DRouter::ProcessIpcCommand(int sock,const QString &cmd)
     }
   }
 
+  if((cmds.at(0)=="SetCrosspoints")&&(cmds.size()>1)&&
+     (((cmds.size()-1)%4)==0)) {
+    //
+    // Resolve the whole salvo first, then hand each node its share in
+    // one call so that the routes land together
+    //
+    QMap<Matrix *,QMap<int,QHostAddress> > salvo;
+    for(int i=1;i<cmds.size();i+=4) {
+      Matrix *dst_lwrp=
+	drouter_nodes.value(QHostAddress(cmds.at(i)).toIPv4Address());
+      unsigned dst_slotnum=cmds.at(i+1).toUInt(&ok);
+      if((dst_lwrp!=NULL)&&ok&&(dst_slotnum<dst_lwrp->dstSlots())) {
+	int src_slotnum=cmds.at(i+3).toInt(&ok);
+	if(ok&&(src_slotnum<0)) {
+	  salvo[dst_lwrp][dst_slotnum]=
+	    QHostAddress(DROUTER_NULL_STREAM_ADDRESS);
+	}
+	else {
+	  Matrix *src_lwrp=
+	    drouter_nodes.value(QHostAddress(cmds.at(i+2)).toIPv4Address());
+	  if((src_lwrp!=NULL)&&ok&&((unsigned)src_slotnum<src_lwrp->srcSlots())) {
+	    salvo[dst_lwrp][dst_slotnum]=src_lwrp->srcAddress(src_slotnum);
+	  }
+	}
+      }
+    }
+    for(QMap<Matrix *,QMap<int,QHostAddress> >::const_iterator
+	  it=salvo.constBegin();it!=salvo.constEnd();it++) {
+      it.key()->setDstAddresses(it.value());
+    }
+  }
+
   if((cmds.at(0)=="SetGpioCrosspoint")&&(cmds.size()==5)) {
     Matrix *gpo_lwrp=
       drouter_nodes[QHostAddress(cmds.at(1)).toIPv4Address()];
@@ -1037,6 +1336,19 @@ bool DRouter::ProcessIpcCommand(int sock,const QString &cmd)
     }
   }
 
+  if((cmds.at(0)=="ConfirmRoute")&&(cmds.size()==5)) {
+    int args[4];
+    for(int i=0;i<4;i++) {
+      args[i]=cmds.at(1+i).toInt(&ok);
+      if(!ok) {
+	break;
+      }
+    }
+    if(ok) {
+      AddPendingTake(args[0],args[1],args[2],args[3]);
+    }
+  }
+
   if((cmds.at(0)=="SetGpoState")&&(cmds.size()==4)) {
     Matrix *gpo_lwrp=
       drouter_nodes[QHostAddress(cmds.at(1)).toIPv4Address()];
@@ -1069,6 +1381,7 @@ bool DRouter::StartDb(QString *err_msg)
     *err_msg=tr("unable to open database")+" ["+db.lastError().driverText()+"]";
     return false;
   }
+  SqlQuery::clearStatementCache();
   sql=QString::asprintf("set max_heap_table_size=%d",
 			drouter_config->maxHeapTableSize());
   SqlQuery::apply(sql);
@@ -1076,7 +1389,7 @@ bool DRouter::StartDb(QString *err_msg)
   //
   // Clear Old Data
   //
-  sql="show tables";
+  sql="show full tables";
   q=new SqlQuery(sql);
   while(q->next()) {
     if(q->value(0).toString()=="PERM_VERSION") {
@@ -1091,7 +1404,12 @@ bool DRouter::StartDb(QString *err_msg)
       delete q1;
     }
     if(q->value(0).toString().left(5)!="PERM_") {
-      sql=QString("drop table `")+q->value(0).toString()+"`";
+      if(q->value(1).toString()=="VIEW") {
+	sql=QString("drop view `")+q->value(0).toString()+"`";
+      }
+      else {
+	sql=QString("drop table `")+q->value(0).toString()+"`";
+      }
       SqlQuery::apply(sql);
     }
   }
@@ -1232,6 +1550,30 @@ bool DRouter::StartDb(QString *err_msg)
     syslog(LOG_DEBUG,"applied schema version %d",schema_ver);
   }
 
+  if(schema_ver<7) {
+    sql=QString("alter table `PERM_SA_EVENTS` ")+
+      "add column `LATENCY` int after `STATUS`";
+    SqlQuery::apply(sql);
+
+    schema_ver=7;
+    sql=QString("update `PERM_VERSION` set ")+
+      QString::asprintf("`DB`=%d",schema_ver);
+    SqlQuery::apply(sql);
+    syslog(LOG_DEBUG,"applied schema version %d",schema_ver);
+  }
+
+  if(schema_ver<8) {
+    sql=QString("alter table `PERM_SA_EVENTS` ")+
+      "add index DATETIME_IDX(`DATETIME`)";
+    SqlQuery::apply(sql);
+
+    schema_ver=8;
+    sql=QString("update `PERM_VERSION` set ")+
+      QString::asprintf("`DB`=%d",schema_ver);
+    SqlQuery::apply(sql);
+    syslog(LOG_DEBUG,"applied schema version %d",schema_ver);
+  }
+
   // New schema updates go here
 
 
@@ -1240,135 +1582,7 @@ bool DRouter::StartDb(QString *err_msg)
   //
   // Ephemeral Tables
   //
-  sql=QString("create table if not exists `NODES` (")+
-    "`HOST_ADDRESS` char(15) not null primary key,"+
-    "`HOST_NAME` char(191),"+
-    "`DEVICE_NAME` char(20),"+
-    "`MATRIX_TYPE` int,"+
-    "`SOURCE_SLOTS` int,"+
-    "`DESTINATION_SLOTS` int,"+
-    "`GPI_SLOTS` int,"+
-    "`GPO_SLOTS` int,"+
-    "index NODES_MATRIX_TYPE_IDX(`MATRIX_TYPE`)) "+
-    "engine MEMORY character set utf8 collate utf8_general_ci";
-  SqlQuery::run(sql);
-
-  sql=QString("create table if not exists `SOURCES` (")+
-    "`ID` int auto_increment not null primary key,"+
-    "`HOST_ADDRESS` char(15) not null,"+
-    "`SLOT` int not null,"+
-    "`HOST_NAME` char(191),"+
-    "`STREAM_ADDRESS` char(15),"+
-    "`NAME` char(191),"+
-    "`STREAM_ENABLED` int,"+
-    "`CHANNELS` int,"+
-    "`BLOCK_SIZE` int,"+
-    "`LEFT_CLIP` int default 0,"+
-    "`RIGHT_CLIP` int default 0,"+
-    "`LEFT_SILENCE` int default 0,"+
-    "`RIGHT_SILENCE` int default 0,"+
-    "unique index SLOT_IDX(`HOST_ADDRESS`,`SLOT`),"+
-    "index STREAM_ADDRESS_IDX(`STREAM_ADDRESS`,`STREAM_ENABLED`)) "+
-    "engine MEMORY character set utf8 collate utf8_general_ci";
-  SqlQuery::apply(sql);
-
-  sql=QString("create table if not exists `DESTINATIONS` (")+
-    "`ID` int auto_increment not null primary key,"+
-    "`HOST_ADDRESS` char(15) not null,"+
-    "`SLOT` int not null,"+
-    "`HOST_NAME` char(191),"+
-    "`STREAM_ADDRESS` char(15),"+
-    "`NAME` char(191),"+
-    "`CHANNELS` int,"+
-    "`LEFT_CLIP` int default 0,"+
-    "`RIGHT_CLIP` int default 0,"+
-    "`LEFT_SILENCE` int default 0,"+
-    "`RIGHT_SILENCE` int default 0,"+
-    "unique index SLOT_IDX(`HOST_ADDRESS`,`SLOT`)) "+
-    "engine MEMORY character set utf8 collate utf8_general_ci";
-  SqlQuery::apply(sql);
-
-  sql=QString("create table if not exists `GPIS` (")+
-    "`ID` int auto_increment not null primary key,"+
-    "`HOST_ADDRESS` char(15) not null,"+
-    "`SLOT` int not null,"+
-    "`HOST_NAME` char(191),"+
-    "`CODE` char(5),"+
-    "unique index SLOT_IDX(`HOST_ADDRESS`,`SLOT`)) "+
-    "engine MEMORY character set utf8 collate utf8_general_ci";
-  SqlQuery::apply(sql);
-
-  sql=QString("create table if not exists `GPOS` (")+
-    "`ID` int auto_increment not null primary key,"+
-    "`HOST_ADDRESS` char(15) not null,"+
-    "`SLOT` int not null,"+
-    "`HOST_NAME` char(191),"+
-    "`CODE` char(5),"+
-    "`NAME` char(191),"+
-    "`SOURCE_ADDRESS` char(22),"+
-    "`SOURCE_SLOT` int default -1,"+
-    "unique index SLOT_IDX(`HOST_ADDRESS`,`SLOT`),"+
-    "index SOURCE_ADDRESS_IDX(`SOURCE_ADDRESS`,`SOURCE_SLOT`)) "+
-    "engine MEMORY character set utf8 collate utf8_general_ci";
-  SqlQuery::apply(sql);
-
-  sql=QString("create table if not exists `SA_SOURCES` (")+
-    "`ID` int auto_increment not null primary key,"+
-    "`HOST_ADDRESS` char(15) not null,"+
-    "`SLOT` int not null,"+
-    "`ROUTER_NUMBER` int not null,"+
-    "`SOURCE_NUMBER` int not null,"
-    "`SOURCE_ID` int not null,"+
-    "`NAME` char(191),"+
-    "`STREAM_ADDRESS` char(15),"+
-    "index HOST_ADDRESS_IDX(`HOST_ADDRESS`,`SLOT`),"+
-    "index STREAM_ADDRESS_IDX(`ROUTER_NUMBER`,`STREAM_ADDRESS`),"+
-    "index ROUTER_NUMBER_IDX(`ROUTER_NUMBER`)) "+
-    "engine MEMORY character set utf8 collate utf8_general_ci";
-  SqlQuery::apply(sql);
-
-  sql=QString("create table if not exists `SA_DESTINATIONS` (")+
-    "`ID` int auto_increment not null primary key,"+
-    "`HOST_ADDRESS` char(15) not null,"+
-    "`SLOT` int not null,"+
-    "`ROUTER_NUMBER` int not null,"+
-    "`SOURCE_NUMBER` int not null,"
-    "`DESTINATION_ID` int not null,"+
-    "`NAME` char(191),"+
-    "`STREAM_ADDRESS` char(15),"+
-    "index HOST_ADDRESS_IDX(`HOST_ADDRESS`,`SLOT`),"+
-    "index ROUTER_NUMBER_IDX(`ROUTER_NUMBER`)) "+
-    "engine MEMORY character set utf8 collate utf8_general_ci";
-  SqlQuery::apply(sql);
-
-  sql=QString("create table if not exists `SA_GPIS` (")+
-    "`ID` int auto_increment not null primary key,"+
-    "`HOST_ADDRESS` char(15) not null,"+
-    "`SLOT` int not null,"+
-    "`ROUTER_NUMBER` int not null,"+
-    "`SOURCE_NUMBER` int not null,"
-    "`GPI_ID` int not null,"+
-    "`NAME` char(191),"+
-    "index HOST_ADDRESS_IDX(`HOST_ADDRESS`,`SLOT`),"+
-    "index ROUTER_IDX(`ROUTER_NUMBER`))"+
-    "engine MEMORY character set utf8 collate utf8_general_ci";
-  SqlQuery::apply(sql);
-
-  sql=QString("create table if not exists `SA_GPOS` (")+
-    "`ID` int auto_increment not null primary key,"+
-    "`HOST_ADDRESS` char(15) not null,"+
-    "`SLOT` int not null,"+
-    "`ROUTER_NUMBER` int not null,"+
-    "`SOURCE_NUMBER` int not null,"
-    "`GPO_ID` int not null,"+
-    "`NAME` char(191),"+
-    "`SOURCE_ADDRESS` char(22),"+
-    "`SOURCE_SLOT` int default -1,"+
-    "index HOST_ADDRESS_IDX(`HOST_ADDRESS`,`SLOT`),"+
-    "index ROUTER_IDX(`ROUTER_NUMBER`),"+
-    "index ROUTER_SOURCE_IDX(`ROUTER_NUMBER`,`SOURCE_NUMBER`))"+
-    "engine MEMORY character set utf8 collate utf8_general_ci";
-  SqlQuery::apply(sql);
+  drouter_tables->createTables();
 
   sql=QString("create table if not exists `TETHER` (")+
     "`IS_ACTIVE` enum('N','Y') not null default 'N') "+
@@ -1482,29 +1696,6 @@ Matrix *DRouter::StartMatrix(Config::MatrixType type,unsigned id)
 }
 
 
-void DRouter::LockTables() const
-{
-  QString sql=QString("lock tables ")+
-    "`DESTINATIONS` write,"+
-    "`GPIS` write,"+
-    "`GPOS` write,"+
-    "`NODES` write,"+
-    "`SA_DESTINATIONS` write,"+
-    "`SA_GPIS` write,"+
-    "`SA_GPOS` write,"+
-    "`SA_SOURCES` write,"+
-    "`SOURCES` write";
-  SqlQuery::apply(sql);
-}
-
-
-void DRouter::UnlockTables() const
-{
-  QString sql=QString("unlock tables");
-  SqlQuery::apply(sql);
-}
-
-
 void DRouter::LoadMaps()
 {
   //
@@ -1555,132 +1746,200 @@ void DRouter::Log(int prio,const QString &msg) const
 }
 
 
-void DRouter::FinalizeSAAudioRoute(int event_id,int router,int output,int input)
+bool DRouter::ResolveTake(PendingTake *take) const
 {
-  QString sql;
-  SqlQuery *q;
+  EndPointMap *map=drouter_maps.value(take->router);
+  QHostAddress addr;
 
-  if(input<0) {  // No route --i.e. destination is "OFF"
-    sql=QString("select ")+
-      "`STREAM_ADDRESS` "+  // 00
-      "from `SA_DESTINATIONS` where "+
-      QString::asprintf("`ROUTER_NUMBER`=%d && ",router)+
-      QString::asprintf("`SOURCE_NUMBER`=%d",output);
-    q=new SqlQuery(sql);
-    if(q->first()) {
-      FinalizeSARouteEvent(event_id,
-			   q->value(0).toString()==DROUTER_NULL_STREAM_ADDRESS);
-    }
-    else {
-      FinalizeSARouteEvent(event_id,false);
-    }
-    delete q;
+  if(map==NULL) {
+    return false;
   }
-  else {
-    sql=QString("select ")+
-      "`SA_DESTINATIONS`.`ID` "+  // 00
-      "from `SA_DESTINATIONS` left join `SA_SOURCES` "+
-      "on `SA_DESTINATIONS`.`STREAM_ADDRESS`=`SA_SOURCES`.`STREAM_ADDRESS` && "+
-      "`SA_SOURCES`.`ROUTER_NUMBER`=`SA_DESTINATIONS`.`ROUTER_NUMBER` "+
-      "where "+
-      QString::asprintf("`SA_DESTINATIONS`.`ROUTER_NUMBER`=%d && ",
-			router)+
-      QString::asprintf("`SA_SOURCES`.`SOURCE_NUMBER`=%d && ",
-			input)+
-      QString::asprintf("`SA_DESTINATIONS`.`SOURCE_NUMBER`=%d",
-			output);
-    //printf("finalize SQL: %s\n",sql.toUtf8().constData());
-    q=new SqlQuery(sql);
-    FinalizeSARouteEvent(event_id,q->first());
-    delete q;
+  take->router_type=map->routerType();
+  addr=map->hostAddress(EndPointMap::Output,take->output);
+  take->dst_id=addr.toIPv4Address();
+  take->dst_slot=map->slot(EndPointMap::Output,take->output);
+  if(addr.isNull()||(take->dst_slot<0)||
+     (!drouter_nodes.contains(take->dst_id))) {
+    return false;
   }
+  if(take->input<0) {  // No route --i.e. destination is "OFF"
+    return true;
+  }
+  addr=map->hostAddress(EndPointMap::Input,take->input);
+  take->src_id=addr.toIPv4Address();
+  take->src_slot=map->slot(EndPointMap::Input,take->input);
+
+  return (!addr.isNull())&&(take->src_slot>=0);
 }
 
 
-void DRouter::FinalizeSAGpioRoute(int event_id,int router,int output,int input)
+bool DRouter::TakeIsComplete(const PendingTake &take) const
 {
-  QString sql;
-  SqlQuery *q;
+  const StateStore::Destination *sdst=NULL;
+  const StateStore::Source *ssrc=NULL;
+  const StateStore::Gpo *sgpo=NULL;
+
+  switch(take.router_type) {
+  case EndPointMap::AudioRouter:
+    if((sdst=drouter_state->destination(take.dst_id,take.dst_slot))==NULL) {
+      return false;
+    }
+    if(take.input<0) {
+      return sdst->stream_address==
+	QHostAddress(DROUTER_NULL_STREAM_ADDRESS).toIPv4Address();
+    }
+    if((ssrc=drouter_state->source(take.src_id,take.src_slot))==NULL) {
+      return false;
+    }
+    return sdst->stream_address==ssrc->stream_address;
+
+  case EndPointMap::GpioRouter:
+    if((sgpo=drouter_state->gpo(take.dst_id,take.dst_slot))==NULL) {
+      return false;
+    }
+    if(take.input<0) {
+      return sgpo->source_slot<0;
+    }
+    return (sgpo->source_address==take.src_id)&&
+      (sgpo->source_slot==take.src_slot);
 
-  if(input<0) {  // No route --i.e. destination is "OFF"
-    sql=QString("select ")+
-      "`SOURCE_SLOT` "+  // 00
-      "from `SA_GPOS` where "+
-      QString::asprintf("`ROUTER_NUMBER`=%d && ",router)+
-      QString::asprintf("`SOURCE_NUMBER`=%d && ",output)+
-      "`SOURCE_SLOT`<0";
-    q=new SqlQuery(sql);
-    FinalizeSARouteEvent(event_id,q->first());
-    delete q;
+  case EndPointMap::LastRouter:
+    break;
   }
-  else {
-    sql=QString("select ")+
-      "`SA_GPOS`.`ID` "+  // 00
-      "from `SA_GPOS` left join `SA_GPIS` "+
-      "on `SA_GPOS`.`SOURCE_ADDRESS`=`SA_GPIS`.`HOST_ADDRESS` && "+
-      "`SA_GPOS`.`SOURCE_SLOT`=`SA_GPIS`.`SLOT` && "+
-      "`SA_GPIS`.`ROUTER_NUMBER`=`SA_GPOS`.`ROUTER_NUMBER` "+
-      "where "+
-      QString::asprintf("`SA_GPOS`.`ROUTER_NUMBER`=%d && ",
-			router)+
-      QString::asprintf("`SA_GPIS`.`SOURCE_NUMBER`=%d && ",
-			input)+
-      QString::asprintf("`SA_GPOS`.`SOURCE_NUMBER`=%d",
-			output);
-    q=new SqlQuery(sql);
-    FinalizeSARouteEvent(event_id,q->first());
-    delete q;
+
+  return false;
+}
+
+
+void DRouter::AddPendingTake(int event_id,int router,int output,int input)
+{
+  PendingTake take;
+
+  take.event_id=event_id;
+  take.router=router;
+  take.output=output;
+  take.input=input;
+  if(!ResolveTake(&take)) {
+    FinalizeSARouteEvent(event_id,router,output,input,false,-1);
+    return;
   }
+  take.started=drouter_take_clock.elapsed();
+  take.deadline=take.started+drouter_config->routeConfirmTimeout();
+  drouter_pending_takes[event_id]=take;
+  drouter_pending_dsts.insert(TakeKey(take.dst_id,take.dst_slot),event_id);
+  drouter_pending_deadlines.insert(take.deadline,event_id);
+
+  //
+  // Already in place, so the node will report no change
+  //
+  if(TakeIsComplete(take)) {
+    FinishPendingTake(event_id,true);
+    return;
+  }
+  ScheduleTakeTimeout();
 }
 
 
-void DRouter::FinalizeSARouteEvent(int event_id,bool status) const
+void DRouter::ConfirmPendingTakes(unsigned id,int slot)
 {
-  QString comment="";
-  QString sql;
-  SqlQuery *q=NULL;
-  QString router_name;
-  QString input_name;
-  QString output_name;
+  quint64 key=TakeKey(id,slot);
 
-  sql=QString("select ")+
-    "`STATUS`,"+              // 00
-    "`ROUTER_NUMBER`,"+       // 01
-    "`DESTINATION_NUMBER`,"+  // 02
-    "`SOURCE_NUMBER`,"+       // 03
-    "`USERNAME`,"+            // 04
-    "`HOSTNAME`,"+            // 05
-    "`ORIGINATING_ADDRESS` "+ // 06
-    "from `PERM_SA_EVENTS` where "+
-    QString::asprintf("`ID`=%d",event_id);
-  q=new SqlQuery(sql);
-  if(q->first()) {
-    EndPointMap *map=drouter_maps.value(q->value(1).toInt());
-    if(map!=NULL) {
-      router_name=map->routerName();
-      output_name=map->name(EndPointMap::Output,q->value(2).toInt());
-      input_name=map->name(EndPointMap::Input,q->value(3).toInt());
+  if(!drouter_pending_dsts.contains(key)) {
+    return;
+  }
+  QList<int> event_ids=drouter_pending_dsts.values(key);
+  for(int i=0;i<event_ids.size();i++) {
+    if(TakeIsComplete(drouter_pending_takes.value(event_ids.at(i)))) {
+      FinishPendingTake(event_ids.at(i),true);
     }
   }
-  delete q;
+}
 
-  if(status) {
-    sql=QString("update `PERM_SA_EVENTS` set ")+
-      "`STATUS`='Y',"+
-      "`ROUTER_NAME`='"+SqlQuery::escape(router_name)+"',"+
-      "`DESTINATION_NAME`='"+SqlQuery::escape(output_name)+"',"+
-      "`SOURCE_NAME`='"+SqlQuery::escape(input_name)+"' "+
-      QString::asprintf("where `ID`=%d",event_id);
+
+void DRouter::FinishPendingTake(int event_id,bool status)
+{
+  if(!drouter_pending_takes.contains(event_id)) {
+    return;
   }
-  else {
-    sql=QString("update `PERM_SA_EVENTS` set ")+
-      "`STATUS`='N',"+
-      "`ROUTER_NAME`='"+SqlQuery::escape(router_name)+"',"+
-      "`DESTINATION_NAME`='"+SqlQuery::escape(output_name)+"',"+
-      "`SOURCE_NAME`='"+SqlQuery::escape(input_name)+"' "+
-      QString::asprintf("where `ID`=%d",event_id);
+  PendingTake take=drouter_pending_takes.take(event_id);
+  int msecs=drouter_take_clock.elapsed()-take.started;
+
+  drouter_pending_dsts.remove(TakeKey(take.dst_id,take.dst_slot),event_id);
+  drouter_pending_deadlines.remove(take.deadline,event_id);
+  FinalizeSARouteEvent(event_id,take.router,take.output,take.input,status,
+		       status ? msecs : -1);
+
+  ProtoIpcMessage msg(ProtoIpcMessage::TypeRouteConfirm);
+  msg.writeInt(event_id);
+  msg.writeInt(take.router);
+  msg.writeInt(take.output);
+  msg.writeInt(take.input);
+  msg.writeBool(status);
+  msg.writeInt(msecs);
+  NotifyProtocols(msg);
+
+  ScheduleTakeTimeout();
+}
+
+
+void DRouter::ClearPendingTakes()
+{
+  //
+  // Left open for whichever instance becomes active next
+  //
+  drouter_pending_takes.clear();
+  drouter_pending_dsts.clear();
+  drouter_pending_deadlines.clear();
+  drouter_take_timer->stop();
+}
+
+
+void DRouter::ScheduleTakeTimeout()
+{
+  if(drouter_pending_deadlines.isEmpty()) {
+    drouter_take_timer->stop();
+    return;
   }
-  SqlQuery::apply(sql);
+  qint64 msecs=
+    drouter_pending_deadlines.firstKey()-drouter_take_clock.elapsed();
+  drouter_take_timer->start(msecs>0 ? msecs : 0);
+}
+
+
+quint64 DRouter::TakeKey(unsigned id,int slot)
+{
+  return ((quint64)id<<32)|(0xFFFFFFFF&(quint64)slot);
+}
+
+
+void DRouter::FinalizeSARouteEvent(int event_id,int router,int output,
+				   int input,bool status,int msecs) const
+{
+  QString sql;
+  QString router_name;
+  QString input_name;
+  QString output_name;
+  QVariant latency(QVariant::Int);  // NULL unless confirmed
+
+  EndPointMap *map=drouter_maps.value(router);
+  if(map!=NULL) {
+    router_name=map->routerName();
+    output_name=map->name(EndPointMap::Output,output);
+    input_name=map->name(EndPointMap::Input,input);
+  }
+  if(msecs>=0) {
+    latency=msecs;
+  }
+  sql=QString("update `PERM_SA_EVENTS` set ")+
+    "`STATUS`=?,"+
+    "`LATENCY`=?,"+
+    "`ROUTER_NAME`=?,"+
+    "`DESTINATION_NAME`=?,"+
+    "`SOURCE_NAME`=? "+
+    "where `ID`=?";
+  drouter_writer->enqueue(QString::asprintf("PERM_SA_EVENTS:%d",event_id),
+			  sql,QVariantList()<<QString(status?"Y":"N")<<latency<<
+			  router_name<<output_name<<input_name<<event_id);
 }
 
 
@@ -1692,7 +1951,7 @@ void DRouter::WriteCommentEvent(const QString &str) const
     "`TYPE`='C',"+
     "`DATETIME`=now(),"+
     "`STATUS`='Y',"+
-    "`COMMENT`='"+SqlQuery::escape(str)+"'";
-  SqlQuery::apply(sql);
+    "`COMMENT`=?";
+  drouter_writer->enqueue("",sql,QVariantList()<<str);
 }
 
@@ -21,20 +21,36 @@
 #ifndef DROUTER_H
 #define DROUTER_H
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QList>
 #include <QMap>
 #include <QObject>
 #include <QSignalMapper>
+#include <QStringList>
 #include <QTcpServer>
 #include <QTimer>
+#include <QVariant>
 
 //#include <sy5/sylwrp_client.h>
 #include <sy5/symcastsocket.h>
 
 #include "matrix.h"
+#include "changejournal.h"
 #include "config.h"
+#include "dbwriter.h"
 #include "endpointmap.h"
+#include "eventpurger.h"
 #include "gpioflasher.h"
+#include "nodetables.h"
+#include "protoipc.h"
+#include "statesnapshot.h"
+#include "statestore.h"
+
+#define DROUTER_WRITER_FLUSH_TIMEOUT 10000
+#define DROUTER_PURGE_EVENTS_INTERVAL 60000
+#define DROUTER_FINALIZE_EVENTS_INTERVAL 60000
+#define DROUTER_PURGE_NAMES_INTERVAL 300000
 
 class DRouter : public QObject
 {
@@ -78,26 +94,56 @@ class DRouter : public QObject
   void newIpcConnectionData(int listen_sock);
   void ipcReadyReadData(int sock);
   void finalizeEventsData();
+  void takeTimeoutData();
   void purgeEventsData();
   void dbKeepaliveData();
+  void ingestData();
+  void writerStatsData();
+  void purgeNamesData();
   
  private:
-  void NotifyProtocols(const QString &type,const QString &id,
-		       int srcs=-1,int dsts=-1,int gpis=-1,int gpos=-1);
+  struct PendingTake {
+    PendingTake();
+    int event_id;
+    int router;
+    int output;
+    int input;
+    EndPointMap::RouterType router_type;
+    unsigned dst_id;
+    int dst_slot;
+    unsigned src_id;
+    int src_slot;
+    qint64 deadline;
+    qint64 started;
+  };
+  void NotifyProtocols(const ProtoIpcMessage &msg);
+  void QueueMirrorUpdate(const QString &key,const QString &sql,
+			 const QVariantList &values);
+  ProtoIpcMessage::Node NodeRecord(unsigned id) const;
+  ProtoIpcMessage::Source SourceRecord(unsigned id,int slot) const;
+  ProtoIpcMessage::Destination DestinationRecord(unsigned id,int slot) const;
+  ProtoIpcMessage::Gpi GpiRecord(unsigned id,int slot) const;
+  ProtoIpcMessage::Gpo GpoRecord(unsigned id,int slot) const;
+  void RebuildSnapshot();
   bool StartProtocolIpc(QString *err_msg);
   bool ProcessIpcCommand(int sock,const QString &cmd);
   bool StartDb(QString *err_msg);
   bool StartStaticMatrices(QString *err_msg);
   bool StartLivewire(QString *err_msg);
   Matrix *StartMatrix(Config::MatrixType type,unsigned id);
-  void LockTables() const;
-  void UnlockTables() const;
   void LoadMaps();
   void SendProtoSocket(int dest_sock,int proto_sock);
   void Log(int prio,const QString &msg) const;
-  void FinalizeSAAudioRoute(int event_id,int router,int output,int input);
-  void FinalizeSAGpioRoute(int event_id,int router,int output,int input);
-  void FinalizeSARouteEvent(int event_id,bool status) const;
+  bool ResolveTake(PendingTake *take) const;
+  bool TakeIsComplete(const PendingTake &take) const;
+  void AddPendingTake(int event_id,int router,int output,int input);
+  void ConfirmPendingTakes(unsigned id,int slot);
+  void FinishPendingTake(int event_id,bool status);
+  void ClearPendingTakes();
+  void ScheduleTakeTimeout();
+  static quint64 TakeKey(unsigned id,int slot);
+  void FinalizeSARouteEvent(int event_id,int router,int output,int input,
+			    bool status,int msecs) const;
   void WriteCommentEvent(const QString &str) const;
   QMap<unsigned,Matrix *> drouter_nodes;
   QList<SyMcastSocket *> drouter_advt_sockets;
@@ -109,9 +155,26 @@ class DRouter : public QObject
   int *drouter_proto_socks;
   bool drouter_writeable;
   GpioFlasher *drouter_flasher;
-  QTimer *drouter_finalize_timer;
+  QMap<int,PendingTake> drouter_pending_takes;
+  QMultiHash<quint64,int> drouter_pending_dsts;
+  QMultiMap<qint64,int> drouter_pending_deadlines;
+  QTimer *drouter_take_timer;
+  QElapsedTimer drouter_take_clock;
+  QTimer *drouter_finalize_events_timer;
   QTimer *drouter_purge_events_timer;
+  EventPurger *drouter_purger;
   QTimer *drouter_db_keepalive_timer;
+  StateStore *drouter_state;
+  StateSnapshot *drouter_snapshot;
+  ChangeJournal *drouter_journal;
+  QList<unsigned> drouter_ingest_connects;
+  QMap<unsigned,ProtoIpcMessage::Node> drouter_ingest_disconnects;
+  QTimer *drouter_ingest_timer;
+  bool drouter_ingest_startup;
+  DbWriter *drouter_writer;
+  NodeTables *drouter_tables;
+  QTimer *drouter_writer_stats_timer;
+  QTimer *drouter_purge_names_timer;
   Config *drouter_config;
 };
 
@@ -0,0 +1,402 @@
+// eventpurger.cpp
+//
+// Background purging of expired event log records for drouterd(8)
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <syslog.h>
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QVariant>
+
+#include "eventpurger.h"
+#include "sqlquery.h"
+
+EventPurger::EventPurger(int chunk_rows,int budget_msecs,bool partitioned,
+			 QObject *parent)
+  : QThread(parent)
+{
+  purger_chunk_rows=chunk_rows;
+  if(purger_chunk_rows<1) {
+    purger_chunk_rows=1;
+  }
+  purger_budget_msecs=budget_msecs;
+  purger_partitioned=partitioned;
+  purger_connected=false;
+  purger_quit=false;
+  purger_purged=0;
+  purger_partitions_dropped=0;
+  purger_last_purged=0;
+  purger_last_purge_msecs=0;
+}
+
+
+EventPurger::~EventPurger()
+{
+  if(isRunning()) {
+    stop();
+  }
+}
+
+
+void EventPurger::purge(const QDateTime &cutoff)
+{
+  QMutexLocker locker(&purger_mutex);
+
+  purger_cutoff=cutoff;
+  purger_wake.wakeAll();
+}
+
+
+void EventPurger::stop(unsigned long msecs)
+{
+  purger_mutex.lock();
+  purger_quit=true;
+  purger_wake.wakeAll();
+  purger_mutex.unlock();
+  if(!wait(msecs)) {
+    syslog(LOG_WARNING,"timed out waiting for the event purger to stop");
+  }
+}
+
+
+qint64 EventPurger::purged() const
+{
+  QMutexLocker locker(&purger_mutex);
+
+  return purger_purged;
+}
+
+
+int EventPurger::partitionsDropped() const
+{
+  QMutexLocker locker(&purger_mutex);
+
+  return purger_partitions_dropped;
+}
+
+
+qint64 EventPurger::lastPurged() const
+{
+  QMutexLocker locker(&purger_mutex);
+
+  return purger_last_purged;
+}
+
+
+qint64 EventPurger::lastPurgeMsecs() const
+{
+  QMutexLocker locker(&purger_mutex);
+
+  return purger_last_purge_msecs;
+}
+
+
+void EventPurger::run()
+{
+  QDateTime cutoff;
+  QElapsedTimer timer;
+  qint64 rows=0;
+  int dropped=0;
+  bool ok=false;
+
+  purger_mutex.lock();
+  while(true) {
+    while((!purger_cutoff.isValid())&&(!purger_quit)) {
+      purger_wake.wait(&purger_mutex);
+    }
+    if(purger_quit) {
+      break;
+    }
+    cutoff=purger_cutoff;
+    purger_cutoff=QDateTime();
+    purger_mutex.unlock();
+
+    timer.start();
+    rows=0;
+    dropped=0;
+    ok=Connect();
+    if(ok&&purger_partitioned) {
+      ok=ManagePartitions(cutoff,&dropped);
+    }
+    if(ok) {
+      ok=PurgeRows(cutoff,&rows);
+    }
+
+    purger_mutex.lock();
+    purger_purged+=rows;
+    purger_partitions_dropped+=dropped;
+    purger_last_purged=rows;
+    purger_last_purge_msecs=timer.elapsed();
+    if((rows>0)||(dropped>0)) {
+      syslog(LOG_INFO,
+	     "purged %lld event record(s) and %d partition(s) older than %s in %lld mS",
+	     rows,dropped,
+	     cutoff.toString("yyyy-MM-dd hh:mm:ss").toUtf8().constData(),
+	     purger_last_purge_msecs);
+    }
+    else {
+      syslog(LOG_DEBUG,"no event records older than %s to purge, %lld mS",
+	     cutoff.toString("yyyy-MM-dd hh:mm:ss").toUtf8().constData(),
+	     purger_last_purge_msecs);
+    }
+    if(!ok) {
+      syslog(LOG_WARNING,"event purge incomplete, will retry next cycle");
+    }
+  }
+  purger_mutex.unlock();
+
+  Disconnect();
+  QSqlDatabase::removeDatabase(EVENTPURGER_CONNECTION_NAME);
+}
+
+
+bool EventPurger::Connect()
+{
+  if(purger_connected) {
+    return true;
+  }
+
+  //
+  // Scoped so that no QSqlDatabase copy outlives a later removeDatabase()
+  //
+  {
+    QSqlDatabase db;
+    if(QSqlDatabase::contains(EVENTPURGER_CONNECTION_NAME)) {
+      db=QSqlDatabase::database(EVENTPURGER_CONNECTION_NAME,false);
+    }
+    else {
+      db=QSqlDatabase::addDatabase("QMYSQL3",EVENTPURGER_CONNECTION_NAME);
+      db.setHostName("localhost");
+      db.setDatabaseName("drouter");
+      db.setUserName("drouter");
+      db.setPassword("drouter");
+    }
+    if(!db.open()) {
+      syslog(LOG_WARNING,"event purger unable to connect [%s]",
+	     db.lastError().driverText().toUtf8().constData());
+      return false;
+    }
+  }
+  purger_connected=true;
+
+  return true;
+}
+
+
+void EventPurger::Disconnect()
+{
+  if(QSqlDatabase::contains(EVENTPURGER_CONNECTION_NAME)) {
+    QSqlDatabase::database(EVENTPURGER_CONNECTION_NAME,false).close();
+  }
+  purger_connected=false;
+}
+
+
+bool EventPurger::Exec(QSqlQuery *q,const QString &sql)
+{
+  if(!q->exec(sql)) {
+    syslog(LOG_WARNING,"event purger sql error [%s]: %s",
+	   q->lastError().text().toUtf8().constData(),
+	   sql.toUtf8().constData());
+    if(SqlQuery::isConnectionError(q->lastError())) {
+      Disconnect();
+    }
+    return false;
+  }
+
+  return true;
+}
+
+
+bool EventPurger::PurgeRows(const QDateTime &cutoff,qint64 *rows)
+{
+  QSqlQuery q(QSqlDatabase::database(EVENTPURGER_CONNECTION_NAME,false));
+  QElapsedTimer tick;
+  int n=0;
+  bool quit=false;
+
+  *rows=0;
+  q.prepare(QString("delete from `PERM_SA_EVENTS` where ")+
+	    "`DATETIME`<? "+
+	    "order by `DATETIME` "+
+	    QString::asprintf("limit %d",purger_chunk_rows));
+  tick.start();
+  while(true) {
+    q.bindValue(0,cutoff);
+    if(!q.exec()) {
+      syslog(LOG_WARNING,"event purger sql error [%s]",
+	     q.lastError().text().toUtf8().constData());
+      if(SqlQuery::isConnectionError(q.lastError())) {
+	Disconnect();
+      }
+      return false;
+    }
+    n=q.numRowsAffected();
+    *rows+=n;
+    q.finish();
+    if(n<purger_chunk_rows) {
+      return true;
+    }
+
+    //
+    // Out of time for this tick, so let everyone else at the table
+    //
+    if(tick.elapsed()>=purger_budget_msecs) {
+      purger_mutex.lock();
+      if(!purger_quit) {
+	purger_wake.wait(&purger_mutex,EVENTPURGER_TICK_INTERVAL);
+      }
+      quit=purger_quit;
+      purger_mutex.unlock();
+      if(quit) {
+	return true;
+      }
+      tick.start();
+    }
+  }
+
+  return true;
+}
+
+
+bool EventPurger::ManagePartitions(const QDateTime &cutoff,int *dropped)
+{
+  QSqlQuery q(QSqlDatabase::database(EVENTPURGER_CONNECTION_NAME,false));
+  QStringList names;
+  QStringList drops;
+  QStringList defs;
+  QDate last;
+  QDate date;
+  bool partitioned=false;
+
+  *dropped=0;
+  if(!LoadPartitions(&names,&partitioned)) {
+    return false;
+  }
+  if(!partitioned) {
+    if(!(Partition()&&LoadPartitions(&names,&partitioned))) {
+      return false;
+    }
+  }
+  for(int i=0;i<names.size();i++) {
+    date=QDate::fromString(names.at(i).mid(1),"yyyyMMdd");
+    if(date.isValid()) {
+      if((!last.isValid())||(date>last)) {
+	last=date;
+      }
+      if(date<cutoff.date()) {
+	drops.push_back("`"+names.at(i)+"`");
+      }
+    }
+  }
+
+  //
+  // Split the days ahead out of the catch-all partition
+  //
+  QDate end=QDate::currentDate().addDays(EVENTPURGER_PARTITIONS_AHEAD);
+  if(!last.isValid()) {
+    last=QDate::currentDate().addDays(-1);
+  }
+  if(last<end) {
+    for(date=last.addDays(1);date<=end;date=date.addDays(1)) {
+      defs.push_back(PartitionDefinition(date));
+    }
+    defs.push_back("partition `pmax` values less than maxvalue");
+    if(!Exec(&q,QString("alter table `PERM_SA_EVENTS` ")+
+	     "reorganize partition `pmax` into ("+defs.join(",")+")")) {
+      return false;
+    }
+  }
+
+  //
+  // Whole days before the cutoff go in one step
+  //
+  if(drops.size()>0) {
+    if(!Exec(&q,QString("alter table `PERM_SA_EVENTS` ")+
+	     "drop partition "+drops.join(","))) {
+      return false;
+    }
+    *dropped=drops.size();
+  }
+
+  return true;
+}
+
+
+bool EventPurger::LoadPartitions(QStringList *names,bool *partitioned)
+{
+  QSqlQuery q(QSqlDatabase::database(EVENTPURGER_CONNECTION_NAME,false));
+  QString sql=QString("select ")+
+    "`PARTITION_NAME` "+  // 00
+    "from `information_schema`.`PARTITIONS` where "+
+    "`TABLE_SCHEMA`=database() && "+
+    "`TABLE_NAME`='PERM_SA_EVENTS' "+
+    "order by `PARTITION_ORDINAL_POSITION`";
+
+  names->clear();
+  *partitioned=false;
+  if(!Exec(&q,sql)) {
+    return false;
+  }
+  while(q.next()) {
+    if(!q.value(0).isNull()) {
+      names->push_back(q.value(0).toString());
+      *partitioned=true;
+    }
+  }
+
+  return true;
+}
+
+
+bool EventPurger::Partition()
+{
+  //
+  // The partitioning column must be part of every unique key, so the
+  // primary key becomes (ID,DATETIME). Everything before today lands
+  // in the first partition.
+  //
+  QSqlQuery q(QSqlDatabase::database(EVENTPURGER_CONNECTION_NAME,false));
+  QStringList defs;
+  QDate today=QDate::currentDate();
+
+  for(int i=-1;i<=EVENTPURGER_PARTITIONS_AHEAD;i++) {
+    defs.push_back(PartitionDefinition(today.addDays(i)));
+  }
+  defs.push_back("partition `pmax` values less than maxvalue");
+  syslog(LOG_INFO,"converting PERM_SA_EVENTS to daily partitions");
+
+  return Exec(&q,QString("alter table `PERM_SA_EVENTS` ")+
+	      "drop primary key,"+
+	      "add primary key(`ID`,`DATETIME`) "+
+	      "partition by range(to_days(`DATETIME`)) ("+defs.join(",")+")");
+}
+
+
+QString EventPurger::PartitionName(const QDate &date)
+{
+  return "p"+date.toString("yyyyMMdd");
+}
+
+
+QString EventPurger::PartitionDefinition(const QDate &date)
+{
+  return "partition `"+PartitionName(date)+"` values less than "+
+    "(to_days('"+date.addDays(1).toString("yyyy-MM-dd")+"'))";
+}
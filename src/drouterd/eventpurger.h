@@ -0,0 +1,94 @@
+// eventpurger.h
+//
+// Background purging of expired event log records for drouterd(8)
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef EVENTPURGER_H
+#define EVENTPURGER_H
+
+#include <limits.h>
+
+#include <QDate>
+#include <QDateTime>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+#define EVENTPURGER_CONNECTION_NAME "eventpurger"
+#define EVENTPURGER_TICK_INTERVAL 1000
+#define EVENTPURGER_PARTITIONS_AHEAD 3
+
+//
+// Deletes event log records older than a cutoff from its own thread and
+// connection. Records are removed through the DATETIME index in chunks
+// of at most 'chunk_rows' rows, spending no more than 'budget_msecs' at
+// a time before pausing for EVENTPURGER_TICK_INTERVAL, so that no single
+// statement holds its locks for long.
+//
+// If 'partitioned' is set, PERM_SA_EVENTS is converted to one partition
+// per day (if it is not already), partitions are created ahead of time
+// and those lying wholly before the cutoff are dropped outright.
+//
+class EventPurger : public QThread
+{
+  Q_OBJECT;
+ public:
+  EventPurger(int chunk_rows,int budget_msecs,bool partitioned,
+	      QObject *parent=0);
+  ~EventPurger();
+  void purge(const QDateTime &cutoff);
+  void stop(unsigned long msecs=ULONG_MAX);
+  qint64 purged() const;
+  int partitionsDropped() const;
+  qint64 lastPurged() const;
+  qint64 lastPurgeMsecs() const;
+
+ protected:
+  void run();
+
+ private:
+  bool Connect();
+  void Disconnect();
+  bool Exec(QSqlQuery *q,const QString &sql);
+  bool PurgeRows(const QDateTime &cutoff,qint64 *rows);
+  bool ManagePartitions(const QDateTime &cutoff,int *dropped);
+  bool LoadPartitions(QStringList *names,bool *partitioned);
+  bool Partition();
+  static QString PartitionName(const QDate &date);
+  static QString PartitionDefinition(const QDate &date);
+  int purger_chunk_rows;
+  int purger_budget_msecs;
+  bool purger_partitioned;
+  QDateTime purger_cutoff;
+  bool purger_connected;
+  bool purger_quit;
+  qint64 purger_purged;
+  int purger_partitions_dropped;
+  qint64 purger_last_purged;
+  qint64 purger_last_purge_msecs;
+  mutable QMutex purger_mutex;
+  QWaitCondition purger_wake;
+};
+
+
+#endif  // EVENTPURGER_H
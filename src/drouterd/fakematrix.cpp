@@ -0,0 +1,129 @@
+// fakematrix.cpp
+//
+// A simulated matrix for drouterd(8) benchmarks
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include "fakematrix.h"
+
+FakeMatrix::FakeMatrix(unsigned id,int slot_quan,Config *conf,QObject *parent)
+  : Matrix(Config::LwrpMatrix,id,conf,parent)
+{
+  fake_slots=slot_quan;
+}
+
+
+bool FakeMatrix::isConnected() const
+{
+  return true;
+}
+
+
+QHostAddress FakeMatrix::hostAddress() const
+{
+  return QHostAddress(id());
+}
+
+
+QString FakeMatrix::hostName() const
+{
+  return QString::asprintf("node%u",0xFFFF&id());
+}
+
+
+QString FakeMatrix::deviceName() const
+{
+  return QString("Axia xNode");
+}
+
+
+unsigned FakeMatrix::dstSlots() const
+{
+  return fake_slots;
+}
+
+
+unsigned FakeMatrix::srcSlots() const
+{
+  return fake_slots;
+}
+
+
+int FakeMatrix::srcNumber(int slot) const
+{
+  return ((id()&0xFFFF)-1)*fake_slots+slot+1;
+}
+
+
+QHostAddress FakeMatrix::srcAddress(int slot) const
+{
+  return streamAddress(srcNumber(slot));
+}
+
+
+QString FakeMatrix::srcName(int slot) const
+{
+  return QString::asprintf("Source %d",slot+1);
+}
+
+
+bool FakeMatrix::srcEnabled(int slot) const
+{
+  return true;
+}
+
+
+unsigned FakeMatrix::srcChannels(int slot) const
+{
+  return 2;
+}
+
+
+unsigned FakeMatrix::srcPacketSize(int slot)
+{
+  return 12;
+}
+
+
+QHostAddress FakeMatrix::dstAddress(int slot) const
+{
+  return srcAddress(slot);
+}
+
+
+QString FakeMatrix::dstName(int slot) const
+{
+  return QString::asprintf("Dest %d",slot+1);
+}
+
+
+unsigned FakeMatrix::dstChannels(int slot) const
+{
+  return 2;
+}
+
+
+void FakeMatrix::connectToHost(const QHostAddress &addr,uint16_t port,
+			       const QString &pwd,bool persistent)
+{
+}
+
+
+QHostAddress FakeMatrix::streamAddress(int num)
+{
+  return QHostAddress((239u<<24)+(192u<<16)+(0xFFFF&(uint32_t)num));
+}
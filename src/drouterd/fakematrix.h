@@ -0,0 +1,57 @@
+// fakematrix.h
+//
+// A simulated matrix for drouterd(8) benchmarks
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef FAKEMATRIX_H
+#define FAKEMATRIX_H
+
+#include "matrix.h"
+
+//
+// A matrix with no device behind it
+//
+class FakeMatrix : public Matrix
+{
+ public:
+  FakeMatrix(unsigned id,int slot_quan,Config *conf,QObject *parent=0);
+  bool isConnected() const;
+  QHostAddress hostAddress() const;
+  QString hostName() const;
+  QString deviceName() const;
+  unsigned dstSlots() const;
+  unsigned srcSlots() const;
+  int srcNumber(int slot) const;
+  QHostAddress srcAddress(int slot) const;
+  QString srcName(int slot) const;
+  bool srcEnabled(int slot) const;
+  unsigned srcChannels(int slot) const;
+  unsigned srcPacketSize(int slot);
+  QHostAddress dstAddress(int slot) const;
+  QString dstName(int slot) const;
+  unsigned dstChannels(int slot) const;
+  void connectToHost(const QHostAddress &addr,uint16_t port,
+		     const QString &pwd,bool persistent=false);
+  static QHostAddress streamAddress(int num);
+
+ private:
+  int fake_slots;
+};
+
+
+#endif  // FAKEMATRIX_H
@@ -0,0 +1,137 @@
+// hostresolver.cpp
+//
+// Cached reverse lookups of client addresses for the event log
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <QDateTime>
+#include <QStringList>
+
+#include "hostresolver.h"
+#include "sqlquery.h"
+
+HostResolver::Entry::Entry()
+{
+  expires=0;
+  lookup_id=-1;
+}
+
+
+HostResolver::HostResolver(int ttl_secs,QObject *parent)
+  : QObject(parent)
+{
+  resolver_ttl=ttl_secs;
+  resolver_started=QDateTime::currentMSecsSinceEpoch();
+}
+
+
+bool HostResolver::hostName(const QHostAddress &addr,QString *hostname)
+{
+  Entry *e=&resolver_entries[addr.toIPv4Address()];
+
+  if(e->expires>QDateTime::currentMSecsSinceEpoch()) {
+    *hostname=e->hostname;
+    return true;
+  }
+  if((e->expires==0)&&(e->lookup_id<0)&&LoadHostName(addr,e)) {
+    *hostname=e->hostname;
+    return true;
+  }
+
+  return false;
+}
+
+
+void HostResolver::resolve(const QHostAddress &addr,int event_id)
+{
+  Entry *e=&resolver_entries[addr.toIPv4Address()];
+
+  e->event_ids.push_back(event_id);
+  if(e->lookup_id<0) {
+    e->lookup_id=QHostInfo::lookupHost(addr.toString(),this,
+			      SLOT(lookupFinishedData(const QHostInfo &)));
+    resolver_lookups[e->lookup_id]=addr.toIPv4Address();
+  }
+}
+
+
+void HostResolver::lookupFinishedData(const QHostInfo &info)
+{
+  QString sql;
+  QStringList ids;
+
+  if(!resolver_lookups.contains(info.lookupId())) {
+    return;
+  }
+  Entry *e=&resolver_entries[resolver_lookups.take(info.lookupId())];
+  e->hostname=info.hostName();
+  e->expires=QDateTime::currentMSecsSinceEpoch()+1000*(qint64)resolver_ttl;
+  e->lookup_id=-1;
+  for(int i=0;i<e->event_ids.size();i++) {
+    ids.push_back(QString::asprintf("%d",e->event_ids.at(i)));
+  }
+  e->event_ids.clear();
+
+  //
+  // Not a prepared statement, as the ID list differs every time
+  //
+  if(ids.size()>0) {
+    sql=QString("update `PERM_SA_EVENTS` set ")+
+      "`HOSTNAME`='"+SqlQuery::escape(e->hostname)+"' where "+
+      "`ID` in ("+ids.join(",")+")";
+    SqlQuery::apply(sql);
+  }
+}
+
+
+bool HostResolver::LoadHostName(const QHostAddress &addr,Entry *e) const
+{
+  //
+  // Only to warm the cache at startup. The rows are also written from
+  // here with the cached name, so their DATETIME says nothing about when
+  // the name was actually resolved.
+  //
+  bool ret=false;
+  qint64 warm_until=resolver_started+1000*(qint64)resolver_ttl;
+
+  if((resolver_ttl<=0)||(QDateTime::currentMSecsSinceEpoch()>=warm_until)) {
+    return false;
+  }
+  QString sql=QString("select ")+
+    "`HOSTNAME`,"+  // 00
+    "`DATETIME` "+  // 01
+    "from `PERM_SA_EVENTS` where "+
+    "`DATETIME`>=? && "+
+    "`ORIGINATING_ADDRESS`=? && "+
+    "`HOSTNAME` is not null "+
+    "order by `DATETIME` desc limit 1";
+  SqlQuery *q=new SqlQuery(sql,QVariantList()<<
+			   QDateTime::currentDateTime().addSecs(-resolver_ttl)<<
+			   addr.toString());
+  if(q->first()) {
+    e->hostname=q->value(0).toString();
+    e->expires=
+      q->value(1).toDateTime().toMSecsSinceEpoch()+1000*(qint64)resolver_ttl;
+    if(e->expires>warm_until) {
+      e->expires=warm_until;
+    }
+    ret=true;
+  }
+  delete q;
+
+  return ret;
+}
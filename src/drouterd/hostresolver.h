@@ -0,0 +1,67 @@
+// hostresolver.h
+//
+// Cached reverse lookups of client addresses for the event log
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef HOSTRESOLVER_H
+#define HOSTRESOLVER_H
+
+#include <QHash>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QList>
+#include <QObject>
+#include <QString>
+
+//
+// Remembers the hostname of each client address for 'ttl_secs' seconds
+// from when it was resolved. Until 'ttl_secs' after startup, a miss is
+// first looked up among the names recently written to PERM_SA_EVENTS,
+// and expires no later than that; otherwise it falls back to a reverse
+// lookup, of which at most one per address is in flight at a time.
+// Events logged while a lookup is in flight have their HOSTNAME filled
+// in by a single update once it completes.
+//
+class HostResolver : public QObject
+{
+  Q_OBJECT;
+ public:
+  HostResolver(int ttl_secs,QObject *parent=0);
+  bool hostName(const QHostAddress &addr,QString *hostname);
+  void resolve(const QHostAddress &addr,int event_id);
+
+ private slots:
+  void lookupFinishedData(const QHostInfo &info);
+
+ private:
+  struct Entry {
+    Entry();
+    QString hostname;
+    qint64 expires;
+    int lookup_id;
+    QList<int> event_ids;
+  };
+  bool LoadHostName(const QHostAddress &addr,Entry *e) const;
+  QHash<quint32,Entry> resolver_entries;
+  QHash<int,quint32> resolver_lookups;
+  int resolver_ttl;
+  qint64 resolver_started;
+};
+
+
+#endif  // HOSTRESOLVER_H
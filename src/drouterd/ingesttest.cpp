@@ -0,0 +1,271 @@
+// ingesttest.cpp
+//
+// Benchmark node ingestion into the Drouter database
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+#include <QSqlError>
+
+#include <sy5/sycmdswitch.h>
+
+#include "ingesttest.h"
+#include "sqlquery.h"
+
+MainObject::MainObject(QObject *parent)
+  : QObject(parent)
+{
+  QString db_hostname="localhost";
+  bool ok=false;
+  bool result=true;
+
+  test_nodes=500;
+  test_slots=64;
+  test_compact=false;
+  test_timeout=10000;
+
+  SyCmdSwitch *cmd=new SyCmdSwitch("ingesttest",VERSION,INGESTTEST_USAGE);
+  for(int i=0;i<cmd->keys();i++) {
+    if(cmd->key(i)=="--db-hostname") {
+      db_hostname=cmd->value(i);
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--nodes") {
+      test_nodes=cmd->value(i).toInt(&ok);
+      if((!ok)||(test_nodes<1)||(test_nodes>65000)) {
+	fprintf(stderr,"ingesttest: invalid --nodes value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--slots") {
+      test_slots=cmd->value(i).toInt(&ok);
+      if((!ok)||(test_slots<1)) {
+	fprintf(stderr,"ingesttest: invalid --slots value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--compact") {
+      test_compact=true;
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--timeout") {
+      test_timeout=cmd->value(i).toInt(&ok);
+      if((!ok)||(test_timeout<1)) {
+	fprintf(stderr,"ingesttest: invalid --timeout value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(!cmd->processed(i)) {
+      fprintf(stderr,"ingesttest: unknown option \"%s\"\n",
+	      cmd->key(i).toUtf8().constData());
+      exit(1);
+    }
+  }
+
+  //
+  // Open Database
+  //
+  test_config=new Config();
+  QSqlDatabase db=QSqlDatabase::addDatabase("QMYSQL3");
+  db.setHostName(db_hostname);
+  db.setDatabaseName("drouter");
+  db.setUserName("drouter");
+  db.setPassword("drouter");
+  if(!db.open()) {
+    fprintf(stderr,"ingesttest: unable to open database [%s]\n",
+	    db.lastError().driverText().toUtf8().constData());
+    exit(1);
+  }
+  SqlQuery::apply(QString::asprintf("set max_heap_table_size=%d",
+				    test_config->maxHeapTableSize()));
+
+  //
+  // Simulated Nodes
+  //
+  // Every source and destination is mapped into a single SA router, so
+  // that the SA_* tables are written as well.
+  //
+  EndPointMap *map=new EndPointMap();
+  map->setRouterType(EndPointMap::AudioRouter);
+  map->setRouterNumber(0);
+  map->setRouterName("ingesttest");
+  test_maps[0]=map;
+  test_state=new StateStore();
+  for(int i=0;i<test_nodes;i++) {
+    FakeMatrix *mtx=
+      new FakeMatrix((10u<<24)+(1u<<16)+i+1,test_slots,test_config,this);
+    test_matrices.push_back(mtx);
+    test_state->addNode(mtx);
+    for(int j=0;j<test_slots;j++) {
+      map->insert(EndPointMap::Input,map->quantity(EndPointMap::Input),
+		  mtx->hostAddress(),j);
+      map->insert(EndPointMap::Output,map->quantity(EndPointMap::Output),
+		  mtx->hostAddress(),j);
+    }
+  }
+
+  result=Run("ingest-per-node",false)&&result;
+  result=Run("ingest-batched",true)&&result;
+
+  exit(!result);
+}
+
+
+bool MainObject::Run(const QString &name,bool batched)
+{
+  //
+  // A fresh NodeTables for each run, so that compact name IDs are
+  // written again as well
+  //
+  NodeTables *tables=new NodeTables(test_state,&test_maps,NULL,test_compact);
+  QList<unsigned> ids=test_state->nodeIds();
+  QElapsedTimer timer;
+  qint64 connect_msecs=0;
+  qint64 disconnect_msecs=0;
+  bool ret=false;
+
+  tables->createTables(true);
+
+  //
+  // Connects
+  //
+  timer.start();
+  if(batched) {
+    tables->lockTables();
+    tables->insertNodeRows(ids);
+    tables->unlockTables();
+  }
+  else {
+    for(int i=0;i<ids.size();i++) {
+      tables->lockTables();
+      tables->insertNodeRows(QList<unsigned>()<<ids.at(i));
+      tables->unlockTables();
+    }
+  }
+  if(WaitForRows(tables,true)) {
+    connect_msecs=timer.elapsed();
+
+    //
+    // Disconnects
+    //
+    timer.start();
+    if(batched) {
+      tables->lockTables();
+      tables->deleteNodeRows(ids);
+      tables->unlockTables();
+    }
+    else {
+      for(int i=0;i<ids.size();i++) {
+	tables->lockTables();
+	tables->deleteNodeRows(QList<unsigned>()<<ids.at(i));
+	tables->unlockTables();
+      }
+    }
+    if(WaitForRows(tables,false)) {
+      disconnect_msecs=timer.elapsed();
+      ret=true;
+    }
+  }
+  printf("bench=%s nodes=%d slots=%d compact=%d converged=%d "
+	 "connect_ms=%lld disconnect_ms=%lld\n",
+	 name.toUtf8().constData(),test_nodes,test_slots,test_compact,ret,
+	 connect_msecs,disconnect_msecs);
+  fflush(stdout);
+
+  DropTables(tables);
+  delete tables;
+
+  return ret;
+}
+
+
+bool MainObject::WaitForRows(NodeTables *tables,bool present) const
+{
+  //
+  // Converged once every node has all of its rows (or none at all) as
+  // seen by a reader of the tables
+  //
+  QElapsedTimer timer;
+  QMap<QString,int> expected;
+  SqlQuery *q=NULL;
+  bool converged=false;
+  int rows=test_nodes*test_slots;
+
+  expected["NODES"]=test_nodes;
+  expected["SOURCES"]=rows;
+  expected["DESTINATIONS"]=rows;
+  expected["SA_SOURCES"]=rows;
+  expected["SA_DESTINATIONS"]=rows;
+  timer.start();
+  while((!converged)&&(timer.elapsed()<test_timeout)) {
+    converged=true;
+    for(QMap<QString,int>::const_iterator it=expected.begin();
+	it!=expected.end();it++) {
+      q=new SqlQuery(QString("select count(*) from `")+
+		     tables->tableName(it.key())+"`");
+      if((!q->first())||(q->value(0).toInt()!=(present*it.value()))) {
+	converged=false;
+      }
+      delete q;
+    }
+    if(!converged) {
+      usleep(1000);
+    }
+  }
+
+  return converged;
+}
+
+
+void MainObject::DropTables(NodeTables *tables) const
+{
+  QStringList names;
+
+  names.push_back("NODES");
+  names.push_back("SOURCES");
+  names.push_back("DESTINATIONS");
+  names.push_back("GPIS");
+  names.push_back("GPOS");
+  names.push_back("SA_SOURCES");
+  names.push_back("SA_DESTINATIONS");
+  names.push_back("SA_GPIS");
+  names.push_back("SA_GPOS");
+  for(int i=0;i<names.size();i++) {
+    names[i]="`"+tables->tableName(names.at(i))+"`";
+  }
+  if(tables->compactSchema()) {
+    names.push_back("`NAMES`");
+  }
+  SqlQuery::apply("drop temporary table if exists "+names.join(","));
+}
+
+
+int main(int argc,char *argv[])
+{
+  QCoreApplication a(argc,argv);
+  new MainObject();
+  return a.exec();
+}
@@ -0,0 +1,57 @@
+// ingesttest.h
+//
+// Benchmark node ingestion into the Drouter database
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef INGESTTEST_H
+#define INGESTTEST_H
+
+#include <QList>
+#include <QMap>
+#include <QObject>
+
+#include "config.h"
+#include "endpointmap.h"
+#include "fakematrix.h"
+#include "nodetables.h"
+#include "statestore.h"
+
+#define INGESTTEST_USAGE "[options]\n\nTime how long the Drouter database takes to converge when simulated\nnodes connect and disconnect, one node per write (as with\nNodeStartupWindow=0) and all nodes in a single batch (as at the end of\na startup window), and print one \"key=value\" line per benchmark on\nstandard output. Rows are written by the same code that drouterd(8)\nuses, into TEMPORARY tables, so this is safe to run against a live\nsystem.\n\nOptions are:\n--db-hostname=<host>\n     Database server (default \"localhost\")\n\n--nodes=<num>\n     Number of simulated nodes (default 500)\n\n--slots=<num>\n     Sources and destinations per node (default 64)\n\n--compact\n     Use the compact schema (see CompactSchema= in drouter.conf(5))\n\n--timeout=<msecs>\n     Maximum time to wait for the database to converge (default 10000)\n\n"
+
+class MainObject : public QObject
+{
+ Q_OBJECT;
+ public:
+  MainObject(QObject *parent=0);
+
+ private:
+  bool Run(const QString &name,bool batched);
+  bool WaitForRows(NodeTables *tables,bool present) const;
+  void DropTables(NodeTables *tables) const;
+  int test_nodes;
+  int test_slots;
+  bool test_compact;
+  int test_timeout;
+  Config *test_config;
+  StateStore *test_state;
+  QList<FakeMatrix *> test_matrices;
+  QMap<int,EndPointMap *> test_maps;
+};
+
+
+#endif  // INGESTTEST_H
@@ -124,6 +124,15 @@ void Matrix::setDstAddress(int slot,const QString &addr)
 }
 
 
+void Matrix::setDstAddresses(const QMap<int,QHostAddress> &addrs)
+{
+  for(QMap<int,QHostAddress>::const_iterator it=addrs.constBegin();
+      it!=addrs.constEnd();it++) {
+    setDstAddress(it.key(),it.value());
+  }
+}
+
+
 QString Matrix::dstName(int slot) const
 {
   return QString();
@@ -27,6 +27,7 @@
 #include <vector>
 
 #include <QHostAddress>
+#include <QMap>
 #include <QObject>
 #include <QString>
 #include <QTcpSocket>
@@ -61,6 +62,7 @@ class Matrix :public QObject
   virtual QHostAddress dstAddress(int slot) const;
   virtual void setDstAddress(int slot,const QHostAddress &addr);
   virtual void setDstAddress(int slot,const QString &addr);
+  virtual void setDstAddresses(const QMap<int,QHostAddress> &addrs);
   virtual QString dstName(int slot) const;
   virtual unsigned dstChannels(int slot) const;
   virtual unsigned gpis() const;
@@ -169,6 +169,29 @@ void MatrixGvg7000::setDstAddress(int slot,const QString &s_addr)
 }
 
 
+void MatrixGvg7000::setDstAddresses(const QMap<int,QHostAddress> &addrs)
+{
+  //
+  // Queue the takes back-to-back and hand them to the socket in one write
+  //
+  QByteArray data;
+
+  for(QMap<int,QHostAddress>::const_iterator it=addrs.constBegin();
+      it!=addrs.constEnd();it++) {
+    if(d_destinations.value(it.key())->streamAddress()!=it.value()) {
+      int src_slot=it.value().toIPv4Address();
+      if(src_slot>=0) {  // Mute is not supported!
+	data+=ToGvgNative(QString::asprintf("TI,%02X,%02X",
+					    it.key(),src_slot-1));
+      }
+    }
+  }
+  if(!data.isEmpty()) {
+    d_socket->write(data);
+  }
+}
+
+
 QString MatrixGvg7000::dstName(int slot) const
 {
   return d_destinations.value(slot)->name();
@@ -55,6 +55,7 @@ class MatrixGvg7000 :public Matrix
   QHostAddress dstAddress(int slot) const;
   void setDstAddress(int slot,const QHostAddress &s_addr);
   void setDstAddress(int slot,const QString &s_addr);
+  void setDstAddresses(const QMap<int,QHostAddress> &addrs);
   QString dstName(int slot) const;
   unsigned dstChannels(int slot) const;
   void connectToHost(const QHostAddress &addr,uint16_t port,const QString &pwd,
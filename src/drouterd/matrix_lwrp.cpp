@@ -19,6 +19,8 @@
 //    Boston, MA  02111-1307  USA
 //
 
+#include <QStringList>
+
 #include "matrix_lwrp.h"
 
 MatrixLwrp::MatrixLwrp(unsigned id,Config *conf,QObject *parent)
@@ -175,6 +177,24 @@ void MatrixLwrp::setDstAddress(int slot,const QString &addr)
 }
 
 
+void MatrixLwrp::setDstAddresses(const QMap<int,QHostAddress> &addrs)
+{
+  //
+  // Send the entire salvo to the node as a single write
+  //
+  QStringList cmds;
+
+  for(QMap<int,QHostAddress>::const_iterator it=addrs.constBegin();
+      it!=addrs.constEnd();it++) {
+    cmds.push_back(QString::asprintf("DST %d ADDR:\"",it.key()+1)+
+		   it.value().toString()+"\"");
+  }
+  if(cmds.size()>0) {
+    d_lwrp_client->sendRawLwrp(cmds.join("\r\n"));
+  }
+}
+
+
 QString MatrixLwrp::dstName(int slot) const
 {
   return d_lwrp_client->dstName(slot);
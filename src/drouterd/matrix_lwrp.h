@@ -51,6 +51,7 @@ class MatrixLwrp :public Matrix
   QHostAddress dstAddress(int slot) const;
   void setDstAddress(int slot,const QHostAddress &addr);
   void setDstAddress(int slot,const QString &addr);
+  void setDstAddresses(const QMap<int,QHostAddress> &addrs);
   QString dstName(int slot) const;
   unsigned dstChannels(int slot) const;
   SyGpioBundle *gpiBundle(int slot) const;
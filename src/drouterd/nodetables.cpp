@@ -0,0 +1,968 @@
+// nodetables.cpp
+//
+// Ephemeral node tables in the Drouter database
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include "nodetables.h"
+#include "sqlquery.h"
+
+NodeTables::NodeTables(StateStore *state,QMap<int,EndPointMap *> *maps,
+		       DbWriter *writer,bool compact)
+{
+  tables_state=state;
+  tables_maps=maps;
+  tables_writer=writer;
+  tables_compact=compact;
+  tables_next_name_id=1;
+}
+
+
+bool NodeTables::compactSchema() const
+{
+  return tables_compact;
+}
+
+
+void NodeTables::createTables(bool temporary) const
+{
+  //
+  // TEMPORARY tables shadow the live ones for the current session only,
+  // and are created without the compact views
+  //
+  if(tables_compact) {
+    CreateCompactTables(temporary);
+  }
+  else {
+    CreateEphemeralTables(temporary);
+  }
+}
+
+
+void NodeTables::lockTables() const
+{
+  //
+  // Not needed when queued, as the DbWriter applies the rows in order.
+  // LOCK TABLES would also commit its open transaction.
+  //
+  if(tables_writer!=NULL) {
+    return;
+  }
+  QString sql=QString("lock tables ")+
+    "`"+tableName("DESTINATIONS")+"` write,"+
+    "`"+tableName("GPIS")+"` write,"+
+    "`"+tableName("GPOS")+"` write,"+
+    "`"+tableName("NODES")+"` write,"+
+    "`"+tableName("SA_DESTINATIONS")+"` write,"+
+    "`"+tableName("SA_GPIS")+"` write,"+
+    "`"+tableName("SA_GPOS")+"` write,"+
+    "`"+tableName("SA_SOURCES")+"` write,"+
+    "`"+tableName("SOURCES")+"` write";
+  if(tables_compact) {
+    sql+=",`NAMES` write";
+  }
+  SqlQuery::apply(sql);
+}
+
+
+void NodeTables::unlockTables() const
+{
+  if(tables_writer!=NULL) {
+    return;
+  }
+  QString sql=QString("unlock tables");
+  SqlQuery::apply(sql);
+}
+
+
+void NodeTables::insertNodeRows(const QList<unsigned> &ids)
+{
+  QStringList node_rows;
+  QStringList src_rows;
+  QStringList dst_rows;
+  QStringList gpi_rows;
+  QStringList gpo_rows;
+  QStringList sa_rows;
+  QStringList name_rows;
+  QList<const StateStore::Node *> src_nodes;
+  QList<const StateStore::Node *> dst_nodes;
+  QList<const StateStore::Node *> gpi_nodes;
+  QList<const StateStore::Node *> gpo_nodes;
+  QList<int> src_ids;
+  QList<int> dst_ids;
+  QList<int> gpi_ids;
+  QList<int> gpo_ids;
+  QList<int> src_slots;
+  QList<int> dst_slots;
+  QList<int> gpi_slots;
+  QList<int> gpo_slots;
+  int endpt;
+
+  //
+  // Node Records
+  //
+  for(int i=0;i<ids.size();i++) {
+    const StateStore::Node *n=tables_state->node(ids.at(i));
+    if(n==NULL) {
+      continue;
+    }
+    QString addr_lit=addressLiteral(QHostAddress(n->id));
+    node_rows.push_back(QString("(")+
+			addr_lit+","+
+			NameLiteral(n->host_name,&name_rows)+","+
+			"'"+SqlQuery::escape(n->device_name)+"',"+
+			QString::asprintf("%u,",n->matrix_type)+
+			QString::asprintf("%d,",n->sources.size())+
+			QString::asprintf("%d,",n->destinations.size())+
+			QString::asprintf("%d,",n->gpis.size())+
+			QString::asprintf("%d)",n->gpos.size()));
+    for(int j=0;j<n->sources.size();j++) {
+      const StateStore::Source *src=&(n->sources.at(j));
+      src_rows.push_back(QString("(")+
+			 addr_lit+","+
+			 QString::asprintf("%d,",j)+
+			 NameLiteral(n->host_name,&name_rows)+","+
+			 addressLiteral(QHostAddress(src->stream_address))+","+
+			 NameLiteral(src->name,&name_rows)+","+
+			 QString::asprintf("%u,",src->enabled)+
+			 QString::asprintf("%u,",src->channels)+
+			 QString::asprintf("%u)",src->packet_size));
+      src_nodes.push_back(n);
+      src_slots.push_back(j);
+    }
+    for(int j=0;j<n->destinations.size();j++) {
+      const StateStore::Destination *dst=&(n->destinations.at(j));
+      dst_rows.push_back(QString("(")+
+			 addr_lit+","+
+			 QString::asprintf("%d,",j)+
+			 NameLiteral(n->host_name,&name_rows)+","+
+			 addressLiteral(QHostAddress(dst->stream_address))+","+
+			 NameLiteral(dst->name,&name_rows)+","+
+			 QString::asprintf("%u)",dst->channels));
+      dst_nodes.push_back(n);
+      dst_slots.push_back(j);
+    }
+    for(int j=0;j<n->gpis.size();j++) {
+      gpi_rows.push_back(QString("(")+
+			 addr_lit+","+
+			 QString::asprintf("%d,",j)+
+			 NameLiteral(n->host_name,&name_rows)+","+
+			 "'"+n->gpis.at(j).code+"')");
+      gpi_nodes.push_back(n);
+      gpi_slots.push_back(j);
+    }
+    for(int j=0;j<n->gpos.size();j++) {
+      const StateStore::Gpo *gpo=&(n->gpos.at(j));
+      QString name=gpo->name;
+      if(name.isEmpty()) {
+	name=QString::asprintf("GPO %d",j+1);
+      }
+      gpo_rows.push_back(QString("(")+
+			 addr_lit+","+
+			 QString::asprintf("%d,",j)+
+			 NameLiteral(n->host_name,&name_rows)+","+
+			 "'"+gpo->code+"',"+
+			 NameLiteral(name,&name_rows)+","+
+			 addressLiteral(gpoSourceAddress(gpo))+","+
+			 QString::asprintf("%d)",gpo->source_slot));
+      gpo_nodes.push_back(n);
+      gpo_slots.push_back(j);
+    }
+  }
+  InsertRows(tableName("NODES"),
+	     "`HOST_ADDRESS`,`HOST_NAME`,`DEVICE_NAME`,"
+	     "`MATRIX_TYPE`,`SOURCE_SLOTS`,`DESTINATION_SLOTS`,"
+	     "`GPI_SLOTS`,`GPO_SLOTS`",node_rows,false);
+
+  //
+  // Sources
+  //
+  src_ids=InsertRows(tableName("SOURCES"),
+		     "`HOST_ADDRESS`,`SLOT`,`HOST_NAME`,"
+		     "`STREAM_ADDRESS`,`NAME`,`STREAM_ENABLED`,`CHANNELS`,"
+		     "`BLOCK_SIZE`",src_rows);
+  sa_rows.clear();
+  for(int i=0;i<src_nodes.size();i++) {
+    const StateStore::Node *n=src_nodes.at(i);
+    int slot=src_slots.at(i);
+    QString addr=QHostAddress(n->id).toString();
+    QString addr_lit=addressLiteral(QHostAddress(n->id));
+    for(QMap<int,EndPointMap *>::const_iterator it=tables_maps->begin();
+	it!=tables_maps->end();it++) {
+      if(it.value()->routerType()==EndPointMap::AudioRouter) {
+	if((endpt=it.value()->endPoint(EndPointMap::Input,addr,slot))>=0) {
+	  if(!it.value()->nameIsCustom(EndPointMap::Input,endpt)) {
+	    it.value()->setName(EndPointMap::Input,endpt,
+				n->sources.at(slot).name);
+	  }
+	  sa_rows.push_back(QString("(")+
+			    QString::asprintf("%d,",it.value()->routerNumber())+
+			    QString::asprintf("%d,",endpt)+
+			    QString::asprintf("%d,",src_ids.at(i))+
+			    addressLiteral(QHostAddress(n->sources.at(slot).
+						    stream_address))+","+
+			    addr_lit+","+
+			    QString::asprintf("%d,",slot)+
+			    NameLiteral(it.value()->
+					name(EndPointMap::Input,endpt),
+					&name_rows)+")");
+	}
+      }
+    }
+  }
+  InsertRows(tableName("SA_SOURCES"),
+	     "`ROUTER_NUMBER`,`SOURCE_NUMBER`,`SOURCE_ID`,"
+	     "`STREAM_ADDRESS`,`HOST_ADDRESS`,`SLOT`,`NAME`",sa_rows);
+
+  //
+  // Destinations
+  //
+  dst_ids=InsertRows(tableName("DESTINATIONS"),
+		     "`HOST_ADDRESS`,`SLOT`,`HOST_NAME`,"
+		     "`STREAM_ADDRESS`,`NAME`,`CHANNELS`",dst_rows);
+  sa_rows.clear();
+  for(int i=0;i<dst_nodes.size();i++) {
+    const StateStore::Node *n=dst_nodes.at(i);
+    int slot=dst_slots.at(i);
+    QString addr=QHostAddress(n->id).toString();
+    QString addr_lit=addressLiteral(QHostAddress(n->id));
+    for(QMap<int,EndPointMap *>::const_iterator it=tables_maps->begin();
+	it!=tables_maps->end();it++) {
+      if(it.value()->routerType()==EndPointMap::AudioRouter) {
+	if((endpt=it.value()->endPoint(EndPointMap::Output,addr,slot))>=0) {
+	  if(!it.value()->nameIsCustom(EndPointMap::Output,endpt)) {
+	    it.value()->setName(EndPointMap::Output,endpt,
+				n->destinations.at(slot).name);
+	  }
+	  sa_rows.push_back(QString("(")+
+			    QString::asprintf("%d,",it.value()->routerNumber())+
+			    QString::asprintf("%d,",endpt)+
+			    QString::asprintf("%d,",dst_ids.at(i))+
+			    addressLiteral(QHostAddress(n->destinations.at(slot).
+						    stream_address))+","+
+			    addr_lit+","+
+			    QString::asprintf("%d,",slot)+
+			    NameLiteral(it.value()->
+					name(EndPointMap::Output,endpt),
+					&name_rows)+")");
+	}
+      }
+    }
+  }
+  InsertRows(tableName("SA_DESTINATIONS"),
+	     "`ROUTER_NUMBER`,`SOURCE_NUMBER`,"
+	     "`DESTINATION_ID`,`STREAM_ADDRESS`,`HOST_ADDRESS`,`SLOT`,`NAME`",
+	     sa_rows);
+
+  //
+  // GPIs
+  //
+  gpi_ids=InsertRows(tableName("GPIS"),
+		     "`HOST_ADDRESS`,`SLOT`,`HOST_NAME`,`CODE`",gpi_rows);
+  sa_rows.clear();
+  for(int i=0;i<gpi_nodes.size();i++) {
+    const StateStore::Node *n=gpi_nodes.at(i);
+    int slot=gpi_slots.at(i);
+    QString addr=QHostAddress(n->id).toString();
+    QString addr_lit=addressLiteral(QHostAddress(n->id));
+    for(QMap<int,EndPointMap *>::const_iterator it=tables_maps->begin();
+	it!=tables_maps->end();it++) {
+      if(it.value()->routerType()==EndPointMap::GpioRouter) {
+	if((endpt=it.value()->endPoint(EndPointMap::Input,addr,slot))>=0) {
+	  if(!it.value()->nameIsCustom(EndPointMap::Input,endpt)) {
+	    it.value()->setName(EndPointMap::Input,endpt,
+				QString::asprintf("GPI-%d",slot+1));
+	  }
+	  sa_rows.push_back(QString("(")+
+			    QString::asprintf("%d,",it.value()->routerNumber())+
+			    QString::asprintf("%d,",endpt)+
+			    QString::asprintf("%d,",gpi_ids.at(i))+
+			    addr_lit+","+
+			    QString::asprintf("%d,",slot)+
+			    NameLiteral(it.value()->
+					name(EndPointMap::Input,endpt),
+					&name_rows)+")");
+	}
+      }
+    }
+  }
+  InsertRows(tableName("SA_GPIS"),
+	     "`ROUTER_NUMBER`,`SOURCE_NUMBER`,`GPI_ID`,"
+	     "`HOST_ADDRESS`,`SLOT`,`NAME`",sa_rows);
+
+  //
+  // GPOs
+  //
+  gpo_ids=InsertRows(tableName("GPOS"),
+		     "`HOST_ADDRESS`,`SLOT`,`HOST_NAME`,`CODE`,"
+		     "`NAME`,`SOURCE_ADDRESS`,`SOURCE_SLOT`",gpo_rows);
+  sa_rows.clear();
+  for(int i=0;i<gpo_nodes.size();i++) {
+    const StateStore::Node *n=gpo_nodes.at(i);
+    int slot=gpo_slots.at(i);
+    const StateStore::Gpo *gpo=&(n->gpos.at(slot));
+    QString addr=QHostAddress(n->id).toString();
+    QString addr_lit=addressLiteral(QHostAddress(n->id));
+    for(QMap<int,EndPointMap *>::const_iterator it=tables_maps->begin();
+	it!=tables_maps->end();it++) {
+      if(it.value()->routerType()==EndPointMap::GpioRouter) {
+	if((endpt=it.value()->endPoint(EndPointMap::Output,addr,slot))>=0) {
+	  if(!it.value()->nameIsCustom(EndPointMap::Output,endpt)) {
+	    it.value()->setName(EndPointMap::Output,endpt,gpo->name);
+	  }
+	  sa_rows.push_back(QString("(")+
+			    QString::asprintf("%d,",it.value()->routerNumber())+
+			    QString::asprintf("%d,",endpt)+
+			    QString::asprintf("%d,",gpo_ids.at(i))+
+			    addressLiteral(gpoSourceAddress(gpo))+","+
+			    QString::asprintf("%d,",gpo->source_slot)+
+			    addr_lit+","+
+			    QString::asprintf("%d,",slot)+
+			    NameLiteral(it.value()->
+					name(EndPointMap::Output,endpt),
+					&name_rows)+")");
+	}
+      }
+    }
+  }
+  InsertRows(tableName("SA_GPOS"),
+	     "`ROUTER_NUMBER`,`SOURCE_NUMBER`,`GPO_ID`,"
+	     "`SOURCE_ADDRESS`,`SOURCE_SLOT`,`HOST_ADDRESS`,`SLOT`,`NAME`",
+	     sa_rows);
+
+  //
+  // Names first seen here
+  //
+  InsertRows("NAMES","`ID`,`NAME`",name_rows,false);
+}
+
+
+void NodeTables::deleteNodeRows(const QList<unsigned> &ids) const
+{
+  QString sql;
+  QStringList addrs;
+  QStringList tables;
+
+  for(int i=0;i<ids.size();i++) {
+    addrs.push_back(addressLiteral(QHostAddress(ids.at(i))));
+  }
+  tables.push_back("SA_SOURCES");
+  tables.push_back("SOURCES");
+  tables.push_back("SA_DESTINATIONS");
+  tables.push_back("DESTINATIONS");
+  tables.push_back("SA_GPIS");
+  tables.push_back("GPIS");
+  tables.push_back("SA_GPOS");
+  tables.push_back("GPOS");
+  tables.push_back("NODES");
+  for(int i=0;i<tables.size();i++) {
+    sql=QString("delete from `")+tableName(tables.at(i))+"` where "+
+      "`HOST_ADDRESS` in ("+addrs.join(",")+")";
+    Apply(sql);
+  }
+}
+
+
+QString NodeTables::CreateTable(bool temporary) const
+{
+  if(temporary) {
+    return QString("create temporary table if not exists ");
+  }
+  return QString("create table if not exists ");
+}
+
+
+void NodeTables::CreateEphemeralTables(bool temporary) const
+{
+  QString sql;
+
+  sql=CreateTable(temporary)+QString("`NODES` (")+
+    "`HOST_ADDRESS` char(15) not null primary key,"+
+    "`HOST_NAME` char(191),"+
+    "`DEVICE_NAME` char(20),"+
+    "`MATRIX_TYPE` int,"+
+    "`SOURCE_SLOTS` int,"+
+    "`DESTINATION_SLOTS` int,"+
+    "`GPI_SLOTS` int,"+
+    "`GPO_SLOTS` int,"+
+    "index NODES_MATRIX_TYPE_IDX(`MATRIX_TYPE`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::run(sql);
+
+  sql=CreateTable(temporary)+QString("`SOURCES` (")+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` char(15) not null,"+
+    "`SLOT` int not null,"+
+    "`HOST_NAME` char(191),"+
+    "`STREAM_ADDRESS` char(15),"+
+    "`NAME` char(191),"+
+    "`STREAM_ENABLED` int,"+
+    "`CHANNELS` int,"+
+    "`BLOCK_SIZE` int,"+
+    "`LEFT_CLIP` int default 0,"+
+    "`RIGHT_CLIP` int default 0,"+
+    "`LEFT_SILENCE` int default 0,"+
+    "`RIGHT_SILENCE` int default 0,"+
+    "unique index SLOT_IDX(`HOST_ADDRESS`,`SLOT`),"+
+    "index STREAM_ADDRESS_IDX(`STREAM_ADDRESS`,`STREAM_ENABLED`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+
+  sql=CreateTable(temporary)+QString("`DESTINATIONS` (")+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` char(15) not null,"+
+    "`SLOT` int not null,"+
+    "`HOST_NAME` char(191),"+
+    "`STREAM_ADDRESS` char(15),"+
+    "`NAME` char(191),"+
+    "`CHANNELS` int,"+
+    "`LEFT_CLIP` int default 0,"+
+    "`RIGHT_CLIP` int default 0,"+
+    "`LEFT_SILENCE` int default 0,"+
+    "`RIGHT_SILENCE` int default 0,"+
+    "unique index SLOT_IDX(`HOST_ADDRESS`,`SLOT`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+
+  sql=CreateTable(temporary)+QString("`GPIS` (")+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` char(15) not null,"+
+    "`SLOT` int not null,"+
+    "`HOST_NAME` char(191),"+
+    "`CODE` char(5),"+
+    "unique index SLOT_IDX(`HOST_ADDRESS`,`SLOT`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+
+  sql=CreateTable(temporary)+QString("`GPOS` (")+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` char(15) not null,"+
+    "`SLOT` int not null,"+
+    "`HOST_NAME` char(191),"+
+    "`CODE` char(5),"+
+    "`NAME` char(191),"+
+    "`SOURCE_ADDRESS` char(22),"+
+    "`SOURCE_SLOT` int default -1,"+
+    "unique index SLOT_IDX(`HOST_ADDRESS`,`SLOT`),"+
+    "index SOURCE_ADDRESS_IDX(`SOURCE_ADDRESS`,`SOURCE_SLOT`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+
+  sql=CreateTable(temporary)+QString("`SA_SOURCES` (")+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` char(15) not null,"+
+    "`SLOT` int not null,"+
+    "`ROUTER_NUMBER` int not null,"+
+    "`SOURCE_NUMBER` int not null,"
+    "`SOURCE_ID` int not null,"+
+    "`NAME` char(191),"+
+    "`STREAM_ADDRESS` char(15),"+
+    "index HOST_ADDRESS_IDX(`HOST_ADDRESS`,`SLOT`),"+
+    "index STREAM_ADDRESS_IDX(`ROUTER_NUMBER`,`STREAM_ADDRESS`),"+
+    "index ROUTER_NUMBER_IDX(`ROUTER_NUMBER`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+
+  sql=CreateTable(temporary)+QString("`SA_DESTINATIONS` (")+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` char(15) not null,"+
+    "`SLOT` int not null,"+
+    "`ROUTER_NUMBER` int not null,"+
+    "`SOURCE_NUMBER` int not null,"
+    "`DESTINATION_ID` int not null,"+
+    "`NAME` char(191),"+
+    "`STREAM_ADDRESS` char(15),"+
+    "index HOST_ADDRESS_IDX(`HOST_ADDRESS`,`SLOT`),"+
+    "index ROUTER_NUMBER_IDX(`ROUTER_NUMBER`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+
+  sql=CreateTable(temporary)+QString("`SA_GPIS` (")+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` char(15) not null,"+
+    "`SLOT` int not null,"+
+    "`ROUTER_NUMBER` int not null,"+
+    "`SOURCE_NUMBER` int not null,"
+    "`GPI_ID` int not null,"+
+    "`NAME` char(191),"+
+    "index HOST_ADDRESS_IDX(`HOST_ADDRESS`,`SLOT`),"+
+    "index ROUTER_IDX(`ROUTER_NUMBER`))"+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+
+  sql=CreateTable(temporary)+QString("`SA_GPOS` (")+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` char(15) not null,"+
+    "`SLOT` int not null,"+
+    "`ROUTER_NUMBER` int not null,"+
+    "`SOURCE_NUMBER` int not null,"
+    "`GPO_ID` int not null,"+
+    "`NAME` char(191),"+
+    "`SOURCE_ADDRESS` char(22),"+
+    "`SOURCE_SLOT` int default -1,"+
+    "index HOST_ADDRESS_IDX(`HOST_ADDRESS`,`SLOT`),"+
+    "index ROUTER_IDX(`ROUTER_NUMBER`),"+
+    "index ROUTER_SOURCE_IDX(`ROUTER_NUMBER`,`SOURCE_NUMBER`))"+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+}
+
+
+void NodeTables::CreateCompactTables(bool temporary) const
+{
+  QString sql;
+
+  //
+  // Addresses are stored as unsigned integers and names as IDs into
+  // NAMES, under the same column names as in the default tables. NAMES
+  // lives on disk, as the MEMORY engine would pad every name out to its
+  // full width again.
+  //
+  sql=CreateTable(temporary)+QString("`NAMES` (")+
+    "`ID` int not null primary key,"+
+    "`NAME` varchar(191)) "+
+    "engine InnoDB character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+
+  sql=CreateTable(temporary)+"`"+
+    DROUTER_COMPACT_TABLE_PREFIX+"NODES` ("+
+    "`HOST_ADDRESS` int unsigned not null,"+
+    "`HOST_NAME` int,"+
+    "`DEVICE_NAME` char(20),"+
+    "`MATRIX_TYPE` int,"+
+    "`SOURCE_SLOTS` int,"+
+    "`DESTINATION_SLOTS` int,"+
+    "`GPI_SLOTS` int,"+
+    "`GPO_SLOTS` int,"+
+    "primary key using hash(`HOST_ADDRESS`),"+
+    "index NODES_MATRIX_TYPE_IDX using hash(`MATRIX_TYPE`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+  CreateCompactView("NODES",QStringList()<<"HOST_ADDRESS"<<"HOST_NAME"<<
+		    "DEVICE_NAME"<<"MATRIX_TYPE"<<"SOURCE_SLOTS"<<
+		    "DESTINATION_SLOTS"<<"GPI_SLOTS"<<"GPO_SLOTS",temporary);
+
+  sql=CreateTable(temporary)+"`"+
+    DROUTER_COMPACT_TABLE_PREFIX+"SOURCES` ("+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` int unsigned not null,"+
+    "`SLOT` int not null,"+
+    "`HOST_NAME` int,"+
+    "`STREAM_ADDRESS` int unsigned,"+
+    "`NAME` int,"+
+    "`STREAM_ENABLED` int,"+
+    "`CHANNELS` int,"+
+    "`BLOCK_SIZE` int,"+
+    "`LEFT_CLIP` int default 0,"+
+    "`RIGHT_CLIP` int default 0,"+
+    "`LEFT_SILENCE` int default 0,"+
+    "`RIGHT_SILENCE` int default 0,"+
+    "unique index SLOT_IDX using hash(`HOST_ADDRESS`,`SLOT`),"+
+    "index STREAM_ADDRESS_IDX using hash(`STREAM_ADDRESS`,`STREAM_ENABLED`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+  CreateCompactView("SOURCES",QStringList()<<"ID"<<"HOST_ADDRESS"<<"SLOT"<<
+		    "HOST_NAME"<<"STREAM_ADDRESS"<<"NAME"<<"STREAM_ENABLED"<<
+		    "CHANNELS"<<"BLOCK_SIZE"<<"LEFT_CLIP"<<"RIGHT_CLIP"<<
+		    "LEFT_SILENCE"<<"RIGHT_SILENCE",temporary);
+
+  sql=CreateTable(temporary)+"`"+
+    DROUTER_COMPACT_TABLE_PREFIX+"DESTINATIONS` ("+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` int unsigned not null,"+
+    "`SLOT` int not null,"+
+    "`HOST_NAME` int,"+
+    "`STREAM_ADDRESS` int unsigned,"+
+    "`NAME` int,"+
+    "`CHANNELS` int,"+
+    "`LEFT_CLIP` int default 0,"+
+    "`RIGHT_CLIP` int default 0,"+
+    "`LEFT_SILENCE` int default 0,"+
+    "`RIGHT_SILENCE` int default 0,"+
+    "unique index SLOT_IDX using hash(`HOST_ADDRESS`,`SLOT`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+  CreateCompactView("DESTINATIONS",QStringList()<<"ID"<<"HOST_ADDRESS"<<
+		    "SLOT"<<"HOST_NAME"<<"STREAM_ADDRESS"<<"NAME"<<"CHANNELS"<<
+		    "LEFT_CLIP"<<"RIGHT_CLIP"<<"LEFT_SILENCE"<<"RIGHT_SILENCE",
+		    temporary);
+
+  sql=CreateTable(temporary)+"`"+
+    DROUTER_COMPACT_TABLE_PREFIX+"GPIS` ("+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` int unsigned not null,"+
+    "`SLOT` int not null,"+
+    "`HOST_NAME` int,"+
+    "`CODE` char(5),"+
+    "unique index SLOT_IDX using hash(`HOST_ADDRESS`,`SLOT`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+  CreateCompactView("GPIS",QStringList()<<"ID"<<"HOST_ADDRESS"<<"SLOT"<<
+		    "HOST_NAME"<<"CODE",temporary);
+
+  sql=CreateTable(temporary)+"`"+
+    DROUTER_COMPACT_TABLE_PREFIX+"GPOS` ("+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` int unsigned not null,"+
+    "`SLOT` int not null,"+
+    "`HOST_NAME` int,"+
+    "`CODE` char(5),"+
+    "`NAME` int,"+
+    "`SOURCE_ADDRESS` int unsigned,"+
+    "`SOURCE_SLOT` int default -1,"+
+    "unique index SLOT_IDX using hash(`HOST_ADDRESS`,`SLOT`),"+
+    "index SOURCE_ADDRESS_IDX using hash(`SOURCE_ADDRESS`,`SOURCE_SLOT`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+  CreateCompactView("GPOS",QStringList()<<"ID"<<"HOST_ADDRESS"<<"SLOT"<<
+		    "HOST_NAME"<<"CODE"<<"NAME"<<"SOURCE_ADDRESS"<<
+		    "SOURCE_SLOT",temporary);
+
+  sql=CreateTable(temporary)+"`"+
+    DROUTER_COMPACT_TABLE_PREFIX+"SA_SOURCES` ("+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` int unsigned not null,"+
+    "`SLOT` int not null,"+
+    "`ROUTER_NUMBER` int not null,"+
+    "`SOURCE_NUMBER` int not null,"+
+    "`SOURCE_ID` int not null,"+
+    "`NAME` int,"+
+    "`STREAM_ADDRESS` int unsigned,"+
+    "index HOST_ADDRESS_IDX using hash(`HOST_ADDRESS`,`SLOT`),"+
+    "index STREAM_ADDRESS_IDX using hash(`ROUTER_NUMBER`,`STREAM_ADDRESS`),"+
+    "index ROUTER_NUMBER_IDX using hash(`ROUTER_NUMBER`),"+
+    "index SOURCE_ID_IDX using hash(`SOURCE_ID`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+  CreateCompactView("SA_SOURCES",QStringList()<<"ID"<<"HOST_ADDRESS"<<
+		    "SLOT"<<"ROUTER_NUMBER"<<"SOURCE_NUMBER"<<"SOURCE_ID"<<
+		    "NAME"<<"STREAM_ADDRESS",temporary);
+
+  sql=CreateTable(temporary)+"`"+
+    DROUTER_COMPACT_TABLE_PREFIX+"SA_DESTINATIONS` ("+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` int unsigned not null,"+
+    "`SLOT` int not null,"+
+    "`ROUTER_NUMBER` int not null,"+
+    "`SOURCE_NUMBER` int not null,"+
+    "`DESTINATION_ID` int not null,"+
+    "`NAME` int,"+
+    "`STREAM_ADDRESS` int unsigned,"+
+    "index HOST_ADDRESS_IDX using hash(`HOST_ADDRESS`,`SLOT`),"+
+    "index ROUTER_NUMBER_IDX using hash(`ROUTER_NUMBER`),"+
+    "index DESTINATION_ID_IDX using hash(`DESTINATION_ID`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+  CreateCompactView("SA_DESTINATIONS",QStringList()<<"ID"<<"HOST_ADDRESS"<<
+		    "SLOT"<<"ROUTER_NUMBER"<<"SOURCE_NUMBER"<<"DESTINATION_ID"<<
+		    "NAME"<<"STREAM_ADDRESS",temporary);
+
+  sql=CreateTable(temporary)+"`"+
+    DROUTER_COMPACT_TABLE_PREFIX+"SA_GPIS` ("+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` int unsigned not null,"+
+    "`SLOT` int not null,"+
+    "`ROUTER_NUMBER` int not null,"+
+    "`SOURCE_NUMBER` int not null,"+
+    "`GPI_ID` int not null,"+
+    "`NAME` int,"+
+    "index HOST_ADDRESS_IDX using hash(`HOST_ADDRESS`,`SLOT`),"+
+    "index ROUTER_IDX using hash(`ROUTER_NUMBER`),"+
+    "index GPI_ID_IDX using hash(`GPI_ID`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+  CreateCompactView("SA_GPIS",QStringList()<<"ID"<<"HOST_ADDRESS"<<"SLOT"<<
+		    "ROUTER_NUMBER"<<"SOURCE_NUMBER"<<"GPI_ID"<<"NAME",
+		    temporary);
+
+  sql=CreateTable(temporary)+"`"+
+    DROUTER_COMPACT_TABLE_PREFIX+"SA_GPOS` ("+
+    "`ID` int auto_increment not null primary key,"+
+    "`HOST_ADDRESS` int unsigned not null,"+
+    "`SLOT` int not null,"+
+    "`ROUTER_NUMBER` int not null,"+
+    "`SOURCE_NUMBER` int not null,"+
+    "`GPO_ID` int not null,"+
+    "`NAME` int,"+
+    "`SOURCE_ADDRESS` int unsigned,"+
+    "`SOURCE_SLOT` int default -1,"+
+    "index HOST_ADDRESS_IDX using hash(`HOST_ADDRESS`,`SLOT`),"+
+    "index ROUTER_IDX using hash(`ROUTER_NUMBER`),"+
+    "index ROUTER_SOURCE_IDX using hash(`ROUTER_NUMBER`,`SOURCE_NUMBER`),"+
+    "index GPO_ID_IDX using hash(`GPO_ID`)) "+
+    "engine MEMORY character set utf8 collate utf8_general_ci";
+  SqlQuery::apply(sql);
+  CreateCompactView("SA_GPOS",QStringList()<<"ID"<<"HOST_ADDRESS"<<"SLOT"<<
+		    "ROUTER_NUMBER"<<"SOURCE_NUMBER"<<"GPO_ID"<<"NAME"<<
+		    "SOURCE_ADDRESS"<<"SOURCE_SLOT",temporary);
+}
+
+
+void NodeTables::CreateCompactView(const QString &table,
+				   const QStringList &fields,
+				   bool temporary) const
+{
+  //
+  // Presents a compact table under its usual name, with addresses in
+  // dotted-quad notation and names looked up from NAMES
+  //
+  QString sql;
+  QStringList cols;
+  QString joins;
+  QString field;
+
+  //
+  // A view can not refer to a TEMPORARY table
+  //
+  if(temporary) {
+    return;
+  }
+  for(int i=0;i<fields.size();i++) {
+    field=fields.at(i);
+    if((field=="HOST_ADDRESS")||(field=="STREAM_ADDRESS")||
+       (field=="SOURCE_ADDRESS")) {
+      cols.push_back("ifnull(inet_ntoa(`T`.`"+field+"`),'') as `"+field+"`");
+    }
+    else {
+      if((field=="HOST_NAME")||(field=="NAME")) {
+	QString alias=QString::asprintf("N%d",i);
+	cols.push_back("`"+alias+"`.`NAME` as `"+field+"`");
+	joins+="left join `NAMES` as `"+alias+"` "+
+	  "on `"+alias+"`.`ID`=`T`.`"+field+"` ";
+      }
+      else {
+	cols.push_back("`T`.`"+field+"`");
+      }
+    }
+  }
+  sql=QString("create view `")+table+"` as select "+cols.join(",")+" "+
+    "from `"+DROUTER_COMPACT_TABLE_PREFIX+table+"` as `T` "+joins;
+  SqlQuery::apply(sql);
+}
+
+
+QList<int> NodeTables::InsertRows(const QString &table,
+				  const QString &fields,
+				  const QStringList &rows,bool numbered)
+{
+  QString sql;
+  QList<int> ids;
+  QStringList chunk;
+
+  //
+  // Rows are numbered here rather than by AUTO_INCREMENT, as a queued
+  // insert has no LAST_INSERT_ID() to read back. The tables are
+  // recreated at startup, so the IDs start over with them.
+  //
+  for(int i=0;i<rows.size();i+=DROUTER_MAX_INSERT_ROWS) {
+    chunk=rows.mid(i,DROUTER_MAX_INSERT_ROWS);
+    if(numbered) {
+      int &next_id=tables_next_ids[table];
+      if(next_id==0) {
+	next_id=1;
+      }
+      for(int j=0;j<chunk.size();j++) {
+	ids.push_back(next_id);
+	chunk[j]=QString::asprintf("(%d,",next_id++)+chunk.at(j).mid(1);
+      }
+      sql=QString("insert into `")+table+"` (`ID`,"+fields+") values "+
+	chunk.join(",");
+    }
+    else {
+      sql=QString("insert into `")+table+"` ("+fields+") values "+
+	chunk.join(",");
+    }
+    Apply(sql);
+  }
+
+  return ids;
+}
+
+
+void NodeTables::Apply(const QString &sql) const
+{
+  if(tables_writer!=NULL) {
+    tables_writer->enqueueBarrier(sql);
+  }
+  else {
+    SqlQuery::apply(sql);
+  }
+}
+
+
+QHostAddress NodeTables::gpoSourceAddress(const StateStore::Gpo *gpo)
+{
+  if(gpo->source_address==0) {
+    return QHostAddress();
+  }
+  return QHostAddress(gpo->source_address);
+}
+
+
+QString NodeTables::tableName(const QString &table) const
+{
+  //
+  // In compact mode the usual table names are read-only views
+  //
+  if(tables_compact) {
+    return DROUTER_COMPACT_TABLE_PREFIX+table;
+  }
+  return table;
+}
+
+
+QVariant NodeTables::addressValue(const QHostAddress &addr) const
+{
+  if(tables_compact) {
+    if(addr.isNull()) {
+      return QVariant(QVariant::UInt);
+    }
+    return addr.toIPv4Address();
+  }
+  return addr.toString();
+}
+
+
+QString NodeTables::addressLiteral(const QHostAddress &addr) const
+{
+  if(tables_compact) {
+    if(addr.isNull()) {
+      return QString("NULL");
+    }
+    return QString::asprintf("%u",addr.toIPv4Address());
+  }
+  return "'"+addr.toString()+"'";
+}
+
+
+QVariant NodeTables::nameValue(const QString &name)
+{
+  int id=0;
+  bool added=false;
+
+  if(!tables_compact) {
+    return name;
+  }
+  id=NameId(name,&added);
+  if(added) {
+    //
+    // Queued ahead of the update that refers to it
+    //
+    tables_writer->enqueue(QString::asprintf("NAMES:%d",id),
+			   "insert into `NAMES` set `ID`=?,`NAME`=? "
+			   "on duplicate key update `NAME`=?",
+			   QVariantList()<<id<<name<<name);
+  }
+  return id;
+}
+
+
+int NodeTables::purgeNames()
+{
+  QSet<QString> names;
+  QList<unsigned> ids;
+  int ret=0;
+
+  if(!tables_compact) {
+    return 0;
+  }
+
+  //
+  // Every name that a row written from here can refer to
+  //
+  ids=tables_state->nodeIds();
+  for(int i=0;i<ids.size();i++) {
+    const StateStore::Node *n=tables_state->node(ids.at(i));
+    names.insert(n->host_name);
+    for(int j=0;j<n->sources.size();j++) {
+      names.insert(n->sources.at(j).name);
+    }
+    for(int j=0;j<n->destinations.size();j++) {
+      names.insert(n->destinations.at(j).name);
+    }
+    for(int j=0;j<n->gpos.size();j++) {
+      names.insert(n->gpos.at(j).name);
+      names.insert(QString::asprintf("GPO %d",j+1));
+    }
+  }
+  for(QMap<int,EndPointMap *>::const_iterator it=tables_maps->begin();
+      it!=tables_maps->end();it++) {
+    for(int i=0;i<it.value()->quantity(EndPointMap::Input);i++) {
+      names.insert(it.value()->name(EndPointMap::Input,i));
+    }
+    for(int i=0;i<it.value()->quantity(EndPointMap::Output);i++) {
+      names.insert(it.value()->name(EndPointMap::Output,i));
+    }
+  }
+
+  //
+  // Anything else is no longer referred to. Its ID is not handed out
+  // again, so a queued row that still refers to it reads as NULL rather
+  // than as some other name.
+  //
+  QHash<QString,int>::iterator it=tables_name_ids.begin();
+  while(it!=tables_name_ids.end()) {
+    if(names.contains(it.key())) {
+      it++;
+      continue;
+    }
+    tables_writer->enqueue(QString::asprintf("NAMES:%d",it.value()),
+			   "delete from `NAMES` where `ID`=?",
+			   QVariantList()<<it.value());
+    it=tables_name_ids.erase(it);
+    ret++;
+  }
+
+  return ret;
+}
+
+
+QString NodeTables::NameLiteral(const QString &name,QStringList *name_rows)
+{
+  int id=0;
+  bool added=false;
+
+  if(!tables_compact) {
+    return "'"+SqlQuery::escape(name)+"'";
+  }
+  id=NameId(name,&added);
+  if(added) {
+    name_rows->push_back(QString::asprintf("(%d,",id)+
+			 "'"+SqlQuery::escape(name)+"')");
+  }
+  return QString::asprintf("%d",id);
+}
+
+
+int NodeTables::NameId(const QString &name,bool *added)
+{
+  //
+  // IDs are handed out here rather than by the DB, so that a new name
+  // can be referred to before its NAMES row has been written
+  //
+  QHash<QString,int>::const_iterator it=tables_name_ids.find(name);
+
+  if(it!=tables_name_ids.end()) {
+    *added=false;
+    return it.value();
+  }
+  int id=tables_next_name_id++;
+  tables_name_ids[name]=id;
+  *added=true;
+
+  return id;
+}
@@ -0,0 +1,94 @@
+// nodetables.h
+//
+// Ephemeral node tables in the Drouter database
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef NODETABLES_H
+#define NODETABLES_H
+
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+#include "dbwriter.h"
+#include "endpointmap.h"
+#include "statestore.h"
+
+#define DROUTER_MAX_INSERT_ROWS 500
+#define DROUTER_COMPACT_TABLE_PREFIX "COMPACT_"
+
+//
+// Creates the NODES, SOURCES, DESTINATIONS, GPIS and GPOS tables (and
+// their SA_* counterparts) and writes whole nodes into them from a
+// StateStore, in either the default or the compact schema.
+//
+// Node rows are queued on the DbWriter as barriers, so that they land
+// in order with the mirror updates around them without the caller
+// waiting on the database; row IDs are handed out here for the same
+// reason. Without a DbWriter they are written synchronously on the
+// default connection. Names handed out by nameValue() in compact mode
+// are written through the DbWriter as keyed upserts, and so are never
+// discarded. Name IDs are never reused; purgeNames() removes the NAMES
+// rows that nothing in the StateStore or the EndPointMaps refers to any
+// more.
+//
+class NodeTables
+{
+ public:
+  NodeTables(StateStore *state,QMap<int,EndPointMap *> *maps,
+	     DbWriter *writer,bool compact);
+  bool compactSchema() const;
+  void createTables(bool temporary=false) const;
+  void lockTables() const;
+  void unlockTables() const;
+  void insertNodeRows(const QList<unsigned> &ids);
+  void deleteNodeRows(const QList<unsigned> &ids) const;
+  QString tableName(const QString &table) const;
+  QVariant addressValue(const QHostAddress &addr) const;
+  QString addressLiteral(const QHostAddress &addr) const;
+  QVariant nameValue(const QString &name);
+  int purgeNames();
+  static QHostAddress gpoSourceAddress(const StateStore::Gpo *gpo);
+
+ private:
+  QString CreateTable(bool temporary) const;
+  void CreateEphemeralTables(bool temporary) const;
+  void CreateCompactTables(bool temporary) const;
+  void CreateCompactView(const QString &table,const QStringList &fields,
+			 bool temporary) const;
+  QList<int> InsertRows(const QString &table,const QString &fields,
+			const QStringList &rows,bool numbered=true);
+  void Apply(const QString &sql) const;
+  QString NameLiteral(const QString &name,QStringList *name_rows);
+  int NameId(const QString &name,bool *added);
+  StateStore *tables_state;
+  QMap<int,EndPointMap *> *tables_maps;
+  DbWriter *tables_writer;
+  bool tables_compact;
+  QHash<QString,int> tables_name_ids;
+  int tables_next_name_id;
+  QHash<QString,int> tables_next_ids;
+};
+
+
+#endif  // NODETABLES_H
@@ -37,6 +37,7 @@
 
 #include "protocol.h"
 #include "protoipc.h"
+#include "sqlquery.h"
 
 bool global_shutting_down=false;
 
@@ -55,10 +56,22 @@ void SigHandler(int signo)
 }
 
 
+Protocol::Crosspoint::Crosspoint()
+{
+  dst_slot=-1;
+  src_slot=-1;
+}
+
+
 Protocol::Protocol(QObject *parent)
   : QObject(parent)
 {
   proto_ipc_socket=NULL;
+  proto_snapshot=NULL;
+  proto_journal=NULL;
+  proto_ipc_sequence=0;
+  proto_replaying=false;
+  proto_db_open=false;
   proto_shutdown_timer=new QTimer(this);
   connect(proto_shutdown_timer,SIGNAL(timeout()),
 	  this,SLOT(shutdownTimerData()));
@@ -94,16 +107,45 @@ bool Protocol::startIpc(QString *err_msg)
   proto_ipc_socket->setSocketDescriptor(sock,QAbstractSocket::ConnectedState);
   connect(proto_ipc_socket,SIGNAL(readyRead()),this,SLOT(ipcReadyReadData()));
 
+  //
+  // Attach to the State Snapshot
+  //
+  QString snap_err;
+  proto_snapshot=new StateSnapshot();
+  if(!proto_snapshot->attach(&snap_err)) {
+    syslog(LOG_DEBUG,"state snapshot unavailable [%s], using the database",
+	   snap_err.toUtf8().constData());
+    delete proto_snapshot;
+    proto_snapshot=NULL;
+  }
+
+  //
+  // Attach to the Change Journal
+  //
+  QString journal_err;
+  proto_journal=new ChangeJournal();
+  if(!proto_journal->attach(&journal_err)) {
+    syslog(LOG_DEBUG,"change journal unavailable [%s], resuming disabled",
+	   journal_err.toUtf8().constData());
+    delete proto_journal;
+    proto_journal=NULL;
+  }
+
+  //
+  // Wait for the core to say where our change notifications start
+  //
+  while((proto_ipc_sequence==0)&&
+	proto_ipc_socket->waitForReadyRead(PROTOCOL_SEQUENCE_TIMEOUT)) {
+  }
+  if(proto_ipc_sequence==0) {
+    syslog(LOG_WARNING,
+	   "no sequence number from drouter service, resuming disabled");
+  }
+
   //
   // Connect to the Database
   //
-  QSqlDatabase db=QSqlDatabase::addDatabase("QMYSQL3");
-  db.setHostName("localhost");
-  db.setDatabaseName("drouter");
-  db.setUserName("drouter");
-  db.setPassword("drouter");
-  if(!db.open()) {
-    *err_msg="database error ["+db.lastError().driverText()+"]";
+  if(databaseRequired()&&(!startDb(err_msg))) {
     return false;
   }
 
@@ -142,6 +184,29 @@ void Protocol::setCrosspoint(const QHostAddress &dst_node_addr,int dst_slotnum,
 }
 
 
+void Protocol::setCrosspoints(const QList<Crosspoint> &xpoints)
+{
+  QString cmd="SetCrosspoints";
+
+  if(xpoints.size()==0) {
+    return;
+  }
+  for(int i=0;i<xpoints.size();i++) {
+    const Crosspoint &xpt=xpoints.at(i);
+    cmd+=" "+xpt.dst_host_address.toString()+
+      QString::asprintf(" %d ",xpt.dst_slot);
+    if(xpt.src_slot<0) {
+      cmd+="0.0.0.0 -1";
+    }
+    else {
+      cmd+=xpt.src_host_address.toString()+
+	QString::asprintf(" %d",xpt.src_slot);
+    }
+  }
+  proto_ipc_socket->write((cmd+"\r\n").toUtf8());
+}
+
+
 void Protocol::setGpioCrosspoint(const QHostAddress &gpo_node_addr,
 				 int gpo_slotnum,
 				 const QHostAddress &gpi_node_addr,
@@ -172,28 +237,27 @@ void Protocol::setGpoState(const QHostAddress &gpo_node_addr,int gpo_slotnum,
 }
 
 
-void Protocol::ipcReadyReadData()
+void Protocol::confirmRoute(int event_id,int router,int output,int input)
 {
-  char data[1501];
-  int n;
+  //
+  // Must be sent ahead of the crosspoint change it is to confirm
+  //
+  proto_ipc_socket->write(QString::asprintf("ConfirmRoute %d %d %d %d\r\n",
+					    event_id,router,output,input).
+			  toUtf8());
+}
 
-  while((n=proto_ipc_socket->read(data,1500))>0) {
-    for(int i=0;i<n;i++) {
-      switch(0xFF&data[i]) {
-      case 10:
-	break;
 
-      case 13:
-	ProcessIpcCommand(proto_ipc_accum);
-	proto_ipc_accum="";
-	break;
+void Protocol::ipcReadyReadData()
+{
+  ProtoIpcMessage msg;
 
-      default:
-	proto_ipc_accum+=0xFF&data[i];
-	break;
-      }
-    }
-  }  
+  proto_ipc_accum+=proto_ipc_socket->readAll();
+  while(msg.takeFrame(&proto_ipc_accum)) {
+    ProcessIpcMessage(&msg);
+    proto_ipc_sequence=msg.sequence();
+    sequenceUpdated(proto_ipc_sequence);
+  }
 }
 
 
@@ -210,72 +274,87 @@ void Protocol::tetherStateUpdated(bool state)
 }
 
 
-void Protocol::nodeAdded(const QHostAddress &host_addr)
+void Protocol::nodeAdded(const ProtoIpcMessage::Node &node,
+			 const QList<ProtoIpcMessage::Source> &srcs,
+			 const QList<ProtoIpcMessage::Destination> &dsts,
+			 const QList<ProtoIpcMessage::Gpi> &gpis,
+			 const QList<ProtoIpcMessage::Gpo> &gpos)
+{
+}
+
+
+void Protocol::nodeRemoved(const ProtoIpcMessage::Node &node)
 {
 }
 
 
-void Protocol::nodeRemoved(const QHostAddress &host_addr,
-			   int srcs,int dsts,int gpis,int gpos)
+void Protocol::nodeChanged(const ProtoIpcMessage::Node &node)
 {
 }
 
 
-void Protocol::nodeChanged(const QHostAddress &host_addr)
+void Protocol::sourceChanged(const ProtoIpcMessage::Source &src)
 {
 }
 
 
-void Protocol::sourceChanged(const QHostAddress &host_addr,int slotnum)
+void Protocol::destinationChanged(const ProtoIpcMessage::Destination &dst)
 {
 }
 
 
-void Protocol::destinationChanged(const QHostAddress &host_addr,int slotnum)
+void Protocol::
+destinationCrosspointChanged(const ProtoIpcMessage::Destination &dst,
+			     const QHostAddress &old_stream_addr,
+			     const QHostAddress &src_host_addr,int src_slotnum)
 {
 }
 
 
-void Protocol::destinationCrosspointChanged(const QHostAddress &host_addr,int slotnum)
+void Protocol::gpiChanged(const ProtoIpcMessage::Gpi &gpi)
 {
 }
 
 
-void Protocol::gpiChanged(const QHostAddress &host_addr,int slotnum)
+void Protocol::gpiCodeChanged(const ProtoIpcMessage::Gpi &gpi)
 {
 }
 
 
-void Protocol::gpiCodeChanged(const QHostAddress &host_addr,int slotnum)
+void Protocol::gpoChanged(const ProtoIpcMessage::Gpo &gpo)
 {
 }
 
 
-void Protocol::gpoChanged(const QHostAddress &host_addr,int slotnum)
+void Protocol::gpoCrosspointChanged(const ProtoIpcMessage::Gpo &gpo,
+				    const QHostAddress &old_src_addr,
+				    int old_src_slotnum)
 {
 }
 
 
-void Protocol::gpoCrosspointChanged(const QHostAddress &host_addr,int slotnum)
+void Protocol::gpoCodeChanged(const ProtoIpcMessage::Gpo &gpo)
 {
 }
 
 
-void Protocol::gpoCodeChanged(const QHostAddress &host_addr,int slotnum)
+void Protocol::clipChanged(const ProtoIpcMessage::Alarm &alarm)
 {
 }
 
 
-void Protocol::clipChanged(const QHostAddress &host_addr,int slotnum,
-			   SyLwrpClient::MeterType meter_type,
-			   const QString &tbl_name,int chan)
+void Protocol::silenceChanged(const ProtoIpcMessage::Alarm &alarm)
 {
 }
 
 
-void Protocol::silenceChanged(const QHostAddress &host_addr,int slotnum,
-			      SyLwrpClient::MeterType meter_type,
-			      const QString &tbl_name,int chan)
+void Protocol::routeConfirmed(int event_id,int router,int output,int input,
+			      bool status,int msecs)
+{
+}
+
+
+void Protocol::sequenceUpdated(quint64 seq)
 {
 }
 
@@ -286,6 +365,84 @@ Config *Protocol::config()
 }
 
 
+StateSnapshot *Protocol::snapshot() const
+{
+  if((proto_snapshot==NULL)||(!proto_snapshot->isValid())) {
+    return NULL;
+  }
+  return proto_snapshot;
+}
+
+
+quint64 Protocol::ipcSequence() const
+{
+  return proto_ipc_sequence;
+}
+
+
+bool Protocol::replayChanges(quint64 since)
+{
+  //
+  // Run the changes after 'since' that this process has already seen
+  // back through the change handlers. Returns false if the journal no
+  // longer holds them all.
+  //
+  QList<ProtoIpcMessage> msgs;
+
+  if((proto_journal==NULL)||(proto_ipc_sequence==0)||
+     (!proto_journal->changes(since,proto_ipc_sequence,&msgs))) {
+    return false;
+  }
+  proto_replaying=true;
+  for(int i=0;i<msgs.size();i++) {
+    ProcessIpcMessage(&msgs[i]);
+  }
+  proto_replaying=false;
+
+  return true;
+}
+
+
+bool Protocol::isReplaying() const
+{
+  return proto_replaying;
+}
+
+
+bool Protocol::databaseRequired() const
+{
+  return true;
+}
+
+
+bool Protocol::startDb(QString *err_msg)
+{
+  if(proto_db_open) {
+    return true;
+  }
+  QSqlDatabase db=QSqlDatabase::addDatabase("QMYSQL3");
+  db.setHostName("localhost");
+  db.setDatabaseName("drouter");
+  db.setUserName("drouter");
+  db.setPassword("drouter");
+  if(!db.open()) {
+    QString msg="database error ["+db.lastError().driverText()+"]";
+    if(err_msg!=NULL) {
+      *err_msg=msg;
+    }
+    else {
+      syslog(LOG_WARNING,"%s",msg.toUtf8().constData());
+    }
+    QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
+    return false;
+  }
+  SqlQuery::clearStatementCache();
+  proto_db_open=true;
+
+  return true;
+}
+
+
 void Protocol::logIpc(const QString &msg)
 {
   if(proto_config->ipcLogPriority()>=0) {
@@ -307,81 +464,195 @@ void Protocol::quit()
 }
 
 
-void Protocol::ProcessIpcCommand(const QString &cmd)
+void Protocol::ProcessIpcMessage(ProtoIpcMessage *msg)
 {
-  logIpc("received core->proto IPC cmd: \""+cmd+"\"");
-
-  QStringList cmds=cmd.split(":");
-
-  if((cmds.at(0)=="TETHER")&&(cmds.size()==2)){
-    tetherStateUpdated(cmds.at(1)=="Y");
-  }
+  bool ok=false;
+  bool state;
+  int32_t slot;
+  int32_t old_slot;
+  QHostAddress addr;
+  QHostAddress addr2;
+  ProtoIpcMessage::Node node;
+  ProtoIpcMessage::Source src;
+  ProtoIpcMessage::Destination dst;
+  ProtoIpcMessage::Gpi gpi;
+  ProtoIpcMessage::Gpo gpo;
+  ProtoIpcMessage::Alarm alarm;
+  int32_t event_id;
+  int32_t router;
+  int32_t output;
+  int32_t input;
+  int32_t msecs;
+  QList<ProtoIpcMessage::Source> srcs;
+  QList<ProtoIpcMessage::Destination> dsts;
+  QList<ProtoIpcMessage::Gpi> gpis;
+  QList<ProtoIpcMessage::Gpo> gpos;
+
+  switch(msg->type()) {
+  case ProtoIpcMessage::TypeTether:
+    if((ok=msg->readBool(&state))) {
+      logIpc("received core->proto IPC msg: \"TETHER:"+
+	     QString(state ? "Y" : "N")+"\"");
+      tetherStateUpdated(state);
+    }
+    break;
 
-  if((cmds.at(0)=="NODEADD")&&(cmds.size()==2)){
-    nodeAdded(QHostAddress(cmds.at(1)));
-  }
+  case ProtoIpcMessage::TypeNodeAdd:
+    if((ok=msg->readNode(&node))) {
+      for(int i=0;ok&&(i<node.sources);i++) {
+	if((ok=msg->readSource(&src))) {
+	  srcs.push_back(src);
+	}
+      }
+      for(int i=0;ok&&(i<node.destinations);i++) {
+	if((ok=msg->readDestination(&dst))) {
+	  dsts.push_back(dst);
+	}
+      }
+      for(int i=0;ok&&(i<node.gpis);i++) {
+	if((ok=msg->readGpi(&gpi))) {
+	  gpis.push_back(gpi);
+	}
+      }
+      for(int i=0;ok&&(i<node.gpos);i++) {
+	if((ok=msg->readGpo(&gpo))) {
+	  gpos.push_back(gpo);
+	}
+      }
+    }
+    if(ok) {
+      logIpc("received core->proto IPC msg: \"NODEADD:"+
+	     node.host_address.toString()+"\"");
+      nodeAdded(node,srcs,dsts,gpis,gpos);
+    }
+    break;
 
-  if((cmds.at(0)=="NODEADD")&&(cmds.size()==2)){
-    nodeAdded(QHostAddress(cmds.at(1)));
-  }
+  case ProtoIpcMessage::TypeNodeDel:
+    if((ok=msg->readNode(&node))) {
+      logIpc("received core->proto IPC msg: \"NODEDEL:"+
+	     node.host_address.toString()+
+	     QString::asprintf(":%d:%d:%d:%d\"",node.sources,
+			       node.destinations,node.gpis,node.gpos));
+      nodeRemoved(node);
+    }
+    break;
 
-  if((cmds.at(0)=="NODEDEL")&&(cmds.size()==6)) {
-    nodeRemoved(QHostAddress(cmds.at(1)),cmds.at(2).toInt(),cmds.at(3).toInt(),
-		cmds.at(4).toInt(),cmds.at(5).toInt());
-  }
+  case ProtoIpcMessage::TypeNode:
+    if((ok=msg->readNode(&node))) {
+      logIpc("received core->proto IPC msg: \"NODE:"+
+	     node.host_address.toString()+"\"");
+      nodeChanged(node);
+    }
+    break;
 
-  if((cmds.at(0)=="NODE")&&(cmds.size()==2)) {
-    nodeChanged(QHostAddress(cmds.at(1)));
-  }
+  case ProtoIpcMessage::TypeSource:
+    if((ok=msg->readSource(&src))) {
+      logIpc("received core->proto IPC msg: \"SRC:"+
+	     src.host_address.toString()+QString::asprintf(":%d\"",src.slot));
+      sourceChanged(src);
+    }
+    break;
 
-  if((cmds.at(0)=="SRC")&&(cmds.size()==3)) {
-    sourceChanged(QHostAddress(cmds.at(1)),cmds.at(2).toInt());
-  }
+  case ProtoIpcMessage::TypeDestination:
+    if((ok=msg->readDestination(&dst))) {
+      logIpc("received core->proto IPC msg: \"DST:"+
+	     dst.host_address.toString()+QString::asprintf(":%d\"",dst.slot));
+      destinationChanged(dst);
+    }
+    break;
 
-  if((cmds.at(0)=="DST")&&(cmds.size()==3)) {
-    destinationChanged(QHostAddress(cmds.at(1)),cmds.at(2).toInt());
-  }
+  case ProtoIpcMessage::TypeDestinationCrosspoint:
+    if((ok=msg->readDestination(&dst)&&msg->readAddress(&addr)&&
+	msg->readAddress(&addr2)&&msg->readInt(&slot))) {
+      logIpc("received core->proto IPC msg: \"DSTX:"+
+	     dst.host_address.toString()+QString::asprintf(":%d\"",dst.slot));
+      destinationCrosspointChanged(dst,addr,addr2,slot);
+    }
+    break;
 
-  if((cmds.at(0)=="DSTX")&&(cmds.size()==3)) {
-    destinationCrosspointChanged(QHostAddress(cmds.at(1)),cmds.at(2).toInt());
-  }
+  case ProtoIpcMessage::TypeGpi:
+    if((ok=msg->readGpi(&gpi))) {
+      logIpc("received core->proto IPC msg: \"GPI:"+
+	     gpi.host_address.toString()+QString::asprintf(":%d\"",gpi.slot));
+      gpiChanged(gpi);
+    }
+    break;
 
-  if((cmds.at(0)=="GPI")&&(cmds.size()==3)) {
-    gpiChanged(QHostAddress(cmds.at(1)),cmds.at(2).toInt());
-  }
+  case ProtoIpcMessage::TypeGpiCode:
+    if((ok=msg->readGpi(&gpi))) {
+      logIpc("received core->proto IPC msg: \"GPICODE:"+
+	     gpi.host_address.toString()+QString::asprintf(":%d\"",gpi.slot));
+      gpiCodeChanged(gpi);
+    }
+    break;
 
-  if((cmds.at(0)=="GPICODE")&&(cmds.size()==3)) {
-    gpiCodeChanged(QHostAddress(cmds.at(1)),cmds.at(2).toInt());
-  }
+  case ProtoIpcMessage::TypeGpo:
+    if((ok=msg->readGpo(&gpo))) {
+      logIpc("received core->proto IPC msg: \"GPO:"+
+	     gpo.host_address.toString()+QString::asprintf(":%d\"",gpo.slot));
+      gpoChanged(gpo);
+    }
+    break;
 
-  if((cmds.at(0)=="GPOX")&&(cmds.size()==3)) {
-    gpoCrosspointChanged(QHostAddress(cmds.at(1)),cmds.at(2).toInt());
-  }
+  case ProtoIpcMessage::TypeGpoCrosspoint:
+    if((ok=msg->readGpo(&gpo)&&msg->readAddress(&addr)&&
+	msg->readInt(&old_slot))) {
+      logIpc("received core->proto IPC msg: \"GPOX:"+
+	     gpo.host_address.toString()+QString::asprintf(":%d\"",gpo.slot));
+      gpoCrosspointChanged(gpo,addr,old_slot);
+    }
+    break;
 
-  if((cmds.at(0)=="GPOCODE")&&(cmds.size()==3)) {
-    gpoCodeChanged(QHostAddress(cmds.at(1)),cmds.at(2).toInt());
-  }
+  case ProtoIpcMessage::TypeGpoCode:
+    if((ok=msg->readGpo(&gpo))) {
+      logIpc("received core->proto IPC msg: \"GPOCODE:"+
+	     gpo.host_address.toString()+QString::asprintf(":%d\"",gpo.slot));
+      gpoCodeChanged(gpo);
+    }
+    break;
 
-  if((cmds.at(0)=="GPO")&&(cmds.size()==3)) {
-    gpoChanged(QHostAddress(cmds.at(1)),cmds.at(2).toInt());
-  }
+  case ProtoIpcMessage::TypeClip:
+    if((ok=msg->readAlarm(&alarm))) {
+      logIpc("received core->proto IPC msg: \"CLIP:"+
+	     QString::asprintf("%d:%d:",alarm.meter_type,alarm.chan)+
+	     alarm.host_address.toString()+
+	     QString::asprintf(":%d\"",alarm.slot));
+      clipChanged(alarm);
+    }
+    break;
 
-  if((cmds.at(0)=="CLIP")&&(cmds.size()==5)) {
-    SyLwrpClient::MeterType meter_type=(SyLwrpClient::MeterType)cmds[1].toInt();
-    QString table_name="DESTINATIONS";
-    if(meter_type==SyLwrpClient::InputMeter) {
-      table_name="SOURCES";
+  case ProtoIpcMessage::TypeSilence:
+    if((ok=msg->readAlarm(&alarm))) {
+      logIpc("received core->proto IPC msg: \"SILENCE:"+
+	     QString::asprintf("%d:%d:",alarm.meter_type,alarm.chan)+
+	     alarm.host_address.toString()+
+	     QString::asprintf(":%d\"",alarm.slot));
+      silenceChanged(alarm);
     }
-    clipChanged(QHostAddress(cmds.at(3)),cmds.at(4).toInt(),meter_type,table_name,cmds.at(2).toInt());
-  }
+    break;
 
-  if((cmds.at(0)=="SILENCE")&&(cmds.size()==5)) {
-    SyLwrpClient::MeterType meter_type=(SyLwrpClient::MeterType)cmds[1].toInt();
-    QString table_name="DESTINATIONS";
-    if(meter_type==SyLwrpClient::InputMeter) {
-      table_name="SOURCES";
+  case ProtoIpcMessage::TypeRouteConfirm:
+    if((ok=msg->readInt(&event_id)&&msg->readInt(&router)&&
+	msg->readInt(&output)&&msg->readInt(&input)&&
+	msg->readBool(&state)&&msg->readInt(&msecs))) {
+      logIpc("received core->proto IPC msg: \"ROUTECONFIRM:"+
+	     QString::asprintf("%d:%d:%d:%d:",event_id,router,output,input)+
+	     QString(state ? "Y" : "N")+QString::asprintf(":%d\"",msecs));
+      routeConfirmed(event_id,router,output,input,state,msecs);
     }
-    silenceChanged(QHostAddress(cmds.at(3)),cmds.at(4).toInt(),meter_type,table_name,cmds.at(2).toInt());
-  }
+    break;
 
+  case ProtoIpcMessage::TypeSequence:
+    logIpc("received core->proto IPC msg: \"SEQUENCE:"+
+	   QString::asprintf("%llu\"",msg->sequence()));
+    ok=true;
+    break;
+
+  case ProtoIpcMessage::TypeNone:
+    break;
+  }
+  if(!ok) {
+    syslog(LOG_WARNING,"received malformed core->proto IPC message, type %d",
+	   msg->type());
+  }
 }
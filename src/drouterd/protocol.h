@@ -28,24 +28,38 @@
 
 #include <sy5/sylwrp_client.h>
 
+#include "changejournal.h"
 #include "config.h"
+#include "protoipc.h"
+#include "statesnapshot.h"
+
+#define PROTOCOL_SEQUENCE_TIMEOUT 5000
 
 class Protocol : public QObject
 {
  Q_OBJECT;
  public:
+  struct Crosspoint {
+    Crosspoint();
+    QHostAddress dst_host_address;
+    int dst_slot;
+    QHostAddress src_host_address;
+    int src_slot;
+  };
   Protocol(QObject *parent=0);
   bool startIpc(QString *err_msg);
   void clearCrosspoint(const QHostAddress &node_addr,int slotnum);
   void clearGpioCrosspoint(const QHostAddress &node_addr,int slotnum);
   void setCrosspoint(const QHostAddress &dst_node_addr,int dst_slotnum,
 		     const QHostAddress &src_node_addr,int src_slotnum);
+  void setCrosspoints(const QList<Crosspoint> &xpoints);
   void setGpioCrosspoint(const QHostAddress &gpo_node_addr,int gpo_slotnum,
 			 const QHostAddress &gpi_node_addr,int gpi_slotnum);
   void setGpiState(const QHostAddress &gpi_node_addr,int gpi_slotnum,
 		   const QString &code);
   void setGpoState(const QHostAddress &gpo_node_addr,int gpo_slotnum,
 		   const QString &code);
+  void confirmRoute(int event_id,int router,int output,int input);
 
  private slots:
   void ipcReadyReadData();
@@ -53,35 +67,54 @@ class Protocol : public QObject
 
  protected:
   virtual void tetherStateUpdated(bool state);
-  virtual void nodeAdded(const QHostAddress &host_addr);
-  virtual void nodeRemoved(const QHostAddress &host_addr,
-			   int srcs,int dsts,int gpis,int gpos);
-  virtual void nodeChanged(const QHostAddress &host_addr);
-  virtual void sourceChanged(const QHostAddress &host_addr,int slotnum);
-  virtual void destinationChanged(const QHostAddress &host_addr,int slotnum);
-  virtual void destinationCrosspointChanged(const QHostAddress &host_addr,int slotnum);
-  virtual void gpiChanged(const QHostAddress &host_addr,int slotnum);
-  virtual void gpiCodeChanged(const QHostAddress &host_addr,int slotnum);
-  virtual void gpoChanged(const QHostAddress &host_addr,int slotnum);
-  virtual void gpoCrosspointChanged(const QHostAddress &host_addr,int slotnum);
-  virtual void gpoCodeChanged(const QHostAddress &host_addr,int slotnum);
-  virtual void clipChanged(const QHostAddress &host_addr,int slotnum,
-			   SyLwrpClient::MeterType meter_type,
-			   const QString &tbl_name,int chan);
-  virtual void silenceChanged(const QHostAddress &host_addr,int slotnum,
-			      SyLwrpClient::MeterType meter_type,
-			      const QString &tbl_name,int chan);
+  virtual void nodeAdded(const ProtoIpcMessage::Node &node,
+			 const QList<ProtoIpcMessage::Source> &srcs,
+			 const QList<ProtoIpcMessage::Destination> &dsts,
+			 const QList<ProtoIpcMessage::Gpi> &gpis,
+			 const QList<ProtoIpcMessage::Gpo> &gpos);
+  virtual void nodeRemoved(const ProtoIpcMessage::Node &node);
+  virtual void nodeChanged(const ProtoIpcMessage::Node &node);
+  virtual void sourceChanged(const ProtoIpcMessage::Source &src);
+  virtual void destinationChanged(const ProtoIpcMessage::Destination &dst);
+  virtual void
+    destinationCrosspointChanged(const ProtoIpcMessage::Destination &dst,
+				 const QHostAddress &old_stream_addr,
+				 const QHostAddress &src_host_addr,
+				 int src_slotnum);
+  virtual void gpiChanged(const ProtoIpcMessage::Gpi &gpi);
+  virtual void gpiCodeChanged(const ProtoIpcMessage::Gpi &gpi);
+  virtual void gpoChanged(const ProtoIpcMessage::Gpo &gpo);
+  virtual void gpoCrosspointChanged(const ProtoIpcMessage::Gpo &gpo,
+				    const QHostAddress &old_src_addr,
+				    int old_src_slotnum);
+  virtual void gpoCodeChanged(const ProtoIpcMessage::Gpo &gpo);
+  virtual void clipChanged(const ProtoIpcMessage::Alarm &alarm);
+  virtual void silenceChanged(const ProtoIpcMessage::Alarm &alarm);
+  virtual void routeConfirmed(int event_id,int router,int output,int input,
+			      bool status,int msecs);
+  virtual void sequenceUpdated(quint64 seq);
   Config *config();
+  StateSnapshot *snapshot() const;
+  quint64 ipcSequence() const;
+  bool replayChanges(quint64 since);
+  bool isReplaying() const;
+  virtual bool databaseRequired() const;
+  bool startDb(QString *err_msg=NULL);
   void logIpc(const QString &msg);
   virtual void quitting();
   void quit();
 
  private:
-  void ProcessIpcCommand(const QString &cmd);
+  void ProcessIpcMessage(ProtoIpcMessage *msg);
   QTcpSocket *proto_ipc_socket;
-  QString proto_ipc_accum;
+  QByteArray proto_ipc_accum;
   QTimer *proto_shutdown_timer;
   Config *proto_config;
+  StateSnapshot *proto_snapshot;
+  ChangeJournal *proto_journal;
+  quint64 proto_ipc_sequence;
+  bool proto_replaying;
+  bool proto_db_open;
 };
 
 
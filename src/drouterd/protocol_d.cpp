@@ -23,6 +23,7 @@
 #include <syslog.h>
 #include <unistd.h>
 
+#include <QSet>
 #include <QStringList>
 
 #include "protocol_d.h"
@@ -32,19 +33,25 @@ ProtocolD::ProtocolD(int sock,QObject *parent)
   : Protocol(parent)
 {
   int flags;
+  QString err_msg;
 
   proto_socket=NULL;
-  proto_tether_subscribed=false;
-  proto_destinations_subscribed=false;
-  proto_gpis_subscribed=false;
-  proto_gpos_subscribed=false;
-  proto_nodes_subscribed=false;
-  proto_sources_subscribed=false;
-  proto_clips_subscribed=false;
-  proto_silences_subscribed=false;
+  proto_replay_sock=-1;
+  proto_replay_sub=TetherSubscription;
+  proto_single_process=config()->protocolSingleProcess();
 
   openlog("dprotod(D)",LOG_PID,LOG_DAEMON);
 
+  //
+  // Connection Mappers
+  //
+  proto_ready_mapper=new QSignalMapper(this);
+  connect(proto_ready_mapper,SIGNAL(mapped(int)),
+	  this,SLOT(readyReadData(int)));
+  proto_disconnected_mapper=new QSignalMapper(this);
+  connect(proto_disconnected_mapper,SIGNAL(mapped(int)),
+	  this,SLOT(disconnectedData(int)));
+
   //
   // The ProtocolD Server
   //
@@ -61,6 +68,17 @@ ProtocolD::ProtocolD(int sock,QObject *parent)
     syslog(LOG_ERR,"socket error [%s], aborting",strerror(errno));
     exit(1);
   }
+
+  //
+  // In single process mode, one IPC link serves every connection
+  //
+  if(proto_single_process) {
+    if(!startIpc(&err_msg)) {
+      syslog(LOG_ERR,"%s, aborting",err_msg.toUtf8().constData());
+      exit(1);
+    }
+    syslog(LOG_DEBUG,"serving all connections from a single process");
+  }
 }
 
 
@@ -68,21 +86,27 @@ void ProtocolD::newConnectionData()
 {
   int flags;
   QString err_msg;
+  QTcpSocket *socket=NULL;
 
   //
   // Process Server Connection
   //
-  proto_socket=proto_server->nextPendingConnection();
-  if((flags=fcntl(proto_socket->socketDescriptor(),F_GETFD,NULL))<0) {
+  socket=proto_server->nextPendingConnection();
+  if((flags=fcntl(socket->socketDescriptor(),F_GETFD,NULL))<0) {
     syslog(LOG_ERR,"socket error [%s], aborting",strerror(errno));
     exit(1);
   }
   flags=flags|FD_CLOEXEC;
-  if((flags=fcntl(proto_socket->socketDescriptor(),F_SETFD,&flags))<0) {
+  if((flags=fcntl(socket->socketDescriptor(),F_SETFD,&flags))<0) {
     syslog(LOG_ERR,"socket error [%s], aborting",strerror(errno));
     exit(1);
   }
-  
+
+  if(proto_single_process) {
+    AddConnection(socket);
+    return;
+  }
+
   if(fork()==0) {
     proto_server->close();
     proto_server=NULL;
@@ -91,7 +115,7 @@ void ProtocolD::newConnectionData()
     // Start IPC
     //
     if(!startIpc(&err_msg)) {
-      proto_socket->
+      socket->
 	write(("unable to bind to drouter service ["+err_msg+"]").toUtf8());
       quit();
     }
@@ -99,309 +123,618 @@ void ProtocolD::newConnectionData()
     //
     // Initialize Connection
     //
-    connect(proto_socket,SIGNAL(readyRead()),this,SLOT(readyReadData()));
-    connect(proto_socket,SIGNAL(disconnected()),this,SLOT(disconnectedData()));
+    AddConnection(socket);
   }
   else {
-    proto_socket->close();
-    delete proto_socket;
-    proto_socket=NULL;
+    socket->close();
+    delete socket;
   }
 }
 
 
-void ProtocolD::readyReadData()
+void ProtocolD::readyReadData(int sock)
 {
   char data[1501];
   int n;
+  QTcpSocket *socket=proto_sockets.value(sock);
 
-  while((n=proto_socket->read(data,1500))>0) {
+  if(socket==NULL) {
+    return;
+  }
+  while((n=socket->read(data,1500))>0) {
     for(int i=0;i<n;i++) {
       switch(0xFF&data[i]) {
       case 10:
 	break;
 
       case 13:
-	ProcessCommand(proto_accum);
-	proto_accum="";
+	ProcessCommand(sock,proto_accums.value(sock));
+	if(!proto_sockets.contains(sock)) {
+	  return;
+	}
+	proto_accums[sock]="";
 	break;
 
       default:
-	proto_accum+=0xFF&data[i];
+	proto_accums[sock]+=0xFF&data[i];
       }
     }
   }
 }
 
 
-void ProtocolD::disconnectedData()
+void ProtocolD::disconnectedData(int sock)
+{
+  CloseConnection(sock);
+}
+
+
+void ProtocolD::overflowedData(int sock)
 {
-  quit();
+  CloseConnection(sock);
 }
 
 
 void ProtocolD::tetherStateUpdated(bool state)
 {
-  if(proto_tether_subscribed) {
-    if(state) {
-      proto_socket->write("TETHER\tY\r\n");
-    }
-    else {
-      proto_socket->write("TETHER\tN\r\n");
-    }
+  if(state) {
+    Broadcast(TetherSubscription,RecordKey("TETHER"),"TETHER\tY\r\n");
+  }
+  else {
+    Broadcast(TetherSubscription,RecordKey("TETHER"),"TETHER\tN\r\n");
   }
 }
 
 
-void ProtocolD::nodeAdded(const QHostAddress &host_addr)
+void ProtocolD::nodeAdded(const ProtoIpcMessage::Node &node,
+			  const QList<ProtoIpcMessage::Source> &srcs,
+			  const QList<ProtoIpcMessage::Destination> &dsts,
+			  const QList<ProtoIpcMessage::Gpi> &gpis,
+			  const QList<ProtoIpcMessage::Gpo> &gpos)
 {
-  QString sql;
-  SqlQuery *q;
+  QByteArray fields;
 
-  if(proto_nodes_subscribed) {
-    sql=NodeSqlFields()+"where "+
-      "`NODES`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u",Config::LwrpMatrix);
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(NodeRecord("NODEADD",q).toUtf8());
-    }
-    delete q;
-  }
-  if(proto_sources_subscribed) {
-    sql=SourceSqlFields()+"where "+
-      "`SOURCES`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `SOURCES`.`HOST_ADDRESS`,`SOURCES`.`SLOT`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(SourceRecord("SRCADD",q).toUtf8());
+  if(node.matrix_type!=Config::LwrpMatrix) {
+    return;
+  }
+  if(IsSubscribed(NodesSubscription)) {
+    Broadcast(NodesSubscription,RecordKey("NODEADD",node.host_address),
+	      NodeRecord("NODEADD",node).toUtf8());
+  }
+  for(int i=0;i<srcs.size();i++) {
+    const ProtoIpcMessage::Source &src=srcs.at(i);
+    fields=SourceFields(src);
+    UpdateRecord(&proto_source_records,src.host_address,src.slot,
+		 src.host_name,src.name,fields);
+    if(IsSubscribed(SourcesSubscription)) {
+      Broadcast(SourcesSubscription,"SRCADD"+fields,
+		src.host_address,src.slot,src.host_name,src.name);
     }
-    delete q;
-  }
-  if(proto_destinations_subscribed) {
-    sql=DestinationSqlFields()+"where "+
-      "`DESTINATIONS`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `DESTINATIONS`.`HOST_ADDRESS`,`DESTINATIONS`.`SLOT`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(DestinationRecord("DSTADD",q).toUtf8());
+  }
+  for(int i=0;i<dsts.size();i++) {
+    const ProtoIpcMessage::Destination &dst=dsts.at(i);
+    fields=DestinationFields(dst);
+    UpdateRecord(&proto_destination_records,dst.host_address,dst.slot,
+		 dst.host_name,dst.name,fields);
+    if(IsSubscribed(DestinationsSubscription)) {
+      Broadcast(DestinationsSubscription,"DSTADD"+fields,
+		dst.host_address,dst.slot,dst.host_name,dst.name);
     }
-    delete q;
-  }
-  if(proto_gpis_subscribed) {
-    sql=GpiSqlFields()+"where "+
-      "`GPIS`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `GPIS`.`HOST_ADDRESS`,`GPIS`.`SLOT`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(GpiRecord("GPIADD",q).toUtf8());
+  }
+  for(int i=0;i<gpis.size();i++) {
+    const ProtoIpcMessage::Gpi &gpi=gpis.at(i);
+    fields=GpiFields(gpi);
+    UpdateRecord(&proto_gpi_records,gpi.host_address,gpi.slot,
+		 gpi.host_name,"",fields);
+    if(IsSubscribed(GpisSubscription)) {
+      Broadcast(GpisSubscription,"GPIADD"+fields,
+		gpi.host_address,gpi.slot,gpi.host_name,"");
     }
-    delete q;
-  }
-  if(proto_gpos_subscribed) {
-    sql=GpoSqlFields()+"where "+
-      "`GPOS`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `GPOS`.`HOST_ADDRESS`,`GPOS`.`SLOT`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(GpoRecord("GPOADD",q).toUtf8());
+  }
+  for(int i=0;i<gpos.size();i++) {
+    const ProtoIpcMessage::Gpo &gpo=gpos.at(i);
+    fields=GpoFields(gpo);
+    UpdateRecord(&proto_gpo_records,gpo.host_address,gpo.slot,
+		 gpo.host_name,gpo.name,fields);
+    if(IsSubscribed(GposSubscription)) {
+      Broadcast(GposSubscription,"GPOADD"+fields,
+		gpo.host_address,gpo.slot,gpo.host_name,gpo.name);
     }
-    delete q;
   }
 }
 
 
-void ProtocolD::nodeRemoved(const QHostAddress &host_addr,
-			    int srcs,int dsts,int gpis,int gpos)
+void ProtocolD::nodeRemoved(const ProtoIpcMessage::Node &node)
 {
-  QString sql;
-  SqlQuery *q;
+  QString addr=node.host_address.toString();
 
-  sql=NodeSqlFields()+"where "+
-    "`NODES`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-    QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix);
-  q=new SqlQuery(sql);
-  if(q->first()) {
-    if(proto_gpos_subscribed) {
-      for(int i=0;i<gpos;i++) {
-	proto_socket->write(("GPODEL\t"+host_addr.toString()+"\t"+
-			     QString::asprintf("%d\r\n",i)).toUtf8());
-      }
-    }
-    if(proto_gpis_subscribed) {
-      for(int i=0;i<gpis;i++) {
-	proto_socket->write(("GPIDEL\t"+host_addr.toString()+"\t"+
-			     QString::asprintf("%d\r\n",i)).toUtf8());
-      }
+  if(node.matrix_type!=Config::LwrpMatrix) {
+    return;
+  }
+  if(!isReplaying()) {
+    proto_source_records.remove(node.host_address);
+    proto_destination_records.remove(node.host_address);
+    proto_gpi_records.remove(node.host_address);
+    proto_gpo_records.remove(node.host_address);
+  }
+
+  //
+  // Slot names are gone by now, so name filters pass every DEL record
+  //
+  if(IsSubscribed(GposSubscription)) {
+    for(int i=0;i<node.gpos;i++) {
+      Broadcast(GposSubscription,
+		("GPODEL\t"+addr+"\t"+QString::asprintf("%d\r\n",i)).toUtf8(),
+		node.host_address,i,node.host_name);
     }
-    if(proto_destinations_subscribed) {
-      for(int i=0;i<dsts;i++) {
-	proto_socket->write(("DSTDEL\t"+host_addr.toString()+"\t"+
-			     QString::asprintf("%d\r\n",i)).toUtf8());
-      }
+  }
+  if(IsSubscribed(GpisSubscription)) {
+    for(int i=0;i<node.gpis;i++) {
+      Broadcast(GpisSubscription,
+		("GPIDEL\t"+addr+"\t"+QString::asprintf("%d\r\n",i)).toUtf8(),
+		node.host_address,i,node.host_name,"");
     }
-    if(proto_sources_subscribed) {
-      for(int i=0;i<srcs;i++) {
-	proto_socket->write(("SRCDEL\t"+host_addr.toString()+"\t"+
-			     QString::asprintf("%d\r\n",i)).toUtf8());
-      }
+  }
+  if(IsSubscribed(DestinationsSubscription)) {
+    for(int i=0;i<node.destinations;i++) {
+      Broadcast(DestinationsSubscription,
+		("DSTDEL\t"+addr+"\t"+QString::asprintf("%d\r\n",i)).toUtf8(),
+		node.host_address,i,node.host_name);
     }
-    if(proto_nodes_subscribed) {
-      proto_socket->write(("NODEDEL\t"+host_addr.toString()+"\r\n").toUtf8());
+  }
+  if(IsSubscribed(SourcesSubscription)) {
+    for(int i=0;i<node.sources;i++) {
+      Broadcast(SourcesSubscription,
+		("SRCDEL\t"+addr+"\t"+QString::asprintf("%d\r\n",i)).toUtf8(),
+		node.host_address,i,node.host_name);
     }
   }
-  delete q;
+  Broadcast(NodesSubscription,RecordKey("NODEDEL",node.host_address),
+	    ("NODEDEL\t"+addr+"\r\n").toUtf8());
 }
 
 
-void ProtocolD::nodeChanged(const QHostAddress &host_addr)
+void ProtocolD::nodeChanged(const ProtoIpcMessage::Node &node)
 {
-  QString sql;
-  SqlQuery *q;
+  if(node.matrix_type!=Config::LwrpMatrix) {
+    return;
+  }
 
-  if(proto_nodes_subscribed) {
-    sql=NodeSqlFields()+"where "+
-      "`NODES`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix);
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(NodeRecord("NODE",q).toUtf8());
-    }
-    delete q;
+  //
+  // Every record of the node carries its hostname, so reload them
+  //
+  if(!isReplaying()) {
+    proto_source_records.invalidate(node.host_address);
+    proto_destination_records.invalidate(node.host_address);
+    proto_gpi_records.invalidate(node.host_address);
+    proto_gpo_records.invalidate(node.host_address);
+  }
+  if(IsSubscribed(NodesSubscription)) {
+    Broadcast(NodesSubscription,RecordKey("NODE",node.host_address),
+	      NodeRecord("NODE",node).toUtf8());
   }
 }
 
 
-void ProtocolD::sourceChanged(const QHostAddress &host_addr,int slotnum)
+void ProtocolD::sourceChanged(const ProtoIpcMessage::Source &src)
 {
-  QString sql;
-  SqlQuery *q;
+  if(src.matrix_type!=Config::LwrpMatrix) {
+    return;
+  }
+  QByteArray fields=SourceFields(src);
+  if(IsSubscribed(SourcesSubscription)) {
+    BroadcastChange(SourcesSubscription,&proto_source_records,"SRC",fields,
+		    src.host_address,src.slot,src.host_name,src.name);
+  }
+  UpdateRecord(&proto_source_records,src.host_address,src.slot,
+	       src.host_name,src.name,fields);
+}
+
+
+void ProtocolD::destinationChanged(const ProtoIpcMessage::Destination &dst)
+{
+  if(dst.matrix_type!=Config::LwrpMatrix) {
+    return;
+  }
+  QByteArray fields=DestinationFields(dst);
+  if(IsSubscribed(DestinationsSubscription)) {
+    BroadcastChange(DestinationsSubscription,&proto_destination_records,
+		    "DST",fields,dst.host_address,dst.slot,dst.host_name,
+		    dst.name);
+  }
+  UpdateRecord(&proto_destination_records,dst.host_address,dst.slot,
+	       dst.host_name,dst.name,fields);
+}
+
 
-  if(proto_sources_subscribed) {
-    sql=SourceSqlFields()+"where "+
-      "`SOURCES`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      "`SOURCES`.`SLOT`="+QString::asprintf("%d && ",slotnum)+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix);
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(SourceRecord("SRC",q).toUtf8());
+void ProtocolD::gpiChanged(const ProtoIpcMessage::Gpi &gpi)
+{
+  if(gpi.matrix_type!=Config::LwrpMatrix) {
+    return;
+  }
+  QByteArray fields=GpiFields(gpi);
+  UpdateRecord(&proto_gpi_records,gpi.host_address,gpi.slot,
+	       gpi.host_name,"",fields);
+  if(IsSubscribed(GpisSubscription)) {
+    Broadcast(GpisSubscription,"GPI"+fields,
+	      gpi.host_address,gpi.slot,gpi.host_name,"");
+  }
+}
+
+
+void ProtocolD::gpoChanged(const ProtoIpcMessage::Gpo &gpo)
+{
+  if(gpo.matrix_type!=Config::LwrpMatrix) {
+    return;
+  }
+  QByteArray fields=GpoFields(gpo);
+  if(IsSubscribed(GposSubscription)) {
+    BroadcastChange(GposSubscription,&proto_gpo_records,"GPO",fields,
+		    gpo.host_address,gpo.slot,gpo.host_name,gpo.name);
+  }
+  UpdateRecord(&proto_gpo_records,gpo.host_address,gpo.slot,
+	       gpo.host_name,gpo.name,fields);
+}
+
+
+void ProtocolD::clipChanged(const ProtoIpcMessage::Alarm &alarm)
+{
+  if(IsSubscribed(ClipsSubscription)) {
+    Broadcast(ClipsSubscription,
+	      RecordKey("CLIP",alarm.host_address,alarm.slot,
+			2*alarm.meter_type+alarm.chan),
+	      AlarmRecord("CLIP",alarm).toUtf8());
+  }
+}
+ 
+
+void ProtocolD::silenceChanged(const ProtoIpcMessage::Alarm &alarm)
+{
+  if(IsSubscribed(SilencesSubscription)) {
+    Broadcast(SilencesSubscription,
+	      RecordKey("SILENCE",alarm.host_address,alarm.slot,
+			2*alarm.meter_type+alarm.chan),
+	      AlarmRecord("SILENCE",alarm).toUtf8());
+  }
+}
+
+
+void ProtocolD::sequenceUpdated(quint64 seq)
+{
+  //
+  // Let resuming clients know how far they have been brought up to date
+  //
+  for(QSet<int>::const_iterator it=proto_sequence_pending.constBegin();
+      it!=proto_sequence_pending.constEnd();it++) {
+    ClientQueue *queue=proto_queues.value(*it);
+    if(queue!=NULL) {
+      queue->update("SEQ",Encode(*it,QByteArray("SEQ\t")+
+				 QByteArray::number(seq)+"\r\n"));
     }
-    delete q;
   }
+  proto_sequence_pending.clear();
 }
 
 
-void ProtocolD::destinationChanged(const QHostAddress &host_addr,int slotnum)
+void ProtocolD::AddConnection(QTcpSocket *socket)
 {
-  QString sql;
-  SqlQuery *q;
+  int sock=socket->socketDescriptor();
+
+  proto_sockets[sock]=socket;
+  proto_accums[sock]="";
+  proto_subscriptions[sock]=0;
+  proto_queues[sock]=
+    new ClientQueue(socket,sock,config()->clientQueueHighWater(),
+		    config()->clientQueueLowWater(),
+		    config()->slowClientTimeout(),this);
+  connect(proto_queues.value(sock),SIGNAL(overflowed(int)),
+	  this,SLOT(overflowedData(int)),Qt::QueuedConnection);
+  connect(socket,SIGNAL(readyRead()),proto_ready_mapper,SLOT(map()));
+  proto_ready_mapper->setMapping(socket,sock);
+  connect(socket,SIGNAL(disconnected()),proto_disconnected_mapper,SLOT(map()));
+  proto_disconnected_mapper->setMapping(socket,sock);
+  connect(socket,SIGNAL(disconnected()),socket,SLOT(deleteLater()));
+}
 
-  if(proto_destinations_subscribed) {
-    sql=DestinationSqlFields()+"where "+
-      "`DESTINATIONS`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      "`DESTINATIONS`.`SLOT`="+QString::asprintf("%d && ",slotnum)+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix);
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(DestinationRecord("DST",q).toUtf8());
+
+void ProtocolD::CloseConnection(int sock)
+{
+  QTcpSocket *socket=NULL;
+
+  if(!proto_single_process) {
+    quit();
+  }
+  if((socket=proto_sockets.take(sock))==NULL) {
+    return;
+  }
+  proto_accums.remove(sock);
+  proto_subscriptions.remove(sock);
+  proto_filters.remove(sock);
+  proto_sequenced.remove(sock);
+  proto_sequence_pending.remove(sock);
+  proto_binary.remove(sock);
+  proto_queues.take(sock)->deleteLater();
+  proto_ready_mapper->removeMappings(socket);
+  proto_disconnected_mapper->removeMappings(socket);
+  if(proto_socket==socket) {
+    proto_socket=NULL;
+  }
+  if(socket->state()==QAbstractSocket::UnconnectedState) {
+    socket->deleteLater();
+  }
+  else {
+    socket->disconnectFromHost();
+  }
+}
+
+
+bool ProtocolD::IsSubscribed(Subscription sub) const
+{
+  for(QMap<int,unsigned>::const_iterator it=proto_subscriptions.constBegin();
+      it!=proto_subscriptions.constEnd();it++) {
+    if((it.value()&sub)!=0) {
+      return true;
     }
-    delete q;
   }
+  return false;
 }
 
 
-void ProtocolD::gpiChanged(const QHostAddress &host_addr,int slotnum)
+void ProtocolD::Broadcast(Subscription sub,const QByteArray &key,
+			  const QByteArray &data)
 {
-  QString sql;
-  SqlQuery *q;
+  if(data.isEmpty()) {
+    return;
+  }
+  for(QMap<int,unsigned>::const_iterator it=proto_subscriptions.constBegin();
+      it!=proto_subscriptions.constEnd();it++) {
+    if((it.value()&sub)!=0) {
+      Send(it.key(),sub,key,data);
+    }
+  }
+}
 
-  if(proto_gpis_subscribed) {
-    sql=GpiSqlFields()+"where "+
-      "`GPIS`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      "`GPIS`.`SLOT`="+QString::asprintf("%d && ",slotnum)+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix);
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(GpiRecord("GPI",q).toUtf8());
+
+void ProtocolD::Broadcast(Subscription sub,const QByteArray &record,
+			  const QHostAddress &host_addr,int slot,
+			  const QString &host_name,const QString &name)
+{
+  //
+  // Send 'record' to each connection whose filter selects it
+  //
+  QByteArray key;
+
+  for(QMap<int,unsigned>::const_iterator it=proto_subscriptions.constBegin();
+      it!=proto_subscriptions.constEnd();it++) {
+    if((it.value()&sub)!=0) {
+      QMap<int,QMap<unsigned,SubscriptionFilter> >::const_iterator f=
+	proto_filters.find(it.key());
+      if((f==proto_filters.end())||(!f.value().contains(sub))||
+	 f.value().find(sub).value().matches(host_addr,slot,host_name,name)) {
+	if(key.isEmpty()) {
+	  key=RecordKey(QString::fromUtf8(record.left(record.indexOf('\t'))),
+			host_addr,slot);
+	}
+	Send(it.key(),sub,key,record);
+      }
     }
-    delete q;
   }
 }
 
 
-void ProtocolD::gpoChanged(const QHostAddress &host_addr,int slotnum)
+void ProtocolD::BroadcastChange(Subscription sub,RecordCache *cache,
+				const QByteArray &keyword,
+				const QByteArray &fields,
+				const QHostAddress &host_addr,int slot,
+				const QString &host_name,const QString &name)
 {
-  QString sql;
-  SqlQuery *q;
+  //
+  // A slot renamed into or out of a connection's filter is added to or
+  // deleted from its view. The previous name is known only once the
+  // cache has been loaded, and not at all for replayed changes; without
+  // it, the change is sent as an update to whoever it matches.
+  //
+  QString kw=QString::fromUtf8(keyword);
+  QString old_name;
+  bool old_known=(!isReplaying())&&cache->name(host_addr,slot,&old_name);
+  QByteArray record=keyword+fields;
+  QByteArray add_record=keyword+"ADD"+fields;
+  QByteArray del_record=keyword+"DEL\t"+host_addr.toString().toUtf8()+
+    QByteArray("\t")+QByteArray::number(slot)+"\r\n";
+  bool old_match=false;
+  bool new_match=false;
+
+  for(QMap<int,unsigned>::const_iterator it=proto_subscriptions.constBegin();
+      it!=proto_subscriptions.constEnd();it++) {
+    if((it.value()&sub)!=0) {
+      QMap<int,QMap<unsigned,SubscriptionFilter> >::const_iterator f=
+	proto_filters.find(it.key());
+      if((f==proto_filters.end())||(!f.value().contains(sub))) {
+	Send(it.key(),sub,RecordKey(kw,host_addr,slot),record);
+	continue;
+      }
+      const SubscriptionFilter &filter=f.value().find(sub).value();
+      new_match=filter.matches(host_addr,slot,host_name,name);
+      old_match=new_match;
+      if(old_known&&(old_name!=name)) {
+	old_match=filter.matches(host_addr,slot,host_name,old_name);
+      }
+      if(new_match&&old_match) {
+	Send(it.key(),sub,RecordKey(kw,host_addr,slot),record);
+      }
+      if(new_match&&(!old_match)) {
+	Send(it.key(),sub,RecordKey(kw+"ADD",host_addr,slot),add_record);
+      }
+      if((!new_match)&&old_match) {
+	Send(it.key(),sub,RecordKey(kw+"DEL",host_addr,slot),del_record);
+      }
+    }
+  }
+}
 
-  if(proto_gpos_subscribed) {
-    sql=GpoSqlFields()+"where "+
-      "`GPOS`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      "`GPOS`.`SLOT`="+QString::asprintf("%d && ",slotnum)+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix);
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(GpoRecord("GPO",q).toUtf8());
+
+void ProtocolD::Send(int sock,Subscription sub,const QByteArray &key,
+		     const QByteArray &data)
+{
+  //
+  // Replayed changes go only to the client being caught up, ahead of
+  // the reply to its command
+  //
+  if(isReplaying()) {
+    if((sock==proto_replay_sock)&&(sub==proto_replay_sub)) {
+      proto_sockets.value(sock)->write(Encode(sock,data));
     }
-    delete q;
+    return;
+  }
+  proto_queues.value(sock)->update(key,Encode(sock,data));
+  if(proto_sequenced.contains(sock)) {
+    proto_sequence_pending.insert(sock);
   }
 }
 
 
-void ProtocolD::clipChanged(const QHostAddress &host_addr,int slotnum,
-			    SyLwrpClient::MeterType meter_type,
-			    const QString &tbl_name,int chan)
+void ProtocolD::UpdateRecord(RecordCache *cache,const QHostAddress &host_addr,
+			     int slot,const QString &host_name,
+			     const QString &name,const QByteArray &fields)
 {
-  QString sql;
-  SqlQuery *q;
+  //
+  // Until (re)loaded from the snapshot, the cache has nothing to keep
+  // current for this node
+  //
+  if((!cache->isStale(host_addr))&&(!isReplaying())) {
+    cache->update(host_addr,slot,host_name,name,fields);
+  }
+}
+
+
+QByteArray ProtocolD::RecordKey(const QString &keyword,
+				const QHostAddress &host_addr,int slot,
+				int chan) const
+{
+  return (keyword+" "+host_addr.toString()+
+	  QString::asprintf(" %d %d",slot,chan)).toUtf8();
+}
 
-  if(proto_clips_subscribed) {
-    sql=AlarmSqlFields(tbl_name,"CLIP",chan)+"from "+tbl_name+" where ";
-    sql+="`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      QString::asprintf("`SLOT`=%d",slotnum);
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(AlarmRecord("CLIP",meter_type,chan,q).toUtf8());
+
+void ProtocolD::Subscribe(int sock,Subscription sub,
+			  const SubscriptionFilter &filter)
+{
+  //
+  // Repeated subscriptions widen the existing filter
+  //
+  if((proto_subscriptions.value(sock)&sub)==0) {
+    proto_filters[sock][sub]=filter;
+  }
+  else {
+    proto_filters[sock][sub].merge(filter);
+  }
+  proto_subscriptions[sock]|=sub;
+}
+
+
+bool ProtocolD::ParseSubscription(const QStringList &args,bool *resume,
+				  quint64 *since,SubscriptionFilter *filter,
+				  QString *err_msg) const
+{
+  //
+  // [since <seq>] [<filter> ...]
+  //
+  QStringList terms=args;
+  bool ok=false;
+
+  *resume=false;
+  *since=0;
+  if((terms.size()>0)&&(terms.at(0).toLower()=="since")) {
+    if(terms.size()<2) {
+      *err_msg="missing sequence number";
+      return false;
+    }
+    *since=terms.at(1).toULongLong(&ok);
+    if(!ok) {
+      *err_msg="invalid sequence number \""+terms.at(1)+"\"";
+      return false;
     }
-    delete q;
+    *resume=true;
+    terms=terms.mid(2);
   }
+
+  return filter->parse(terms,err_msg);
 }
- 
 
-void ProtocolD::silenceChanged(const QHostAddress &host_addr,int slotnum,
-			       SyLwrpClient::MeterType meter_type,
-			       const QString &tbl_name,int chan)
+
+bool ProtocolD::Resume(int sock,Subscription sub,bool resume,quint64 since)
 {
-  QString sql;
-  SqlQuery *q;
+  //
+  // Returns true if the client has been brought up to date from the
+  // change journal, otherwise it is to be sent a full dump
+  //
+  bool ret=false;
 
-  if(proto_silences_subscribed) {
-    sql=AlarmSqlFields(tbl_name,"SILENCE",chan)+"from "+tbl_name+" where ";
-    sql+="`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      QString::asprintf("`SLOT`=%d",slotnum);
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(AlarmRecord("SILENCE",meter_type,chan,q).toUtf8());
+  if(!resume) {
+    return false;
+  }
+  proto_sequenced.insert(sock);
+  proto_replay_sock=sock;
+  proto_replay_sub=sub;
+  ret=replayChanges(since);
+  proto_replay_sock=-1;
+  if(!ret) {
+    //
+    // The client must drop what it holds before taking the full dump
+    //
+    switch(sub) {
+    case DestinationsSubscription:
+      Write("DSTRESET\r\n");
+      break;
+
+    case GpisSubscription:
+      Write("GPIRESET\r\n");
+      break;
+
+    case GposSubscription:
+      Write("GPORESET\r\n");
+      break;
+
+    case NodesSubscription:
+      Write("NODERESET\r\n");
+      break;
+
+    case SourcesSubscription:
+      Write("SRCRESET\r\n");
+      break;
+
+    default:
+      break;
     }
-    delete q;
+  }
+
+  return ret;
+}
+
+
+void ProtocolD::SendSequence(int sock)
+{
+  if(proto_sequenced.contains(sock)&&(ipcSequence()!=0)) {
+    Write(QByteArray("SEQ\t")+QByteArray::number(ipcSequence())+"\r\n");
   }
 }
 
 
-void ProtocolD::ProcessCommand(const QString &cmd)
+void ProtocolD::ProcessCommand(int sock,const QString &cmd)
 {
   QStringList cmds=cmd.split(" ");
   QString keyword=cmds.at(0).toLower();
-  QString sql;
-  SqlQuery *q;
+  SubscriptionFilter filter;
+  QString err_msg;
+  bool resume=false;
+  quint64 since=0;
+
+  proto_socket=proto_sockets.value(sock);
 
   if(keyword=="exit") {
     syslog(LOG_DEBUG,"exiting normally");
-    quit();
+    CloseConnection(sock);
+    return;
   }
 
   if(keyword.isEmpty()) {
@@ -409,301 +742,152 @@ void ProtocolD::ProcessCommand(const QString &cmd)
   }
 
   if(keyword=="ping") {
-    proto_socket->write("Pong\r\n",6);
+    Write("Pong\r\n");
     return;
   }
 
-  if(keyword=="listdestinations") {
-    sql=DestinationSqlFields()+"where "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `DESTINATIONS`.`HOST_ADDRESS`,`DESTINATIONS`.`SLOT`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(DestinationRecord("DST",q).toUtf8());
-    }
-    delete q;
-    proto_socket->write("ok\r\n");
+  //
+  // Replies must not overtake updates still held for this client
+  //
+  proto_queues.value(sock)->flush();
+
+  //
+  // Everything after the reply is sent in binary frames
+  //
+  if((keyword=="binary")&&(cmds.size()==1)) {
+    Write("ok\r\n");
+    proto_binary.insert(sock);
     return;
   }
 
-  if(keyword=="subscribedestinations") {
-    proto_destinations_subscribed=true;
-    sql=DestinationSqlFields()+"where "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `DESTINATIONS`.`HOST_ADDRESS`,`DESTINATIONS`.`SLOT`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(DestinationRecord("DSTADD",q).toUtf8());
-    }
-    delete q;
-    proto_socket->write("ok\r\n");
+  if((keyword=="listdestinations")&&filter.parse(cmds.mid(1),&err_msg)) {
+    SendDestinations("DST",filter);
+    Write("ok\r\n");
     return;
   }
 
-  if(keyword=="listgpis") {
-    sql=GpiSqlFields()+"where "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `GPIS`.`HOST_ADDRESS`,`GPIS`.`SLOT`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(GpiRecord("GPI",q).toUtf8());
+  if((keyword=="subscribedestinations")&&
+     ParseSubscription(cmds.mid(1),&resume,&since,&filter,&err_msg)) {
+    Subscribe(sock,DestinationsSubscription,filter);
+    if(!Resume(sock,DestinationsSubscription,resume,since)) {
+      SendDestinations("DSTADD",filter);
     }
-    delete q;
-    proto_socket->write("ok\r\n");
+    SendSequence(sock);
+    Write("ok\r\n");
     return;
   }
 
-  if(keyword=="subscribegpis") {
-    proto_gpis_subscribed=true;
-    sql=GpiSqlFields()+"where "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `GPIS`.`HOST_ADDRESS`,`GPIS`.`SLOT`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(GpiRecord("GPIADD",q).toUtf8());
-    }
-    delete q;
-    proto_socket->write("ok\r\n");
+  if((keyword=="listgpis")&&filter.parse(cmds.mid(1),&err_msg)) {
+    SendGpis("GPI",filter);
+    Write("ok\r\n");
     return;
   }
 
-  if(keyword=="listgpos") {
-    sql=GpoSqlFields()+"where "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `GPOS`.`HOST_ADDRESS`,`GPOS`.`SLOT`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(GpoRecord("GPO",q).toUtf8());
+  if((keyword=="subscribegpis")&&
+     ParseSubscription(cmds.mid(1),&resume,&since,&filter,&err_msg)) {
+    Subscribe(sock,GpisSubscription,filter);
+    if(!Resume(sock,GpisSubscription,resume,since)) {
+      SendGpis("GPIADD",filter);
     }
-    delete q;
-    proto_socket->write("ok\r\n");
+    SendSequence(sock);
+    Write("ok\r\n");
     return;
   }
 
-  if(keyword=="subscribegpos") {
-    proto_gpos_subscribed=true;
-    sql=GpoSqlFields()+"where "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `GPOS`.`HOST_ADDRESS`,`GPOS`.`SLOT`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(GpoRecord("GPOADD",q).toUtf8());
+  if((keyword=="listgpos")&&filter.parse(cmds.mid(1),&err_msg)) {
+    SendGpos("GPO",filter);
+    Write("ok\r\n");
+    return;
+  }
+
+  if((keyword=="subscribegpos")&&
+     ParseSubscription(cmds.mid(1),&resume,&since,&filter,&err_msg)) {
+    Subscribe(sock,GposSubscription,filter);
+    if(!Resume(sock,GposSubscription,resume,since)) {
+      SendGpos("GPOADD",filter);
     }
-    delete q;
-    proto_socket->write("ok\r\n");
+    SendSequence(sock);
+    Write("ok\r\n");
     return;
   }
 
   if(keyword=="listnodes") {
-    sql=NodeSqlFields()+"where "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `HOST_ADDRESS`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(NodeRecord("NODE",q).toUtf8());
-    }
-    delete q;
-    proto_socket->write("ok\r\n");
+    SendNodes("NODE");
+    Write("ok\r\n");
     return;
   }
 
-  if(keyword=="subscribenodes") {
-    proto_nodes_subscribed=true;
-    sql=NodeSqlFields()+"where "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `NODES`.`HOST_ADDRESS`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(NodeRecord("NODEADD",q).toUtf8());
+  if((keyword=="subscribenodes")&&
+     ParseSubscription(cmds.mid(1),&resume,&since,&filter,&err_msg)&&
+     filter.matchesAll()) {
+    proto_subscriptions[sock]|=NodesSubscription;
+    if(!Resume(sock,NodesSubscription,resume,since)) {
+      SendNodes("NODEADD");
     }
-    delete q;
-    proto_socket->write("ok\r\n");
+    SendSequence(sock);
+    Write("ok\r\n");
     return;
   }
 
-  if(keyword=="listsources") {
-    sql=SourceSqlFields()+"where "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `SOURCES`.`HOST_ADDRESS`,`SOURCES`.`SLOT`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(SourceRecord("SRC",q).toUtf8());
-    }
-    delete q;
-    proto_socket->write("ok\r\n");
+  if((keyword=="listsources")&&filter.parse(cmds.mid(1),&err_msg)) {
+    SendSources("SRC",filter);
+    Write("ok\r\n");
     return;
   }
 
-  if(keyword=="subscribesources") {
-    proto_sources_subscribed=true;
-    sql=SourceSqlFields()+"where "+
-      QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-      "order by `SOURCES`.`HOST_ADDRESS`,`SOURCES`.`SLOT`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(SourceRecord("SRCADD",q).toUtf8());
+  if((keyword=="subscribesources")&&
+     ParseSubscription(cmds.mid(1),&resume,&since,&filter,&err_msg)) {
+    Subscribe(sock,SourcesSubscription,filter);
+    if(!Resume(sock,SourcesSubscription,resume,since)) {
+      SendSources("SRCADD",filter);
     }
-    delete q;
-    proto_socket->write("ok\r\n");
+    SendSequence(sock);
+    Write("ok\r\n");
     return;
   }
 
   if(keyword=="listclips") {
-    for(int j=0;j<2;j++) {
-      sql=AlarmSqlFields("SOURCES","CLIP",j)+
-	"from `SOURCES` left join `NODES` "+
-	"on `SOURCES`.`HOST_ADDRESS`=`NODES`.`HOST_ADDRESS` "+
-	"where "+
-	QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-	"order by `SOURCES`.`HOST_ADDRESS`,`SOURCES`.`SLOT`";
-      q=new SqlQuery(sql);
-      while(q->next()) {
-	proto_socket->
-	  write(AlarmRecord("CLIP",SyLwrpClient::InputMeter,j,q).toUtf8());
-      }
-      delete q;
-    }
-    for(int j=0;j<2;j++) {
-      sql=AlarmSqlFields("DESTINATIONS","CLIP",j)+
-	"from `DESTINATIONS` left join `NODES` "+
-	"on `DESTINATIONS`.`HOST_ADDRESS`=`NODES`.`HOST_ADDRESS` "+
-	"where "+
-	QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-	"order by `DESTINATIONS`.`HOST_ADDRESS`,`DESTINATIONS`.`SLOT`";
-      q=new SqlQuery(sql);
-      while(q->next()) {
-	proto_socket->
-	  write(AlarmRecord("CLIP",SyLwrpClient::OutputMeter,j,q).toUtf8());
-      }
-      delete q;
-    }
-    proto_socket->write("ok\r\n");
+    SendAlarms("CLIP",StateSnapshot::ClipAlarm);
+    Write("ok\r\n");
     return;
   }
 
   if(keyword=="subscribeclips") {
-    proto_clips_subscribed=true;
-    for(int j=0;j<2;j++) {
-      sql=AlarmSqlFields("SOURCES","CLIP",j)+
-	"from `SOURCES` left join `NODES` "+
-	"on `SOURCES`.`HOST_ADDRESS`=`NODES`.`HOST_ADDRESS` "+
-	"where "+
-	QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-	"order by `SOURCES`.`HOST_ADDRESS`,`SOURCES`.`SLOT`";
-      q=new SqlQuery(sql);
-      while(q->next()) {
-	proto_socket->
-	  write(AlarmRecord("CLIPADD",SyLwrpClient::InputMeter,j,q).toUtf8());
-      }
-      delete q;
-    }
-    for(int j=0;j<2;j++) {
-      sql=AlarmSqlFields("DESTINATIONS","CLIP",j)+
-	"from `DESTINATIONS` left join `NODES` "+
-	"on `DESTINATIONS`.`HOST_ADDRESS`=`NODES`.`HOST_ADDRESS` "+
-	"where "+
-	QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-	"order by `DESTINATIONS`.`HOST_ADDRESS`,`DESTINATIONS`.`SLOT`";
-      q=new SqlQuery(sql);
-      while(q->next()) {
-	proto_socket->
-	  write(AlarmRecord("CLIPADD",SyLwrpClient::OutputMeter,j,q).toUtf8());
-      }
-      delete q;
-    }
-    proto_socket->write("ok\r\n");
+    proto_subscriptions[sock]|=ClipsSubscription;
+    SendAlarms("CLIPADD",StateSnapshot::ClipAlarm);
+    Write("ok\r\n");
     return;
   }
 
   if(keyword=="listsilences") {
-    for(int j=0;j<2;j++) {
-      sql=AlarmSqlFields("SOURCES","SILENCE",j)+
-	"from `SOURCES` left join `NODES` "+
-	"on `SOURCES`.`HOST_ADDRESS`=`NODES`.`HOST_ADDRESS` "+
-	"where "+
-	QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-	"order by `SOURCES`.`HOST_ADDRESS`,`SOURCES`.`SLOT`";
-      q=new SqlQuery(sql);
-      while(q->next()) {
-	proto_socket->
-	  write(AlarmRecord("SILENCE",SyLwrpClient::InputMeter,j,q).toUtf8());
-      }
-      delete q;
-    }
-    for(int j=0;j<2;j++) {
-      sql=AlarmSqlFields("DESTINATIONS","SILENCE",j)+
-	"from `DESTINATIONS` left join 'NODES' "+
-	"on `DESTINATIONS`.`HOST_ADDRESS`=`NODES`.`HOST_ADDRESS` "+
-	"where "+
-	QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-	"order by `DESTINATIONS`.`HOST_ADDRESS`,`DESTINATIONS`.`SLOT`";
-      q=new SqlQuery(sql);
-      while(q->next()) {
-	proto_socket->
-	  write(AlarmRecord("SILENCE",SyLwrpClient::OutputMeter,j,q).toUtf8());
-      }
-      delete q;
-    }
-    proto_socket->write("ok\r\n");
+    SendAlarms("SILENCE",StateSnapshot::SilenceAlarm);
+    Write("ok\r\n");
     return;
   }
 
   if(keyword=="subscribesilences") {
-    proto_silences_subscribed=true;
-    for(int j=0;j<2;j++) {
-      sql=AlarmSqlFields("SOURCES","SILENCE",j)+
-	"from `SOURCES` left join `NODES` "+
-	"on `SOURCES`.`HOST_ADDRESS`=`NODES`.`HOST_ADDRESS` "+
-	"where "+
-	QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-	"order by `SOURCES`.`HOST_ADDRESS`,`SOURCES`.`SLOT`";
-      q=new SqlQuery(sql);
-      while(q->next()) {
-	proto_socket->
-	  write(AlarmRecord("SILENCEADD",SyLwrpClient::InputMeter,j,q).toUtf8());
-      }
-      delete q;
-    }
-    for(int j=0;j<2;j++) {
-      sql=AlarmSqlFields("DESTINATIONS","SILENCE",j)+
-	"from `DESTINATIONS` left join `NODES` "+
-	"on `DESTINATIONS`.`HOST_ADDRESS`=`NODES`.`HOST_ADDRESS` "+
-	"where "+
-	QString::asprintf("`NODES`.`MATRIX_TYPE`=%u ",Config::LwrpMatrix)+
-	"order by `DESTINATIONS`.`HOST_ADDRESS`,`DESTINATIONS`.`SLOT`";
-      q=new SqlQuery(sql);
-      while(q->next()) {
-	proto_socket->
-	  write(AlarmRecord("SILENCEADD",SyLwrpClient::OutputMeter,j,q).toUtf8());
-      }
-      delete q;
-    }
-    proto_socket->write("ok\r\n");
+    proto_subscriptions[sock]|=SilencesSubscription;
+    SendAlarms("SILENCEADD",StateSnapshot::SilenceAlarm);
+    Write("ok\r\n");
+    return;
+  }
+
+  if(keyword=="listqueues") {
+    SendQueues();
+    Write("ok\r\n");
     return;
   }
 
   if(keyword=="listtether") {
-    sql=QString("select `TETHER`.`IS_ACTIVE` from `TETHER`");
-    q=new SqlQuery(sql);
-    if(q->first()) {
-      proto_socket->
-	write((QString("TETHER\t")+q->value(0).toString()+"\r\n").toUtf8());
-    }
-    delete q;
-    proto_socket->write("ok\r\n");
+    SendTether();
+    Write("ok\r\n");
     return;
   }
 
   if(keyword=="subscribetether") {
-    proto_tether_subscribed=true;
-    sql=QString("select `TETHER`.`IS_ACTIVE` from `TETHER`");
-    q=new SqlQuery(sql);
-    if(q->first()) {
-      proto_socket->
-	write((QString("TETHER\t")+q->value(0).toString()+"\r\n").toUtf8());
-    }
-    delete q;
-    proto_socket->write("ok\r\n");
+    proto_subscriptions[sock]|=TetherSubscription;
+    SendTether();
+    Write("ok\r\n");
     return;
   }
 
@@ -719,7 +903,7 @@ void ProtocolD::ProcessCommand(const QString &cmd)
 	  int src_slotnum=cmds.at(4).toInt(&ok);
 	  if(ok&&IsLivewire(dst_addr,src_addr)) {
 	    setCrosspoint(dst_addr,dst_slotnum,src_addr,src_slotnum);
-	    proto_socket->write("ok\r\n");
+	    Write("ok\r\n");
 	    return;
 	  }
 	}
@@ -727,6 +911,43 @@ void ProtocolD::ProcessCommand(const QString &cmd)
     }
   }
 
+  if((keyword=="setcrosspoints")&&(cmds.size()>1)&&
+     (((cmds.size()-1)%4)==0)) {
+    bool ok=true;
+    QList<Protocol::Crosspoint> xpoints;
+    QMap<quint32,bool> livewire;
+
+    for(int i=1;ok&&(i<cmds.size());i+=4) {
+      Protocol::Crosspoint xpt;
+      xpt.dst_host_address.setAddress(cmds.at(i));
+      xpt.src_host_address.setAddress(cmds.at(i+2));
+      if(xpt.dst_host_address.isNull()||xpt.src_host_address.isNull()) {
+	ok=false;
+	break;
+      }
+      xpt.dst_slot=cmds.at(i+1).toInt(&ok);
+      if(ok) {
+	xpt.src_slot=cmds.at(i+3).toInt(&ok);
+      }
+      for(int j=0;ok&&(j<2);j++) {
+	quint32 addr=xpt.dst_host_address.toIPv4Address();
+	if(j==1) {
+	  addr=xpt.src_host_address.toIPv4Address();
+	}
+	if(!livewire.contains(addr)) {
+	  livewire[addr]=IsLivewire(QHostAddress(addr));
+	}
+	ok=livewire.value(addr);
+      }
+      xpoints.push_back(xpt);
+    }
+    if(ok) {
+      setCrosspoints(xpoints);
+      Write("ok\r\n");
+      return;
+    }
+  }
+
   if((keyword=="setgpiocrosspoint")&&(cmds.size()==5)) {
     bool ok;
 
@@ -739,7 +960,7 @@ void ProtocolD::ProcessCommand(const QString &cmd)
 	  int gpi_slotnum=cmds.at(4).toInt(&ok);
 	  if(ok&&IsLivewire(gpo_addr,gpi_addr)) {
 	    setGpioCrosspoint(gpo_addr,gpo_slotnum,gpi_addr,gpi_slotnum);
-	    proto_socket->write("ok\r\n");
+	    Write("ok\r\n");
 	    return;
 	  }
 	}
@@ -755,7 +976,7 @@ void ProtocolD::ProcessCommand(const QString &cmd)
       int dst_slotnum=cmds.at(2).toInt(&ok);
       if(ok&&IsLivewire(dst_addr)) {
 	clearCrosspoint(dst_addr,dst_slotnum);
-	proto_socket->write("ok\r\n");
+	Write("ok\r\n");
 	return;
       }
     }
@@ -769,7 +990,7 @@ void ProtocolD::ProcessCommand(const QString &cmd)
       int gpo_slotnum=cmds.at(2).toInt(&ok);
       if(ok&&IsLivewire(gpo_addr)) {
 	clearGpioCrosspoint(gpo_addr,gpo_slotnum);
-	proto_socket->write("ok\r\n");
+	Write("ok\r\n");
 	return;
       }
     }
@@ -783,7 +1004,7 @@ void ProtocolD::ProcessCommand(const QString &cmd)
       int gpi_slotnum=cmds.at(2).toInt(&ok);
       if(ok&&IsLivewire(gpi_addr)) {
 	setGpiState(gpi_addr,gpi_slotnum,cmds.at(3));
-	proto_socket->write("ok\r\n");
+	Write("ok\r\n");
 	return;
       }
     }
@@ -797,13 +1018,380 @@ void ProtocolD::ProcessCommand(const QString &cmd)
       int gpo_slotnum=cmds.at(2).toInt(&ok);
       if(ok&&IsLivewire(gpo_addr)) {
 	setGpoState(gpo_addr,gpo_slotnum,cmds.at(3));
-	proto_socket->write("ok\r\n");
+	Write("ok\r\n");
 	return;
       }
     }
   }
 
-  proto_socket->write("error\r\n");
+  Write("error\r\n");
+}
+
+
+void ProtocolD::Write(const QByteArray &data)
+{
+  proto_socket->write(Encode(proto_socket->socketDescriptor(),data));
+}
+
+
+QByteArray ProtocolD::Encode(int sock,const QByteArray &data)
+{
+  //
+  // The same update usually goes to several connections in a row
+  //
+  if(!proto_binary.contains(sock)) {
+    return data;
+  }
+  if(data!=proto_encoded_text) {
+    proto_encoded_text=data;
+    proto_encoded_frames=proto_codec.encode(data);
+  }
+  return proto_encoded_frames;
+}
+
+
+bool ProtocolD::databaseRequired() const
+{
+  return snapshot()==NULL;
+}
+
+
+bool ProtocolD::LoadRecords(Subscription sub)
+{
+  //
+  // Once loaded, a cache is kept current by the change notifications
+  // that follow on the IPC link. Only the nodes not yet loaded, or
+  // invalidated since, are formatted here.
+  //
+  QList<ProtoIpcMessage::Source> srcs;
+  QList<ProtoIpcMessage::Destination> dsts;
+  QList<ProtoIpcMessage::Gpi> gpis;
+  QList<ProtoIpcMessage::Gpo> gpos;
+
+  switch(sub) {
+  case SourcesSubscription:
+    if((!proto_source_records.isValid())&&(snapshot()!=NULL)&&
+       snapshot()->sources(&srcs)) {
+      for(int i=0;i<srcs.size();i++) {
+	const ProtoIpcMessage::Source &src=srcs.at(i);
+	if((src.matrix_type==Config::LwrpMatrix)&&
+	   proto_source_records.isStale(src.host_address)) {
+	  proto_source_records.update(src.host_address,src.slot,src.host_name,
+				      src.name,SourceFields(src));
+	}
+      }
+      proto_source_records.setValid(true);
+    }
+    return proto_source_records.isValid();
+
+  case DestinationsSubscription:
+    if((!proto_destination_records.isValid())&&(snapshot()!=NULL)&&
+       snapshot()->destinations(&dsts)) {
+      for(int i=0;i<dsts.size();i++) {
+	const ProtoIpcMessage::Destination &dst=dsts.at(i);
+	if((dst.matrix_type==Config::LwrpMatrix)&&
+	   proto_destination_records.isStale(dst.host_address)) {
+	  proto_destination_records.
+	    update(dst.host_address,dst.slot,dst.host_name,dst.name,
+		   DestinationFields(dst));
+	}
+      }
+      proto_destination_records.setValid(true);
+    }
+    return proto_destination_records.isValid();
+
+  case GpisSubscription:
+    if((!proto_gpi_records.isValid())&&(snapshot()!=NULL)&&
+       snapshot()->gpis(&gpis)) {
+      for(int i=0;i<gpis.size();i++) {
+	const ProtoIpcMessage::Gpi &gpi=gpis.at(i);
+	if((gpi.matrix_type==Config::LwrpMatrix)&&
+	   proto_gpi_records.isStale(gpi.host_address)) {
+	  proto_gpi_records.update(gpi.host_address,gpi.slot,gpi.host_name,"",
+				   GpiFields(gpi));
+	}
+      }
+      proto_gpi_records.setValid(true);
+    }
+    return proto_gpi_records.isValid();
+
+  case GposSubscription:
+    if((!proto_gpo_records.isValid())&&(snapshot()!=NULL)&&
+       snapshot()->gpos(&gpos)) {
+      for(int i=0;i<gpos.size();i++) {
+	const ProtoIpcMessage::Gpo &gpo=gpos.at(i);
+	if((gpo.matrix_type==Config::LwrpMatrix)&&
+	   proto_gpo_records.isStale(gpo.host_address)) {
+	  proto_gpo_records.update(gpo.host_address,gpo.slot,gpo.host_name,
+				   gpo.name,GpoFields(gpo));
+	}
+      }
+      proto_gpo_records.setValid(true);
+    }
+    return proto_gpo_records.isValid();
+
+  default:
+    break;
+  }
+
+  return false;
+}
+
+
+void ProtocolD::SendAlarms(const QString &keyword,
+			   StateSnapshot::AlarmType type)
+{
+  QString sql;
+  SqlQuery *q;
+  QString type_name="CLIP";
+  SyLwrpClient::MeterType meters[2]=
+    {SyLwrpClient::InputMeter,SyLwrpClient::OutputMeter};
+  QString tables[2]={"SOURCES","DESTINATIONS"};
+  QList<ProtoIpcMessage::Node> nodes;
+  QList<ProtoIpcMessage::Alarm> alarms;
+  QList<QList<ProtoIpcMessage::Alarm> > lists;
+  QSet<quint32> lwrp_addrs;
+  bool ok=(snapshot()!=NULL)&&snapshot()->nodes(&nodes);
+
+  if(type==StateSnapshot::SilenceAlarm) {
+    type_name="SILENCE";
+  }
+
+  //
+  // Check that all four lists can be read before sending anything
+  //
+  for(int i=0;i<nodes.size();i++) {
+    if(nodes.at(i).matrix_type==Config::LwrpMatrix) {
+      lwrp_addrs.insert(nodes.at(i).host_address.toIPv4Address());
+    }
+  }
+  for(int i=0;ok&&(i<2);i++) {
+    for(int j=0;ok&&(j<2);j++) {
+      if((ok=snapshot()->alarms(&alarms,type,meters[i],j))) {
+	lists.push_back(alarms);
+      }
+    }
+  }
+  if(ok) {
+    for(int i=0;i<lists.size();i++) {
+      for(int j=0;j<lists.at(i).size();j++) {
+	if(lwrp_addrs.
+	   contains(lists.at(i).at(j).host_address.toIPv4Address())) {
+	  Write(AlarmRecord(keyword,lists.at(i).at(j)).toUtf8());
+	}
+      }
+    }
+    return;
+  }
+
+  if(!startDb()) {
+    return;
+  }
+  for(int i=0;i<2;i++) {
+    for(int j=0;j<2;j++) {
+      sql=AlarmSqlFields(tables[i],type_name,j)+
+	"from `"+tables[i]+"` left join `NODES` "+
+	"on `"+tables[i]+"`.`HOST_ADDRESS`=`NODES`.`HOST_ADDRESS` "+
+	"where "+
+	"`NODES`.`MATRIX_TYPE`=? "+
+	"order by `"+tables[i]+"`.`HOST_ADDRESS`,`"+tables[i]+"`.`SLOT`";
+      q=new SqlQuery(sql,QVariantList()<<Config::LwrpMatrix);
+      while(q->next()) {
+	Write(AlarmRecord(keyword,meters[i],j,q).toUtf8());
+      }
+      delete q;
+    }
+  }
+}
+
+
+void ProtocolD::SendDestinations(const QString &keyword,
+				 const SubscriptionFilter &filter)
+{
+  QString sql;
+  SqlQuery *q;
+
+  if(LoadRecords(DestinationsSubscription)) {
+    Write(proto_destination_records.records(keyword.toUtf8(),filter));
+    return;
+  }
+
+  if(!startDb()) {
+    return;
+  }
+  sql=DestinationSqlFields()+"where "+
+    "`NODES`.`MATRIX_TYPE`=? "+
+    "order by `DESTINATIONS`.`HOST_ADDRESS`,`DESTINATIONS`.`SLOT`";
+  q=new SqlQuery(sql,QVariantList()<<Config::LwrpMatrix);
+  while(q->next()) {
+    if(filter.matches(QHostAddress(q->value(0).toString()),
+		      q->value(1).toInt(),q->value(2).toString(),
+		      q->value(4).toString())) {
+      Write(DestinationRecord(keyword,q));
+    }
+  }
+  delete q;
+}
+
+
+void ProtocolD::SendGpis(const QString &keyword,
+			 const SubscriptionFilter &filter)
+{
+  QString sql;
+  SqlQuery *q;
+
+  if(LoadRecords(GpisSubscription)) {
+    Write(proto_gpi_records.records(keyword.toUtf8(),filter));
+    return;
+  }
+
+  if(!startDb()) {
+    return;
+  }
+  sql=GpiSqlFields()+"where "+
+    "`NODES`.`MATRIX_TYPE`=? "+
+    "order by `GPIS`.`HOST_ADDRESS`,`GPIS`.`SLOT`";
+  q=new SqlQuery(sql,QVariantList()<<Config::LwrpMatrix);
+  while(q->next()) {
+    if(filter.matches(QHostAddress(q->value(0).toString()),
+		      q->value(1).toInt(),q->value(2).toString(),"")) {
+      Write(GpiRecord(keyword,q));
+    }
+  }
+  delete q;
+}
+
+
+void ProtocolD::SendGpos(const QString &keyword,
+			 const SubscriptionFilter &filter)
+{
+  QString sql;
+  SqlQuery *q;
+
+  if(LoadRecords(GposSubscription)) {
+    Write(proto_gpo_records.records(keyword.toUtf8(),filter));
+    return;
+  }
+
+  if(!startDb()) {
+    return;
+  }
+  sql=GpoSqlFields()+"where "+
+    "`NODES`.`MATRIX_TYPE`=? "+
+    "order by `GPOS`.`HOST_ADDRESS`,`GPOS`.`SLOT`";
+  q=new SqlQuery(sql,QVariantList()<<Config::LwrpMatrix);
+  while(q->next()) {
+    if(filter.matches(QHostAddress(q->value(0).toString()),
+		      q->value(1).toInt(),q->value(2).toString(),
+		      q->value(4).toString())) {
+      Write(GpoRecord(keyword,q));
+    }
+  }
+  delete q;
+}
+
+
+void ProtocolD::SendNodes(const QString &keyword)
+{
+  QString sql;
+  SqlQuery *q;
+  QList<ProtoIpcMessage::Node> nodes;
+  QByteArray data;
+
+  if((snapshot()!=NULL)&&snapshot()->nodes(&nodes)) {
+    for(int i=0;i<nodes.size();i++) {
+      if(nodes.at(i).matrix_type==Config::LwrpMatrix) {
+	data+=NodeRecord(keyword,nodes.at(i)).toUtf8();
+      }
+    }
+    Write(data);
+    return;
+  }
+
+  if(!startDb()) {
+    return;
+  }
+  sql=NodeSqlFields()+"where "+
+    "`NODES`.`MATRIX_TYPE`=? "+
+    "order by `NODES`.`HOST_ADDRESS`";
+  q=new SqlQuery(sql,QVariantList()<<Config::LwrpMatrix);
+  while(q->next()) {
+    Write(NodeRecord(keyword,q).toUtf8());
+  }
+  delete q;
+}
+
+
+void ProtocolD::SendSources(const QString &keyword,
+			    const SubscriptionFilter &filter)
+{
+  QString sql;
+  SqlQuery *q;
+
+  if(LoadRecords(SourcesSubscription)) {
+    Write(proto_source_records.records(keyword.toUtf8(),filter));
+    return;
+  }
+
+  if(!startDb()) {
+    return;
+  }
+  sql=SourceSqlFields()+"where "+
+    "`NODES`.`MATRIX_TYPE`=? "+
+    "order by `SOURCES`.`HOST_ADDRESS`,`SOURCES`.`SLOT`";
+  q=new SqlQuery(sql,QVariantList()<<Config::LwrpMatrix);
+  while(q->next()) {
+    if(filter.matches(QHostAddress(q->value(0).toString()),
+		      q->value(1).toInt(),q->value(2).toString(),
+		      q->value(4).toString())) {
+      Write(SourceRecord(keyword,q));
+    }
+  }
+  delete q;
+}
+
+
+void ProtocolD::SendQueues()
+{
+  for(QMap<int,ClientQueue *>::const_iterator it=proto_queues.constBegin();
+      it!=proto_queues.constEnd();it++) {
+    QTcpSocket *socket=proto_sockets.value(it.key());
+    ClientQueue *queue=it.value();
+    Write((QString("QUEUE\t")+
+	   socket->peerAddress().toString()+"\t"+
+	   QString::asprintf("%u\t",0xFFFF&socket->peerPort())+
+	   QString::asprintf("%lld\t",queue->depth())+
+	   QString::asprintf("%d\t",queue->conflated())+
+	   QString(queue->isCongested()?"Y":"N")+"\r\n").toUtf8());
+  }
+}
+
+
+void ProtocolD::SendTether()
+{
+  QString sql;
+  SqlQuery *q;
+  bool state=false;
+
+  if((snapshot()!=NULL)&&snapshot()->tetherState(&state)) {
+    if(state) {
+      Write("TETHER\tY\r\n");
+    }
+    else {
+      Write("TETHER\tN\r\n");
+    }
+    return;
+  }
+
+  if(!startDb()) {
+    return;
+  }
+  sql=QString("select `TETHER`.`IS_ACTIVE` from `TETHER`");
+  q=new SqlQuery(sql);
+  if(q->first()) {
+    Write((QString("TETHER\t")+q->value(0).toString()+"\r\n").toUtf8());
+  }
+  delete q;
 }
 
 
@@ -826,13 +1414,28 @@ QString ProtocolD::AlarmSqlFields(const QString &tbl_name,const QString &type,
 
 QString ProtocolD::AlarmRecord(const QString &keyword,SyLwrpClient::MeterType port,
 			       int chan,SqlQuery *q)
+{
+  ProtoIpcMessage::Alarm alarm;
+
+  alarm.host_address.setAddress(q->value(0).toString());
+  alarm.slot=q->value(1).toInt();
+  alarm.meter_type=port;
+  alarm.chan=chan;
+  alarm.state=q->value(2).toInt();
+
+  return AlarmRecord(keyword,alarm);
+}
+
+
+QString ProtocolD::AlarmRecord(const QString &keyword,
+			       const ProtoIpcMessage::Alarm &alarm) const
 {
   QString ret="";
 
   ret+=keyword+"\t";
-  ret+=q->value(0).toString()+"\t";
-  ret+=QString::asprintf("%d\t",q->value(1).toInt());
-  switch(port) {
+  ret+=alarm.host_address.toString()+"\t";
+  ret+=QString::asprintf("%d\t",alarm.slot);
+  switch((SyLwrpClient::MeterType)alarm.meter_type) {
   case SyLwrpClient::InputMeter:
     ret+="INPUT\t";
     break;
@@ -845,7 +1448,7 @@ QString ProtocolD::AlarmRecord(const QString &keyword,SyLwrpClient::MeterType po
     ret+="UNKNOWN\t";
     break;
   }
-  switch(chan) {
+  switch(alarm.chan) {
   case 0:
     ret+="LEFT\t";
     break;
@@ -858,7 +1461,7 @@ QString ProtocolD::AlarmRecord(const QString &keyword,SyLwrpClient::MeterType po
     ret+="UNKNOWN\t";
     break;
   }
-  ret+=QString::asprintf("%d\t",q->value(2).toInt());
+  ret+=QString::asprintf("%d\t",alarm.state);
   ret+="\r\n";
 
   return ret;
@@ -879,17 +1482,33 @@ QString ProtocolD::DestinationSqlFields() const
 }
 
 
-QString ProtocolD::DestinationRecord(const QString &keyword,SqlQuery *q) const
+QByteArray ProtocolD::DestinationRecord(const QString &keyword,SqlQuery *q)
+  const
 {
-  QString ret="";
+  ProtoIpcMessage::Destination dst;
 
-  ret+=keyword+"\t";
-  ret+=q->value(0).toString()+"\t";
-  ret+=QString::asprintf("%d\t",q->value(1).toInt());
-  ret+=q->value(2).toString()+"\t";
-  ret+=q->value(3).toString()+"\t";
-  ret+=q->value(4).toString()+"\t";
-  ret+=QString::asprintf("%u",q->value(5).toInt());
+  dst.host_address.setAddress(q->value(0).toString());
+  dst.slot=q->value(1).toInt();
+  dst.host_name=q->value(2).toString();
+  dst.stream_address.setAddress(q->value(3).toString());
+  dst.name=q->value(4).toString();
+  dst.channels=q->value(5).toInt();
+
+  return keyword.toUtf8()+DestinationFields(dst);
+}
+
+
+QByteArray
+ProtocolD::DestinationFields(const ProtoIpcMessage::Destination &dst) const
+{
+  QByteArray ret;
+
+  ret+="\t"+dst.host_address.toString().toUtf8();
+  ret+="\t"+QByteArray::number(dst.slot);
+  ret+="\t"+dst.host_name.toUtf8();
+  ret+="\t"+dst.stream_address.toString().toUtf8();
+  ret+="\t"+dst.name.toUtf8();
+  ret+="\t"+QByteArray::number(dst.channels);
   ret+="\r\n";
 
   return ret;
@@ -908,15 +1527,27 @@ QString ProtocolD::GpiSqlFields() const
 }
 
 
-QString ProtocolD::GpiRecord(const QString &keyword,SqlQuery *q)
+QByteArray ProtocolD::GpiRecord(const QString &keyword,SqlQuery *q) const
 {
-  QString ret="";
+  ProtoIpcMessage::Gpi gpi;
 
-  ret+=keyword+"\t";
-  ret+=q->value(0).toString()+"\t";
-  ret+=QString::asprintf("%d\t",q->value(1).toInt());
-  ret+=q->value(2).toString()+"\t";
-  ret+=q->value(3).toString();
+  gpi.host_address.setAddress(q->value(0).toString());
+  gpi.slot=q->value(1).toInt();
+  gpi.host_name=q->value(2).toString();
+  gpi.code=q->value(3).toString();
+
+  return keyword.toUtf8()+GpiFields(gpi);
+}
+
+
+QByteArray ProtocolD::GpiFields(const ProtoIpcMessage::Gpi &gpi) const
+{
+  QByteArray ret;
+
+  ret+="\t"+gpi.host_address.toString().toUtf8();
+  ret+="\t"+QByteArray::number(gpi.slot);
+  ret+="\t"+gpi.host_name.toUtf8();
+  ret+="\t"+gpi.code.toUtf8();
   ret+="\r\n";
 
   return ret;
@@ -938,18 +1569,33 @@ QString ProtocolD::GpoSqlFields() const
 }
 
 
-QString ProtocolD::GpoRecord(const QString &keyword,SqlQuery *q)
+QByteArray ProtocolD::GpoRecord(const QString &keyword,SqlQuery *q) const
 {
-  QString ret="";
+  ProtoIpcMessage::Gpo gpo;
 
-  ret+=keyword+"\t";
-  ret+=q->value(0).toString()+"\t";
-  ret+=QString::asprintf("%d\t",q->value(1).toInt());
-  ret+=q->value(2).toString()+"\t";
-  ret+=q->value(3).toString()+"\t";
-  ret+=q->value(4).toString()+"\t";
-  ret+=q->value(5).toString()+"\t";
-  ret+=QString::asprintf("%d",q->value(6).toInt());
+  gpo.host_address.setAddress(q->value(0).toString());
+  gpo.slot=q->value(1).toInt();
+  gpo.host_name=q->value(2).toString();
+  gpo.code=q->value(3).toString();
+  gpo.name=q->value(4).toString();
+  gpo.source_address.setAddress(q->value(5).toString());
+  gpo.source_slot=q->value(6).toInt();
+
+  return keyword.toUtf8()+GpoFields(gpo);
+}
+
+
+QByteArray ProtocolD::GpoFields(const ProtoIpcMessage::Gpo &gpo) const
+{
+  QByteArray ret;
+
+  ret+="\t"+gpo.host_address.toString().toUtf8();
+  ret+="\t"+QByteArray::number(gpo.slot);
+  ret+="\t"+gpo.host_name.toUtf8();
+  ret+="\t"+gpo.code.toUtf8();
+  ret+="\t"+gpo.name.toUtf8();
+  ret+="\t"+gpo.source_address.toString().toUtf8();
+  ret+="\t"+QByteArray::number(gpo.source_slot);
   ret+="\r\n";
 
   return ret;
@@ -971,17 +1617,34 @@ QString ProtocolD::NodeSqlFields() const
 
 
 QString ProtocolD::NodeRecord(const QString &keyword,SqlQuery *q) const
+{
+  ProtoIpcMessage::Node node;
+
+  node.host_address.setAddress(q->value(0).toString());
+  node.host_name=q->value(1).toString();
+  node.device_name=q->value(2).toString();
+  node.sources=q->value(3).toInt();
+  node.destinations=q->value(4).toInt();
+  node.gpis=q->value(5).toInt();
+  node.gpos=q->value(6).toInt();
+
+  return NodeRecord(keyword,node);
+}
+
+
+QString ProtocolD::NodeRecord(const QString &keyword,
+			      const ProtoIpcMessage::Node &node) const
 {
   QString ret;
 
   ret+=keyword+"\t";
-  ret+=q->value(0).toString()+"\t";
-  ret+=q->value(1).toString()+"\t";
-  ret+=q->value(2).toString()+"\t";
-  ret+=QString::asprintf("%u\t",q->value(3).toInt());
-  ret+=QString::asprintf("%u\t",q->value(4).toInt());
-  ret+=QString::asprintf("%u\t",q->value(5).toInt());
-  ret+=QString::asprintf("%u",q->value(6).toInt());
+  ret+=node.host_address.toString()+"\t";
+  ret+=node.host_name+"\t";
+  ret+=node.device_name+"\t";
+  ret+=QString::asprintf("%u\t",node.sources);
+  ret+=QString::asprintf("%u\t",node.destinations);
+  ret+=QString::asprintf("%u\t",node.gpis);
+  ret+=QString::asprintf("%u",node.gpos);
   ret+="\r\n";
 
   return ret;
@@ -1004,19 +1667,35 @@ QString ProtocolD::SourceSqlFields() const
 }
 
 
-QString ProtocolD::SourceRecord(const QString &keyword,SqlQuery *q)
+QByteArray ProtocolD::SourceRecord(const QString &keyword,SqlQuery *q) const
 {
-  QString ret="";
+  ProtoIpcMessage::Source src;
+
+  src.host_address.setAddress(q->value(0).toString());
+  src.slot=q->value(1).toInt();
+  src.host_name=q->value(2).toString();
+  src.stream_address.setAddress(q->value(3).toString());
+  src.name=q->value(4).toString();
+  src.enabled=q->value(5).toInt();
+  src.channels=q->value(6).toInt();
+  src.block_size=q->value(7).toInt();
+
+  return keyword.toUtf8()+SourceFields(src);
+}
 
-  ret+=keyword+"\t";
-  ret+=q->value(0).toString()+"\t";
-  ret+=QString::asprintf("%d\t",q->value(1).toInt());
-  ret+=q->value(2).toString()+"\t";
-  ret+=q->value(3).toString()+"\t";
-  ret+=q->value(4).toString()+"\t";
-  ret+=QString::asprintf("%u\t",q->value(5).toInt());
-  ret+=QString::asprintf("%u\t",q->value(6).toInt());
-  ret+=QString::asprintf("%u",q->value(7).toInt());
+
+QByteArray ProtocolD::SourceFields(const ProtoIpcMessage::Source &src) const
+{
+  QByteArray ret;
+
+  ret+="\t"+src.host_address.toString().toUtf8();
+  ret+="\t"+QByteArray::number(src.slot);
+  ret+="\t"+src.host_name.toUtf8();
+  ret+="\t"+src.stream_address.toString().toUtf8();
+  ret+="\t"+src.name.toUtf8();
+  ret+="\t"+QByteArray(src.enabled?"1":"0");
+  ret+="\t"+QByteArray::number(src.channels);
+  ret+="\t"+QByteArray::number(src.block_size);
   ret+="\r\n";
 
   return ret;
@@ -1028,17 +1707,42 @@ bool ProtocolD::IsLivewire(const QHostAddress &host_addr1,
 {
   bool ret;
   int size=1;
+  ProtoIpcMessage::Node node1;
+  ProtoIpcMessage::Node node2;
+
+  if((snapshot()!=NULL)&&snapshot()->node(host_addr1,&node1)) {
+    ret=(!node1.host_address.isNull())&&
+      (node1.matrix_type==Config::LwrpMatrix);
+    if(ret&&(!host_addr2.isNull())&&(host_addr1!=host_addr2)) {
+      if(snapshot()->node(host_addr2,&node2)) {
+	ret=(!node2.host_address.isNull())&&
+	  (node2.matrix_type==Config::LwrpMatrix);
+	return ret;
+      }
+    }
+    else {
+      return ret;
+    }
+  }
+
+  if(!startDb()) {
+    return false;
+  }
+  QVariantList values;
+  values.push_back(Config::LwrpMatrix);
+  values.push_back(host_addr1.toString());
   QString sql=NodeSqlFields()+" where "+
-    QString::asprintf("`NODES`.`MATRIX_TYPE`=%u && (",Config::LwrpMatrix)+
-    "`NODES`.`HOST_ADDRESS`='"+host_addr1.toString()+"' ";
+    "`NODES`.`MATRIX_TYPE`=? && ("+
+    "`NODES`.`HOST_ADDRESS`=? ";
   if(!host_addr2.isNull()) {
-    sql+="|| `NODES`.`HOST_ADDRESS`='"+host_addr2.toString()+"'";
+    sql+="|| `NODES`.`HOST_ADDRESS`=?";
+    values.push_back(host_addr2.toString());
     if(host_addr1!=host_addr2) {
       size=2;
     }
   }
   sql+=")";
-  SqlQuery *q=new SqlQuery(sql);
+  SqlQuery *q=new SqlQuery(sql,values);
   ret=q->size()==size;
   delete q;
 
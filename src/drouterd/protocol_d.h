@@ -23,70 +23,139 @@
 
 #include <signal.h>
 
+#include <QMap>
+#include <QSet>
+#include <QSignalMapper>
 #include <QTcpServer>
 
 #include <sy5/sylwrp_client.h>
 
+#include "clientqueue.h"
+#include "dcodec.h"
 #include "protocol.h"
+#include "recordcache.h"
 #include "sqlquery.h"
+#include "subscriptionfilter.h"
 
 class ProtocolD : public Protocol
 {
  Q_OBJECT;
  public:
+  enum Subscription {TetherSubscription=0x01,DestinationsSubscription=0x02,
+		     GpisSubscription=0x04,GposSubscription=0x08,
+		     NodesSubscription=0x10,SourcesSubscription=0x20,
+		     ClipsSubscription=0x40,SilencesSubscription=0x80};
  ProtocolD(int sock,QObject *parent=0);
 
  private slots:
   void newConnectionData();
-  void readyReadData();
-  void disconnectedData();
+  void readyReadData(int sock);
+  void disconnectedData(int sock);
+  void overflowedData(int sock);
 
  protected:
   void tetherStateUpdated(bool state);
-  void nodeAdded(const QHostAddress &host_addr);
-  void nodeRemoved(const QHostAddress &host_addr,
-		   int srcs,int dsts,int gpis,int gpos);
-  void nodeChanged(const QHostAddress &host_addr);
-  void sourceChanged(const QHostAddress &host_addr,int slotnum);
-  void destinationChanged(const QHostAddress &host_addr,int slotnum);
-  void gpiChanged(const QHostAddress &host_addr,int slotnum);
-  void gpoChanged(const QHostAddress &host_addr,int slotnum);
-  void clipChanged(const QHostAddress &host_addr,int slotnum,
-		   SyLwrpClient::MeterType meter_type,
-		   const QString &tbl_name,int chan);
-  void silenceChanged(const QHostAddress &host_addr,int slotnum,
-		      SyLwrpClient::MeterType meter_type,
-		      const QString &tbl_name,int chan);
+  void nodeAdded(const ProtoIpcMessage::Node &node,
+		 const QList<ProtoIpcMessage::Source> &srcs,
+		 const QList<ProtoIpcMessage::Destination> &dsts,
+		 const QList<ProtoIpcMessage::Gpi> &gpis,
+		 const QList<ProtoIpcMessage::Gpo> &gpos);
+  void nodeRemoved(const ProtoIpcMessage::Node &node);
+  void nodeChanged(const ProtoIpcMessage::Node &node);
+  void sourceChanged(const ProtoIpcMessage::Source &src);
+  void destinationChanged(const ProtoIpcMessage::Destination &dst);
+  void gpiChanged(const ProtoIpcMessage::Gpi &gpi);
+  void gpoChanged(const ProtoIpcMessage::Gpo &gpo);
+  void clipChanged(const ProtoIpcMessage::Alarm &alarm);
+  void silenceChanged(const ProtoIpcMessage::Alarm &alarm);
+  void sequenceUpdated(quint64 seq);
+  bool databaseRequired() const;
 
  private:
-  void ProcessCommand(const QString &cmd);
+  void AddConnection(QTcpSocket *socket);
+  void CloseConnection(int sock);
+  bool IsSubscribed(Subscription sub) const;
+  void Broadcast(Subscription sub,const QByteArray &key,
+		 const QByteArray &data);
+  void Broadcast(Subscription sub,const QByteArray &record,
+		 const QHostAddress &host_addr,int slot,
+		 const QString &host_name,const QString &name=QString());
+  void BroadcastChange(Subscription sub,RecordCache *cache,
+		       const QByteArray &keyword,const QByteArray &fields,
+		       const QHostAddress &host_addr,int slot,
+		       const QString &host_name,const QString &name);
+  void Send(int sock,Subscription sub,const QByteArray &key,
+	    const QByteArray &data);
+  void UpdateRecord(RecordCache *cache,const QHostAddress &host_addr,int slot,
+		    const QString &host_name,const QString &name,
+		    const QByteArray &fields);
+  bool LoadRecords(Subscription sub);
+  QByteArray RecordKey(const QString &keyword,
+		       const QHostAddress &host_addr=QHostAddress(),
+		       int slot=-1,int chan=-1) const;
+  void Subscribe(int sock,Subscription sub,const SubscriptionFilter &filter);
+  bool ParseSubscription(const QStringList &args,bool *resume,quint64 *since,
+			 SubscriptionFilter *filter,QString *err_msg) const;
+  bool Resume(int sock,Subscription sub,bool resume,quint64 since);
+  void SendSequence(int sock);
+  void ProcessCommand(int sock,const QString &cmd);
+  void Write(const QByteArray &data);
+  QByteArray Encode(int sock,const QByteArray &data);
+  void SendAlarms(const QString &keyword,StateSnapshot::AlarmType type);
+  void SendDestinations(const QString &keyword,
+			const SubscriptionFilter &filter);
+  void SendGpis(const QString &keyword,const SubscriptionFilter &filter);
+  void SendGpos(const QString &keyword,const SubscriptionFilter &filter);
+  void SendNodes(const QString &keyword);
+  void SendQueues();
+  void SendSources(const QString &keyword,const SubscriptionFilter &filter);
+  void SendTether();
   QString AlarmSqlFields(const QString &tbl_name,const QString &type,
 			 int chan) const;
   QString AlarmRecord(const QString &keyword,SyLwrpClient::MeterType port,
 		      int chan,SqlQuery *q);
+  QString AlarmRecord(const QString &keyword,
+		      const ProtoIpcMessage::Alarm &alarm) const;
   QString DestinationSqlFields() const;
-  QString DestinationRecord(const QString &keyword,SqlQuery *q) const;
+  QByteArray DestinationRecord(const QString &keyword,SqlQuery *q) const;
+  QByteArray DestinationFields(const ProtoIpcMessage::Destination &dst) const;
   QString GpiSqlFields() const;
-  QString GpiRecord(const QString &keyword,SqlQuery *q);
+  QByteArray GpiRecord(const QString &keyword,SqlQuery *q) const;
+  QByteArray GpiFields(const ProtoIpcMessage::Gpi &gpi) const;
   QString GpoSqlFields() const;
-  QString GpoRecord(const QString &keyword,SqlQuery *q);
+  QByteArray GpoRecord(const QString &keyword,SqlQuery *q) const;
+  QByteArray GpoFields(const ProtoIpcMessage::Gpo &gpo) const;
   QString NodeSqlFields() const;
   QString NodeRecord(const QString &keyword,SqlQuery *q) const;
+  QString NodeRecord(const QString &keyword,
+		     const ProtoIpcMessage::Node &node) const;
   QString SourceSqlFields() const;
-  QString SourceRecord(const QString &keyword,SqlQuery *q);
+  QByteArray SourceRecord(const QString &keyword,SqlQuery *q) const;
+  QByteArray SourceFields(const ProtoIpcMessage::Source &src) const;
   bool IsLivewire(const QHostAddress &host_addr1,
 		  const QHostAddress &host_addr2=QHostAddress());
   QTcpSocket *proto_socket;
   QTcpServer *proto_server;
-  QString proto_accum;
-  bool proto_tether_subscribed;
-  bool proto_destinations_subscribed;
-  bool proto_gpis_subscribed;
-  bool proto_gpos_subscribed;
-  bool proto_nodes_subscribed;
-  bool proto_sources_subscribed;
-  bool proto_clips_subscribed;
-  bool proto_silences_subscribed;
+  QMap<int,QTcpSocket *> proto_sockets;
+  QMap<int,QString> proto_accums;
+  QMap<int,unsigned> proto_subscriptions;
+  QMap<int,QMap<unsigned,SubscriptionFilter> > proto_filters;
+  QMap<int,ClientQueue *> proto_queues;
+  QSet<int> proto_sequenced;
+  QSet<int> proto_sequence_pending;
+  int proto_replay_sock;
+  Subscription proto_replay_sub;
+  QSet<int> proto_binary;
+  DCodec proto_codec;
+  QByteArray proto_encoded_text;
+  QByteArray proto_encoded_frames;
+  RecordCache proto_source_records;
+  RecordCache proto_destination_records;
+  RecordCache proto_gpi_records;
+  RecordCache proto_gpo_records;
+  QSignalMapper *proto_ready_mapper;
+  QSignalMapper *proto_disconnected_mapper;
+  bool proto_single_process;
 };
 
 
@@ -23,6 +23,7 @@
 #include <syslog.h>
 #include <unistd.h>
 
+#include <QSqlDatabase>
 #include <QSqlError>
 #include <QStringList>
 
@@ -35,20 +36,25 @@ ProtocolSa::ProtocolSa(int sock,QObject *parent)
 {
   int flags;
   QString sql;
+  QString err_msg;
 
   proto_socket=NULL;
-  proto_destinations_subscribed=false;
-  proto_gpis_subscribed=false;
-  proto_gpos_subscribed=false;
-  proto_nodes_subscribed=false;
-  proto_sources_subscribed=false;
-  proto_clips_subscribed=false;
-  proto_silences_subscribed=false;
-  proto_gpistat_masked=false;
-  proto_gpostat_masked=false;
-  proto_routestat_masked=false;
+  proto_current_sock=-1;
+  proto_event_batch=0;
+  proto_event_transaction=false;
+  proto_single_process=config()->protocolSingleProcess();
   openlog("dprotod(SA)",LOG_PID,LOG_DAEMON);
 
+  //
+  // Connection Mappers
+  //
+  proto_ready_mapper=new QSignalMapper(this);
+  connect(proto_ready_mapper,SIGNAL(mapped(int)),
+	  this,SLOT(readyReadData(int)));
+  proto_disconnected_mapper=new QSignalMapper(this);
+  connect(proto_disconnected_mapper,SIGNAL(mapped(int)),
+	  this,SLOT(disconnectedData(int)));
+
   //
   // The ProtocolSa Server
   //
@@ -68,6 +74,20 @@ ProtocolSa::ProtocolSa(int sock,QObject *parent)
 
   LoadMaps();
   LoadHelp();
+  proto_routes=new RouteTable(proto_maps);
+  proto_resolver=new HostResolver(config()->hostnameCacheTimeout(),this);
+
+  //
+  // In single process mode, one IPC link serves every connection
+  //
+  if(proto_single_process) {
+    if(!startIpc(&err_msg)) {
+      syslog(LOG_ERR,"%s, aborting",err_msg.toUtf8().constData());
+      exit(1);
+    }
+    LoadRoutes();
+    syslog(LOG_DEBUG,"serving all connections from a single process");
+  }
 }
 
 
@@ -75,21 +95,27 @@ void ProtocolSa::newConnectionData()
 {
   int flags;
   QString err_msg;
+  QTcpSocket *socket=NULL;
 
   //
   // Process Server Connection
   //
-  proto_socket=proto_server->nextPendingConnection();
-  if((flags=fcntl(proto_socket->socketDescriptor(),F_GETFD,NULL))<0) {
+  socket=proto_server->nextPendingConnection();
+  if((flags=fcntl(socket->socketDescriptor(),F_GETFD,NULL))<0) {
     syslog(LOG_ERR,"socket error [%s], aborting",strerror(errno));
     exit(1);
   }
   flags=flags|FD_CLOEXEC;
-  if((flags=fcntl(proto_socket->socketDescriptor(),F_SETFD,&flags))<0) {
+  if((flags=fcntl(socket->socketDescriptor(),F_SETFD,&flags))<0) {
     syslog(LOG_ERR,"socket error [%s], aborting",strerror(errno));
     exit(1);
   }
-  
+
+  if(proto_single_process) {
+    AddConnection(socket);
+    return;
+  }
+
   if(fork()==0) {
     proto_server->close();
     proto_server=NULL;
@@ -98,155 +124,195 @@ void ProtocolSa::newConnectionData()
     // Start IPC
     //
     if(!startIpc(&err_msg)) {
-      proto_socket->
+      socket->
 	write(("unable to bind to drouter service ["+err_msg+"]").toUtf8());
       quit();
     }
+    LoadRoutes();
 
     //
     // Initialize Connection
     //
-    connect(proto_socket,SIGNAL(readyRead()),this,SLOT(readyReadData()));
-    connect(proto_socket,SIGNAL(disconnected()),this,SLOT(disconnectedData()));
+    AddConnection(socket);
   }
   else {
-    proto_socket->close();
-    delete proto_socket;
-    proto_socket=NULL;
+    socket->close();
+    delete socket;
   }
 }
 
 
-void ProtocolSa::readyReadData()
+void ProtocolSa::readyReadData(int sock)
 {
   char data[1501];
   int n;
+  QTcpSocket *socket=proto_sockets.value(sock);
 
-  while((n=proto_socket->read(data,1500))>0) {
+  if(socket==NULL) {
+    return;
+  }
+  while((n=socket->read(data,1500))>0) {
     for(int i=0;i<n;i++) {
       switch(0xFF&data[i]) {
       case 10:
 	break;
 
       case 13:
-	ProcessCommand(proto_accum);
-	proto_accum="";
+	ProcessCommand(sock,proto_accums.value(sock));
+	if(!proto_sockets.contains(sock)) {
+	  return;
+	}
+	proto_accums[sock]="";
 	break;
 
       default:
-	proto_accum+=0xFF&data[i];
+	proto_accums[sock]+=0xFF&data[i];
       }
     }
   }
 }
 
 
-void ProtocolSa::disconnectedData()
+void ProtocolSa::disconnectedData(int sock)
 {
-  quit();
+  CloseConnection(sock);
 }
 
 
-void ProtocolSa::snapshotHostLookupFinishedData(const QHostInfo &info)
+void ProtocolSa::overflowedData(int sock)
 {
-  QString sql=QString("update `PERM_SA_EVENTS` set ")+
-    "`HOSTNAME`='"+SqlQuery::escape(info.hostName())+"',"+
-    "`STATUS`='Y' where "+
-    QString::asprintf("`ID`=%d",proto_event_lookups.value(info.lookupId()));
-  SqlQuery::apply(sql);
+  CloseConnection(sock);
 }
 
 
-void ProtocolSa::routeHostLookupFinishedData(const QHostInfo &info)
+void ProtocolSa::nodeAdded(const ProtoIpcMessage::Node &node,
+			   const QList<ProtoIpcMessage::Source> &srcs,
+			   const QList<ProtoIpcMessage::Destination> &dsts,
+			   const QList<ProtoIpcMessage::Gpi> &gpis,
+			   const QList<ProtoIpcMessage::Gpo> &gpos)
 {
-  QString sql=QString("update `PERM_SA_EVENTS` set ")+
-    "`HOSTNAME`='"+SqlQuery::escape(info.hostName())+"' where "+
-    QString::asprintf("`ID`=%d",proto_event_lookups.value(info.lookupId()));
-  SqlQuery::apply(sql);
+  QList<RouteTable::Change> changes;
+
+  for(int i=0;i<srcs.size();i++) {
+    changes+=proto_routes->updateSource(srcs.at(i).host_address,
+					srcs.at(i).slot,
+					srcs.at(i).stream_address);
+  }
+  for(int i=0;i<dsts.size();i++) {
+    changes+=proto_routes->updateDestination(dsts.at(i).host_address,
+					     dsts.at(i).slot,
+					     dsts.at(i).stream_address);
+  }
+  for(int i=0;i<gpos.size();i++) {
+    changes+=proto_routes->updateGpo(gpos.at(i).host_address,
+				     gpos.at(i).slot,
+				     gpos.at(i).source_address,
+				     gpos.at(i).source_slot);
+  }
+  BroadcastRoutes(changes);
 }
 
 
-void ProtocolSa::destinationCrosspointChanged(const QHostAddress &host_addr,int slotnum)
+void ProtocolSa::nodeRemoved(const ProtoIpcMessage::Node &node)
 {
-  QString sql;
-  SqlQuery *q;
- 
-  if(!proto_routestat_masked) {
-    sql=RouteStatSqlFields(EndPointMap::AudioRouter)+
-      " `SA_DESTINATIONS`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      QString::asprintf("`SA_DESTINATIONS`.`SLOT`=%d ",slotnum)+
-      "order by `SA_DESTINATIONS`.`SOURCE_NUMBER`,`SA_DESTINATIONS`.`ROUTER_NUMBER`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(RouteStatMessage(q).toUtf8());
-      proto_socket->write(">>",2);
-    }
-    delete q;
-  }
+  BroadcastRoutes(proto_routes->removeNode(node));
 }
 
 
-void ProtocolSa::gpiCodeChanged(const QHostAddress &host_addr,int slotnum)
+void ProtocolSa::sourceChanged(const ProtoIpcMessage::Source &src)
 {
-  QString sql;
-  SqlQuery *q;
+  BroadcastRoutes(proto_routes->updateSource(src.host_address,src.slot,
+					     src.stream_address));
+}
 
-  if(!proto_gpistat_masked) {
-    sql=GPIStatSqlFields()+" where "+
-      "`GPIS`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      QString::asprintf("`GPIS`.`SLOT`=%d",slotnum);
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(GPIStatMessage(q).toUtf8());
-      proto_socket->write(">>",2);
+
+void ProtocolSa::destinationChanged(const ProtoIpcMessage::Destination &dst)
+{
+  BroadcastRoutes(proto_routes->updateDestination(dst.host_address,dst.slot,
+						  dst.stream_address));
+}
+
+
+void ProtocolSa::gpiCodeChanged(const ProtoIpcMessage::Gpi &gpi)
+{
+  EndPointMap *map;
+  int input;
+
+  if(IsUnmasked(GpiStatMask)) {
+    for(QMap<int,EndPointMap *>::const_iterator it=proto_maps.constBegin();
+	it!=proto_maps.constEnd();it++) {
+      map=it.value();
+      if(map->routerType()==EndPointMap::GpioRouter) {
+	input=map->endPoint(EndPointMap::Input,gpi.host_address,gpi.slot);
+	if(input>=0) {
+	  Broadcast(GpiStatMask,QString::asprintf("GPIStat %d %d",
+						  map->routerNumber(),
+						  input).toUtf8(),
+		    (QString::asprintf("GPIStat %d %d ",
+				       map->routerNumber()+1,input+1)+
+		     gpi.code+"\r\n>>").toUtf8());
+	}
+      }
     }
-    delete q;
   }
 }
 
 
-void ProtocolSa::gpoCodeChanged(const QHostAddress &host_addr,int slotnum)
+void ProtocolSa::gpoCodeChanged(const ProtoIpcMessage::Gpo &gpo)
 {
-  QString sql;
-  SqlQuery *q;
-
-  if(!proto_gpostat_masked) {
-    sql=GPOStatSqlFields()+" where "+
-      "`GPOS`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      QString::asprintf("`GPOS`.`SLOT`=%d",slotnum);
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(GPOStatMessage(q).toUtf8());
-      proto_socket->write(">>",2);
+  EndPointMap *map;
+  int output;
+
+  if(IsUnmasked(GpoStatMask)) {
+    for(QMap<int,EndPointMap *>::const_iterator it=proto_maps.constBegin();
+	it!=proto_maps.constEnd();it++) {
+      map=it.value();
+      if(map->routerType()==EndPointMap::GpioRouter) {
+	output=map->endPoint(EndPointMap::Output,gpo.host_address,gpo.slot);
+	if(output>=0) {
+	  Broadcast(GpoStatMask,QString::asprintf("GPOStat %d %d",
+						  map->routerNumber(),
+						  output).toUtf8(),
+		    (QString::asprintf("GPOStat %d %d ",
+				       map->routerNumber()+1,output+1)+
+		     gpo.code+"\r\n>>").toUtf8());
+	}
+      }
     }
-    delete q;
   }
 }
 
 
-void ProtocolSa::gpoCrosspointChanged(const QHostAddress &host_addr,int slotnum)
+void ProtocolSa::gpoChanged(const ProtoIpcMessage::Gpo &gpo)
 {
-  QString sql;
-  SqlQuery *q;
+  BroadcastRoutes(proto_routes->updateGpo(gpo.host_address,gpo.slot,
+					  gpo.source_address,
+					  gpo.source_slot));
+}
 
-  if(!proto_routestat_masked) {
-    sql=RouteStatSqlFields(EndPointMap::GpioRouter)+
-      " `SA_GPOS`.`HOST_ADDRESS`='"+host_addr.toString()+"' && "+
-      QString::asprintf("`SA_GPOS`.`SLOT`=%d ",slotnum)+
-      "order by `SA_GPOS`.`SOURCE_NUMBER`,`SA_GPOS`.`ROUTER_NUMBER`";
-    q=new SqlQuery(sql);
-    while(q->next()) {
-      proto_socket->write(RouteStatMessage(q).toUtf8());
-      proto_socket->write(">>",2);
-    }
-    delete q;
+
+void ProtocolSa::routeConfirmed(int event_id,int router,int output,int input,
+				bool status,int msecs)
+{
+  QTcpSocket *socket=NULL;
+
+  if(!proto_confirm_events.contains(event_id)) {
+    return;
+  }
+  if((socket=proto_sockets.value(proto_confirm_events.take(event_id)))!=NULL) {
+    socket->write(QString::asprintf("RouteConfirm %d %d %d %s %d\r\n>>",
+				    router+1,output+1,input+1,
+				    status ? "True" : "False",msecs).toUtf8());
   }
 }
 
 
 void ProtocolSa::quitting()
 {
-  shutdown(proto_socket->socketDescriptor(),SHUT_RDWR);
+  for(QMap<int,QTcpSocket *>::const_iterator it=proto_sockets.constBegin();
+      it!=proto_sockets.constEnd();it++) {
+    shutdown(it.key(),SHUT_RDWR);
+  }
 }
 
 
@@ -259,14 +325,17 @@ void ProtocolSa::ActivateRoute(unsigned router,unsigned output,unsigned input)
     QHostAddress dst_addr=map->hostAddress(EndPointMap::Output,output);
     int dst_slotnum=map->slot(EndPointMap::Output,output);
     if(!dst_addr.isNull()&&(dst_slotnum>=0)) {
+      Protocol::Crosspoint xpt;
+      xpt.dst_host_address=dst_addr;
+      xpt.dst_slot=dst_slotnum;
       if(input==0) {
 	switch(map->routerType()) {
 	case EndPointMap::AudioRouter:
-	  clearCrosspoint(dst_addr,dst_slotnum);
+	  TakeCrosspoint(xpt,false);
 	  break;
 
 	case EndPointMap::GpioRouter:
-	  clearGpioCrosspoint(dst_addr,dst_slotnum);
+	  TakeCrosspoint(xpt,true);
 	  break;
 
 	case EndPointMap::LastRouter:
@@ -277,16 +346,18 @@ void ProtocolSa::ActivateRoute(unsigned router,unsigned output,unsigned input)
 	QHostAddress src_addr=map->hostAddress(EndPointMap::Input,input-1);
 	int src_slotnum=map->slot(EndPointMap::Input,input-1);
 	if(!src_addr.isNull()&&(src_slotnum>=0)) {
+	  xpt.src_host_address=src_addr;
+	  xpt.src_slot=src_slotnum;
 	  switch(map->routerType()) {
 	  case EndPointMap::AudioRouter:
-	    setCrosspoint(dst_addr,dst_slotnum,src_addr,src_slotnum);
+	    TakeCrosspoint(xpt,false);
 	    syslog(LOG_INFO,"activated audio route router: %d  input: %d to output: %d from %s",
 		   router+1,output+1,input,
 		   proto_socket->peerAddress().toString().toUtf8().constData());
 	    break;
 	  
 	  case EndPointMap::GpioRouter:
-	    setGpioCrosspoint(dst_addr,dst_slotnum,src_addr,src_slotnum);
+	    TakeCrosspoint(xpt,true);
 	    syslog(LOG_INFO,"activated gpio route router: %d  input: %d to output: %d from %s",
 		   router+1,output+1,input,
 		   proto_socket->peerAddress().toString().toUtf8().constData());
@@ -302,6 +373,57 @@ void ProtocolSa::ActivateRoute(unsigned router,unsigned output,unsigned input)
 }
 
 
+void ProtocolSa::ActivateRoutes(unsigned router,
+				const QMap<unsigned,unsigned> &routes)
+{
+  //
+  // Audio routes are sent to the core as a single salvo; GPIO routes
+  // still go one at a time. Either way, nothing is sent until the event
+  // records have been committed.
+  //
+  EndPointMap *map;
+  QList<Protocol::Crosspoint> xpoints;
+
+  if((map=proto_maps.value(router))==NULL) {
+    return;
+  }
+  BeginEventBatch();
+  if(map->routerType()!=EndPointMap::AudioRouter) {
+    for(QMap<unsigned,unsigned>::const_iterator it=routes.constBegin();
+	it!=routes.constEnd();it++) {
+      ActivateRoute(router,it.key(),it.value());
+    }
+    CommitEventBatch();
+    return;
+  }
+  for(QMap<unsigned,unsigned>::const_iterator it=routes.constBegin();
+      it!=routes.constEnd();it++) {
+    unsigned output=it.key();
+    unsigned input=it.value();
+    Protocol::Crosspoint xpt;
+    AddRouteEvent(router,output,input-1);
+    xpt.dst_host_address=map->hostAddress(EndPointMap::Output,output);
+    xpt.dst_slot=map->slot(EndPointMap::Output,output);
+    if(xpt.dst_host_address.isNull()||(xpt.dst_slot<0)) {
+      continue;
+    }
+    if(input>0) {
+      xpt.src_host_address=map->hostAddress(EndPointMap::Input,input-1);
+      xpt.src_slot=map->slot(EndPointMap::Input,input-1);
+      if(xpt.src_host_address.isNull()||(xpt.src_slot<0)) {
+	continue;
+      }
+    }
+    xpoints.push_back(xpt);
+  }
+  proto_batch_xpoints+=xpoints;
+  CommitEventBatch();
+  syslog(LOG_INFO,"activated %d audio routes on router: %d from %s",
+	 xpoints.size(),router+1,
+	 proto_socket->peerAddress().toString().toUtf8().constData());
+}
+
+
 void ProtocolSa::TriggerGpi(unsigned router,unsigned input,unsigned msecs,const QString &code)
 {
   EndPointMap *map;
@@ -403,10 +525,14 @@ void ProtocolSa::ActivateSnapshot(unsigned router,const QString &snapshot_name)
   }
   proto_socket->write(QString("Snapshot Initiated\r\n").toUtf8());
   if((ss=map->snapshot(snapshot_name))!=NULL) {
+    BeginEventBatch();
     AddSnapEvent(router,snapshot_name);
+    QMap<unsigned,unsigned> routes;
     for(int i=0;i<ss->routeQuantity();i++) {
-      ActivateRoute(router,ss->routeOutput(i)-1,ss->routeInput(i));
+      routes[ss->routeOutput(i)-1]=ss->routeInput(i);
     }
+    ActivateRoutes(router,routes);
+    CommitEventBatch();
   }
   syslog(LOG_INFO,"activated snapshot %d:%s from %s",router+1,
 	 snapshot_name.toUtf8().constData(),
@@ -426,15 +552,15 @@ void ProtocolSa::SendSourceInfo(unsigned router)
   }
   if(map->routerType()==EndPointMap::AudioRouter) {
     sql=SourceNamesSqlFields(map->routerType())+"where "+
-      QString::asprintf("`SA_SOURCES`.`ROUTER_NUMBER`=%u ",router)+
+      "`SA_SOURCES`.`ROUTER_NUMBER`=? "+
       "order by `SA_SOURCES`.`SOURCE_NUMBER`";
   }
   else {
     sql=SourceNamesSqlFields(map->routerType())+"where "+
-      QString::asprintf("`SA_GPIS`.`ROUTER_NUMBER`=%u ",router)+
+      "`SA_GPIS`.`ROUTER_NUMBER`=? "+
       "order by `SA_GPIS`.`SOURCE_NUMBER`";
   }
-  q=new SqlQuery(sql);
+  q=new SqlQuery(sql,QVariantList()<<router);
   proto_socket->write(QString::asprintf("Begin SourceNames - %d\r\n",router+1).toUtf8());
   while(q->next()) {
     proto_socket->write(SourceNamesMessage(map->routerType(),q).toUtf8());
@@ -515,15 +641,15 @@ void ProtocolSa::SendDestInfo(unsigned router)
   proto_socket->write(">>",2);
   if(map->routerType()==EndPointMap::AudioRouter) {
     sql=DestNamesSqlFields(map->routerType())+"where "+
-      QString::asprintf("`SA_DESTINATIONS`.`ROUTER_NUMBER`=%u ",router)+
+      "`SA_DESTINATIONS`.`ROUTER_NUMBER`=? "+
       "order by `SA_DESTINATIONS`.`SOURCE_NUMBER`";
   }
   else {
     sql=DestNamesSqlFields(map->routerType())+"where "+
-      QString::asprintf("`SA_GPOS`.`ROUTER_NUMBER`=%u ",router)+
+      "`SA_GPOS`.`ROUTER_NUMBER`=? "+
       "order by `SA_GPOS`.`SOURCE_NUMBER`";
   }
-  q=new SqlQuery(sql);
+  q=new SqlQuery(sql,QVariantList()<<router);
   proto_socket->write(QString::asprintf("Begin DestNames - %d\r\n",router+1).toUtf8());
   while(q->next()) {
     proto_socket->write(DestNamesMessage(map->routerType(),q).toUtf8());
@@ -576,6 +702,7 @@ void ProtocolSa::SendGpiInfo(unsigned router,int input)
 {
   EndPointMap *map;
   QString sql;
+  QVariantList values;
   SqlQuery *q;
 
   if((map=proto_maps.value(router))==NULL) {
@@ -587,18 +714,20 @@ void ProtocolSa::SendGpiInfo(unsigned router,int input)
     proto_socket->write(QString("Error - Router is not a GPIO Router.\r\n").toUtf8());
     return;
   }
+  values.push_back(router);
   if(input<0) {
     sql=GPIStatSqlFields()+"where "+
-      QString::asprintf("`SA_GPIS`.`ROUTER_NUMBER`=%u ",router)+
+      "`SA_GPIS`.`ROUTER_NUMBER`=? "+
       "order by `SA_GPIS`.`SOURCE_NUMBER`";
   }
   else {
     sql=GPIStatSqlFields()+"where "+
-      QString::asprintf("`SA_GPIS`.`ROUTER_NUMBER`=%u && ",router)+
-      QString::asprintf("`SA_GPIS`.`SOURCE_NUMBER`=%u ",input)+
+      "`SA_GPIS`.`ROUTER_NUMBER`=? && "+
+      "`SA_GPIS`.`SOURCE_NUMBER`=? "+
       "order by `SA_GPIS`.`SOURCE_NUMBER`";
+    values.push_back(input);
   }
-  q=new SqlQuery(sql);
+  q=new SqlQuery(sql,values);
   while(q->next()) {
     proto_socket->write(GPIStatMessage(q).toUtf8());
   }
@@ -627,6 +756,7 @@ void ProtocolSa::SendGpoInfo(unsigned router,int output)
 {
   EndPointMap *map;
   QString sql;
+  QVariantList values;
   SqlQuery *q;
 
   if((map=proto_maps.value(router))==NULL) {
@@ -638,18 +768,20 @@ void ProtocolSa::SendGpoInfo(unsigned router,int output)
     return;
   }
   proto_socket->write(">>",2);
+  values.push_back(router);
   if(output<0) {
     sql=GPOStatSqlFields()+"where "+
-      QString::asprintf("`SA_GPOS`.`ROUTER_NUMBER`=%u ",router)+
+      "`SA_GPOS`.`ROUTER_NUMBER`=? "+
       "order by `SA_GPOS`.`SOURCE_NUMBER`";
   }
   else {
     sql=GPOStatSqlFields()+"where "+
-      QString::asprintf("`SA_GPOS`.`ROUTER_NUMBER`=%u && ",router)+
-      QString::asprintf("`SA_GPOS`.`SOURCE_NUMBER`=%u ",output)+
+      "`SA_GPOS`.`ROUTER_NUMBER`=? && "+
+      "`SA_GPOS`.`SOURCE_NUMBER`=? "+
       "order by `SA_GPOS`.`SOURCE_NUMBER`";
+    values.push_back(output);
   }
-  q=new SqlQuery(sql);
+  q=new SqlQuery(sql,values);
   while(q->next()) {
     proto_socket->write(GPOStatMessage(q).toUtf8());
   }
@@ -676,128 +808,108 @@ QString ProtocolSa::GPOStatMessage(SqlQuery *q)
 
 void ProtocolSa::SendRouteInfo(unsigned router,int output)
 {
-  EndPointMap *map;
-  QString sql;
-  SqlQuery *q;
+  QByteArray data;
 
-  if((map=proto_maps.value(router))==NULL) {
+  if(!proto_maps.contains(router)) {
     proto_socket->write(QString("Error - Bay Does Not exist.\r\n").toUtf8());
     return;
   }
-  sql=RouteStatSqlFields(map->routerType());
-  if(map->routerType()==EndPointMap::AudioRouter) {
-    sql+=QString::asprintf("`SA_DESTINATIONS`.`ROUTER_NUMBER`=%d ",router);
-    if(output>=0) {
-      sql+=QString::asprintf("&& `SA_DESTINATIONS`.`SOURCE_NUMBER`=%d ",output);
-    }
-    sql+="&& `SA_SOURCES`.`STREAM_ADDRESS`!='"+DROUTER_NULL_STREAM_ADDRESS+"' ";
-    sql+="&& `SA_SOURCES`.`STREAM_ADDRESS`!='0.0.0.0' ";
-    sql+="&& `SA_SOURCES`.`STREAM_ADDRESS`!='255.255.255.255' ";
-    sql+="&& `SA_SOURCES`.`STREAM_ADDRESS`!='' ";
-    sql+="&& `SA_SOURCES`.`STREAM_ADDRESS` is not null ";
-    sql+="order by `SA_DESTINATIONS`.`SOURCE_NUMBER`";
-  }
-  else {
-    sql+=QString::asprintf("`SA_GPOS`.`ROUTER_NUMBER`=%d ",router);
-    if(output>=0) {
-      sql+=QString::asprintf("&& `SA_GPOS`.`SOURCE_NUMBER`=%d ",output);
-    }
-    sql+="order by `SA_GPOS`.`SOURCE_NUMBER`";
-  }
-  q=new SqlQuery(sql);
-  q->first();
   if(output<0) {  // Send all crosspoints for the router
-    for(int i=0;i<map->quantity(EndPointMap::Output);i++) {
-      if(q->isValid()&&q->value(1).toInt()==i) {
-	proto_socket->write(RouteStatMessage(q).toUtf8());
-	q->next();
-      }
-      else {
-	proto_socket->write(QString::asprintf("RouteStat %d %d 0 False\r\n",
-					      router+1,i+1).toUtf8());
-      }
+    for(int i=0;i<proto_routes->outputQuantity(router);i++) {
+      data+=RouteStatMessage(router,i,proto_routes->input(router,i));
     }
   }
   else {  // Send just the requested crosspoint
-    if(output<map->quantity(EndPointMap::Output)) {
-      if(q->isValid()) {
-	proto_socket->write(RouteStatMessage(q).toUtf8());
-      }
-      else {
-	proto_socket->write(QString::asprintf("RouteStat %d %d 0 False\r\n",
-					      router+1,output+1).toUtf8());
-      }
+    if(output<proto_routes->outputQuantity(router)) {
+      data=RouteStatMessage(router,output,proto_routes->input(router,output));
     }
   }
-  delete q;
+  proto_socket->write(data);
 }
 
 
-QString ProtocolSa::RouteStatSqlFields(EndPointMap::RouterType type)
+QByteArray ProtocolSa::RouteStatMessage(int router,int output,int input)
 {
-  if(type==EndPointMap::AudioRouter) {
-    return QString("select ")+
-      "`SA_DESTINATIONS`.`ROUTER_NUMBER`,"+  // 00
-      "`SA_DESTINATIONS`.`SOURCE_NUMBER`,"+  // 01
-      "`SA_SOURCES`.`SOURCE_NUMBER` "+       // 02
-      "from `SA_DESTINATIONS` left join `SA_SOURCES` "+
-      "on `SA_DESTINATIONS`.`STREAM_ADDRESS`=`SA_SOURCES`.`STREAM_ADDRESS` && "+
-      "`SA_SOURCES`.`ROUTER_NUMBER`=`SA_DESTINATIONS`.`ROUTER_NUMBER` where ";
+  //
+  // Rendered again only when the crosspoint has changed
+  //
+  RouteStat &stat=proto_route_stats[((quint64)router<<32)|(quint32)output];
+
+  if(stat.data.isEmpty()||(stat.input!=input)) {
+    stat.input=input;
+    stat.data=QString::asprintf("RouteStat %d %d %d False\r\n",
+				router+1,output+1,input+1).toUtf8();
   }
-  else {
-    return QString("select ")+
-      "`SA_GPOS`.`ROUTER_NUMBER`,"+  // 00
-      "`SA_GPOS`.`SOURCE_NUMBER`,"+  // 01
-      "`SA_GPIS`.`SOURCE_NUMBER` "+  // 02
-      "from `SA_GPOS` left join `SA_GPIS` "+
-      "on `SA_GPOS`.`SOURCE_ADDRESS`=`SA_GPIS`.`HOST_ADDRESS` && "+
-      "`SA_GPOS`.`SOURCE_SLOT`=`SA_GPIS`.`SLOT` && "+
-      "`SA_GPIS`.`ROUTER_NUMBER`=`SA_GPOS`.`ROUTER_NUMBER` where ";
-  }
-  return QString();
+  return stat.data;
 }
 
 
-QString ProtocolSa::RouteStatMessage(SqlQuery *q)
+void ProtocolSa::BroadcastRoutes(const QList<RouteTable::Change> &changes)
 {
-  int input=q->value(2).toInt()+1;
-  if(q->value(2).isNull()) {
-    input=0;
-  }
-  return QString::asprintf("RouteStat %d %d %d False\r\n",
-			   q->value(0).toInt()+1,
-			   q->value(1).toInt()+1,
-			   input);
+  if(IsUnmasked(RouteStatMask)) {
+    for(int i=0;i<changes.size();i++) {
+      const RouteTable::Change &c=changes.at(i);
+      Broadcast(RouteStatMask,
+		QString::asprintf("RouteStat %d %d",c.router,c.output).toUtf8(),
+		RouteStatMessage(c.router,c.output,c.input)+">>");
+    }
+  }
 }
 
 
 void ProtocolSa::DrouterMaskGpiStat(bool state)
 {
-  proto_gpistat_masked=state;
+  if(state) {
+    proto_stat_masks[proto_current_sock]|=GpiStatMask;
+  }
+  else {
+    proto_stat_masks[proto_current_sock]&=~GpiStatMask;
+  }
 }
 
 
 void ProtocolSa::DrouterMaskGpoStat(bool state)
 {
-  proto_gpostat_masked=state;
+  if(state) {
+    proto_stat_masks[proto_current_sock]|=GpoStatMask;
+  }
+  else {
+    proto_stat_masks[proto_current_sock]&=~GpoStatMask;
+  }
 }
 
 
 void ProtocolSa::DrouterMaskRouteStat(bool state)
 {
-  proto_routestat_masked=state;
+  if(state) {
+    proto_stat_masks[proto_current_sock]|=RouteStatMask;
+  }
+  else {
+    proto_stat_masks[proto_current_sock]&=~RouteStatMask;
+  }
 }
 
 
 void ProtocolSa::DrouterMaskStat(bool state)
 {
-  proto_gpistat_masked=state;
-  proto_gpostat_masked=state;
-  proto_routestat_masked=state;
+  DrouterMaskGpiStat(state);
+  DrouterMaskGpoStat(state);
+  DrouterMaskRouteStat(state);
 }
 
 
-void ProtocolSa::ProcessCommand(const QString &cmd)
+void ProtocolSa::DrouterRouteConfirm(bool state)
+{
+  if(state) {
+    proto_route_confirms.insert(proto_current_sock);
+  }
+  else {
+    proto_route_confirms.remove(proto_current_sock);
+  }
+}
+
+
+void ProtocolSa::ProcessCommand(int sock,const QString &cmd)
 {
   unsigned cardnum=0;
   unsigned input=0;
@@ -806,15 +918,24 @@ void ProtocolSa::ProcessCommand(const QString &cmd)
   bool ok=false;
   QStringList cmds=cmd.split(" ");
 
+  proto_socket=proto_sockets.value(sock);
+  proto_current_sock=sock;
+
+  //
+  // Replies must not overtake updates still held for this client
+  //
+  proto_queues.value(sock)->flush();
+
   if((cmds[0].toLower()=="login")&&(cmds.size()>=2)) {
-    proto_username=cmds.at(1);
+    proto_usernames[sock]=cmds.at(1);
     proto_socket->write(QString("Login Successful\r\n").toUtf8());
     proto_socket->write(">>",2);
   }
 
   if((cmds[0].toLower()=="exit")||(cmds[0].toLower()=="quit")) {
     syslog(LOG_DEBUG,"exiting normally");
-    quit();
+    CloseConnection(sock);
+    return;
   }
 
   if((cmds[0].toLower()=="help")||(cmds[0]=="?")) {
@@ -934,6 +1055,33 @@ void ProtocolSa::ProcessCommand(const QString &cmd)
     proto_socket->write(">>",2);
   }
 
+  if(cmds[0].toLower()=="drouteractivateroutes") {
+    if((cmds.size()>=4)&&((cmds.size()%2)==0)) {
+      QMap<unsigned,unsigned> routes;
+      cardnum=cmds[1].toUInt(&ok);
+      for(int i=2;ok&&(i<cmds.size());i+=2) {
+	output=cmds[i].toUInt(&ok);
+	if(ok&&(output>0)) {
+	  input=cmds[i+1].toUInt(&ok);
+	  routes[output-1]=input;
+	}
+	else {
+	  ok=false;
+	}
+      }
+      if(ok&&(proto_maps.value(cardnum-1)!=NULL)) {
+	ActivateRoutes(cardnum-1,routes);
+      }
+      else {
+	proto_socket->write(QString("Error\r\n").toUtf8());
+      }
+    }
+    else {
+      proto_socket->write(QString("Error\r\n").toUtf8());
+    }
+    proto_socket->write(">>",2);
+  }
+
   if(cmds[0].toLower()=="routestat") {
     if((cmds.size()==2)||(cmds.size()==3)) {
       cardnum=cmds[1].toUInt(&ok);
@@ -1073,6 +1221,102 @@ void ProtocolSa::ProcessCommand(const QString &cmd)
     }
     proto_socket->write(">>",2);
   }
+
+  if((cmds[0].toLower()=="drouterrouteconfirm")&&(cmds.size()==2)) {
+    if((cmds.at(1).toLower()=="true")||(cmds.at(1).toLower()=="false")) {
+      DrouterRouteConfirm(cmds.at(1).toLower()=="true");
+    }
+    else {
+      proto_socket->
+	write(QString("Error - Invalid boolean value.\r\n").toUtf8());
+    }
+    proto_socket->write(">>",2);
+  }
+}
+
+
+void ProtocolSa::AddConnection(QTcpSocket *socket)
+{
+  int sock=socket->socketDescriptor();
+
+  proto_sockets[sock]=socket;
+  proto_accums[sock]="";
+  proto_usernames[sock]="";
+  proto_stat_masks[sock]=0;
+  proto_queues[sock]=
+    new ClientQueue(socket,sock,config()->clientQueueHighWater(),
+		    config()->clientQueueLowWater(),
+		    config()->slowClientTimeout(),this);
+  connect(proto_queues.value(sock),SIGNAL(overflowed(int)),
+	  this,SLOT(overflowedData(int)),Qt::QueuedConnection);
+  connect(socket,SIGNAL(readyRead()),proto_ready_mapper,SLOT(map()));
+  proto_ready_mapper->setMapping(socket,sock);
+  connect(socket,SIGNAL(disconnected()),proto_disconnected_mapper,SLOT(map()));
+  proto_disconnected_mapper->setMapping(socket,sock);
+  connect(socket,SIGNAL(disconnected()),socket,SLOT(deleteLater()));
+}
+
+
+void ProtocolSa::CloseConnection(int sock)
+{
+  QTcpSocket *socket=NULL;
+
+  if(!proto_single_process) {
+    quit();
+  }
+  if((socket=proto_sockets.take(sock))==NULL) {
+    return;
+  }
+  proto_accums.remove(sock);
+  proto_usernames.remove(sock);
+  proto_stat_masks.remove(sock);
+  proto_queues.take(sock)->deleteLater();
+  proto_route_confirms.remove(sock);
+  for(QMap<int,int>::iterator it=proto_confirm_events.begin();
+      it!=proto_confirm_events.end();) {
+    if(it.value()==sock) {
+      it=proto_confirm_events.erase(it);
+    }
+    else {
+      it++;
+    }
+  }
+  proto_ready_mapper->removeMappings(socket);
+  proto_disconnected_mapper->removeMappings(socket);
+  if(proto_socket==socket) {
+    proto_socket=NULL;
+    proto_current_sock=-1;
+  }
+  if(socket->state()==QAbstractSocket::UnconnectedState) {
+    socket->deleteLater();
+  }
+  else {
+    socket->disconnectFromHost();
+  }
+}
+
+
+bool ProtocolSa::IsUnmasked(StatMask mask) const
+{
+  for(QMap<int,unsigned>::const_iterator it=proto_stat_masks.constBegin();
+      it!=proto_stat_masks.constEnd();it++) {
+    if((it.value()&mask)==0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+void ProtocolSa::Broadcast(StatMask mask,const QByteArray &key,
+			   const QByteArray &data)
+{
+  for(QMap<int,unsigned>::const_iterator it=proto_stat_masks.constBegin();
+      it!=proto_stat_masks.constEnd();it++) {
+    if((it.value()&mask)==0) {
+      proto_queues.value(it.key())->update(key,data);
+    }
+  }
 }
 
 
@@ -1090,16 +1334,30 @@ void ProtocolSa::LoadMaps()
 }
 
 
+void ProtocolSa::LoadRoutes()
+{
+  //
+  // Changes arriving from here on are already queued on the IPC link,
+  // so nothing is lost between the initial load and the updates
+  //
+  if(!proto_routes->load(snapshot())) {
+    proto_routes->loadDb();
+  }
+}
+
+
 void ProtocolSa::LoadHelp()
 {
   proto_help_strings[""]=QString("ActivateRoute")+
     ", ActivateScene"+
     ", ActivateSnap"+
     ", DestNames"+
+    ", DrouterActivateRoutes"+
     ", DrouterMaskGPIStat"+
     ", DrouterMaskGPOStat"+
     ", DrouterMaskRouteStat"+
     ", DrouterMaskStat"+
+    ", DrouterRouteConfirm"+
     ", Exit"+
     ", GPIStat"+
     ", GPOStat"+
@@ -1117,9 +1375,11 @@ void ProtocolSa::LoadHelp()
   proto_help_strings["activatescene"]="ActivateScene <router> <snapshot>\r\n\r\nActivate the specified snapshot.";
   proto_help_strings["activatesnap"]="ActivateSnap <router> <snapshot>\r\n\r\nActivate the specified snapshot.";
   proto_help_strings["destnames"]="DestNames <router>\r\n\r\nReturn names of all outputs on the specified router.";
+  proto_help_strings["drouteractivateroutes"]="DrouterActivateRoutes <router> <output> <input> [<output> <input> ...]\r\n\r\nRoute each <input> to its <output> on <router> as a single salvo.";
   proto_help_strings["droutermaskgpistat"]="DrouterMaskGPIStat True | False\r\n\r\nSuppress generation of GPIStat update messages on this connection.";
   proto_help_strings["droutermaskgpostat"]="DrouterMaskGPOStat True | False\r\n\r\nSuppress generation of GPOStat update messages on this connection.";
   proto_help_strings["droutermaskroutestat"]="DrouterMaskRouteStat True | False\r\n\r\nSuppress generation of RouteStat update messages on this connection.";
+  proto_help_strings["drouterrouteconfirm"]="DrouterRouteConfirm True | False\r\n\r\nReport when each route taken on this connection has been confirmed\r\nby the node, as \"RouteConfirm <router> <output> <input> True|False <msecs>\".";
   proto_help_strings["droutermaskstat"]="DrouterMaskStat True | False\r\n\r\nSuppress generation of all state update messages on this connection.";
   proto_help_strings["droutermaskroutestat"]="DrouterMaskRouteStat True | False\r\n\r\nSuppress generation of RouteStat update messages on this connection.";
   proto_help_strings["exit"]="Exit\r\n\r\nClose TCP/IP connection.";
@@ -1141,20 +1401,49 @@ void ProtocolSa::AddRouteEvent(int router,int output,int input)
   QString sql=QString("insert into `PERM_SA_EVENTS` set ")+
     "`DATETIME`=now(),"+
     "`TYPE`='R',"+
-    "`ORIGINATING_ADDRESS`='"+proto_socket->peerAddress().toString()+"',"+
-    QString::asprintf("`ROUTER_NUMBER`=%d,",router)+
-    QString::asprintf("`DESTINATION_NUMBER`=%d,",output)+
-    QString::asprintf("`SOURCE_NUMBER`=%d,",input);
-  if(proto_username.isEmpty()) {
-    sql+="`USERNAME`=NULL";
+    "`ORIGINATING_ADDRESS`=?,"+
+    "`ROUTER_NUMBER`=?,"+
+    "`DESTINATION_NUMBER`=?,"+
+    "`SOURCE_NUMBER`=?,"+
+    "`USERNAME`=?,"+
+    "`HOSTNAME`=?";
+  QString username=proto_usernames.value(proto_current_sock);
+  QVariant user;  // NULL when not logged in
+  if(!username.isEmpty()) {
+    user=username;
+  }
+  QString hostname;
+  QVariant host;  // NULL until resolved
+  if(proto_resolver->hostName(proto_socket->peerAddress(),&hostname)) {
+    host=hostname;
+  }
+  int event_id=SqlQuery::run(sql,QVariantList()<<
+			     proto_socket->peerAddress().toString()<<router<<
+			     output<<input<<user<<host).toInt();
+  if(event_id<=0) {
+    return;
   }
-  else {
-    sql+="`USERNAME`='"+SqlQuery::escape(proto_username)+"'";
+  if(host.isNull()) {
+    proto_resolver->resolve(proto_socket->peerAddress(),event_id);
+  }
+
+  //
+  // The core confirms the take when the node reports the change. Within
+  // a batch, it is not told of the event until the event is committed.
+  //
+  if(proto_route_confirms.contains(proto_current_sock)) {
+    proto_confirm_events[event_id]=proto_current_sock;
+  }
+  if(proto_event_batch>0) {
+    BatchedRoute route;
+    route.event_id=event_id;
+    route.router=router;
+    route.output=output;
+    route.input=input;
+    proto_batch_routes.push_back(route);
+    return;
   }
-  proto_event_lookups
-    [QHostInfo::lookupHost(proto_socket->peerAddress().toString(),
-     this,SLOT(routeHostLookupFinishedData(const QHostInfo &)))]=
-    SqlQuery::run(sql).toInt();
+  confirmRoute(event_id,router,output,input);
 }
 
 
@@ -1164,19 +1453,130 @@ void ProtocolSa::AddSnapEvent(int router,const QString &name)
     "`DATETIME`=now(),"+
     "`STATUS`='Y',"+
     "`TYPE`='S',"+
-    "`ORIGINATING_ADDRESS`='"+proto_socket->peerAddress().toString()+"',"+
-    QString::asprintf("`ROUTER_NUMBER`=%d,",router)+
-    "`COMMENT`='"+tr("Executing snapshot")+" "+
-    SqlQuery::escape("<strong>"+name+"</strong>")+" - "+
-    tr("Router")+": "+QString::asprintf("<strong>%d</strong>",1+router)+"',";
-  if(proto_username.isEmpty()) {
-    sql+="`USERNAME`=NULL";
+    "`ORIGINATING_ADDRESS`=?,"+
+    "`ROUTER_NUMBER`=?,"+
+    "`COMMENT`=?,"+
+    "`USERNAME`=?,"+
+    "`HOSTNAME`=?";
+  QString comment=tr("Executing snapshot")+" "+
+    "<strong>"+name+"</strong>"+" - "+
+    tr("Router")+": "+QString::asprintf("<strong>%d</strong>",1+router);
+  QString username=proto_usernames.value(proto_current_sock);
+  QVariant user;  // NULL when not logged in
+  if(!username.isEmpty()) {
+    user=username;
+  }
+  QString hostname;
+  QVariant host;  // NULL until resolved
+  if(proto_resolver->hostName(proto_socket->peerAddress(),&hostname)) {
+    host=hostname;
+  }
+  int event_id=SqlQuery::run(sql,QVariantList()<<
+			     proto_socket->peerAddress().toString()<<router<<
+			     comment<<user<<host).toInt();
+  if((event_id>0)&&host.isNull()) {
+    proto_resolver->resolve(proto_socket->peerAddress(),event_id);
+  }
+}
+
+
+void ProtocolSa::BeginEventBatch()
+{
+  //
+  // Events logged until the matching CommitEventBatch() share a single
+  // transaction, so that a salvo costs one commit rather than one per
+  // route. Each insert still runs on its own, so event IDs stay exact.
+  //
+  if((proto_event_batch++)==0) {
+    proto_event_transaction=QSqlDatabase::database().transaction();
+  }
+}
+
+
+void ProtocolSa::CommitEventBatch()
+{
+  if((proto_event_batch<=0)||((--proto_event_batch)>0)) {
+    return;
+  }
+  bool ok=true;
+  if(proto_event_transaction) {
+    QSqlDatabase db=QSqlDatabase::database();
+    if(!db.commit()) {
+      syslog(LOG_WARNING,"unable to commit event records [%s]",
+	     db.lastError().text().toUtf8().constData());
+      db.rollback();
+      ok=false;
+    }
+    proto_event_transaction=false;
+  }
+
+  //
+  // Only now can the core settle the events, so the confirmations and
+  // then the crosspoint changes they confirm go out here. If the events
+  // were rolled back, the routes are abandoned along with them.
+  //
+  QList<BatchedRoute> routes=proto_batch_routes;
+  QList<Protocol::Crosspoint> xpoints=proto_batch_xpoints;
+  QList<Protocol::Crosspoint> gpio_xpoints=proto_batch_gpio_xpoints;
+  proto_batch_routes.clear();
+  proto_batch_xpoints.clear();
+  proto_batch_gpio_xpoints.clear();
+  if(!ok) {
+    for(int i=0;i<routes.size();i++) {
+      const BatchedRoute &route=routes.at(i);
+      routeConfirmed(route.event_id,route.router,route.output,route.input,
+		     false,0);
+    }
+    syslog(LOG_WARNING,"discarded %d route(s) after event rollback",
+	   xpoints.size()+gpio_xpoints.size());
+    return;
+  }
+  for(int i=0;i<routes.size();i++) {
+    const BatchedRoute &route=routes.at(i);
+    confirmRoute(route.event_id,route.router,route.output,route.input);
+  }
+  setCrosspoints(xpoints);
+  for(int i=0;i<gpio_xpoints.size();i++) {
+    SendGpioCrosspoint(gpio_xpoints.at(i));
+  }
+}
+
+
+void ProtocolSa::TakeCrosspoint(const Protocol::Crosspoint &xpt,bool gpio)
+{
+  //
+  // A source slot of -1 clears the crosspoint
+  //
+  if(proto_event_batch>0) {
+    if(gpio) {
+      proto_batch_gpio_xpoints.push_back(xpt);
+    }
+    else {
+      proto_batch_xpoints.push_back(xpt);
+    }
+    return;
+  }
+  if(gpio) {
+    SendGpioCrosspoint(xpt);
+    return;
+  }
+  if(xpt.src_slot<0) {
+    clearCrosspoint(xpt.dst_host_address,xpt.dst_slot);
+  }
+  else {
+    setCrosspoint(xpt.dst_host_address,xpt.dst_slot,
+		  xpt.src_host_address,xpt.src_slot);
+  }
+}
+
+
+void ProtocolSa::SendGpioCrosspoint(const Protocol::Crosspoint &xpt)
+{
+  if(xpt.src_slot<0) {
+    clearGpioCrosspoint(xpt.dst_host_address,xpt.dst_slot);
   }
   else {
-    sql+="`USERNAME`='"+SqlQuery::escape(proto_username)+"'";
+    setGpioCrosspoint(xpt.dst_host_address,xpt.dst_slot,
+		      xpt.src_host_address,xpt.src_slot);
   }
-  proto_event_lookups
-    [QHostInfo::lookupHost(proto_socket->peerAddress().toString(),
-     this,SLOT(snapshotHostLookupFinishedData(const QHostInfo &)))]=
-    SqlQuery::run(sql).toInt();
 }
@@ -23,37 +23,63 @@
 
 #include <signal.h>
 
-#include <QHostInfo>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QSignalMapper>
 #include <QTcpServer>
 
 #include <sy5/sylwrp_client.h>
 
+#include "clientqueue.h"
 #include "endpointmap.h"
+#include "hostresolver.h"
 #include "protocol.h"
+#include "routetable.h"
 #include "sqlquery.h"
 
 class ProtocolSa : public Protocol
 {
  Q_OBJECT;
  public:
+  enum StatMask {GpiStatMask=0x01,GpoStatMask=0x02,RouteStatMask=0x04};
   ProtocolSa(int sock,QObject *parent=0);
 
  private slots:
   void newConnectionData();
-  void readyReadData();
-  void disconnectedData();
-  void snapshotHostLookupFinishedData(const QHostInfo &info);
-  void routeHostLookupFinishedData(const QHostInfo &info);
+  void readyReadData(int sock);
+  void disconnectedData(int sock);
+  void overflowedData(int sock);
 
  protected:
-  void destinationCrosspointChanged(const QHostAddress &host_addr,int slotnum);
-  void gpiCodeChanged(const QHostAddress &host_addr,int slotnum);
-  void gpoCodeChanged(const QHostAddress &host_addr,int slotnum);
-  void gpoCrosspointChanged(const QHostAddress &host_addr,int slotnum);
+  void nodeAdded(const ProtoIpcMessage::Node &node,
+		 const QList<ProtoIpcMessage::Source> &srcs,
+		 const QList<ProtoIpcMessage::Destination> &dsts,
+		 const QList<ProtoIpcMessage::Gpi> &gpis,
+		 const QList<ProtoIpcMessage::Gpo> &gpos);
+  void nodeRemoved(const ProtoIpcMessage::Node &node);
+  void sourceChanged(const ProtoIpcMessage::Source &src);
+  void destinationChanged(const ProtoIpcMessage::Destination &dst);
+  void gpiCodeChanged(const ProtoIpcMessage::Gpi &gpi);
+  void gpoChanged(const ProtoIpcMessage::Gpo &gpo);
+  void gpoCodeChanged(const ProtoIpcMessage::Gpo &gpo);
+  void routeConfirmed(int event_id,int router,int output,int input,
+		      bool status,int msecs);
   void quitting();
 
  private:
+  struct RouteStat {
+    int input;
+    QByteArray data;
+  };
+  struct BatchedRoute {
+    int event_id;
+    int router;
+    int output;
+    int input;
+  };
   void ActivateRoute(unsigned router,unsigned output,unsigned input);
+  void ActivateRoutes(unsigned router,const QMap<unsigned,unsigned> &routes);
   void TriggerGpi(unsigned router,unsigned input,unsigned msecs,const QString &code);
   void TriggerGpo(unsigned router,unsigned output,unsigned msecs,const QString &code);
   void SendSnapshotNames(unsigned router);
@@ -72,36 +98,50 @@ class ProtocolSa : public Protocol
   QString GPOStatSqlFields() const;
   QString GPOStatMessage(SqlQuery *q);
   void SendRouteInfo(unsigned router,int output);
-  QString RouteStatSqlFields(EndPointMap::RouterType type);
-  QString RouteStatMessage(SqlQuery *q);
+  QByteArray RouteStatMessage(int router,int output,int input);
+  void BroadcastRoutes(const QList<RouteTable::Change> &changes);
   void DrouterMaskGpiStat(bool state);
   void DrouterMaskGpoStat(bool state);
   void DrouterMaskRouteStat(bool state);
   void DrouterMaskStat(bool state);
-  void ProcessCommand(const QString &cmd);
+  void DrouterRouteConfirm(bool state);
+  void ProcessCommand(int sock,const QString &cmd);
+  void AddConnection(QTcpSocket *socket);
+  void CloseConnection(int sock);
+  bool IsUnmasked(StatMask mask) const;
+  void Broadcast(StatMask mask,const QByteArray &key,const QByteArray &data);
   void LoadMaps();
+  void LoadRoutes();
   void LoadHelp();
   void AddRouteEvent(int router,int output,int input);
   void AddSnapEvent(int router,const QString &name);
+  void BeginEventBatch();
+  void CommitEventBatch();
+  void TakeCrosspoint(const Protocol::Crosspoint &xpt,bool gpio);
+  void SendGpioCrosspoint(const Protocol::Crosspoint &xpt);
   QMap<QString,QString> proto_help_strings;
   QTcpSocket *proto_socket;
+  int proto_current_sock;
   QTcpServer *proto_server;
-  QString proto_accum;
+  QMap<int,QTcpSocket *> proto_sockets;
+  QMap<int,QString> proto_accums;
+  QMap<int,QString> proto_usernames;
+  QMap<int,unsigned> proto_stat_masks;
+  QMap<int,ClientQueue *> proto_queues;
+  QSet<int> proto_route_confirms;
+  QMap<int,int> proto_confirm_events;
+  QSignalMapper *proto_ready_mapper;
+  QSignalMapper *proto_disconnected_mapper;
+  bool proto_single_process;
   QMap<int,EndPointMap *> proto_maps;
-  QMap <int,int> proto_event_lookups;
-  QString proto_username;
-  QString proto_hostname;
-
-  bool proto_destinations_subscribed;
-  bool proto_gpis_subscribed;
-  bool proto_gpos_subscribed;
-  bool proto_nodes_subscribed;
-  bool proto_sources_subscribed;
-  bool proto_clips_subscribed;
-  bool proto_silences_subscribed;
-  bool proto_gpistat_masked;
-  bool proto_gpostat_masked;
-  bool proto_routestat_masked;
+  RouteTable *proto_routes;
+  QHash<quint64,RouteStat> proto_route_stats;
+  HostResolver *proto_resolver;
+  int proto_event_batch;
+  bool proto_event_transaction;
+  QList<BatchedRoute> proto_batch_routes;
+  QList<Protocol::Crosspoint> proto_batch_xpoints;
+  QList<Protocol::Crosspoint> proto_batch_gpio_xpoints;
 };
 
 
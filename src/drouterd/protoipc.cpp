@@ -0,0 +1,527 @@
+// protoipc.cpp
+//
+// Common data structures for DRouter protocol IPC
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include "protoipc.h"
+
+ProtoIpcMessage::Node::Node()
+{
+  matrix_type=0;
+  sources=0;
+  destinations=0;
+  gpis=0;
+  gpos=0;
+}
+
+
+ProtoIpcMessage::Source::Source()
+{
+  slot=-1;
+  matrix_type=0;
+  enabled=false;
+  channels=0;
+  block_size=0;
+}
+
+
+ProtoIpcMessage::Destination::Destination()
+{
+  slot=-1;
+  matrix_type=0;
+  channels=0;
+}
+
+
+ProtoIpcMessage::Gpi::Gpi()
+{
+  slot=-1;
+  matrix_type=0;
+}
+
+
+ProtoIpcMessage::Gpo::Gpo()
+{
+  slot=-1;
+  matrix_type=0;
+  source_slot=-1;
+}
+
+
+ProtoIpcMessage::Alarm::Alarm()
+{
+  slot=-1;
+  meter_type=0;
+  chan=0;
+  state=false;
+}
+
+
+ProtoIpcMessage::ProtoIpcMessage(Type type)
+{
+  msg_type=type;
+  msg_sequence=0;
+  msg_pos=0;
+}
+
+
+ProtoIpcMessage::Type ProtoIpcMessage::type() const
+{
+  return msg_type;
+}
+
+
+quint64 ProtoIpcMessage::sequence() const
+{
+  return msg_sequence;
+}
+
+
+void ProtoIpcMessage::setSequence(quint64 seq)
+{
+  msg_sequence=seq;
+}
+
+
+void ProtoIpcMessage::writeBool(bool state)
+{
+  msg_payload.append((char)state);
+}
+
+
+void ProtoIpcMessage::writeInt(int32_t val)
+{
+  msg_payload.append(0xFF&(val>>24));
+  msg_payload.append(0xFF&(val>>16));
+  msg_payload.append(0xFF&(val>>8));
+  msg_payload.append(0xFF&val);
+}
+
+
+void ProtoIpcMessage::writeString(const QString &str)
+{
+  QByteArray data=str.toUtf8().left(0xFFFF);
+
+  msg_payload.append(0xFF&(data.size()>>8));
+  msg_payload.append(0xFF&data.size());
+  msg_payload.append(data);
+}
+
+
+void ProtoIpcMessage::writeAddress(const QHostAddress &addr)
+{
+  writeBool(addr.isNull());
+  writeInt(addr.toIPv4Address());
+}
+
+
+void ProtoIpcMessage::writeNode(const Node &node)
+{
+  writeAddress(node.host_address);
+  writeString(node.host_name);
+  writeString(node.device_name);
+  writeInt(node.matrix_type);
+  writeInt(node.sources);
+  writeInt(node.destinations);
+  writeInt(node.gpis);
+  writeInt(node.gpos);
+}
+
+
+void ProtoIpcMessage::writeSource(const Source &src)
+{
+  writeAddress(src.host_address);
+  writeInt(src.slot);
+  writeInt(src.matrix_type);
+  writeString(src.host_name);
+  writeAddress(src.stream_address);
+  writeString(src.name);
+  writeBool(src.enabled);
+  writeInt(src.channels);
+  writeInt(src.block_size);
+}
+
+
+void ProtoIpcMessage::writeDestination(const Destination &dst)
+{
+  writeAddress(dst.host_address);
+  writeInt(dst.slot);
+  writeInt(dst.matrix_type);
+  writeString(dst.host_name);
+  writeAddress(dst.stream_address);
+  writeString(dst.name);
+  writeInt(dst.channels);
+}
+
+
+void ProtoIpcMessage::writeGpi(const Gpi &gpi)
+{
+  writeAddress(gpi.host_address);
+  writeInt(gpi.slot);
+  writeInt(gpi.matrix_type);
+  writeString(gpi.host_name);
+  writeString(gpi.code);
+}
+
+
+void ProtoIpcMessage::writeGpo(const Gpo &gpo)
+{
+  writeAddress(gpo.host_address);
+  writeInt(gpo.slot);
+  writeInt(gpo.matrix_type);
+  writeString(gpo.host_name);
+  writeString(gpo.code);
+  writeString(gpo.name);
+  writeAddress(gpo.source_address);
+  writeInt(gpo.source_slot);
+}
+
+
+void ProtoIpcMessage::writeAlarm(const Alarm &alarm)
+{
+  writeAddress(alarm.host_address);
+  writeInt(alarm.slot);
+  writeInt(alarm.meter_type);
+  writeInt(alarm.chan);
+  writeBool(alarm.state);
+}
+
+
+bool ProtoIpcMessage::readBool(bool *state)
+{
+  if((msg_pos+1)>msg_payload.size()) {
+    return false;
+  }
+  *state=msg_payload.at(msg_pos++)!=0;
+
+  return true;
+}
+
+
+bool ProtoIpcMessage::readInt(int32_t *val)
+{
+  if((msg_pos+4)>msg_payload.size()) {
+    return false;
+  }
+  const unsigned char *data=
+    (const unsigned char *)msg_payload.constData()+msg_pos;
+  *val=(int32_t)(((uint32_t)data[0]<<24)|((uint32_t)data[1]<<16)|
+		 ((uint32_t)data[2]<<8)|(uint32_t)data[3]);
+  msg_pos+=4;
+
+  return true;
+}
+
+
+bool ProtoIpcMessage::readString(QString *str)
+{
+  if((msg_pos+2)>msg_payload.size()) {
+    return false;
+  }
+  const unsigned char *data=
+    (const unsigned char *)msg_payload.constData()+msg_pos;
+  int len=(data[0]<<8)|data[1];
+  if((msg_pos+2+len)>msg_payload.size()) {
+    return false;
+  }
+  *str=QString::fromUtf8(msg_payload.constData()+msg_pos+2,len);
+  msg_pos+=2+len;
+
+  return true;
+}
+
+
+bool ProtoIpcMessage::readAddress(QHostAddress *addr)
+{
+  bool is_null=false;
+  int32_t val=0;
+
+  if(!(readBool(&is_null)&&readInt(&val))) {
+    return false;
+  }
+  if(is_null) {
+    *addr=QHostAddress();
+  }
+  else {
+    addr->setAddress((quint32)val);
+  }
+
+  return true;
+}
+
+
+bool ProtoIpcMessage::readNode(Node *node)
+{
+  int32_t matrix_type=0;
+  int32_t srcs=0;
+  int32_t dsts=0;
+  int32_t gpis=0;
+  int32_t gpos=0;
+
+  if(!(readAddress(&node->host_address)&&
+       readString(&node->host_name)&&
+       readString(&node->device_name)&&
+       readInt(&matrix_type)&&
+       readInt(&srcs)&&
+       readInt(&dsts)&&
+       readInt(&gpis)&&
+       readInt(&gpos))) {
+    return false;
+  }
+  node->matrix_type=matrix_type;
+  node->sources=srcs;
+  node->destinations=dsts;
+  node->gpis=gpis;
+  node->gpos=gpos;
+
+  return true;
+}
+
+
+bool ProtoIpcMessage::readSource(Source *src)
+{
+  int32_t slot=0;
+  int32_t matrix_type=0;
+  int32_t chans=0;
+  int32_t block_size=0;
+
+  if(!(readAddress(&src->host_address)&&
+       readInt(&slot)&&
+       readInt(&matrix_type)&&
+       readString(&src->host_name)&&
+       readAddress(&src->stream_address)&&
+       readString(&src->name)&&
+       readBool(&src->enabled)&&
+       readInt(&chans)&&
+       readInt(&block_size))) {
+    return false;
+  }
+  src->slot=slot;
+  src->matrix_type=matrix_type;
+  src->channels=chans;
+  src->block_size=block_size;
+
+  return true;
+}
+
+
+bool ProtoIpcMessage::readDestination(Destination *dst)
+{
+  int32_t slot=0;
+  int32_t matrix_type=0;
+  int32_t chans=0;
+
+  if(!(readAddress(&dst->host_address)&&
+       readInt(&slot)&&
+       readInt(&matrix_type)&&
+       readString(&dst->host_name)&&
+       readAddress(&dst->stream_address)&&
+       readString(&dst->name)&&
+       readInt(&chans))) {
+    return false;
+  }
+  dst->slot=slot;
+  dst->matrix_type=matrix_type;
+  dst->channels=chans;
+
+  return true;
+}
+
+
+bool ProtoIpcMessage::readGpi(Gpi *gpi)
+{
+  int32_t slot=0;
+  int32_t matrix_type=0;
+
+  if(!(readAddress(&gpi->host_address)&&
+       readInt(&slot)&&
+       readInt(&matrix_type)&&
+       readString(&gpi->host_name)&&
+       readString(&gpi->code))) {
+    return false;
+  }
+  gpi->slot=slot;
+  gpi->matrix_type=matrix_type;
+
+  return true;
+}
+
+
+bool ProtoIpcMessage::readGpo(Gpo *gpo)
+{
+  int32_t slot=0;
+  int32_t matrix_type=0;
+  int32_t source_slot=0;
+
+  if(!(readAddress(&gpo->host_address)&&
+       readInt(&slot)&&
+       readInt(&matrix_type)&&
+       readString(&gpo->host_name)&&
+       readString(&gpo->code)&&
+       readString(&gpo->name)&&
+       readAddress(&gpo->source_address)&&
+       readInt(&source_slot))) {
+    return false;
+  }
+  gpo->slot=slot;
+  gpo->matrix_type=matrix_type;
+  gpo->source_slot=source_slot;
+
+  return true;
+}
+
+
+bool ProtoIpcMessage::readAlarm(Alarm *alarm)
+{
+  int32_t slot=0;
+  int32_t meter_type=0;
+  int32_t chan=0;
+
+  if(!(readAddress(&alarm->host_address)&&
+       readInt(&slot)&&
+       readInt(&meter_type)&&
+       readInt(&chan)&&
+       readBool(&alarm->state))) {
+    return false;
+  }
+  alarm->slot=slot;
+  alarm->meter_type=meter_type;
+  alarm->chan=chan;
+
+  return true;
+}
+
+
+QByteArray ProtoIpcMessage::frame() const
+{
+  QByteArray ret;
+  uint32_t len=msg_payload.size()+9;
+
+  ret.append(0xFF&(len>>24));
+  ret.append(0xFF&(len>>16));
+  ret.append(0xFF&(len>>8));
+  ret.append(0xFF&len);
+  ret.append((char)msg_type);
+  for(int i=56;i>=0;i-=8) {
+    ret.append(0xFF&(msg_sequence>>i));
+  }
+  ret.append(msg_payload);
+
+  return ret;
+}
+
+
+bool ProtoIpcMessage::takeFrame(QByteArray *data)
+{
+  if(data->size()<13) {
+    return false;
+  }
+  const unsigned char *hdr=(const unsigned char *)data->constData();
+  uint32_t len=((uint32_t)hdr[0]<<24)|((uint32_t)hdr[1]<<16)|
+    ((uint32_t)hdr[2]<<8)|(uint32_t)hdr[3];
+  if((len<9)||((uint32_t)data->size()<(4+len))) {
+    return false;
+  }
+  msg_type=(ProtoIpcMessage::Type)hdr[4];
+  msg_sequence=0;
+  for(int i=0;i<8;i++) {
+    msg_sequence=(msg_sequence<<8)|hdr[5+i];
+  }
+  msg_payload=data->mid(13,len-9);
+  msg_pos=0;
+  data->remove(0,4+len);
+
+  return true;
+}
+
+
+QString ProtoIpcMessage::typeString(Type type)
+{
+  QString ret="UNKNOWN";
+
+  switch(type) {
+  case ProtoIpcMessage::TypeTether:
+    ret="TETHER";
+    break;
+
+  case ProtoIpcMessage::TypeNodeAdd:
+    ret="NODEADD";
+    break;
+
+  case ProtoIpcMessage::TypeNodeDel:
+    ret="NODEDEL";
+    break;
+
+  case ProtoIpcMessage::TypeNode:
+    ret="NODE";
+    break;
+
+  case ProtoIpcMessage::TypeSource:
+    ret="SRC";
+    break;
+
+  case ProtoIpcMessage::TypeDestination:
+    ret="DST";
+    break;
+
+  case ProtoIpcMessage::TypeDestinationCrosspoint:
+    ret="DSTX";
+    break;
+
+  case ProtoIpcMessage::TypeGpi:
+    ret="GPI";
+    break;
+
+  case ProtoIpcMessage::TypeGpiCode:
+    ret="GPICODE";
+    break;
+
+  case ProtoIpcMessage::TypeGpo:
+    ret="GPO";
+    break;
+
+  case ProtoIpcMessage::TypeGpoCrosspoint:
+    ret="GPOX";
+    break;
+
+  case ProtoIpcMessage::TypeGpoCode:
+    ret="GPOCODE";
+    break;
+
+  case ProtoIpcMessage::TypeClip:
+    ret="CLIP";
+    break;
+
+  case ProtoIpcMessage::TypeSilence:
+    ret="SILENCE";
+    break;
+
+  case ProtoIpcMessage::TypeRouteConfirm:
+    ret="ROUTECONFIRM";
+    break;
+
+  case ProtoIpcMessage::TypeSequence:
+    ret="SEQUENCE";
+    break;
+
+  case ProtoIpcMessage::TypeNone:
+    break;
+  }
+
+  return ret;
+}
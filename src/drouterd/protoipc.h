@@ -2,7 +2,7 @@
 //
 // Common data structures for DRouter protocol IPC
 //
-//   (C) Copyright 2018-2022 Fred Gleason <fredg@paravelsystems.com>
+//   (C) Copyright 2018-2026 Fred Gleason <fredg@paravelsystems.com>
 //
 //   This program is free software; you can redistribute it and/or modify
 //   it under the terms of the GNU General Public License version 2 as
@@ -21,9 +21,136 @@
 #ifndef PROTOIPC_H
 #define PROTOIPC_H
 
+#include <stdint.h>
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QList>
+#include <QString>
+
 /*
  * The UNIX socket address
  */
 #define DROUTER_IPC_ADDRESS "/var/cache/drouter/protoipc.sock"
 
+/*
+ * Core->protocol change notifications
+ *
+ * Each notification is a frame consisting of a 32 bit length (counting
+ * the type byte, sequence number and payload), an 8 bit message type,
+ * a 64 bit sequence number and the payload. Integers are big-endian,
+ * strings are a 16 bit length followed by UTF-8 data and addresses are
+ * a null flag byte followed by a 32 bit IPv4 address. Each notification
+ * carries the complete changed record, so protocol modules can render
+ * it without going to the database.
+ *
+ * Sequence numbers are assigned by the core as changes are journaled
+ * (see changejournal.h). A TypeSequence frame with no payload is sent
+ * first on each new connection, giving the number of the last change
+ * made before the connection was accepted.
+ */
+class ProtoIpcMessage
+{
+ public:
+  enum Type {TypeNone=0,TypeTether=1,TypeNodeAdd=2,TypeNodeDel=3,
+	     TypeNode=4,TypeSource=5,TypeDestination=6,
+	     TypeDestinationCrosspoint=7,TypeGpi=8,TypeGpiCode=9,TypeGpo=10,
+	     TypeGpoCrosspoint=11,TypeGpoCode=12,TypeClip=13,TypeSilence=14,
+	     TypeRouteConfirm=15,TypeSequence=16};
+  struct Node {
+    Node();
+    QHostAddress host_address;
+    QString host_name;
+    QString device_name;
+    int matrix_type;
+    int sources;
+    int destinations;
+    int gpis;
+    int gpos;
+  };
+  struct Source {
+    Source();
+    QHostAddress host_address;
+    int slot;
+    int matrix_type;
+    QString host_name;
+    QHostAddress stream_address;
+    QString name;
+    bool enabled;
+    unsigned channels;
+    unsigned block_size;
+  };
+  struct Destination {
+    Destination();
+    QHostAddress host_address;
+    int slot;
+    int matrix_type;
+    QString host_name;
+    QHostAddress stream_address;
+    QString name;
+    unsigned channels;
+  };
+  struct Gpi {
+    Gpi();
+    QHostAddress host_address;
+    int slot;
+    int matrix_type;
+    QString host_name;
+    QString code;
+  };
+  struct Gpo {
+    Gpo();
+    QHostAddress host_address;
+    int slot;
+    int matrix_type;
+    QString host_name;
+    QString code;
+    QString name;
+    QHostAddress source_address;
+    int source_slot;
+  };
+  struct Alarm {
+    Alarm();
+    QHostAddress host_address;
+    int slot;
+    int meter_type;
+    int chan;
+    bool state;
+  };
+  ProtoIpcMessage(Type type=TypeNone);
+  Type type() const;
+  quint64 sequence() const;
+  void setSequence(quint64 seq);
+  void writeBool(bool state);
+  void writeInt(int32_t val);
+  void writeString(const QString &str);
+  void writeAddress(const QHostAddress &addr);
+  void writeNode(const Node &node);
+  void writeSource(const Source &src);
+  void writeDestination(const Destination &dst);
+  void writeGpi(const Gpi &gpi);
+  void writeGpo(const Gpo &gpo);
+  void writeAlarm(const Alarm &alarm);
+  bool readBool(bool *state);
+  bool readInt(int32_t *val);
+  bool readString(QString *str);
+  bool readAddress(QHostAddress *addr);
+  bool readNode(Node *node);
+  bool readSource(Source *src);
+  bool readDestination(Destination *dst);
+  bool readGpi(Gpi *gpi);
+  bool readGpo(Gpo *gpo);
+  bool readAlarm(Alarm *alarm);
+  QByteArray frame() const;
+  bool takeFrame(QByteArray *data);
+  static QString typeString(Type type);
+
+ private:
+  Type msg_type;
+  quint64 msg_sequence;
+  QByteArray msg_payload;
+  int msg_pos;
+};
+
+
 #endif  // PROTOIPC_H
@@ -0,0 +1,156 @@
+// recordcache.cpp
+//
+// Pre-rendered Protocol D records
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <QList>
+#include <QSet>
+
+#include "recordcache.h"
+
+RecordCache::RecordCache()
+{
+  cache_valid=false;
+}
+
+
+bool RecordCache::isValid() const
+{
+  return cache_valid&&cache_stale.isEmpty();
+}
+
+
+void RecordCache::setValid(bool state)
+{
+  cache_valid=state;
+  cache_stale.clear();
+}
+
+
+bool RecordCache::isStale(const QHostAddress &host_addr) const
+{
+  return (!cache_valid)||cache_stale.contains(host_addr.toIPv4Address());
+}
+
+
+void RecordCache::clear()
+{
+  cache_entries.clear();
+  cache_stale.clear();
+  cache_valid=false;
+}
+
+
+void RecordCache::invalidate(const QHostAddress &host_addr)
+{
+  remove(host_addr);
+  if(cache_valid) {
+    cache_stale.insert(host_addr.toIPv4Address());
+  }
+}
+
+
+bool RecordCache::name(const QHostAddress &host_addr,int slot,
+		       QString *name) const
+{
+  if(!cache_valid) {
+    return false;
+  }
+  QMap<quint64,Entry>::const_iterator it=
+    cache_entries.find(Key(host_addr.toIPv4Address(),slot));
+  if(it==cache_entries.constEnd()) {
+    return false;
+  }
+  *name=it.value().name;
+
+  return true;
+}
+
+
+void RecordCache::update(const QHostAddress &host_addr,int slot,
+			 const QString &host_name,const QString &name,
+			 const QByteArray &fields)
+{
+  Entry &e=cache_entries[Key(host_addr.toIPv4Address(),slot)];
+
+  e.host_name=host_name;
+  e.name=name;
+  e.fields=fields;
+}
+
+
+void RecordCache::remove(const QHostAddress &host_addr)
+{
+  uint32_t addr=host_addr.toIPv4Address();
+  QMap<quint64,Entry>::iterator it=cache_entries.lowerBound(Key(addr,0));
+
+  cache_stale.remove(addr);
+  while((it!=cache_entries.end())&&((it.key()>>32)==addr)) {
+    it=cache_entries.erase(it);
+  }
+}
+
+
+QByteArray RecordCache::records(const QByteArray &keyword,
+				const SubscriptionFilter &filter) const
+{
+  QByteArray ret;
+  QSet<uint32_t> hosts;
+
+  if(filter.hosts(&hosts)) {
+    //
+    // Visit only the nodes named by the filter
+    //
+    QList<uint32_t> addrs=hosts.toList();
+    qSort(addrs);
+    for(int i=0;i<addrs.size();i++) {
+      for(QMap<quint64,Entry>::const_iterator
+	    it=cache_entries.lowerBound(Key(addrs.at(i),0));
+	  (it!=cache_entries.constEnd())&&((it.key()>>32)==addrs.at(i));it++) {
+	Append(&ret,keyword,it.key(),it.value(),filter);
+      }
+    }
+  }
+  else {
+    for(QMap<quint64,Entry>::const_iterator it=cache_entries.constBegin();
+	it!=cache_entries.constEnd();it++) {
+      Append(&ret,keyword,it.key(),it.value(),filter);
+    }
+  }
+
+  return ret;
+}
+
+
+void RecordCache::Append(QByteArray *data,const QByteArray &keyword,
+			 quint64 key,const Entry &e,
+			 const SubscriptionFilter &filter) const
+{
+  if(filter.matchesAll()||
+     filter.matches(QHostAddress((quint32)(key>>32)),(int)(0xFFFFFFFF&key),
+		    e.host_name,e.name)) {
+    data->append(keyword);
+    data->append(e.fields);
+  }
+}
+
+
+quint64 RecordCache::Key(uint32_t host_addr,int slot)
+{
+  return ((quint64)host_addr<<32)|(0xFFFFFFFF&(quint64)slot);
+}
@@ -0,0 +1,73 @@
+// recordcache.h
+//
+// Pre-rendered Protocol D records
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef RECORDCACHE_H
+#define RECORDCACHE_H
+
+#include <stdint.h>
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QMap>
+#include <QSet>
+#include <QString>
+
+#include "subscriptionfilter.h"
+
+//
+// The fields of each slot of one table, serialized once as everything
+// after the record keyword and kept in host address/slot order. Loaded
+// from the state snapshot on first use and kept current from the change
+// notifications thereafter. The entries of a single node can be marked
+// stale with invalidate(), to be reloaded from the snapshot on next use
+// while those of the other nodes are kept.
+//
+class RecordCache
+{
+ public:
+  RecordCache();
+  bool isValid() const;
+  void setValid(bool state);
+  bool isStale(const QHostAddress &host_addr) const;
+  void clear();
+  void invalidate(const QHostAddress &host_addr);
+  bool name(const QHostAddress &host_addr,int slot,QString *name) const;
+  void update(const QHostAddress &host_addr,int slot,const QString &host_name,
+	      const QString &name,const QByteArray &fields);
+  void remove(const QHostAddress &host_addr);
+  QByteArray records(const QByteArray &keyword,
+		     const SubscriptionFilter &filter) const;
+
+ private:
+  struct Entry {
+    QString host_name;
+    QString name;
+    QByteArray fields;
+  };
+  void Append(QByteArray *data,const QByteArray &keyword,quint64 key,
+	      const Entry &e,const SubscriptionFilter &filter) const;
+  static quint64 Key(uint32_t host_addr,int slot);
+  bool cache_valid;
+  QSet<uint32_t> cache_stale;
+  QMap<quint64,Entry> cache_entries;
+};
+
+
+#endif  // RECORDCACHE_H
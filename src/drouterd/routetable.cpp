@@ -0,0 +1,332 @@
+// routetable.cpp
+//
+// In-memory crosspoint state for the Protocol SA routers
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include "config.h"
+#include "routetable.h"
+#include "sqlquery.h"
+
+RouteTable::RouteTable(const QMap<int,EndPointMap *> &maps)
+{
+  for(QMap<int,EndPointMap *>::const_iterator it=maps.constBegin();
+      it!=maps.constEnd();it++) {
+    EndPointMap *map=it.value();
+    Router *rtr=new Router();
+    rtr->map=map;
+    rtr->inputs.fill(-1,map->quantity(EndPointMap::Output));
+    for(int i=0;i<map->quantity(EndPointMap::Output);i++) {
+      if(map->slot(EndPointMap::Output,i)>=0) {
+	EndPoint ep;
+	ep.router=it.key();
+	ep.number=i;
+	table_outputs[SlotKey(map->hostAddress(EndPointMap::Output,i),
+			      map->slot(EndPointMap::Output,i))].push_back(ep);
+      }
+    }
+    if(map->routerType()==EndPointMap::AudioRouter) {
+      rtr->dst_streams.fill(0,map->quantity(EndPointMap::Output));
+      rtr->src_streams.fill(0,map->quantity(EndPointMap::Input));
+      for(int i=0;i<map->quantity(EndPointMap::Input);i++) {
+	if(map->slot(EndPointMap::Input,i)>=0) {
+	  EndPoint ep;
+	  ep.router=it.key();
+	  ep.number=i;
+	  table_inputs[SlotKey(map->hostAddress(EndPointMap::Input,i),
+			       map->slot(EndPointMap::Input,i))].push_back(ep);
+	}
+      }
+    }
+    table_routers[it.key()]=rtr;
+  }
+}
+
+
+RouteTable::~RouteTable()
+{
+  for(QHash<int,Router *>::const_iterator it=table_routers.constBegin();
+      it!=table_routers.constEnd();it++) {
+    delete it.value();
+  }
+}
+
+
+int RouteTable::input(int router,int output) const
+{
+  Router *rtr=table_routers.value(router);
+
+  if((rtr==NULL)||(output<0)||(output>=rtr->inputs.size())) {
+    return -1;
+  }
+  return rtr->inputs.at(output);
+}
+
+
+int RouteTable::outputQuantity(int router) const
+{
+  Router *rtr=table_routers.value(router);
+
+  if(rtr==NULL) {
+    return 0;
+  }
+  return rtr->inputs.size();
+}
+
+
+void RouteTable::clear()
+{
+  for(QHash<int,Router *>::const_iterator it=table_routers.constBegin();
+      it!=table_routers.constEnd();it++) {
+    Router *rtr=it.value();
+    rtr->inputs.fill(-1);
+    rtr->dst_streams.fill(0);
+    rtr->src_streams.fill(0);
+    rtr->input_streams.clear();
+  }
+}
+
+
+bool RouteTable::load(const StateSnapshot *snap)
+{
+  QList<ProtoIpcMessage::Source> srcs;
+  QList<ProtoIpcMessage::Destination> dsts;
+  QList<ProtoIpcMessage::Gpo> gpos;
+
+  if((snap==NULL)||(!snap->sources(&srcs))||(!snap->destinations(&dsts))||
+     (!snap->gpos(&gpos))) {
+    return false;
+  }
+  clear();
+  for(int i=0;i<srcs.size();i++) {
+    const ProtoIpcMessage::Source &src=srcs.at(i);
+    updateSource(src.host_address,src.slot,src.stream_address);
+  }
+  for(int i=0;i<dsts.size();i++) {
+    const ProtoIpcMessage::Destination &dst=dsts.at(i);
+    updateDestination(dst.host_address,dst.slot,dst.stream_address);
+  }
+  for(int i=0;i<gpos.size();i++) {
+    const ProtoIpcMessage::Gpo &gpo=gpos.at(i);
+    updateGpo(gpo.host_address,gpo.slot,gpo.source_address,gpo.source_slot);
+  }
+
+  return true;
+}
+
+
+bool RouteTable::loadDb()
+{
+  QString sql;
+  SqlQuery *q;
+
+  clear();
+  sql=QString("select ")+
+    "`HOST_ADDRESS`,"+   // 00
+    "`SLOT`,"+           // 01
+    "`STREAM_ADDRESS` "+ // 02
+    "from `SOURCES`";
+  q=new SqlQuery(sql);
+  while(q->next()) {
+    updateSource(QHostAddress(q->value(0).toString()),q->value(1).toInt(),
+		 QHostAddress(q->value(2).toString()));
+  }
+  delete q;
+
+  sql=QString("select ")+
+    "`HOST_ADDRESS`,"+   // 00
+    "`SLOT`,"+           // 01
+    "`STREAM_ADDRESS` "+ // 02
+    "from `DESTINATIONS`";
+  q=new SqlQuery(sql);
+  while(q->next()) {
+    updateDestination(QHostAddress(q->value(0).toString()),
+		      q->value(1).toInt(),
+		      QHostAddress(q->value(2).toString()));
+  }
+  delete q;
+
+  sql=QString("select ")+
+    "`HOST_ADDRESS`,"+    // 00
+    "`SLOT`,"+            // 01
+    "`SOURCE_ADDRESS`,"+  // 02
+    "`SOURCE_SLOT` "+     // 03
+    "from `GPOS`";
+  q=new SqlQuery(sql);
+  while(q->next()) {
+    updateGpo(QHostAddress(q->value(0).toString()),q->value(1).toInt(),
+	      QHostAddress(q->value(2).toString()),q->value(3).toInt());
+  }
+  delete q;
+
+  return true;
+}
+
+
+QList<RouteTable::Change>
+RouteTable::updateSource(const QHostAddress &host_addr,int slot,
+			 const QHostAddress &stream_addr)
+{
+  QList<Change> changes;
+  QList<EndPoint> eps=table_inputs.value(SlotKey(host_addr,slot));
+  uint32_t stream=StreamKey(stream_addr);
+
+  for(int i=0;i<eps.size();i++) {
+    int router=eps.at(i).router;
+    int input=eps.at(i).number;
+    Router *rtr=table_routers.value(router);
+    uint32_t old_stream=rtr->src_streams.at(input);
+    if(old_stream==stream) {
+      continue;
+    }
+    rtr->src_streams[input]=stream;
+
+    //
+    // Each stream resolves to the lowest input carrying it
+    //
+    if((old_stream!=0)&&(rtr->input_streams.value(old_stream,-1)==input)) {
+      rtr->input_streams.remove(old_stream);
+      for(int j=0;j<rtr->src_streams.size();j++) {
+	if(rtr->src_streams.at(j)==old_stream) {
+	  rtr->input_streams[old_stream]=j;
+	  break;
+	}
+      }
+    }
+    if(stream!=0) {
+      QHash<uint32_t,int>::iterator it=rtr->input_streams.find(stream);
+      if((it==rtr->input_streams.end())||(it.value()>input)) {
+	rtr->input_streams[stream]=input;
+      }
+    }
+    for(int j=0;j<rtr->dst_streams.size();j++) {
+      uint32_t dst_stream=rtr->dst_streams.at(j);
+      if((dst_stream!=0)&&((dst_stream==old_stream)||(dst_stream==stream))) {
+	SetInput(rtr,router,j,StreamInput(rtr,dst_stream),&changes);
+      }
+    }
+  }
+
+  return changes;
+}
+
+
+QList<RouteTable::Change>
+RouteTable::updateDestination(const QHostAddress &host_addr,int slot,
+			      const QHostAddress &stream_addr)
+{
+  QList<Change> changes;
+  QList<EndPoint> eps=table_outputs.value(SlotKey(host_addr,slot));
+  uint32_t stream=StreamKey(stream_addr);
+
+  for(int i=0;i<eps.size();i++) {
+    Router *rtr=table_routers.value(eps.at(i).router);
+    if(rtr->map->routerType()==EndPointMap::AudioRouter) {
+      rtr->dst_streams[eps.at(i).number]=stream;
+      SetInput(rtr,eps.at(i).router,eps.at(i).number,
+	       StreamInput(rtr,stream),&changes);
+    }
+  }
+
+  return changes;
+}
+
+
+QList<RouteTable::Change>
+RouteTable::updateGpo(const QHostAddress &host_addr,int slot,
+		      const QHostAddress &src_addr,int src_slot)
+{
+  QList<Change> changes;
+  QList<EndPoint> eps=table_outputs.value(SlotKey(host_addr,slot));
+
+  for(int i=0;i<eps.size();i++) {
+    Router *rtr=table_routers.value(eps.at(i).router);
+    if(rtr->map->routerType()==EndPointMap::GpioRouter) {
+      int input=-1;
+      if(src_slot>=0) {
+	input=rtr->map->endPoint(EndPointMap::Input,src_addr,src_slot);
+      }
+      SetInput(rtr,eps.at(i).router,eps.at(i).number,input,&changes);
+    }
+  }
+
+  return changes;
+}
+
+
+QList<RouteTable::Change>
+RouteTable::removeNode(const ProtoIpcMessage::Node &node)
+{
+  QList<Change> changes;
+
+  for(int i=0;i<node.sources;i++) {
+    changes+=updateSource(node.host_address,i,QHostAddress());
+  }
+  for(int i=0;i<node.destinations;i++) {
+    changes+=updateDestination(node.host_address,i,QHostAddress());
+  }
+  for(int i=0;i<node.gpos;i++) {
+    changes+=updateGpo(node.host_address,i,QHostAddress(),-1);
+  }
+
+  return changes;
+}
+
+
+void RouteTable::SetInput(Router *rtr,int router,int output,int input,
+			  QList<Change> *changes)
+{
+  if(rtr->inputs.at(output)!=input) {
+    rtr->inputs[output]=input;
+    Change c;
+    c.router=router;
+    c.output=output;
+    c.input=input;
+    changes->push_back(c);
+  }
+}
+
+
+int RouteTable::StreamInput(const Router *rtr,uint32_t stream) const
+{
+  if(stream==0) {
+    return -1;
+  }
+  return rtr->input_streams.value(stream,-1);
+}
+
+
+uint32_t RouteTable::StreamKey(const QHostAddress &addr)
+{
+  //
+  // Zero stands for "no stream", whichever way the node spelled it
+  //
+  static const uint32_t null_stream=
+    QHostAddress(DROUTER_NULL_STREAM_ADDRESS).toIPv4Address();
+  uint32_t ret=Config::normalizedStreamAddress(addr).toIPv4Address();
+
+  if(ret==null_stream) {
+    return 0;
+  }
+  return ret;
+}
+
+
+quint64 RouteTable::SlotKey(const QHostAddress &addr,int slot)
+{
+  return ((quint64)addr.toIPv4Address()<<32)|(0xFFFFFFFF&(quint64)slot);
+}
@@ -0,0 +1,88 @@
+// routetable.h
+//
+// In-memory crosspoint state for the Protocol SA routers
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef ROUTETABLE_H
+#define ROUTETABLE_H
+
+#include <stdint.h>
+
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QVector>
+
+#include "endpointmap.h"
+#include "protoipc.h"
+#include "statesnapshot.h"
+
+//
+// Keeps the input currently feeding each output of every mapped router,
+// as a dense array per router, updated from the core's change
+// notifications. Audio outputs are resolved by matching the destination
+// stream address against the stream addresses of that router's inputs,
+// GPIO outputs by the GPO's source address and slot.
+//
+class RouteTable
+{
+ public:
+  struct Change {
+    int router;
+    int output;
+    int input;
+  };
+  RouteTable(const QMap<int,EndPointMap *> &maps);
+  ~RouteTable();
+  int input(int router,int output) const;
+  int outputQuantity(int router) const;
+  void clear();
+  bool load(const StateSnapshot *snap);
+  bool loadDb();
+  QList<Change> updateSource(const QHostAddress &host_addr,int slot,
+			     const QHostAddress &stream_addr);
+  QList<Change> updateDestination(const QHostAddress &host_addr,int slot,
+				  const QHostAddress &stream_addr);
+  QList<Change> updateGpo(const QHostAddress &host_addr,int slot,
+			  const QHostAddress &src_addr,int src_slot);
+  QList<Change> removeNode(const ProtoIpcMessage::Node &node);
+
+ private:
+  struct EndPoint {
+    int router;
+    int number;
+  };
+  struct Router {
+    EndPointMap *map;
+    QVector<int> inputs;
+    QVector<uint32_t> dst_streams;
+    QVector<uint32_t> src_streams;
+    QHash<uint32_t,int> input_streams;
+  };
+  void SetInput(Router *rtr,int router,int output,int input,
+		QList<Change> *changes);
+  int StreamInput(const Router *rtr,uint32_t stream) const;
+  static uint32_t StreamKey(const QHostAddress &addr);
+  static quint64 SlotKey(const QHostAddress &addr,int slot);
+  QHash<int,Router *> table_routers;
+  QHash<quint64,QList<EndPoint> > table_outputs;
+  QHash<quint64,QList<EndPoint> > table_inputs;
+};
+
+
+#endif  // ROUTETABLE_H
@@ -0,0 +1,214 @@
+// statebench.cpp
+//
+// Benchmark drouterd(8) change handling with simulated matrices
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include <sy5/sycmdswitch.h>
+
+#include "protoipc.h"
+#include "statebench.h"
+
+MainObject::MainObject(QObject *parent)
+  : QObject(parent)
+{
+  QElapsedTimer timer;
+  StateStore *store=new StateStore();
+  Config *config=new Config();
+  bool ok=false;
+  bool xpoint_changed=false;
+  unsigned id=0;
+  int slot=0;
+  int frames=0;
+
+  bench_nodes=500;
+  bench_slots=32;
+  bench_changes=100000;
+
+  SyCmdSwitch *cmd=new SyCmdSwitch("statebench",VERSION,STATEBENCH_USAGE);
+  for(int i=0;i<cmd->keys();i++) {
+    if(cmd->key(i)=="--nodes") {
+      bench_nodes=cmd->value(i).toInt(&ok);
+      if((!ok)||(bench_nodes<1)||(bench_nodes>65000)) {
+	fprintf(stderr,"statebench: invalid --nodes value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--slots") {
+      bench_slots=cmd->value(i).toInt(&ok);
+      if((!ok)||(bench_slots<2)) {
+	fprintf(stderr,"statebench: invalid --slots value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--changes") {
+      bench_changes=cmd->value(i).toInt(&ok);
+      if((!ok)||(bench_changes<1)) {
+	fprintf(stderr,"statebench: invalid --changes value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(!cmd->processed(i)) {
+      fprintf(stderr,"statebench: unknown option \"%s\"\n",
+	      cmd->key(i).toUtf8().constData());
+      exit(1);
+    }
+  }
+  if((bench_nodes*bench_slots)>65000) {
+    fprintf(stderr,"statebench: too many simulated sources\n");
+    exit(1);
+  }
+  for(int i=0;i<bench_nodes;i++) {
+    bench_matrices.push_back(new FakeMatrix((10u<<24)+(1u<<16)+i+1,
+					    bench_slots,config,this));
+  }
+  int srcs=bench_nodes*bench_slots;
+
+  //
+  // Node Connects
+  //
+  timer.start();
+  for(int i=0;i<bench_matrices.size();i++) {
+    store->addNode(bench_matrices.at(i));
+  }
+  Report("state_addnode",bench_matrices.size(),timer.nsecsElapsed());
+
+  //
+  // Source Changes (DRouter::sourceChangedData())
+  //
+  timer.start();
+  for(int i=0;i<bench_changes;i++) {
+    FakeMatrix *mtx=bench_matrices.at(i%bench_nodes);
+    slot=(i/bench_nodes)%bench_slots;
+    SyNode node;
+    node.setHostName(mtx->hostName());
+    SySource src;
+    src.setStreamAddress(mtx->srcAddress(slot));
+    src.setName(QString::asprintf("Source %d",i));
+    src.setEnabled(true);
+    src.setChannels(2);
+    src.setPacketSize(12);
+    if(store->updateSource(mtx->id(),slot,node,src,mtx->srcNumber(slot))) {
+      ProtoIpcMessage::Source rec;
+      rec.host_address=mtx->hostAddress();
+      rec.slot=slot;
+      rec.matrix_type=mtx->matrixType();
+      rec.host_name=node.hostName();
+      rec.stream_address=src.streamAddress();
+      rec.name=src.name();
+      rec.enabled=src.enabled();
+      rec.channels=src.channels();
+      rec.block_size=src.packetSize();
+      ProtoIpcMessage msg(ProtoIpcMessage::TypeSource);
+      msg.writeSource(rec);
+      frames+=msg.frame().size();
+    }
+  }
+  Report("state_source_change",bench_changes,timer.nsecsElapsed());
+
+  //
+  // Crosspoint Changes (DRouter::destinationChangedData())
+  //
+  timer.start();
+  for(int i=0;i<bench_changes;i++) {
+    FakeMatrix *mtx=bench_matrices.at(i%bench_nodes);
+    slot=(i/bench_nodes)%bench_slots;
+    SyNode node;
+    node.setHostName(mtx->hostName());
+    SyDestination dst;
+    dst.setStreamAddress(FakeMatrix::streamAddress((i+slot)%srcs+1));
+    dst.setName(mtx->dstName(slot));
+    dst.setChannels(2);
+    QHostAddress old_stream_addr=
+      QHostAddress(store->destination(mtx->id(),slot)->stream_address);
+    if(store->updateDestination(mtx->id(),slot,node,dst,&xpoint_changed)&&
+       xpoint_changed) {
+      ProtoIpcMessage::Destination rec;
+      rec.host_address=mtx->hostAddress();
+      rec.slot=slot;
+      rec.matrix_type=mtx->matrixType();
+      rec.host_name=node.hostName();
+      rec.stream_address=dst.streamAddress();
+      rec.name=dst.name();
+      rec.channels=dst.channels();
+      QHostAddress src_addr;
+      int src_slot=-1;
+      if(store->sourceByStream(dst.streamAddress().toIPv4Address(),
+			       &id,&src_slot)) {
+	src_addr=QHostAddress(id);
+      }
+      ProtoIpcMessage msg(ProtoIpcMessage::TypeDestinationCrosspoint);
+      msg.writeDestination(rec);
+      msg.writeAddress(old_stream_addr);
+      msg.writeAddress(src_addr);
+      msg.writeInt(src_slot);
+      frames+=msg.frame().size();
+    }
+  }
+  Report("state_crosspoint_change",bench_changes,timer.nsecsElapsed());
+
+  //
+  // Source Resolution
+  //
+  timer.start();
+  for(int i=0;i<bench_changes;i++) {
+    store->sourceByStream(FakeMatrix::streamAddress(i%srcs+1).toIPv4Address(),
+			  &id,&slot);
+  }
+  Report("state_source_by_stream",bench_changes,timer.nsecsElapsed());
+
+  //
+  // Node Disconnects
+  //
+  timer.start();
+  for(int i=0;i<bench_matrices.size();i++) {
+    store->removeNode(bench_matrices.at(i)->id());
+  }
+  Report("state_removenode",bench_matrices.size(),timer.nsecsElapsed());
+  fprintf(stderr,"statebench: %d bytes of IPC frames generated\n",frames);
+
+  delete store;
+  exit(0);
+}
+
+
+void MainObject::Report(const QString &name,qint64 ops,qint64 nsecs) const
+{
+  printf("bench=%s ops=%lld total_us=%lld ns_per_op=%.1f\n",
+	 name.toUtf8().constData(),ops,nsecs/1000,
+	 (double)nsecs/(double)ops);
+  fflush(stdout);
+}
+
+
+int main(int argc,char *argv[])
+{
+  QCoreApplication a(argc,argv);
+
+  new MainObject();
+
+  return a.exec();
+}
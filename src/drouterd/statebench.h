@@ -0,0 +1,47 @@
+// statebench.h
+//
+// Benchmark drouterd(8) change handling with simulated matrices
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef STATEBENCH_H
+#define STATEBENCH_H
+
+#include <QList>
+#include <QObject>
+
+#include "fakematrix.h"
+#include "statestore.h"
+
+#define STATEBENCH_USAGE "[options]\n\nTime the in-memory change handling of drouterd(8) against simulated\nmatrices and print one \"key=value\" line per benchmark on standard\noutput. No network or database access is done.\n\nOptions are:\n--nodes=<num>\n     Number of simulated nodes (default 500)\n\n--slots=<num>\n     Sources and destinations per node (default 32)\n\n--changes=<num>\n     Change events applied per benchmark (default 100000)\n\n"
+
+class MainObject : public QObject
+{
+ Q_OBJECT;
+ public:
+  MainObject(QObject *parent=0);
+
+ private:
+  void Report(const QString &name,qint64 ops,qint64 nsecs) const;
+  int bench_nodes;
+  int bench_slots;
+  int bench_changes;
+  QList<FakeMatrix *> bench_matrices;
+};
+
+
+#endif  // STATEBENCH_H
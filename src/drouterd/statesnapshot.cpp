@@ -0,0 +1,950 @@
+// statesnapshot.cpp
+//
+// Shared memory snapshot of Drouter node state
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <sy5/sylwrp_client.h>
+
+#include "statesnapshot.h"
+
+//
+// Slot kinds, used to pick a record table
+//
+#define SNAPSHOT_KIND_SOURCE 0
+#define SNAPSHOT_KIND_DESTINATION 1
+#define SNAPSHOT_KIND_GPI 2
+#define SNAPSHOT_KIND_GPO 3
+
+StateSnapshot::StateSnapshot()
+{
+  snap_base=NULL;
+  snap_size=0;
+  snap_writeable=false;
+  snap_header=NULL;
+  snap_nodes=NULL;
+  snap_sources=NULL;
+  snap_destinations=NULL;
+  snap_gpis=NULL;
+  snap_gpos=NULL;
+}
+
+
+StateSnapshot::~StateSnapshot()
+{
+  if(snap_writeable&&(snap_header!=NULL)) {
+    snap_header->valid=0;
+    shm_unlink(DROUTER_SNAPSHOT_NAME);
+  }
+  Unmap();
+}
+
+
+bool StateSnapshot::create(int max_nodes,int max_slots,bool tether_state,
+			   QString *err_msg)
+{
+  int fd=-1;
+  size_t size=0;
+
+  if((max_nodes<1)||(max_slots<1)) {
+    *err_msg=QString::asprintf("invalid state snapshot size "
+			       "(%d nodes, %d slots)",max_nodes,max_slots);
+    return false;
+  }
+  if(((quint64)max_nodes*sizeof(NodeRec)+
+      (quint64)max_slots*(sizeof(SourceRec)+sizeof(DestinationRec)+
+			  sizeof(GpiRec)+sizeof(GpoRec)))>
+     (DROUTER_SNAPSHOT_MAX_SIZE-sizeof(Header))) {
+    *err_msg=QString::asprintf("state snapshot too large "
+			       "(%d nodes, %d slots)",max_nodes,max_slots);
+    return false;
+  }
+  size=sizeof(Header)+max_nodes*sizeof(NodeRec)+
+    max_slots*(sizeof(SourceRec)+sizeof(DestinationRec)+
+	       sizeof(GpiRec)+sizeof(GpoRec));
+
+  //
+  // Start from a fresh object, so that processes still mapping a
+  // previous instance keep their (now invalid) copy.
+  //
+  shm_unlink(DROUTER_SNAPSHOT_NAME);
+  if((fd=shm_open(DROUTER_SNAPSHOT_NAME,O_CREAT|O_EXCL|O_RDWR,
+		  S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH))<0) {
+    *err_msg=QString("unable to create state snapshot [")+
+      strerror(errno)+"]";
+    return false;
+  }
+  if(ftruncate(fd,size)<0) {
+    *err_msg=QString("unable to size state snapshot [")+strerror(errno)+"]";
+    close(fd);
+    shm_unlink(DROUTER_SNAPSHOT_NAME);
+    return false;
+  }
+  snap_size=size;
+  if(!Map(fd,true,err_msg)) {
+    close(fd);
+    shm_unlink(DROUTER_SNAPSHOT_NAME);
+    return false;
+  }
+  close(fd);
+
+  memset(snap_header,0,sizeof(Header));
+  snap_header->magic=DROUTER_SNAPSHOT_MAGIC;
+  snap_header->version=DROUTER_SNAPSHOT_VERSION;
+  snap_header->max_nodes=max_nodes;
+  snap_header->max_slots=max_slots;
+  snap_header->writeable=tether_state;
+  if(!Map(-1,true,err_msg)) {
+    Unmap();
+    shm_unlink(DROUTER_SNAPSHOT_NAME);
+    return false;
+  }
+  __atomic_store_n(&snap_header->valid,1,__ATOMIC_RELEASE);
+
+  return true;
+}
+
+
+bool StateSnapshot::attach(QString *err_msg)
+{
+  int fd=-1;
+  struct stat st;
+
+  if((fd=shm_open(DROUTER_SNAPSHOT_NAME,O_RDONLY,0))<0) {
+    *err_msg=QString("unable to open state snapshot [")+strerror(errno)+"]";
+    return false;
+  }
+  if(fstat(fd,&st)<0) {
+    *err_msg=QString("unable to stat state snapshot [")+strerror(errno)+"]";
+    close(fd);
+    return false;
+  }
+  if((size_t)st.st_size<sizeof(Header)) {
+    *err_msg="state snapshot is truncated";
+    close(fd);
+    return false;
+  }
+  snap_size=st.st_size;
+  if(!Map(fd,false,err_msg)) {
+    close(fd);
+    return false;
+  }
+  close(fd);
+  if((snap_header->magic!=DROUTER_SNAPSHOT_MAGIC)||
+     (snap_header->version!=DROUTER_SNAPSHOT_VERSION)) {
+    *err_msg="state snapshot has an unknown format";
+    Unmap();
+    return false;
+  }
+  if(!Map(-1,false,err_msg)) {
+    Unmap();
+    return false;
+  }
+
+  return true;
+}
+
+
+bool StateSnapshot::isValid() const
+{
+  return (snap_header!=NULL)&&
+    (__atomic_load_n(&snap_header->valid,__ATOMIC_ACQUIRE)!=0)&&
+    (__atomic_load_n(&snap_header->overflow,__ATOMIC_ACQUIRE)==0);
+}
+
+
+bool StateSnapshot::tetherState(bool *state) const
+{
+  uint32_t seq;
+
+  if(!isValid()) {
+    return false;
+  }
+  for(int i=0;i<DROUTER_SNAPSHOT_MAX_RETRIES;i++) {
+    seq=__atomic_load_n(&snap_header->tether_seq,__ATOMIC_ACQUIRE);
+    if((seq&1)==0) {
+      *state=snap_header->writeable!=0;
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if(__atomic_load_n(&snap_header->tether_seq,__ATOMIC_RELAXED)==seq) {
+	return true;
+      }
+    }
+  }
+  return false;
+}
+
+
+bool StateSnapshot::node(const QHostAddress &host_addr,
+			 ProtoIpcMessage::Node *node) const
+{
+  QList<NodeRec> recs;
+  uint32_t addr=host_addr.toIPv4Address();
+
+  if(!ReadNodes(&recs)) {
+    return false;
+  }
+  for(int i=0;i<recs.size();i++) {
+    const NodeRec &rec=recs.at(i);
+    if(rec.host_address==addr) {
+      node->host_address=QHostAddress(rec.host_address);
+      node->host_name=GetString(rec.host_name,DROUTER_SNAPSHOT_NAME_SIZE);
+      node->device_name=
+	GetString(rec.device_name,DROUTER_SNAPSHOT_DEVICE_SIZE);
+      node->matrix_type=rec.matrix_type;
+      node->sources=rec.sources;
+      node->destinations=rec.destinations;
+      node->gpis=rec.gpis;
+      node->gpos=rec.gpos;
+      return true;
+    }
+  }
+  *node=ProtoIpcMessage::Node();
+
+  return true;
+}
+
+
+bool StateSnapshot::nodes(QList<ProtoIpcMessage::Node> *nodes) const
+{
+  QList<NodeRec> recs;
+
+  nodes->clear();
+  if(!ReadNodes(&recs)) {
+    return false;
+  }
+  for(int i=0;i<recs.size();i++) {
+    const NodeRec &rec=recs.at(i);
+    ProtoIpcMessage::Node node;
+    node.host_address=QHostAddress(rec.host_address);
+    node.host_name=GetString(rec.host_name,DROUTER_SNAPSHOT_NAME_SIZE);
+    node.device_name=GetString(rec.device_name,DROUTER_SNAPSHOT_DEVICE_SIZE);
+    node.matrix_type=rec.matrix_type;
+    node.sources=rec.sources;
+    node.destinations=rec.destinations;
+    node.gpis=rec.gpis;
+    node.gpos=rec.gpos;
+    nodes->push_back(node);
+  }
+
+  return true;
+}
+
+
+bool StateSnapshot::sources(QList<ProtoIpcMessage::Source> *srcs) const
+{
+  QList<NodeRec> recs;
+  SourceRec rec;
+  uint32_t seq;
+
+  for(int retry=0;retry<DROUTER_SNAPSHOT_MAX_RETRIES;retry++) {
+    srcs->clear();
+    seq=__atomic_load_n(&snap_header->layout_seq,__ATOMIC_ACQUIRE);
+    if(!ReadNodes(&recs)) {
+      return false;
+    }
+    for(int i=0;i<recs.size();i++) {
+      const NodeRec &node=recs.at(i);
+      QString host_name=GetString(node.host_name,DROUTER_SNAPSHOT_NAME_SIZE);
+      for(uint32_t j=0;j<node.sources;j++) {
+	if(!ReadRecord(snap_sources+node.first_source+j,&rec)) {
+	  return false;
+	}
+	ProtoIpcMessage::Source src;
+	src.host_address=QHostAddress(node.host_address);
+	src.slot=rec.slot;
+	src.matrix_type=node.matrix_type;
+	src.host_name=host_name;
+	src.stream_address=QHostAddress(rec.stream_address);
+	src.name=GetString(rec.name,DROUTER_SNAPSHOT_NAME_SIZE);
+	src.enabled=rec.enabled;
+	src.channels=rec.channels;
+	src.block_size=rec.block_size;
+	srcs->push_back(src);
+      }
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&snap_header->layout_seq,__ATOMIC_RELAXED)==seq) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool StateSnapshot::destinations(QList<ProtoIpcMessage::Destination> *dsts)
+  const
+{
+  QList<NodeRec> recs;
+  DestinationRec rec;
+  uint32_t seq;
+
+  for(int retry=0;retry<DROUTER_SNAPSHOT_MAX_RETRIES;retry++) {
+    dsts->clear();
+    seq=__atomic_load_n(&snap_header->layout_seq,__ATOMIC_ACQUIRE);
+    if(!ReadNodes(&recs)) {
+      return false;
+    }
+    for(int i=0;i<recs.size();i++) {
+      const NodeRec &node=recs.at(i);
+      QString host_name=GetString(node.host_name,DROUTER_SNAPSHOT_NAME_SIZE);
+      for(uint32_t j=0;j<node.destinations;j++) {
+	if(!ReadRecord(snap_destinations+node.first_destination+j,&rec)) {
+	  return false;
+	}
+	ProtoIpcMessage::Destination dst;
+	dst.host_address=QHostAddress(node.host_address);
+	dst.slot=rec.slot;
+	dst.matrix_type=node.matrix_type;
+	dst.host_name=host_name;
+	dst.stream_address=QHostAddress(rec.stream_address);
+	dst.name=GetString(rec.name,DROUTER_SNAPSHOT_NAME_SIZE);
+	dst.channels=rec.channels;
+	dsts->push_back(dst);
+      }
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&snap_header->layout_seq,__ATOMIC_RELAXED)==seq) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool StateSnapshot::gpis(QList<ProtoIpcMessage::Gpi> *gpis) const
+{
+  QList<NodeRec> recs;
+  GpiRec rec;
+  uint32_t seq;
+
+  for(int retry=0;retry<DROUTER_SNAPSHOT_MAX_RETRIES;retry++) {
+    gpis->clear();
+    seq=__atomic_load_n(&snap_header->layout_seq,__ATOMIC_ACQUIRE);
+    if(!ReadNodes(&recs)) {
+      return false;
+    }
+    for(int i=0;i<recs.size();i++) {
+      const NodeRec &node=recs.at(i);
+      QString host_name=GetString(node.host_name,DROUTER_SNAPSHOT_NAME_SIZE);
+      for(uint32_t j=0;j<node.gpis;j++) {
+	if(!ReadRecord(snap_gpis+node.first_gpi+j,&rec)) {
+	  return false;
+	}
+	ProtoIpcMessage::Gpi gpi;
+	gpi.host_address=QHostAddress(node.host_address);
+	gpi.slot=rec.slot;
+	gpi.matrix_type=node.matrix_type;
+	gpi.host_name=host_name;
+	gpi.code=GetString(rec.code,DROUTER_SNAPSHOT_CODE_SIZE);
+	gpis->push_back(gpi);
+      }
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&snap_header->layout_seq,__ATOMIC_RELAXED)==seq) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool StateSnapshot::gpos(QList<ProtoIpcMessage::Gpo> *gpos) const
+{
+  QList<NodeRec> recs;
+  GpoRec rec;
+  uint32_t seq;
+
+  for(int retry=0;retry<DROUTER_SNAPSHOT_MAX_RETRIES;retry++) {
+    gpos->clear();
+    seq=__atomic_load_n(&snap_header->layout_seq,__ATOMIC_ACQUIRE);
+    if(!ReadNodes(&recs)) {
+      return false;
+    }
+    for(int i=0;i<recs.size();i++) {
+      const NodeRec &node=recs.at(i);
+      QString host_name=GetString(node.host_name,DROUTER_SNAPSHOT_NAME_SIZE);
+      for(uint32_t j=0;j<node.gpos;j++) {
+	if(!ReadRecord(snap_gpos+node.first_gpo+j,&rec)) {
+	  return false;
+	}
+	ProtoIpcMessage::Gpo gpo;
+	gpo.host_address=QHostAddress(node.host_address);
+	gpo.slot=rec.slot;
+	gpo.matrix_type=node.matrix_type;
+	gpo.host_name=host_name;
+	gpo.code=GetString(rec.code,DROUTER_SNAPSHOT_CODE_SIZE);
+	gpo.name=GetString(rec.name,DROUTER_SNAPSHOT_NAME_SIZE);
+	if(rec.source_address!=0) {
+	  gpo.source_address=QHostAddress(rec.source_address);
+	}
+	gpo.source_slot=rec.source_slot;
+	gpos->push_back(gpo);
+      }
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&snap_header->layout_seq,__ATOMIC_RELAXED)==seq) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool StateSnapshot::alarms(QList<ProtoIpcMessage::Alarm> *alarms,
+			   AlarmType type,int meter_type,int chan) const
+{
+  QList<NodeRec> recs;
+  SourceRec src;
+  DestinationRec dst;
+  uint32_t seq;
+  bool input=meter_type==SyLwrpClient::InputMeter;
+
+  if((chan<0)||(chan>1)) {
+    return false;
+  }
+  for(int retry=0;retry<DROUTER_SNAPSHOT_MAX_RETRIES;retry++) {
+    alarms->clear();
+    seq=__atomic_load_n(&snap_header->layout_seq,__ATOMIC_ACQUIRE);
+    if(!ReadNodes(&recs)) {
+      return false;
+    }
+    for(int i=0;i<recs.size();i++) {
+      const NodeRec &node=recs.at(i);
+      uint32_t quan=input ? node.sources : node.destinations;
+      for(uint32_t j=0;j<quan;j++) {
+	ProtoIpcMessage::Alarm alarm;
+	alarm.host_address=QHostAddress(node.host_address);
+	alarm.meter_type=meter_type;
+	alarm.chan=chan;
+	if(input) {
+	  if(!ReadRecord(snap_sources+node.first_source+j,&src)) {
+	    return false;
+	  }
+	  alarm.slot=src.slot;
+	  alarm.state=src.alarms[type][chan]!=0;
+	}
+	else {
+	  if(!ReadRecord(snap_destinations+node.first_destination+j,&dst)) {
+	    return false;
+	  }
+	  alarm.slot=dst.slot;
+	  alarm.state=dst.alarms[type][chan]!=0;
+	}
+	alarms->push_back(alarm);
+      }
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&snap_header->layout_seq,__ATOMIC_RELAXED)==seq) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+void StateSnapshot::rebuild(const QList<ProtoIpcMessage::Node> &nodes,
+			    const QList<ProtoIpcMessage::Source> &srcs,
+			    const QList<ProtoIpcMessage::Destination> &dsts,
+			    const QList<ProtoIpcMessage::Gpi> &gpis,
+			    const QList<ProtoIpcMessage::Gpo> &gpos)
+{
+  int src_ptr=0;
+  int dst_ptr=0;
+  int gpi_ptr=0;
+  int gpo_ptr=0;
+
+  if((!snap_writeable)||(snap_header==NULL)) {
+    return;
+  }
+  BeginWrite(&snap_header->layout_seq);
+  snap_node_index.clear();
+
+  //
+  // Check Capacity
+  //
+  uint32_t max_slots=snap_header->max_slots;
+  if((nodes.size()>(int)snap_header->max_nodes)||
+     (srcs.size()>(int)max_slots)||(dsts.size()>(int)max_slots)||
+     (gpis.size()>(int)max_slots)||(gpos.size()>(int)max_slots)) {
+    if(snap_header->overflow==0) {
+      syslog(LOG_WARNING,
+	     "state snapshot capacity exceeded (%d nodes, %d/%d/%d/%d slots), protocols will use the database",
+	     nodes.size(),srcs.size(),dsts.size(),gpis.size(),gpos.size());
+    }
+    snap_header->overflow=1;
+    snap_header->nodes=0;
+    EndWrite(&snap_header->layout_seq);
+    return;
+  }
+  snap_header->overflow=0;
+
+  for(int i=0;i<nodes.size();i++) {
+    const ProtoIpcMessage::Node &node=nodes.at(i);
+    NodeRec *rec=snap_nodes+i;
+    uint32_t addr=node.host_address.toIPv4Address();
+
+    rec->host_address=addr;
+    rec->matrix_type=node.matrix_type;
+    rec->sources=node.sources;
+    rec->destinations=node.destinations;
+    rec->gpis=node.gpis;
+    rec->gpos=node.gpos;
+    rec->first_source=src_ptr;
+    rec->first_destination=dst_ptr;
+    rec->first_gpi=gpi_ptr;
+    rec->first_gpo=gpo_ptr;
+    SetString(rec->host_name,node.host_name,DROUTER_SNAPSHOT_NAME_SIZE);
+    SetString(rec->device_name,node.device_name,
+	      DROUTER_SNAPSHOT_DEVICE_SIZE);
+    snap_node_index[addr]=i;
+
+    for(int j=0;j<node.sources;j++) {
+      const ProtoIpcMessage::Source &src=srcs.at(src_ptr);
+      SourceRec *srec=snap_sources+src_ptr++;
+      srec->slot=src.slot;
+      srec->stream_address=src.stream_address.toIPv4Address();
+      srec->enabled=src.enabled;
+      srec->channels=src.channels;
+      srec->block_size=src.block_size;
+      ApplyAlarms(addr,src.slot,SNAPSHOT_KIND_SOURCE,srec->alarms);
+      SetString(srec->name,src.name,DROUTER_SNAPSHOT_NAME_SIZE);
+    }
+    for(int j=0;j<node.destinations;j++) {
+      const ProtoIpcMessage::Destination &dst=dsts.at(dst_ptr);
+      DestinationRec *drec=snap_destinations+dst_ptr++;
+      drec->slot=dst.slot;
+      drec->stream_address=dst.stream_address.toIPv4Address();
+      drec->channels=dst.channels;
+      ApplyAlarms(addr,dst.slot,SNAPSHOT_KIND_DESTINATION,drec->alarms);
+      SetString(drec->name,dst.name,DROUTER_SNAPSHOT_NAME_SIZE);
+    }
+    for(int j=0;j<node.gpis;j++) {
+      const ProtoIpcMessage::Gpi &gpi=gpis.at(gpi_ptr);
+      GpiRec *grec=snap_gpis+gpi_ptr++;
+      grec->slot=gpi.slot;
+      SetString(grec->code,gpi.code,DROUTER_SNAPSHOT_CODE_SIZE);
+    }
+    for(int j=0;j<node.gpos;j++) {
+      const ProtoIpcMessage::Gpo &gpo=gpos.at(gpo_ptr);
+      GpoRec *grec=snap_gpos+gpo_ptr++;
+      grec->slot=gpo.slot;
+      grec->source_address=
+	gpo.source_address.isNull() ? 0 : gpo.source_address.toIPv4Address();
+      grec->source_slot=gpo.source_slot;
+      SetString(grec->code,gpo.code,DROUTER_SNAPSHOT_CODE_SIZE);
+      SetString(grec->name,gpo.name,DROUTER_SNAPSHOT_NAME_SIZE);
+    }
+  }
+  snap_header->nodes=nodes.size();
+  snap_header->sources=src_ptr;
+  snap_header->destinations=dst_ptr;
+  snap_header->gpis=gpi_ptr;
+  snap_header->gpos=gpo_ptr;
+
+  EndWrite(&snap_header->layout_seq);
+}
+
+
+void StateSnapshot::setTetherState(bool state)
+{
+  if((!snap_writeable)||(snap_header==NULL)) {
+    return;
+  }
+  BeginWrite(&snap_header->tether_seq);
+  snap_header->writeable=state;
+  EndWrite(&snap_header->tether_seq);
+}
+
+
+void StateSnapshot::updateSource(const ProtoIpcMessage::Source &src)
+{
+  int index=SlotIndex(src.host_address.toIPv4Address(),src.slot,
+		      SNAPSHOT_KIND_SOURCE);
+  if(index<0) {
+    return;
+  }
+  SourceRec *rec=snap_sources+index;
+  BeginWrite(&rec->seq);
+  rec->stream_address=src.stream_address.toIPv4Address();
+  rec->enabled=src.enabled;
+  rec->channels=src.channels;
+  rec->block_size=src.block_size;
+  SetString(rec->name,src.name,DROUTER_SNAPSHOT_NAME_SIZE);
+  EndWrite(&rec->seq);
+  UpdateHostName(src.host_address.toIPv4Address(),src.host_name);
+}
+
+
+void StateSnapshot::updateDestination(const ProtoIpcMessage::Destination &dst)
+{
+  int index=SlotIndex(dst.host_address.toIPv4Address(),dst.slot,
+		      SNAPSHOT_KIND_DESTINATION);
+  if(index<0) {
+    return;
+  }
+  DestinationRec *rec=snap_destinations+index;
+  BeginWrite(&rec->seq);
+  rec->stream_address=dst.stream_address.toIPv4Address();
+  rec->channels=dst.channels;
+  SetString(rec->name,dst.name,DROUTER_SNAPSHOT_NAME_SIZE);
+  EndWrite(&rec->seq);
+  UpdateHostName(dst.host_address.toIPv4Address(),dst.host_name);
+}
+
+
+void StateSnapshot::updateGpi(const ProtoIpcMessage::Gpi &gpi)
+{
+  int index=SlotIndex(gpi.host_address.toIPv4Address(),gpi.slot,
+		      SNAPSHOT_KIND_GPI);
+  if(index<0) {
+    return;
+  }
+  GpiRec *rec=snap_gpis+index;
+  BeginWrite(&rec->seq);
+  SetString(rec->code,gpi.code,DROUTER_SNAPSHOT_CODE_SIZE);
+  EndWrite(&rec->seq);
+}
+
+
+void StateSnapshot::updateGpo(const ProtoIpcMessage::Gpo &gpo)
+{
+  int index=SlotIndex(gpo.host_address.toIPv4Address(),gpo.slot,
+		      SNAPSHOT_KIND_GPO);
+  if(index<0) {
+    return;
+  }
+  GpoRec *rec=snap_gpos+index;
+  BeginWrite(&rec->seq);
+  rec->source_address=
+    gpo.source_address.isNull() ? 0 : gpo.source_address.toIPv4Address();
+  rec->source_slot=gpo.source_slot;
+  SetString(rec->code,gpo.code,DROUTER_SNAPSHOT_CODE_SIZE);
+  SetString(rec->name,gpo.name,DROUTER_SNAPSHOT_NAME_SIZE);
+  EndWrite(&rec->seq);
+}
+
+
+void StateSnapshot::setAlarm(const ProtoIpcMessage::Alarm &alarm,
+			     AlarmType type)
+{
+  uint32_t addr=alarm.host_address.toIPv4Address();
+  int kind=SNAPSHOT_KIND_DESTINATION;
+  int index=-1;
+
+  if((!snap_writeable)||(alarm.chan<0)||(alarm.chan>1)) {
+    return;
+  }
+  if(alarm.meter_type==SyLwrpClient::InputMeter) {
+    kind=SNAPSHOT_KIND_SOURCE;
+  }
+
+  //
+  // Remember the state so that it survives a layout rebuild
+  //
+  quint64 key=AlarmKey(addr,kind,alarm.slot);
+  uint8_t bits=snap_alarms.value(key);
+  uint8_t mask=1<<(2*type+alarm.chan);
+  if(alarm.state) {
+    bits|=mask;
+  }
+  else {
+    bits&=~mask;
+  }
+  if(bits==0) {
+    snap_alarms.remove(key);
+  }
+  else {
+    snap_alarms[key]=bits;
+  }
+
+  if((index=SlotIndex(addr,alarm.slot,kind))<0) {
+    return;
+  }
+  if(kind==SNAPSHOT_KIND_SOURCE) {
+    SourceRec *rec=snap_sources+index;
+    BeginWrite(&rec->seq);
+    rec->alarms[type][alarm.chan]=alarm.state;
+    EndWrite(&rec->seq);
+  }
+  else {
+    DestinationRec *rec=snap_destinations+index;
+    BeginWrite(&rec->seq);
+    rec->alarms[type][alarm.chan]=alarm.state;
+    EndWrite(&rec->seq);
+  }
+}
+
+
+void StateSnapshot::clearAlarms(const QHostAddress &host_addr)
+{
+  uint32_t addr=host_addr.toIPv4Address();
+
+  QHash<quint64,uint8_t>::iterator it=snap_alarms.begin();
+  while(it!=snap_alarms.end()) {
+    if((it.key()>>32)==addr) {
+      it=snap_alarms.erase(it);
+    }
+    else {
+      it++;
+    }
+  }
+}
+
+
+bool StateSnapshot::Map(int fd,bool writeable,QString *err_msg)
+{
+  //
+  // Called with a descriptor to map the object, then with -1 to set
+  // the table pointers once the header is readable.
+  //
+  if(fd>=0) {
+    int prot=PROT_READ;
+    if(writeable) {
+      prot|=PROT_WRITE;
+    }
+    if((snap_base=mmap(NULL,snap_size,prot,MAP_SHARED,fd,0))==MAP_FAILED) {
+      *err_msg=QString("unable to map state snapshot [")+
+	strerror(errno)+"]";
+      snap_base=NULL;
+      return false;
+    }
+    snap_writeable=writeable;
+    snap_header=(Header *)snap_base;
+    return true;
+  }
+
+  size_t max_nodes=snap_header->max_nodes;
+  size_t max_slots=snap_header->max_slots;
+  size_t size=sizeof(Header)+max_nodes*sizeof(NodeRec)+
+    max_slots*(sizeof(SourceRec)+sizeof(DestinationRec)+
+	       sizeof(GpiRec)+sizeof(GpoRec));
+  if(size>snap_size) {
+    *err_msg="state snapshot is truncated";
+    return false;
+  }
+  char *ptr=(char *)snap_base+sizeof(Header);
+  snap_nodes=(NodeRec *)ptr;
+  ptr+=max_nodes*sizeof(NodeRec);
+  snap_sources=(SourceRec *)ptr;
+  ptr+=max_slots*sizeof(SourceRec);
+  snap_destinations=(DestinationRec *)ptr;
+  ptr+=max_slots*sizeof(DestinationRec);
+  snap_gpis=(GpiRec *)ptr;
+  ptr+=max_slots*sizeof(GpiRec);
+  snap_gpos=(GpoRec *)ptr;
+
+  return true;
+}
+
+
+void StateSnapshot::Unmap()
+{
+  if(snap_base!=NULL) {
+    munmap(snap_base,snap_size);
+  }
+  snap_base=NULL;
+  snap_size=0;
+  snap_writeable=false;
+  snap_header=NULL;
+  snap_nodes=NULL;
+  snap_sources=NULL;
+  snap_destinations=NULL;
+  snap_gpis=NULL;
+  snap_gpos=NULL;
+}
+
+
+bool StateSnapshot::ReadNodes(QList<NodeRec> *nodes) const
+{
+  uint32_t seq;
+  NodeRec rec;
+
+  if(!isValid()) {
+    return false;
+  }
+  for(int retry=0;retry<DROUTER_SNAPSHOT_MAX_RETRIES;retry++) {
+    nodes->clear();
+    seq=__atomic_load_n(&snap_header->layout_seq,__ATOMIC_ACQUIRE);
+    if((seq&1)!=0) {
+      continue;
+    }
+    uint32_t quan=snap_header->nodes;
+    if(quan>snap_header->max_nodes) {
+      continue;
+    }
+    for(uint32_t i=0;i<quan;i++) {
+      if(!ReadRecord(snap_nodes+i,&rec)) {
+	return false;
+      }
+      nodes->push_back(rec);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(__atomic_load_n(&snap_header->layout_seq,__ATOMIC_RELAXED)==seq) {
+      return isValid();
+    }
+  }
+  return false;
+}
+
+
+template<class T> bool StateSnapshot::ReadRecord(const T *rec,T *copy) const
+{
+  uint32_t seq;
+
+  for(int i=0;i<DROUTER_SNAPSHOT_MAX_RETRIES;i++) {
+    seq=__atomic_load_n(&rec->seq,__ATOMIC_ACQUIRE);
+    if((seq&1)==0) {
+      memcpy(copy,rec,sizeof(T));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if(__atomic_load_n(&rec->seq,__ATOMIC_RELAXED)==seq) {
+	return true;
+      }
+    }
+  }
+  return false;
+}
+
+
+void StateSnapshot::BeginWrite(uint32_t *seq)
+{
+  __atomic_store_n(seq,*seq+1,__ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+
+void StateSnapshot::EndWrite(uint32_t *seq)
+{
+  __atomic_store_n(seq,*seq+1,__ATOMIC_RELEASE);
+}
+
+
+int StateSnapshot::SlotIndex(uint32_t host_addr,int slot,int kind) const
+{
+  if((!snap_writeable)||(snap_header==NULL)||(slot<0)) {
+    return -1;
+  }
+  QHash<uint32_t,int>::const_iterator it=snap_node_index.find(host_addr);
+  if(it==snap_node_index.end()) {
+    return -1;
+  }
+  const NodeRec *node=snap_nodes+it.value();
+  switch(kind) {
+  case SNAPSHOT_KIND_SOURCE:
+    if(slot<(int)node->sources) {
+      return node->first_source+slot;
+    }
+    break;
+
+  case SNAPSHOT_KIND_DESTINATION:
+    if(slot<(int)node->destinations) {
+      return node->first_destination+slot;
+    }
+    break;
+
+  case SNAPSHOT_KIND_GPI:
+    if(slot<(int)node->gpis) {
+      return node->first_gpi+slot;
+    }
+    break;
+
+  case SNAPSHOT_KIND_GPO:
+    if(slot<(int)node->gpos) {
+      return node->first_gpo+slot;
+    }
+    break;
+  }
+  return -1;
+}
+
+
+void StateSnapshot::UpdateHostName(uint32_t host_addr,const QString &str)
+{
+  QHash<uint32_t,int>::const_iterator it=snap_node_index.find(host_addr);
+  if(it==snap_node_index.end()) {
+    return;
+  }
+  NodeRec *node=snap_nodes+it.value();
+  if(GetString(node->host_name,DROUTER_SNAPSHOT_NAME_SIZE)!=str) {
+    BeginWrite(&node->seq);
+    SetString(node->host_name,str,DROUTER_SNAPSHOT_NAME_SIZE);
+    EndWrite(&node->seq);
+  }
+}
+
+
+void StateSnapshot::ApplyAlarms(uint32_t host_addr,int slot,int kind,
+				uint8_t alarms[2][2])
+{
+  uint8_t bits=snap_alarms.value(AlarmKey(host_addr,kind,slot));
+
+  for(int i=0;i<2;i++) {
+    for(int j=0;j<2;j++) {
+      alarms[i][j]=(bits>>(2*i+j))&1;
+    }
+  }
+}
+
+
+quint64 StateSnapshot::AlarmKey(uint32_t host_addr,int kind,int slot)
+{
+  return ((quint64)host_addr<<32)|((quint64)(0xFF&kind)<<24)|
+    (0xFFFFFF&slot);
+}
+
+
+void StateSnapshot::SetString(char *dest,const QString &str,int size)
+{
+  QByteArray data;
+  int chars=(size-1)/3;
+  int end=0;
+  int len=0;
+
+  //
+  // Truncate to the column width in characters, then (for characters
+  // outside the BMP) on a UTF-8 character boundary
+  //
+  for(int i=0;(i<chars)&&(end<str.size());i++) {
+    if(str.at(end).isHighSurrogate()&&((end+1)<str.size())) {
+      end++;
+    }
+    end++;
+  }
+  data=str.left(end).toUtf8();
+  len=data.size();
+  if(len>(size-1)) {
+    len=size-1;
+    while((len>0)&&((0xC0&data.at(len))==0x80)) {
+      len--;
+    }
+  }
+  memcpy(dest,data.constData(),len);
+  memset(dest+len,0,size-len);
+}
+
+
+QString StateSnapshot::GetString(const char *src,int size)
+{
+  return QString::fromUtf8(src,qstrnlen(src,size));
+}
@@ -0,0 +1,177 @@
+// statesnapshot.h
+//
+// Shared memory snapshot of Drouter node state
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef STATESNAPSHOT_H
+#define STATESNAPSHOT_H
+
+#include <stdint.h>
+
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QString>
+
+#include "protoipc.h"
+
+/*
+ * The POSIX shared memory object name
+ */
+#define DROUTER_SNAPSHOT_NAME "/drouter-state"
+#define DROUTER_SNAPSHOT_MAGIC 0x44525353
+#define DROUTER_SNAPSHOT_VERSION 2
+#define DROUTER_SNAPSHOT_CODE_SIZE 16
+#define DROUTER_SNAPSHOT_MAX_SIZE 0x7FFFFFFFu
+
+/*
+ * String fields hold as many characters as the matching char(N) column
+ * in the database, at up to three bytes each (the 'utf8' character set)
+ */
+#define DROUTER_SNAPSHOT_NAME_SIZE (3*191+1)
+#define DROUTER_SNAPSHOT_DEVICE_SIZE (3*20+1)
+#define DROUTER_SNAPSHOT_MAX_RETRIES 100
+
+//
+// Fixed-layout copy of the router state, published by drouterd(8) and
+// mapped read-only by the protocol processes. The node table is guarded
+// by a layout sequence counter that changes only when nodes come and go;
+// each record carries its own sequence counter for point updates.
+//
+class StateSnapshot
+{
+ public:
+  enum AlarmType {ClipAlarm=0,SilenceAlarm=1};
+  StateSnapshot();
+  ~StateSnapshot();
+  bool create(int max_nodes,int max_slots,bool tether_state,
+	      QString *err_msg);
+  bool attach(QString *err_msg);
+  bool isValid() const;
+  bool tetherState(bool *state) const;
+  bool node(const QHostAddress &host_addr,ProtoIpcMessage::Node *node) const;
+  bool nodes(QList<ProtoIpcMessage::Node> *nodes) const;
+  bool sources(QList<ProtoIpcMessage::Source> *srcs) const;
+  bool destinations(QList<ProtoIpcMessage::Destination> *dsts) const;
+  bool gpis(QList<ProtoIpcMessage::Gpi> *gpis) const;
+  bool gpos(QList<ProtoIpcMessage::Gpo> *gpos) const;
+  bool alarms(QList<ProtoIpcMessage::Alarm> *alarms,AlarmType type,
+	      int meter_type,int chan) const;
+  void rebuild(const QList<ProtoIpcMessage::Node> &nodes,
+	       const QList<ProtoIpcMessage::Source> &srcs,
+	       const QList<ProtoIpcMessage::Destination> &dsts,
+	       const QList<ProtoIpcMessage::Gpi> &gpis,
+	       const QList<ProtoIpcMessage::Gpo> &gpos);
+  void setTetherState(bool state);
+  void updateSource(const ProtoIpcMessage::Source &src);
+  void updateDestination(const ProtoIpcMessage::Destination &dst);
+  void updateGpi(const ProtoIpcMessage::Gpi &gpi);
+  void updateGpo(const ProtoIpcMessage::Gpo &gpo);
+  void setAlarm(const ProtoIpcMessage::Alarm &alarm,AlarmType type);
+  void clearAlarms(const QHostAddress &host_addr);
+
+ private:
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t valid;
+    uint32_t layout_seq;
+    uint32_t max_nodes;
+    uint32_t max_slots;
+    uint32_t nodes;
+    uint32_t sources;
+    uint32_t destinations;
+    uint32_t gpis;
+    uint32_t gpos;
+    uint32_t overflow;
+    uint32_t tether_seq;
+    uint32_t writeable;
+  };
+  struct NodeRec {
+    uint32_t seq;
+    uint32_t host_address;
+    int32_t matrix_type;
+    uint32_t sources;
+    uint32_t destinations;
+    uint32_t gpis;
+    uint32_t gpos;
+    uint32_t first_source;
+    uint32_t first_destination;
+    uint32_t first_gpi;
+    uint32_t first_gpo;
+    char host_name[DROUTER_SNAPSHOT_NAME_SIZE];
+    char device_name[DROUTER_SNAPSHOT_DEVICE_SIZE];
+  };
+  struct SourceRec {
+    uint32_t seq;
+    int32_t slot;
+    uint32_t stream_address;
+    uint32_t enabled;
+    uint32_t channels;
+    uint32_t block_size;
+    uint8_t alarms[2][2];
+    char name[DROUTER_SNAPSHOT_NAME_SIZE];
+  };
+  struct DestinationRec {
+    uint32_t seq;
+    int32_t slot;
+    uint32_t stream_address;
+    uint32_t channels;
+    uint8_t alarms[2][2];
+    char name[DROUTER_SNAPSHOT_NAME_SIZE];
+  };
+  struct GpiRec {
+    uint32_t seq;
+    int32_t slot;
+    char code[DROUTER_SNAPSHOT_CODE_SIZE];
+  };
+  struct GpoRec {
+    uint32_t seq;
+    int32_t slot;
+    uint32_t source_address;
+    int32_t source_slot;
+    char code[DROUTER_SNAPSHOT_CODE_SIZE];
+    char name[DROUTER_SNAPSHOT_NAME_SIZE];
+  };
+  bool Map(int fd,bool writeable,QString *err_msg);
+  void Unmap();
+  bool ReadNodes(QList<NodeRec> *nodes) const;
+  template<class T> bool ReadRecord(const T *rec,T *copy) const;
+  void BeginWrite(uint32_t *seq);
+  void EndWrite(uint32_t *seq);
+  int SlotIndex(uint32_t host_addr,int slot,int kind) const;
+  void UpdateHostName(uint32_t host_addr,const QString &str);
+  void ApplyAlarms(uint32_t host_addr,int slot,int kind,uint8_t alarms[2][2]);
+  static quint64 AlarmKey(uint32_t host_addr,int kind,int slot);
+  static void SetString(char *dest,const QString &str,int size);
+  static QString GetString(const char *src,int size);
+  void *snap_base;
+  size_t snap_size;
+  bool snap_writeable;
+  Header *snap_header;
+  NodeRec *snap_nodes;
+  SourceRec *snap_sources;
+  DestinationRec *snap_destinations;
+  GpiRec *snap_gpis;
+  GpoRec *snap_gpos;
+  QHash<uint32_t,int> snap_node_index;
+  QHash<quint64,uint8_t> snap_alarms;
+};
+
+
+#endif  // STATESNAPSHOT_H
@@ -0,0 +1,371 @@
+// statestore.cpp
+//
+// In-memory model of Drouter node state
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include "statestore.h"
+
+StateStore::Source::Source()
+{
+  exists=false;
+  stream_address=0;
+  enabled=false;
+  channels=0;
+  packet_size=0;
+  number=-1;
+}
+
+
+StateStore::Destination::Destination()
+{
+  exists=false;
+  stream_address=0;
+  channels=0;
+}
+
+
+StateStore::Gpo::Gpo()
+{
+  source_address=0;
+  source_slot=-1;
+}
+
+
+StateStore::StateStore()
+{
+}
+
+
+StateStore::~StateStore()
+{
+  clear();
+}
+
+
+int StateStore::nodeQuantity() const
+{
+  return store_nodes.size();
+}
+
+
+const StateStore::Node *StateStore::node(unsigned id) const
+{
+  return store_nodes.value(id);
+}
+
+
+QList<unsigned> StateStore::nodeIds() const
+{
+  return store_nodes.keys();
+}
+
+
+const StateStore::Source *StateStore::source(unsigned id,int slot) const
+{
+  Node *n=store_nodes.value(id);
+  if((n==NULL)||(slot<0)||(slot>=n->sources.size())) {
+    return NULL;
+  }
+  return &(n->sources.at(slot));
+}
+
+
+const StateStore::Destination *StateStore::destination(unsigned id,
+						       int slot) const
+{
+  Node *n=store_nodes.value(id);
+  if((n==NULL)||(slot<0)||(slot>=n->destinations.size())) {
+    return NULL;
+  }
+  return &(n->destinations.at(slot));
+}
+
+
+const StateStore::Gpi *StateStore::gpi(unsigned id,int slot) const
+{
+  Node *n=store_nodes.value(id);
+  if((n==NULL)||(slot<0)||(slot>=n->gpis.size())) {
+    return NULL;
+  }
+  return &(n->gpis.at(slot));
+}
+
+
+const StateStore::Gpo *StateStore::gpo(unsigned id,int slot) const
+{
+  Node *n=store_nodes.value(id);
+  if((n==NULL)||(slot<0)||(slot>=n->gpos.size())) {
+    return NULL;
+  }
+  return &(n->gpos.at(slot));
+}
+
+
+bool StateStore::sourceByStream(uint32_t stream_addr,unsigned *id,
+				int *slot) const
+{
+  return FirstMatch(store_stream_index.values(stream_addr),id,slot);
+}
+
+
+bool StateStore::sourceByNumber(int srcnum,unsigned *id,int *slot) const
+{
+  return FirstMatch(store_number_index.values(srcnum),id,slot);
+}
+
+
+const StateStore::Node *StateStore::addNode(Matrix *mtx)
+{
+  Node *n=store_nodes.value(mtx->id());
+
+  if(n==NULL) {
+    n=new Node();
+    store_nodes[mtx->id()]=n;
+  }
+  else {
+    for(int i=0;i<n->sources.size();i++) {
+      UnindexSource(n->id,i,n->sources.at(i));
+    }
+  }
+  n->id=mtx->id();
+  n->matrix_type=mtx->matrixType();
+  n->host_name=mtx->hostName();
+  n->device_name=mtx->deviceName();
+
+  n->sources.resize(mtx->srcSlots());
+  for(unsigned i=0;i<mtx->srcSlots();i++) {
+    Source *src=&(n->sources[i]);
+    src->exists=(mtx->src(i)!=NULL)&&mtx->src(i)->exists();
+    src->stream_address=
+      Config::normalizedStreamAddress(mtx->srcAddress(i)).toIPv4Address();
+    src->name=mtx->srcName(i);
+    src->enabled=mtx->srcEnabled(i);
+    src->channels=mtx->srcChannels(i);
+    src->packet_size=mtx->srcPacketSize(i);
+    src->number=mtx->srcNumber(i);
+    IndexSource(n->id,i,*src);
+  }
+
+  n->destinations.resize(mtx->dstSlots());
+  for(unsigned i=0;i<mtx->dstSlots();i++) {
+    Destination *dst=&(n->destinations[i]);
+    dst->exists=(mtx->dst(i)!=NULL)&&mtx->dst(i)->exists();
+    dst->stream_address=
+      Config::normalizedStreamAddress(mtx->dstAddress(i)).toIPv4Address();
+    dst->name=mtx->dstName(i);
+    dst->channels=mtx->dstChannels(i);
+  }
+
+  n->gpis.resize(mtx->gpis());
+  for(unsigned i=0;i<mtx->gpis();i++) {
+    if(mtx->gpiBundle(i)!=NULL) {
+      n->gpis[i].code=mtx->gpiBundle(i)->code().toLower();
+    }
+  }
+
+  n->gpos.resize(mtx->gpos());
+  for(unsigned i=0;i<mtx->gpos();i++) {
+    Gpo *gpo=&(n->gpos[i]);
+    if(mtx->gpo(i)!=NULL) {
+      gpo->code=mtx->gpo(i)->bundle()->code().toLower();
+      gpo->name=mtx->gpo(i)->name();
+      gpo->source_address=mtx->gpo(i)->sourceAddress().toIPv4Address();
+      gpo->source_slot=mtx->gpo(i)->sourceSlot();
+    }
+  }
+
+  return n;
+}
+
+
+void StateStore::removeNode(unsigned id)
+{
+  Node *n=store_nodes.take(id);
+  if(n!=NULL) {
+    for(int i=0;i<n->sources.size();i++) {
+      UnindexSource(id,i,n->sources.at(i));
+    }
+    delete n;
+  }
+}
+
+
+bool StateStore::updateSource(unsigned id,int slot,const SyNode &node,
+			      const SySource &src,int srcnum)
+{
+  Node *n=store_nodes.value(id);
+  if((n==NULL)||(slot<0)||(slot>=n->sources.size())) {
+    return false;
+  }
+  Source *s=&(n->sources[slot]);
+  uint32_t saddr=
+    Config::normalizedStreamAddress(src.streamAddress()).toIPv4Address();
+  bool changed=(n->host_name!=node.hostName())||
+    (s->stream_address!=saddr)||
+    (s->name!=src.name())||
+    (s->enabled!=src.enabled())||
+    (s->channels!=src.channels())||
+    (s->packet_size!=src.packetSize());
+
+  UnindexSource(id,slot,*s);
+  n->host_name=node.hostName();
+  s->exists=src.exists();
+  s->stream_address=saddr;
+  s->name=src.name();
+  s->enabled=src.enabled();
+  s->channels=src.channels();
+  s->packet_size=src.packetSize();
+  s->number=srcnum;
+  IndexSource(id,slot,*s);
+
+  return changed;
+}
+
+
+bool StateStore::updateDestination(unsigned id,int slot,const SyNode &node,
+				   const SyDestination &dst,
+				   bool *xpoint_changed)
+{
+  *xpoint_changed=false;
+  Node *n=store_nodes.value(id);
+  if((n==NULL)||(slot<0)||(slot>=n->destinations.size())) {
+    return false;
+  }
+  Destination *d=&(n->destinations[slot]);
+  uint32_t saddr=
+    Config::normalizedStreamAddress(dst.streamAddress()).toIPv4Address();
+  *xpoint_changed=d->stream_address!=saddr;
+  bool changed=*xpoint_changed||
+    (n->host_name!=node.hostName())||
+    (d->name!=dst.name())||
+    (d->channels!=dst.channels());
+
+  n->host_name=node.hostName();
+  d->exists=dst.exists();
+  d->stream_address=saddr;
+  d->name=dst.name();
+  d->channels=dst.channels();
+
+  return changed;
+}
+
+
+bool StateStore::updateGpi(unsigned id,int slot,const SyGpioBundle &gpi,
+			   bool *code_changed)
+{
+  *code_changed=false;
+  Node *n=store_nodes.value(id);
+  if((n==NULL)||(slot<0)||(slot>=n->gpis.size())) {
+    return false;
+  }
+  QString code=gpi.code().toLower();
+  *code_changed=n->gpis.at(slot).code!=code;
+  n->gpis[slot].code=code;
+
+  //
+  // A GPI reasserted with an unchanged code is still an event
+  //
+  return true;
+}
+
+
+bool StateStore::updateGpo(unsigned id,int slot,const SyGpo &gpo,
+			   bool *xpoint_changed,bool *code_changed)
+{
+  *xpoint_changed=false;
+  *code_changed=false;
+  Node *n=store_nodes.value(id);
+  if((n==NULL)||(slot<0)||(slot>=n->gpos.size())) {
+    return false;
+  }
+  Gpo *g=&(n->gpos[slot]);
+  QString code=gpo.bundle()->code().toLower();
+  uint32_t saddr=gpo.sourceAddress().toIPv4Address();
+  *xpoint_changed=(g->source_address!=saddr)||
+    (g->source_slot!=gpo.sourceSlot());
+  *code_changed=g->code!=code;
+  bool changed=*xpoint_changed||*code_changed||(g->name!=gpo.name());
+
+  g->code=code;
+  g->name=gpo.name();
+  g->source_address=saddr;
+  g->source_slot=gpo.sourceSlot();
+
+  return changed;
+}
+
+
+void StateStore::clear()
+{
+  for(QHash<unsigned,Node *>::const_iterator it=store_nodes.constBegin();
+      it!=store_nodes.constEnd();it++) {
+    delete it.value();
+  }
+  store_nodes.clear();
+  store_stream_index.clear();
+  store_number_index.clear();
+}
+
+
+void StateStore::IndexSource(unsigned id,int slot,const Source &src)
+{
+  //
+  // Null streams (x.x.0.0) never match a crosspoint, so keep them out
+  //
+  if((0xFFFF&src.stream_address)!=0) {
+    store_stream_index.insert(src.stream_address,SlotKey(id,slot));
+  }
+  if(src.number>0) {
+    store_number_index.insert(src.number,SlotKey(id,slot));
+  }
+}
+
+
+void StateStore::UnindexSource(unsigned id,int slot,const Source &src)
+{
+  store_stream_index.remove(src.stream_address,SlotKey(id,slot));
+  store_number_index.remove(src.number,SlotKey(id,slot));
+}
+
+
+bool StateStore::FirstMatch(const QList<quint64> &keys,unsigned *id,int *slot)
+{
+  //
+  // Duplicate addresses resolve to the lowest node/slot, the same answer
+  // the old linear scan gave
+  //
+  if(keys.size()==0) {
+    return false;
+  }
+  quint64 key=keys.at(0);
+  for(int i=1;i<keys.size();i++) {
+    if(keys.at(i)<key) {
+      key=keys.at(i);
+    }
+  }
+  *id=key>>32;
+  *slot=0xFFFFFFFF&key;
+
+  return true;
+}
+
+
+quint64 StateStore::SlotKey(unsigned id,int slot)
+{
+  return ((quint64)id<<32)|(0xFFFFFFFF&(quint64)slot);
+}
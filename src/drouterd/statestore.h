@@ -0,0 +1,114 @@
+// statestore.h
+//
+// In-memory model of Drouter node state
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef STATESTORE_H
+#define STATESTORE_H
+
+#include <stdint.h>
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+#include <sy5/sylwrp_client.h>
+
+#include "matrix.h"
+
+//
+// The authoritative copy of node state inside drouterd. Change detection
+// is done against this model; the SQL tables are only a mirror of it.
+// Sources are also indexed by stream address and source number, so
+// crosspoint resolution does not have to walk every slot of every node.
+//
+class StateStore
+{
+ public:
+  struct Source {
+    Source();
+    bool exists;
+    uint32_t stream_address;
+    QString name;
+    bool enabled;
+    unsigned channels;
+    unsigned packet_size;
+    int number;
+  };
+  struct Destination {
+    Destination();
+    bool exists;
+    uint32_t stream_address;
+    QString name;
+    unsigned channels;
+  };
+  struct Gpi {
+    QString code;
+  };
+  struct Gpo {
+    Gpo();
+    QString code;
+    QString name;
+    uint32_t source_address;
+    int source_slot;
+  };
+  struct Node {
+    unsigned id;
+    Config::MatrixType matrix_type;
+    QString host_name;
+    QString device_name;
+    QVector<Source> sources;
+    QVector<Destination> destinations;
+    QVector<Gpi> gpis;
+    QVector<Gpo> gpos;
+  };
+  StateStore();
+  ~StateStore();
+  int nodeQuantity() const;
+  const Node *node(unsigned id) const;
+  QList<unsigned> nodeIds() const;
+  const Source *source(unsigned id,int slot) const;
+  const Destination *destination(unsigned id,int slot) const;
+  const Gpi *gpi(unsigned id,int slot) const;
+  const Gpo *gpo(unsigned id,int slot) const;
+  bool sourceByStream(uint32_t stream_addr,unsigned *id,int *slot) const;
+  bool sourceByNumber(int srcnum,unsigned *id,int *slot) const;
+  const Node *addNode(Matrix *mtx);
+  void removeNode(unsigned id);
+  bool updateSource(unsigned id,int slot,const SyNode &node,
+		    const SySource &src,int srcnum);
+  bool updateDestination(unsigned id,int slot,const SyNode &node,
+			 const SyDestination &dst,bool *xpoint_changed);
+  bool updateGpi(unsigned id,int slot,const SyGpioBundle &gpi,
+		 bool *code_changed);
+  bool updateGpo(unsigned id,int slot,const SyGpo &gpo,
+		 bool *xpoint_changed,bool *code_changed);
+  void clear();
+
+ private:
+  void IndexSource(unsigned id,int slot,const Source &src);
+  void UnindexSource(unsigned id,int slot,const Source &src);
+  static bool FirstMatch(const QList<quint64> &keys,unsigned *id,int *slot);
+  static quint64 SlotKey(unsigned id,int slot);
+  QHash<unsigned,Node *> store_nodes;
+  QMultiHash<uint32_t,quint64> store_stream_index;
+  QMultiHash<int,quint64> store_number_index;
+};
+
+
+#endif  // STATESTORE_H
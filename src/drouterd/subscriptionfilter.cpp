@@ -0,0 +1,169 @@
+// subscriptionfilter.cpp
+//
+// Record filters for Protocol D subscriptions
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include "subscriptionfilter.h"
+
+SubscriptionFilter::SubscriptionFilter()
+{
+  filter_all=true;
+}
+
+
+bool SubscriptionFilter::matchesAll() const
+{
+  return filter_all;
+}
+
+
+bool SubscriptionFilter::matches(const QHostAddress &host_addr,int slot,
+				 const QString &host_name,
+				 const QString &name) const
+{
+  if(filter_all) {
+    return true;
+  }
+
+  //
+  // Slots named by address
+  //
+  QHash<uint32_t,QList<SlotRange> >::const_iterator it=
+    filter_slots.find(host_addr.toIPv4Address());
+  if(it!=filter_slots.end()) {
+    const QList<SlotRange> &ranges=it.value();
+    for(int i=0;i<ranges.size();i++) {
+      if((slot<0)||((slot>=ranges.at(i).first)&&(slot<=ranges.at(i).last))) {
+	return true;
+      }
+    }
+  }
+
+  //
+  // Names
+  //
+  for(int i=0;i<filter_host_names.size();i++) {
+    if(filter_host_names.at(i).exactMatch(host_name)) {
+      return true;
+    }
+  }
+  if(name.isNull()) {
+    //
+    // Unknown name (e.g. a slot on a node that has just gone away)
+    //
+    return filter_names.size()>0;
+  }
+  for(int i=0;i<filter_names.size();i++) {
+    if(filter_names.at(i).exactMatch(name)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+bool SubscriptionFilter::hosts(QSet<uint32_t> *addrs) const
+{
+  //
+  // Only address terms narrow a dump down to particular nodes
+  //
+  addrs->clear();
+  if(filter_all||(filter_host_names.size()>0)||(filter_names.size()>0)) {
+    return false;
+  }
+  for(QHash<uint32_t,QList<SlotRange> >::const_iterator
+	it=filter_slots.constBegin();it!=filter_slots.constEnd();it++) {
+    addrs->insert(it.key());
+  }
+
+  return true;
+}
+
+
+void SubscriptionFilter::merge(const SubscriptionFilter &filter)
+{
+  if(filter_all) {
+    return;
+  }
+  if(filter.filter_all) {
+    *this=SubscriptionFilter();
+    return;
+  }
+  for(QHash<uint32_t,QList<SlotRange> >::const_iterator
+	it=filter.filter_slots.constBegin();it!=filter.filter_slots.constEnd();
+      it++) {
+    filter_slots[it.key()]+=it.value();
+  }
+  filter_host_names+=filter.filter_host_names;
+  filter_names+=filter.filter_names;
+}
+
+
+bool SubscriptionFilter::parse(const QStringList &terms,QString *err_msg)
+{
+  QHostAddress addr;
+  SlotRange range;
+  bool ok=false;
+
+  *this=SubscriptionFilter();
+  for(int i=0;i<terms.size();i++) {
+    QString term=terms.at(i).trimmed();
+    if(term.isEmpty()) {
+      continue;
+    }
+    filter_all=false;
+
+    if(term.left(5).toLower()=="host=") {
+      filter_host_names.
+	push_back(QRegExp(term.mid(5),Qt::CaseInsensitive,QRegExp::Wildcard));
+      continue;
+    }
+    if(term.left(5).toLower()=="name=") {
+      filter_names.
+	push_back(QRegExp(term.mid(5),Qt::CaseInsensitive,QRegExp::Wildcard));
+      continue;
+    }
+
+    QStringList f0=term.split(":");
+    if((f0.size()>2)||(!addr.setAddress(f0.at(0)))||
+       (addr.protocol()!=QAbstractSocket::IPv4Protocol)) {
+      *err_msg="invalid filter \""+term+"\"";
+      return false;
+    }
+    range.first=0;
+    range.last=INT32_MAX;
+    if(f0.size()==2) {
+      QStringList f1=f0.at(1).split("-");
+      range.first=f1.at(0).toInt(&ok);
+      if(ok&&(f1.size()==1)) {
+	range.last=range.first;
+      }
+      if(ok&&(f1.size()==2)) {
+	range.last=f1.at(1).toInt(&ok);
+      }
+      if((!ok)||(f1.size()>2)||(range.first<0)||(range.last<range.first)) {
+	*err_msg="invalid slot range \""+term+"\"";
+	return false;
+      }
+    }
+    filter_slots[addr.toIPv4Address()].push_back(range);
+  }
+
+  return true;
+}
@@ -0,0 +1,71 @@
+// subscriptionfilter.h
+//
+// Record filters for Protocol D subscriptions
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef SUBSCRIPTIONFILTER_H
+#define SUBSCRIPTIONFILTER_H
+
+#include <stdint.h>
+
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QRegExp>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+//
+// A set of terms, any one of which selects a record:
+//
+//   <host-addr>                   Every slot on the node
+//   <host-addr>:<slot>            A single slot
+//   <host-addr>:<first>-<last>    A range of slots (inclusive)
+//   host=<pattern>                Nodes whose hostname matches
+//   name=<pattern>                Slots whose name matches
+//
+// Patterns are case-insensitive wildcards ('*' and '?'), compiled once
+// when the filter is parsed. An empty filter selects everything. A null
+// 'name' in matches() means the name is not known, and is selected by
+// any filter having name terms.
+//
+class SubscriptionFilter
+{
+ public:
+  SubscriptionFilter();
+  bool matchesAll() const;
+  bool matches(const QHostAddress &host_addr,int slot,
+	       const QString &host_name,const QString &name=QString()) const;
+  bool hosts(QSet<uint32_t> *addrs) const;
+  void merge(const SubscriptionFilter &filter);
+  bool parse(const QStringList &terms,QString *err_msg);
+
+ private:
+  struct SlotRange {
+    int first;
+    int last;
+  };
+  bool filter_all;
+  QHash<uint32_t,QList<SlotRange> > filter_slots;
+  QList<QRegExp> filter_host_names;
+  QList<QRegExp> filter_names;
+};
+
+
+#endif  // SUBSCRIPTIONFILTER_H
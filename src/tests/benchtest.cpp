@@ -0,0 +1,641 @@
+// benchtest.cpp
+//
+// Microbenchmarks for Drouter hot paths
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QStringList>
+#include <QTemporaryFile>
+#include <QTimer>
+
+#include <sy5/sycmdswitch.h>
+
+#include "benchtest.h"
+#include "dparser.h"
+#include "endpointmap.h"
+#include "saparser.h"
+#include "sqlquery.h"
+
+MainObject::MainObject(QObject *parent)
+  : QObject(parent)
+{
+  bool ok=false;
+
+  bench_db_hostname="localhost";
+  bench_iterations=1000;
+  bench_nodes=200;
+  bench_slots=16;
+  bench_endpoints=1000;
+  bench_routers=4;
+  bench_changes=10000;
+  bench_server_type=MainObject::DServer;
+  bench_socket=NULL;
+  bench_signals=0;
+  bench_expected_signals=0;
+
+  SyCmdSwitch *cmd=new SyCmdSwitch("benchtest",VERSION,BENCHTEST_USAGE);
+  for(int i=0;i<cmd->keys();i++) {
+    if(cmd->key(i)=="--db-hostname") {
+      bench_db_hostname=cmd->value(i);
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--iterations") {
+      bench_iterations=cmd->value(i).toInt(&ok);
+      if((!ok)||(bench_iterations<1)) {
+	fprintf(stderr,"benchtest: invalid --iterations value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--nodes") {
+      bench_nodes=cmd->value(i).toInt(&ok);
+      if((!ok)||(bench_nodes<1)||(bench_nodes>65000)) {
+	fprintf(stderr,"benchtest: invalid --nodes value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--slots") {
+      bench_slots=cmd->value(i).toInt(&ok);
+      if((!ok)||(bench_slots<2)||(bench_slots>255)) {
+	fprintf(stderr,"benchtest: invalid --slots value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--endpoints") {
+      bench_endpoints=cmd->value(i).toInt(&ok);
+      if((!ok)||(bench_endpoints<1)) {
+	fprintf(stderr,"benchtest: invalid --endpoints value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--routers") {
+      bench_routers=cmd->value(i).toInt(&ok);
+      if((!ok)||(bench_routers<1)) {
+	fprintf(stderr,"benchtest: invalid --routers value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--changes") {
+      bench_changes=cmd->value(i).toInt(&ok);
+      if((!ok)||(bench_changes<1)) {
+	fprintf(stderr,"benchtest: invalid --changes value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--d-dump") {
+      bench_d_dump=cmd->value(i);
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--only") {
+      bench_only=cmd->value(i).toLower();
+      cmd->setProcessed(i,true);
+    }
+    if(!cmd->processed(i)) {
+      fprintf(stderr,"benchtest: unknown option \"%s\"\n",
+	      cmd->key(i).toUtf8().constData());
+      exit(1);
+    }
+  }
+
+  //
+  // Loopback Server for the Protocol Parsers
+  //
+  bench_loop=new QEventLoop(this);
+  bench_server=new QTcpServer(this);
+  connect(bench_server,SIGNAL(newConnection()),
+	  this,SLOT(newConnectionData()));
+  if(!bench_server->listen(QHostAddress::LocalHost,0)) {
+    fprintf(stderr,"benchtest: unable to open loopback server [%s]\n",
+	    bench_server->errorString().toUtf8().constData());
+    exit(1);
+  }
+
+  if(bench_only.isEmpty()||(bench_only=="endpointmap")) {
+    BenchEndPointMap();
+  }
+  if(bench_only.isEmpty()||(bench_only=="saparser")) {
+    BenchSaParser();
+  }
+  if(bench_only.isEmpty()||(bench_only=="dparser")) {
+    BenchDParser();
+  }
+  if(bench_only.isEmpty()||(bench_only=="sqlquery")) {
+    BenchSqlQuery();
+  }
+
+  exit(0);
+}
+
+
+void MainObject::newConnectionData()
+{
+  QTcpSocket *sock=bench_server->nextPendingConnection();
+  int lines=0;
+
+  if(bench_socket!=NULL) {
+    bench_socket->deleteLater();
+  }
+  bench_socket=sock;
+  bench_accum.clear();
+  connect(bench_socket,SIGNAL(readyRead()),this,SLOT(serverReadyReadData()));
+  if(bench_server_type==MainObject::DServer) {
+    bench_socket->write(DParserDump(&lines));
+  }
+}
+
+
+void MainObject::serverReadyReadData()
+{
+  QByteArray data=bench_socket->readAll();
+
+  if(bench_server_type!=MainObject::SaServer) {
+    return;
+  }
+  for(int i=0;i<data.length();i++) {
+    switch(0xFF&data[i]) {
+    case 13:
+      break;
+
+    case 10:
+      if(!bench_accum.isEmpty()) {
+	SaReply(QString::fromUtf8(bench_accum));
+      }
+      bench_accum.clear();
+      break;
+
+    default:
+      bench_accum+=data[i];
+      break;
+    }
+  }
+}
+
+
+void MainObject::dparserConnectedData(bool state)
+{
+  if(state) {
+    bench_signals++;
+    if(bench_signals>=bench_expected_signals) {
+      bench_loop->quit();
+    }
+  }
+}
+
+
+void MainObject::dparserDestinationChangedData(const QHostAddress &host_addr,
+					       int slot,SyDestination *dst)
+{
+  bench_signals++;
+  if(bench_signals>=bench_expected_signals) {
+    bench_loop->quit();
+  }
+}
+
+
+void MainObject::saCrosspointChangedData(int router,int output,int input)
+{
+  bench_signals++;
+  if(bench_signals>=bench_expected_signals) {
+    bench_loop->quit();
+  }
+}
+
+
+void MainObject::BenchEndPointMap()
+{
+  QElapsedTimer timer;
+  EndPointMap *map=new EndPointMap();
+  QList<QHostAddress> addrs;
+  QList<int> slot_nums;
+  int loads=qMax(1,bench_iterations/100);
+  int lookups=100*bench_iterations;
+  volatile int sum=0;
+
+  //
+  // Generate a map file
+  //
+  for(int i=0;i<bench_endpoints;i++) {
+    QHostAddress addr=NodeAddress(i/bench_slots);
+    int slot=i%bench_slots;
+    map->insert(EndPointMap::Input,i,addr,slot,
+		QString::asprintf("Input %d",i+1));
+    map->insert(EndPointMap::Output,i,addr,slot,
+		QString::asprintf("Output %d",i+1));
+    addrs.push_back(addr);
+    slot_nums.push_back(slot);
+  }
+  QTemporaryFile file(QDir::tempPath()+"/benchtest-XXXXXX.map");
+  if(!file.open()) {
+    Skip("endpointmap_load","unable to create temporary file");
+    delete map;
+    return;
+  }
+  FILE *f=fdopen(dup(file.handle()),"w");
+  map->save(f,true);
+  fclose(f);
+  delete map;
+
+  //
+  // EndPointMap::load()
+  //
+  map=new EndPointMap();
+  timer.start();
+  for(int i=0;i<loads;i++) {
+    if(!map->load(file.fileName())) {
+      Skip("endpointmap_load","unable to load generated map");
+      delete map;
+      return;
+    }
+  }
+  Report("endpointmap_load",loads,timer.nsecsElapsed());
+
+  //
+  // EndPointMap::endPoint()
+  //
+  timer.start();
+  for(int i=0;i<lookups;i++) {
+    int n=i%addrs.size();
+    sum+=map->endPoint(EndPointMap::Output,addrs.at(n),slot_nums.at(n));
+  }
+  Report("endpointmap_endpoint",lookups,timer.nsecsElapsed());
+  timer.start();
+  for(int i=0;i<lookups;i++) {
+    sum+=map->endPoint(EndPointMap::Input,addrs.at(i%addrs.size()),-1);
+  }
+  Report("endpointmap_endpoint_miss",lookups,timer.nsecsElapsed());
+  delete map;
+
+  //
+  // EndPointMap::loadSet()
+  //
+  QMap<int,EndPointMap *> maps;
+  QStringList msgs;
+  QStringList filter;
+  filter.push_back(ENDPOINTMAP_MAP_FILTER);
+  if(QDir(ENDPOINTMAP_MAP_DIRECTORY).entryList(filter,QDir::Files).size()==0) {
+    Skip("endpointmap_loadset",QString("no maps in ")+
+	 ENDPOINTMAP_MAP_DIRECTORY);
+    return;
+  }
+  timer.start();
+  for(int i=0;i<loads;i++) {
+    EndPointMap::loadSet(&maps,&msgs);
+    for(QMap<int,EndPointMap *>::const_iterator it=maps.constBegin();
+	it!=maps.constEnd();it++) {
+      delete it.value();
+    }
+    maps.clear();
+  }
+  Report("endpointmap_loadset",loads,timer.nsecsElapsed());
+}
+
+
+void MainObject::BenchSaParser()
+{
+  QElapsedTimer timer;
+  int outputs=bench_endpoints;
+
+  bench_server_type=MainObject::SaServer;
+  SaParser *parser=new SaParser(this);
+  connect(parser,SIGNAL(outputCrosspointChanged(int,int,int)),
+	  this,SLOT(saCrosspointChangedData(int,int,int)));
+
+  //
+  // Startup dump (RouterNames through RouteStat)
+  //
+  bench_signals=0;
+  bench_expected_signals=bench_routers*outputs;
+  timer.start();
+  parser->connectToHost("localhost",bench_server->serverPort(),
+			"benchtest","");
+  if(!Wait()) {
+    Skip("saparser_startup","timed out");
+    delete parser;
+    return;
+  }
+  Report("saparser_startup",bench_routers*(3*outputs+6),timer.nsecsElapsed());
+
+  //
+  // RouteStat storm
+  //
+  bench_signals=0;
+  bench_expected_signals=bench_changes;
+  timer.start();
+  bench_socket->write(RouteStatLines(bench_changes));
+  if(!Wait()) {
+    Skip("saparser_routestat","timed out");
+    delete parser;
+    return;
+  }
+  Report("saparser_routestat",bench_changes,timer.nsecsElapsed());
+  delete parser;
+}
+
+
+void MainObject::BenchDParser()
+{
+  QElapsedTimer timer;
+  int lines=0;
+
+  bench_server_type=MainObject::DServer;
+  DParserDump(&lines);
+  DParser *parser=new DParser(this);
+  connect(parser,SIGNAL(connected(bool)),this,SLOT(dparserConnectedData(bool)));
+
+  //
+  // Subscription dump
+  //
+  bench_signals=0;
+  bench_expected_signals=1;
+  timer.start();
+  parser->connectToHost("localhost",bench_server->serverPort());
+  if(!Wait()) {
+    Skip("dparser_dump","timed out");
+    delete parser;
+    return;
+  }
+  Report("dparser_dump",lines,timer.nsecsElapsed());
+  if(!bench_d_dump.isEmpty()) {
+    Skip("dparser_changes","recorded dump in use");
+    delete parser;
+    return;
+  }
+
+  //
+  // Crosspoint changes
+  //
+  connect(parser,
+	  SIGNAL(destinationChanged(const QHostAddress &,int,SyDestination *)),
+	  this,
+	  SLOT(dparserDestinationChangedData(const QHostAddress &,int,
+					     SyDestination *)));
+  int dsts=bench_nodes*bench_slots;
+  QByteArray data;
+  for(int i=0;i<bench_changes;i++) {
+    int dst=i%dsts;
+    int src=(i/dsts+dst+1)%dsts;
+    QHostAddress addr=NodeAddress(dst/bench_slots);
+    data+=(QString("DST\t")+addr.toString()+
+	   QString::asprintf("\t%d\t",dst%bench_slots)+
+	   QString::asprintf("node%d\t",dst/bench_slots)+
+	   QString::asprintf("239.192.%d.%d\t",(src+1)>>8,(src+1)&0xFF)+
+	   QString::asprintf("Dest %d\t2\r\n",dst%bench_slots+1)).toUtf8();
+  }
+  bench_signals=0;
+  bench_expected_signals=bench_changes;
+  timer.start();
+  bench_socket->write(data);
+  if(!Wait()) {
+    Skip("dparser_changes","timed out");
+    delete parser;
+    return;
+  }
+  Report("dparser_changes",bench_changes,timer.nsecsElapsed());
+  delete parser;
+}
+
+
+void MainObject::BenchSqlQuery()
+{
+  QElapsedTimer timer;
+  SqlQuery *q=NULL;
+
+  QSqlDatabase db=QSqlDatabase::addDatabase("QMYSQL3");
+  db.setHostName(bench_db_hostname);
+  db.setDatabaseName("drouter");
+  db.setUserName("drouter");
+  db.setPassword("drouter");
+  if(!db.open()) {
+    Skip("sqlquery_construct","unable to open database ["+
+	 db.lastError().driverText()+"]");
+    return;
+  }
+
+  timer.start();
+  for(int i=0;i<bench_iterations;i++) {
+    q=new SqlQuery("select 1");
+    delete q;
+  }
+  Report("sqlquery_construct",bench_iterations,timer.nsecsElapsed());
+
+  timer.start();
+  for(int i=0;i<bench_iterations;i++) {
+    SqlQuery::run("select 1");
+  }
+  Report("sqlquery_run",bench_iterations,timer.nsecsElapsed());
+
+  timer.start();
+  for(int i=0;i<bench_iterations;i++) {
+    q=new SqlQuery("select ?",QVariantList()<<i);
+    delete q;
+  }
+  Report("sqlquery_prepared",bench_iterations,timer.nsecsElapsed());
+}
+
+
+void MainObject::SaReply(const QString &cmd)
+{
+  QStringList f0=cmd.split(" ",QString::SkipEmptyParts);
+  QByteArray data;
+  int router=0;
+  int inputs=bench_endpoints;
+  int outputs=bench_endpoints;
+
+  if(f0.size()==0) {
+    return;
+  }
+  QString verb=f0.at(0).toLower();
+  if(f0.size()>=2) {
+    router=f0.at(1).toInt();
+  }
+  if(verb=="login") {
+    data="Login Successful\r\n";
+  }
+  if(verb=="routernames") {
+    data="Begin RouterNames\r\n";
+    for(int i=0;i<bench_routers;i++) {
+      data+=QString::asprintf("    %d Router %d\r\n",i+1,i+1).toUtf8();
+    }
+    data+="End RouterNames\r\n";
+  }
+  if(verb=="sourcenames") {
+    data=QString::asprintf("Begin SourceNames - %d\r\n",router).toUtf8();
+    for(int i=0;i<inputs;i++) {
+      QString host=QString::asprintf("node%d",i/bench_slots);
+      QString name=QString::asprintf("Source %d",i+1);
+      data+=(QString::asprintf("    %d",i+1)+
+	     "\t"+name+
+	     "\t"+name+" ON "+host+
+	     "\t"+NodeAddress(i/bench_slots).toString()+
+	     "\t"+host+
+	     QString::asprintf("\t%d",i%bench_slots+1)+
+	     QString::asprintf("\t%d",i+1)+
+	     QString::asprintf("\t239.192.%d.%d",(i+1)>>8,(i+1)&0xFF)+
+	     "\r\n").toUtf8();
+    }
+    data+=QString::asprintf("End SourceNames - %d\r\n",router).toUtf8();
+  }
+  if(verb=="destnames") {
+    data=QString::asprintf("Begin DestNames - %d\r\n",router).toUtf8();
+    for(int i=0;i<outputs;i++) {
+      QString host=QString::asprintf("node%d",i/bench_slots);
+      QString name=QString::asprintf("Dest %d",i+1);
+      data+=(QString::asprintf("    %d",i+1)+
+	     "\t"+name+
+	     "\t"+name+" ON "+host+
+	     "\t"+NodeAddress(i/bench_slots).toString()+
+	     "\t"+host+
+	     QString::asprintf("\t%d",i%bench_slots+1)+
+	     "\r\n").toUtf8();
+    }
+    data+=QString::asprintf("End DestNames - %d\r\n",router).toUtf8();
+  }
+  if(verb=="snapshots") {
+    data=QString::asprintf("Begin SnapshotNames - %d\r\n",router).toUtf8()+
+      QString::asprintf("End SnapshotNames - %d\r\n",router).toUtf8();
+  }
+  if((verb=="routestat")&&(f0.size()==2)) {
+    for(int i=0;i<outputs;i++) {
+      data+=QString::asprintf("RouteStat %d %d %d False\r\n",
+			      router,i+1,i%inputs+1).toUtf8();
+    }
+  }
+  if(!data.isEmpty()) {
+    bench_socket->write(data);
+  }
+}
+
+
+QByteArray MainObject::DParserDump(int *lines) const
+{
+  QByteArray ret;
+
+  *lines=0;
+  if(!bench_d_dump.isEmpty()) {
+    QFile file(bench_d_dump);
+    if(!file.open(QIODevice::ReadOnly)) {
+      fprintf(stderr,"benchtest: unable to open \"%s\"\n",
+	      bench_d_dump.toUtf8().constData());
+      exit(1);
+    }
+    ret=file.readAll();
+    *lines=ret.count('\r');
+  }
+  else {
+    for(int i=0;i<bench_nodes;i++) {
+      QString addr=NodeAddress(i).toString();
+      QString host=QString::asprintf("node%d",i);
+      ret+=(QString("NODEADD\t")+addr+"\t"+host+"\tAxia xNode"+
+	    QString::asprintf("\t%d\t%d\t0\t0\r\n",bench_slots,bench_slots)).
+	toUtf8();
+      for(int j=0;j<bench_slots;j++) {
+	int num=i*bench_slots+j+1;
+	ret+=(QString("SRCADD\t")+addr+QString::asprintf("\t%d\t",j)+host+
+	      QString::asprintf("\t239.192.%d.%d",num>>8,num&0xFF)+
+	      QString::asprintf("\tSource %d\t1\t2\t12\r\n",j+1)).toUtf8();
+	ret+=(QString("DSTADD\t")+addr+QString::asprintf("\t%d\t",j)+host+
+	      QString::asprintf("\t239.192.%d.%d",num>>8,num&0xFF)+
+	      QString::asprintf("\tDest %d\t2\r\n",j+1)).toUtf8();
+      }
+      *lines+=1+2*bench_slots;
+    }
+  }
+
+  //
+  // DParser reports itself connected on the first PONG
+  //
+  ret+="PONG\r\n";
+  (*lines)++;
+
+  return ret;
+}
+
+
+QByteArray MainObject::RouteStatLines(int count) const
+{
+  QByteArray ret;
+  int outputs=bench_endpoints;
+
+  for(int i=0;i<count;i++) {
+    ret+=QString::asprintf("RouteStat %d %d %d False\r\n",
+			   i%bench_routers+1,(i/bench_routers)%outputs+1,
+			   (i*7)%bench_endpoints+1).toUtf8();
+  }
+
+  return ret;
+}
+
+
+bool MainObject::Wait()
+{
+  QTimer *timer=new QTimer(this);
+  timer->setSingleShot(true);
+  connect(timer,SIGNAL(timeout()),bench_loop,SLOT(quit()));
+  timer->start(BENCHTEST_TIMEOUT);
+  if(bench_signals<bench_expected_signals) {
+    bench_loop->exec();
+  }
+  delete timer;
+
+  return bench_signals>=bench_expected_signals;
+}
+
+
+void MainObject::Report(const QString &name,qint64 ops,qint64 nsecs) const
+{
+  printf("bench=%s ops=%lld total_us=%lld ns_per_op=%.1f\n",
+	 name.toUtf8().constData(),ops,nsecs/1000,
+	 (double)nsecs/(double)ops);
+  fflush(stdout);
+}
+
+
+void MainObject::Skip(const QString &name,const QString &reason) const
+{
+  printf("bench=%s skipped=\"%s\"\n",name.toUtf8().constData(),
+	 reason.toUtf8().constData());
+  fflush(stdout);
+}
+
+
+QHostAddress MainObject::NodeAddress(int node) const
+{
+  return QHostAddress((10u<<24)+(1u<<16)+node+1);
+}
+
+
+int main(int argc,char *argv[])
+{
+  QCoreApplication a(argc,argv);
+  new MainObject();
+  return a.exec();
+}
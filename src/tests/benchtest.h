@@ -0,0 +1,85 @@
+// benchtest.h
+//
+// Microbenchmarks for Drouter hot paths
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef BENCHTEST_H
+#define BENCHTEST_H
+
+#include <QByteArray>
+#include <QEventLoop>
+#include <QHostAddress>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <sy5/sydestination.h>
+
+#define BENCHTEST_USAGE "[options]\n\nTime the Drouter hot paths and print one \"key=value\" line per\nbenchmark on standard output, suitable for comparison between builds.\n\nOptions are:\n--db-hostname=<host>\n     Database server for the SqlQuery benchmark (default \"localhost\").\n     The benchmark is skipped if the database cannot be opened.\n\n--iterations=<num>\n     Repetitions of the shorter benchmarks (default 1000)\n\n--nodes=<num>\n     Simulated nodes in the generated Protocol D stream (default 200)\n\n--slots=<num>\n     Sources and destinations per simulated node (default 16)\n\n--endpoints=<num>\n     Inputs and outputs in the generated endpoint map (default 1000)\n\n--routers=<num>\n     Routers in the generated Protocol SA session (default 4)\n\n--changes=<num>\n     Crosspoint changes sent after the initial dumps (default 10000)\n\n--d-dump=<filename>\n     Replay a recorded Protocol D subscription stream instead of\n     generating one\n\n--only=<name>\n     Run only the named benchmark group (endpointmap, saparser, dparser,\n     sqlquery)\n\n"
+
+#define BENCHTEST_TIMEOUT 60000
+
+class MainObject : public QObject
+{
+  Q_OBJECT;
+ public:
+  MainObject(QObject *parent=0);
+
+ private slots:
+  void newConnectionData();
+  void serverReadyReadData();
+  void dparserConnectedData(bool state);
+  void dparserDestinationChangedData(const QHostAddress &host_addr,int slot,
+				     SyDestination *dst);
+  void saCrosspointChangedData(int router,int output,int input);
+
+ private:
+  enum Server {DServer=0,SaServer=1};
+  void BenchEndPointMap();
+  void BenchSaParser();
+  void BenchDParser();
+  void BenchSqlQuery();
+  void SaReply(const QString &cmd);
+  QByteArray DParserDump(int *lines) const;
+  QByteArray RouteStatLines(int count) const;
+  bool Wait();
+  void Report(const QString &name,qint64 ops,qint64 nsecs) const;
+  void Skip(const QString &name,const QString &reason) const;
+  QHostAddress NodeAddress(int node) const;
+  QString bench_db_hostname;
+  int bench_iterations;
+  int bench_nodes;
+  int bench_slots;
+  int bench_endpoints;
+  int bench_routers;
+  int bench_changes;
+  QString bench_d_dump;
+  QString bench_only;
+  Server bench_server_type;
+  QTcpServer *bench_server;
+  QTcpSocket *bench_socket;
+  QByteArray bench_accum;
+  QEventLoop *bench_loop;
+  int bench_signals;
+  int bench_expected_signals;
+};
+
+
+#endif  // BENCHTEST_H
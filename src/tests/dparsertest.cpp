@@ -36,6 +36,7 @@ MainObject::MainObject(QObject *parent)
   : QObject(parent)
 {
   test_hostname="localhost";
+  test_binary=false;
 
   SyCmdSwitch *cmd=new SyCmdSwitch("dparsertest",VERSION,DPARSERTEST_USAGE);
   for(int i=0;i<cmd->keys();i++) {
@@ -43,6 +44,10 @@ MainObject::MainObject(QObject *parent)
       test_hostname=cmd->value(i);
       cmd->setProcessed(i,true);
     }
+    if(cmd->key(i)=="--binary") {
+      test_binary=true;
+      cmd->setProcessed(i,true);
+    }
     if(!cmd->processed(i)) {
       fprintf(stderr,"dparsertest: unknown option \"%s\"\n",
 	      (const char *)cmd->key(i).toUtf8());
@@ -51,6 +56,7 @@ MainObject::MainObject(QObject *parent)
   }
 
   test_parser=new DParser(this);
+  test_parser->setBinaryFraming(test_binary);
   connect(test_parser,SIGNAL(connected(bool)),this,SLOT(connectedData(bool)));
   connect(test_parser,
 	  SIGNAL(error(QAbstractSocket::SocketError,const QString &)),
@@ -33,7 +33,7 @@
 #include "dparser.h"
 #include "endpointmap.h"
 
-#define DPARSERTEST_USAGE "--hostname=<host-name>\n"
+#define DPARSERTEST_USAGE "--hostname=<host-name> [--binary]\n"
 
 class MainObject : public QObject
 {
@@ -60,6 +60,7 @@ class MainObject : public QObject
  private:
   DParser *test_parser;
   QString test_hostname;
+  bool test_binary;
 };
 
 
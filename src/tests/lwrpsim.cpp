@@ -0,0 +1,545 @@
+// lwrpsim.cpp
+//
+// Simulate a farm of LWRP nodes for load testing drouterd(8)
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QStringList>
+#include <QtAlgorithms>
+
+#include <sy5/sycmdswitch.h>
+#include <sy5/syconfig.h>
+
+#include "lwrpsim.h"
+
+MainObject::Step::Step()
+{
+  wait=false;
+  msecs=0;
+  type=MainObject::DstChange;
+  count=0;
+  rate=0;
+}
+
+
+MainObject::MainObject(QObject *parent)
+  : QObject(parent)
+{
+  QHostAddress base_addr("127.0.1.1");
+  QString script;
+  QString err_msg;
+  Step step;
+  bool ok=false;
+  int nodes=10;
+  int advert_interval=1000;
+
+  sim_interface.setAddress("127.0.0.1");
+  sim_drouter_hostname="localhost";
+  sim_slots=8;
+  sim_gpios=0;
+  sim_timeout=60000;
+  sim_discovery_start=0;
+  sim_expected_endpoints=0;
+  sim_discovered=false;
+  sim_step=-1;
+  sim_step_remaining=0;
+  sim_change=0;
+  sim_dst_sent=0;
+  sim_src_sent=0;
+  sim_gpi_sent=0;
+  step.count=1000;
+  step.rate=100;
+
+  SyCmdSwitch *cmd=new SyCmdSwitch("lwrpsim",VERSION,LWRPSIM_USAGE);
+  for(int i=0;i<cmd->keys();i++) {
+    if(cmd->key(i)=="--nodes") {
+      nodes=cmd->value(i).toInt(&ok);
+      if((!ok)||(nodes<1)||(nodes>65000)) {
+	fprintf(stderr,"lwrpsim: invalid --nodes value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--slots") {
+      sim_slots=cmd->value(i).toInt(&ok);
+      if((!ok)||(sim_slots<1)) {
+	fprintf(stderr,"lwrpsim: invalid --slots value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--gpios") {
+      sim_gpios=cmd->value(i).toInt(&ok);
+      if((!ok)||(sim_gpios<0)) {
+	fprintf(stderr,"lwrpsim: invalid --gpios value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--base-address") {
+      if(!base_addr.setAddress(cmd->value(i))) {
+	fprintf(stderr,"lwrpsim: invalid --base-address value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--interface") {
+      if(!sim_interface.setAddress(cmd->value(i))) {
+	fprintf(stderr,"lwrpsim: invalid --interface value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--advert-interval") {
+      advert_interval=cmd->value(i).toInt(&ok);
+      if((!ok)||(advert_interval<1)) {
+	fprintf(stderr,"lwrpsim: invalid --advert-interval value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--drouter-hostname") {
+      sim_drouter_hostname=cmd->value(i);
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--changes") {
+      step.count=cmd->value(i).toInt(&ok);
+      if((!ok)||(step.count<0)) {
+	fprintf(stderr,"lwrpsim: invalid --changes value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--change-rate") {
+      step.rate=cmd->value(i).toInt(&ok);
+      if((!ok)||(step.rate<0)) {
+	fprintf(stderr,"lwrpsim: invalid --change-rate value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--change-type") {
+      step.type=ChangeTypeFromString(cmd->value(i),&ok);
+      if(!ok) {
+	fprintf(stderr,"lwrpsim: invalid --change-type value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--script") {
+      script=cmd->value(i);
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--timeout") {
+      sim_timeout=cmd->value(i).toInt(&ok);
+      if((!ok)||(sim_timeout<1)) {
+	fprintf(stderr,"lwrpsim: invalid --timeout value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(!cmd->processed(i)) {
+      fprintf(stderr,"lwrpsim: unknown option \"%s\"\n",
+	      cmd->key(i).toUtf8().constData());
+      exit(1);
+    }
+  }
+  if(script.isEmpty()) {
+    sim_steps.push_back(step);
+  }
+  else {
+    if(!LoadScript(script)) {
+      exit(1);
+    }
+  }
+  for(int i=0;i<sim_steps.size();i++) {
+    if((!sim_steps.at(i).wait)&&(sim_steps.at(i).type==MainObject::GpiChange)&&
+       (sim_gpios==0)) {
+      fprintf(stderr,"lwrpsim: GPI changes require --gpios\n");
+      exit(1);
+    }
+  }
+
+  //
+  // Create Nodes
+  //
+  for(int i=0;i<nodes;i++) {
+    SimNode *node=new SimNode(i,QHostAddress(base_addr.toIPv4Address()+i),
+			      sim_slots,sim_gpios,this);
+    if(!node->listen(SWITCHYARD_LWRP_PORT,&err_msg)) {
+      fprintf(stderr,"lwrpsim: unable to listen at %s:%d [%s]\n",
+	      node->hostAddress().toString().toUtf8().constData(),
+	      SWITCHYARD_LWRP_PORT,err_msg.toUtf8().constData());
+      exit(1);
+    }
+    sim_nodes.push_back(node);
+    sim_node_index[node->hostAddress().toIPv4Address()]=node;
+  }
+  sim_expected_endpoints=2*nodes*sim_slots;
+
+  //
+  // Timers
+  //
+  sim_advert_timer=new QTimer(this);
+  connect(sim_advert_timer,SIGNAL(timeout()),this,SLOT(advertiseData()));
+  sim_advert_timer->setInterval(advert_interval);
+
+  sim_step_timer=new QTimer(this);
+  sim_step_timer->setSingleShot(true);
+  connect(sim_step_timer,SIGNAL(timeout()),this,SLOT(stepData()));
+
+  sim_timeout_timer=new QTimer(this);
+  sim_timeout_timer->setSingleShot(true);
+  connect(sim_timeout_timer,SIGNAL(timeout()),this,SLOT(timeoutData()));
+
+  //
+  // Protocol D Observer
+  //
+  sim_parser=new DParser(this);
+  connect(sim_parser,SIGNAL(connected(bool)),this,SLOT(connectedData(bool)));
+  connect(sim_parser,
+	  SIGNAL(error(QAbstractSocket::SocketError,const QString &)),
+	  this,SLOT(errorData(QAbstractSocket::SocketError,const QString &)));
+  connect(sim_parser,SIGNAL(sourceAdded(const QHostAddress &,int)),
+	  this,SLOT(sourceAddedData(const QHostAddress &,int)));
+  connect(sim_parser,SIGNAL(destinationAdded(const QHostAddress &,int)),
+	  this,SLOT(destinationAddedData(const QHostAddress &,int)));
+  connect(sim_parser,SIGNAL(sourceChanged(const QHostAddress &,int,SySource *)),
+	  this,SLOT(sourceChangedData(const QHostAddress &,int,SySource *)));
+  connect(sim_parser,
+	  SIGNAL(destinationChanged(const QHostAddress &,int,SyDestination *)),
+	  this,
+	SLOT(destinationChangedData(const QHostAddress &,int,SyDestination *)));
+  sim_clock.start();
+  sim_parser->connectToHost(sim_drouter_hostname,23883);
+}
+
+
+void MainObject::connectedData(bool state)
+{
+  if(state&&(!sim_advert_timer->isActive())&&(!sim_discovered)) {
+    sim_discovery_start=sim_clock.nsecsElapsed();
+    advertiseData();
+    sim_advert_timer->start();
+    sim_timeout_timer->start(sim_timeout);
+  }
+}
+
+
+void MainObject::errorData(QAbstractSocket::SocketError err,
+			   const QString &err_msg)
+{
+  fprintf(stderr,"lwrpsim: Protocol D error [%s]\n",
+	  err_msg.toUtf8().constData());
+}
+
+
+void MainObject::sourceAddedData(const QHostAddress &host_addr,int slot)
+{
+  if((!sim_discovered)&&(Node(host_addr)!=NULL)) {
+    sim_seen.insert(PendingKey(host_addr,slot,MainObject::SrcChange));
+    if(sim_seen.size()>=sim_expected_endpoints) {
+      sim_discovered=true;
+      StartSteps();
+    }
+  }
+}
+
+
+void MainObject::destinationAddedData(const QHostAddress &host_addr,int slot)
+{
+  if((!sim_discovered)&&(Node(host_addr)!=NULL)) {
+    sim_seen.insert(PendingKey(host_addr,slot,MainObject::DstChange));
+    if(sim_seen.size()>=sim_expected_endpoints) {
+      sim_discovered=true;
+      StartSteps();
+    }
+  }
+}
+
+
+void MainObject::sourceChangedData(const QHostAddress &host_addr,int slot,
+				   SySource *src)
+{
+  quint64 key=PendingKey(host_addr,slot,MainObject::SrcChange);
+
+  if(sim_pending.contains(key)) {
+    sim_src_latencies.push_back(sim_clock.nsecsElapsed()-sim_pending.take(key));
+    if((sim_step>=sim_steps.size())&&(sim_pending.size()==0)) {
+      Finish();
+    }
+  }
+}
+
+
+void MainObject::destinationChangedData(const QHostAddress &host_addr,int slot,
+					SyDestination *dst)
+{
+  quint64 key=PendingKey(host_addr,slot,MainObject::DstChange);
+
+  if(sim_pending.contains(key)) {
+    sim_dst_latencies.push_back(sim_clock.nsecsElapsed()-sim_pending.take(key));
+    if((sim_step>=sim_steps.size())&&(sim_pending.size()==0)) {
+      Finish();
+    }
+  }
+}
+
+
+void MainObject::advertiseData()
+{
+  QHostAddress group(SWITCHYARD_ADVERTS_ADDRESS);
+
+  for(int i=0;i<sim_nodes.size();i++) {
+    if(!sim_nodes.at(i)->sendAdvertisement(sim_interface,group,
+					   SWITCHYARD_ADVERTS_PORT)) {
+      fprintf(stderr,"lwrpsim: unable to send advertisement for %s\n",
+	      sim_nodes.at(i)->hostAddress().toString().toUtf8().constData());
+    }
+  }
+}
+
+
+void MainObject::stepData()
+{
+  int n=0;
+  int interval=0;
+
+  if(sim_step_remaining<=0) {
+    sim_step++;
+    if(sim_step>=sim_steps.size()) {
+      if(sim_pending.size()==0) {
+	Finish();
+      }
+      sim_timeout_timer->start(sim_timeout);
+      return;
+    }
+    if(sim_steps.at(sim_step).wait) {
+      sim_step_timer->start(sim_steps.at(sim_step).msecs);
+      return;
+    }
+    sim_step_remaining=sim_steps.at(sim_step).count;
+  }
+
+  //
+  // Rates above 1000/sec are sent in batches on a 1 mS tick
+  //
+  const Step &step=sim_steps.at(sim_step);
+  n=sim_step_remaining;
+  if(step.rate>0) {
+    if(step.rate>=1000) {
+      n=qMin(n,step.rate/1000);
+      interval=1;
+    }
+    else {
+      n=1;
+      interval=1000/step.rate;
+    }
+  }
+  for(int i=0;i<n;i++) {
+    ApplyChange(step.type);
+  }
+  sim_step_remaining-=n;
+  sim_step_timer->start(interval);
+}
+
+
+void MainObject::timeoutData()
+{
+  if(!sim_discovered) {
+    printf("nodes=%d slots=%d discovery_ms=-1 endpoints_seen=%d/%d\n",
+	   sim_nodes.size(),sim_slots,sim_seen.size(),sim_expected_endpoints);
+    exit(1);
+  }
+  Finish();
+}
+
+
+bool MainObject::LoadScript(const QString &filename)
+{
+  QFile file(filename);
+  QString line;
+  bool ok=false;
+  int count=0;
+
+  if(!file.open(QIODevice::ReadOnly)) {
+    fprintf(stderr,"lwrpsim: unable to open \"%s\"\n",
+	    filename.toUtf8().constData());
+    return false;
+  }
+  while(!file.atEnd()) {
+    line=QString::fromUtf8(file.readLine()).trimmed();
+    count++;
+    if(line.isEmpty()||(line.left(1)=="#")) {
+      continue;
+    }
+    QStringList f0=line.split(" ",QString::SkipEmptyParts);
+    Step step;
+    if(f0.at(0).toLower()=="wait") {
+      step.wait=true;
+      if(f0.size()==2) {
+	step.msecs=f0.at(1).toInt(&ok);
+      }
+    }
+    else {
+      step.type=ChangeTypeFromString(f0.at(0),&ok);
+      if(ok&&(f0.size()>=2)&&(f0.size()<=3)) {
+	step.count=f0.at(1).toInt(&ok);
+	if(ok&&(f0.size()==3)) {
+	  step.rate=f0.at(2).toInt(&ok);
+	}
+      }
+      else {
+	ok=false;
+      }
+    }
+    if((!ok)||(step.msecs<0)||(step.count<0)||(step.rate<0)) {
+      fprintf(stderr,"lwrpsim: syntax error in \"%s\" at line %d\n",
+	      filename.toUtf8().constData(),count);
+      return false;
+    }
+    sim_steps.push_back(step);
+  }
+
+  return true;
+}
+
+
+void MainObject::StartSteps()
+{
+  sim_timeout_timer->stop();
+  printf("nodes=%d slots=%d discovery_ms=%.1f\n",
+	 sim_nodes.size(),sim_slots,
+	 (double)(sim_clock.nsecsElapsed()-sim_discovery_start)/1000000.0);
+  fflush(stdout);
+  sim_step=-1;
+  sim_step_remaining=0;
+  stepData();
+}
+
+
+void MainObject::ApplyChange(ChangeType type)
+{
+  SimNode *node=sim_nodes.at(sim_change%sim_nodes.size());
+  int slot=(sim_change/sim_nodes.size())%sim_slots;
+  int srcs=sim_nodes.size()*sim_slots;
+  int srcnum=(int)(((qint64)sim_change*7919)%srcs)+1;
+
+  switch(type) {
+  case MainObject::DstChange:
+    if(node->dstAddress(slot)==SimNode::streamAddress(srcnum)) {
+      srcnum=srcnum%srcs+1;
+    }
+    sim_pending[PendingKey(node->hostAddress(),slot,type)]=
+      sim_clock.nsecsElapsed();
+    node->setDstAddress(slot,SimNode::streamAddress(srcnum));
+    sim_dst_sent++;
+    break;
+
+  case MainObject::SrcChange:
+    sim_pending[PendingKey(node->hostAddress(),slot,type)]=
+      sim_clock.nsecsElapsed();
+    node->setSrcName(slot,QString::asprintf("Sim Change %d",sim_change));
+    sim_src_sent++;
+    break;
+
+  case MainObject::GpiChange:
+    node->setGpiCode(slot%sim_gpios,
+		     ((sim_change/sim_gpios)%2)?"hhhhh":"lhhhh");
+    sim_gpi_sent++;
+    break;
+  }
+  sim_change++;
+}
+
+
+void MainObject::Finish()
+{
+  ReportLatencies("dst",&sim_dst_latencies,sim_dst_sent);
+  ReportLatencies("src",&sim_src_latencies,sim_src_sent);
+  if(sim_gpi_sent>0) {
+    printf("type=gpi sent=%d\n",sim_gpi_sent);
+  }
+  exit(0);
+}
+
+
+void MainObject::ReportLatencies(const QString &name,QList<qint64> *lats,
+				 int sent) const
+{
+  if(sent==0) {
+    return;
+  }
+  printf("type=%s sent=%d received=%d lost=%d",name.toUtf8().constData(),
+	 sent,lats->size(),sent-lats->size());
+  if(lats->size()>0) {
+    qSort(*lats);
+    printf(" p50_ms=%.2f p90_ms=%.2f p99_ms=%.2f max_ms=%.2f",
+	   (double)lats->at((lats->size()-1)*50/100)/1000000.0,
+	   (double)lats->at((lats->size()-1)*90/100)/1000000.0,
+	   (double)lats->at((lats->size()-1)*99/100)/1000000.0,
+	   (double)lats->back()/1000000.0);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+
+SimNode *MainObject::Node(const QHostAddress &addr) const
+{
+  return sim_node_index.value(addr.toIPv4Address());
+}
+
+
+quint64 MainObject::PendingKey(const QHostAddress &addr,int slot,
+			       ChangeType type)
+{
+  return ((quint64)addr.toIPv4Address()<<32)|
+    ((quint64)(0xFFFFFF&slot)<<8)|(quint64)type;
+}
+
+
+MainObject::ChangeType MainObject::ChangeTypeFromString(const QString &str,
+							bool *ok)
+{
+  *ok=true;
+  if(str.toLower()=="dst") {
+    return MainObject::DstChange;
+  }
+  if(str.toLower()=="src") {
+    return MainObject::SrcChange;
+  }
+  if(str.toLower()=="gpi") {
+    return MainObject::GpiChange;
+  }
+  *ok=false;
+
+  return MainObject::DstChange;
+}
+
+
+int main(int argc,char *argv[])
+{
+  QCoreApplication a(argc,argv);
+  new MainObject();
+  return a.exec();
+}
@@ -0,0 +1,109 @@
+// lwrpsim.h
+//
+// Simulate a farm of LWRP nodes for load testing drouterd(8)
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef LWRPSIM_H
+#define LWRPSIM_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+
+#include <sy5/sydestination.h>
+#include <sy5/sysource.h>
+
+#include "dparser.h"
+#include "simnode.h"
+
+#define LWRPSIM_USAGE "[options]\n\nSimulate a farm of LWRP nodes on loopback addresses, let drouterd(8)\ndiscover them, then apply scripted changes and measure how long they\ntake to show up through Protocol D. Results are printed as \"key=value\"\nlines on standard output.\n\nThe nodes listen on the LWRP port (93), so this must normally be run as\nroot, and the loopback interface must be one of the interfaces that\ndrouterd(8) listens on for Livewire advertisements.\n\nOptions are:\n--nodes=<num>\n     Number of simulated nodes (default 10)\n\n--slots=<num>\n     Sources and destinations per node (default 8)\n\n--gpios=<num>\n     GPI and GPO ports per node (default 0)\n\n--base-address=<addr>\n     Address of the first node, incremented for each further node\n     (default \"127.0.1.1\")\n\n--interface=<addr>\n     Interface to send advertisements from (default \"127.0.0.1\")\n\n--advert-interval=<msecs>\n     Interval between advertisements from each node (default 1000)\n\n--drouter-hostname=<host>\n     Host running drouterd(8) (default \"localhost\")\n\n--changes=<num>\n     Number of changes to apply after discovery (default 1000)\n\n--change-rate=<num>\n     Changes per second, or 0 to send them all at once (default 100)\n\n--change-type=dst|src|gpi\n     Type of change to apply (default \"dst\")\n\n--script=<filename>\n     Read the change sequence from <filename> instead. Each line is one\n     of \"wait <msecs>\" or \"dst|src|gpi <count> [<rate>]\"; lines\n     starting with '#' are ignored.\n\n--timeout=<msecs>\n     Time to wait for discovery, and for outstanding notifications once\n     the last change has been sent (default 60000)\n\n"
+
+class MainObject : public QObject
+{
+  Q_OBJECT;
+ public:
+  MainObject(QObject *parent=0);
+
+ private slots:
+  void connectedData(bool state);
+  void errorData(QAbstractSocket::SocketError err,const QString &err_msg);
+  void sourceAddedData(const QHostAddress &host_addr,int slot);
+  void destinationAddedData(const QHostAddress &host_addr,int slot);
+  void sourceChangedData(const QHostAddress &host_addr,int slot,
+			 SySource *src);
+  void destinationChangedData(const QHostAddress &host_addr,int slot,
+			      SyDestination *dst);
+  void advertiseData();
+  void stepData();
+  void timeoutData();
+
+ private:
+  enum ChangeType {DstChange=0,SrcChange=1,GpiChange=2};
+  struct Step {
+    Step();
+    bool wait;
+    int msecs;
+    ChangeType type;
+    int count;
+    int rate;
+  };
+  bool LoadScript(const QString &filename);
+  void StartSteps();
+  void ApplyChange(ChangeType type);
+  void Finish();
+  void ReportLatencies(const QString &name,QList<qint64> *lats,
+		       int sent) const;
+  SimNode *Node(const QHostAddress &addr) const;
+  static quint64 PendingKey(const QHostAddress &addr,int slot,ChangeType type);
+  static ChangeType ChangeTypeFromString(const QString &str,bool *ok);
+  QList<SimNode *> sim_nodes;
+  QHash<uint32_t,SimNode *> sim_node_index;
+  QHostAddress sim_interface;
+  QString sim_drouter_hostname;
+  int sim_slots;
+  int sim_gpios;
+  int sim_timeout;
+  DParser *sim_parser;
+  QTimer *sim_advert_timer;
+  QTimer *sim_step_timer;
+  QTimer *sim_timeout_timer;
+  QElapsedTimer sim_clock;
+  qint64 sim_discovery_start;
+  int sim_expected_endpoints;
+  QSet<quint64> sim_seen;
+  bool sim_discovered;
+  QList<Step> sim_steps;
+  int sim_step;
+  int sim_step_remaining;
+  int sim_change;
+  QHash<quint64,qint64> sim_pending;
+  QList<qint64> sim_dst_latencies;
+  QList<qint64> sim_src_latencies;
+  int sim_dst_sent;
+  int sim_src_sent;
+  int sim_gpi_sent;
+};
+
+
+#endif  // LWRPSIM_H
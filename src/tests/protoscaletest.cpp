@@ -0,0 +1,307 @@
+// protoscaletest.cpp
+//
+// Benchmark connection scaling of the dprotod(8) protocol servers
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QStringList>
+
+#include <sy5/sycmdswitch.h>
+
+#include "protoscaletest.h"
+
+MainObject::MainObject(QObject *parent)
+  : QObject(parent)
+{
+  bool ok=false;
+  QString port;
+  struct rlimit rlim;
+
+  test_hostname="localhost";
+  test_protocol="d";
+  test_port=0;
+  test_levels.push_back(1);
+  test_levels.push_back(100);
+  test_levels.push_back(1000);
+
+  SyCmdSwitch *cmd=
+    new SyCmdSwitch("protoscaletest",VERSION,PROTOSCALETEST_USAGE);
+  for(int i=0;i<cmd->keys();i++) {
+    if(cmd->key(i)=="--hostname") {
+      test_hostname=cmd->value(i);
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--protocol") {
+      test_protocol=cmd->value(i).toLower();
+      if((test_protocol!="d")&&(test_protocol!="sa")) {
+	fprintf(stderr,"protoscaletest: invalid --protocol value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--port") {
+      test_port=cmd->value(i).toUInt(&ok);
+      if((!ok)||(test_port==0)) {
+	fprintf(stderr,"protoscaletest: invalid --port value\n");
+	exit(1);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(cmd->key(i)=="--clients") {
+      QStringList f0=cmd->value(i).split(",",QString::SkipEmptyParts);
+      test_levels.clear();
+      for(int j=0;j<f0.size();j++) {
+	int level=f0.at(j).trimmed().toInt(&ok);
+	if((!ok)||(level<1)) {
+	  fprintf(stderr,"protoscaletest: invalid --clients value\n");
+	  exit(1);
+	}
+	test_levels.push_back(level);
+      }
+      cmd->setProcessed(i,true);
+    }
+    if(!cmd->processed(i)) {
+      fprintf(stderr,"protoscaletest: unknown option \"%s\"\n",
+	      cmd->key(i).toUtf8().constData());
+      exit(1);
+    }
+  }
+  if(test_port==0) {
+    if(test_protocol=="d") {
+      test_port=23883;
+    }
+    else {
+      test_port=9500;
+    }
+  }
+
+  //
+  // We need one descriptor per simulated client
+  //
+  if(getrlimit(RLIMIT_NOFILE,&rlim)==0) {
+    rlim.rlim_cur=rlim.rlim_max;
+    setrlimit(RLIMIT_NOFILE,&rlim);
+  }
+
+  printf("protocol: %s  port: %u\n",test_protocol.toUtf8().constData(),
+	 test_port);
+  for(int i=0;i<test_levels.size();i++) {
+    if(!RunLevel(test_levels.at(i))) {
+      exit(1);
+    }
+  }
+
+  exit(0);
+}
+
+
+bool MainObject::RunLevel(int clients)
+{
+  QList<int> socks;
+  QList<double> latencies;
+  double msecs=0.0;
+  double total=0.0;
+  qint64 mem_before=0;
+  qint64 mem_after=0;
+  int sock=-1;
+
+  mem_before=ProtocolMemory();
+  for(int i=0;i<clients;i++) {
+    if((sock=Connect(&msecs))<0) {
+      fprintf(stderr,"protoscaletest: connection %d of %d failed\n",
+	      i+1,clients);
+      for(int j=0;j<socks.size();j++) {
+	close(socks.at(j));
+      }
+      return false;
+    }
+    socks.push_back(sock);
+    latencies.push_back(msecs);
+    total+=msecs;
+  }
+
+  //
+  // Let forked children finish initializing before measuring
+  //
+  usleep(500000);
+  mem_after=ProtocolMemory();
+
+  qSort(latencies);
+  printf("clients=%d",clients);
+  if((mem_before>=0)&&(mem_after>=0)) {
+    printf(" mem_total_kb=%lld mem_per_client_kb=%.1f",
+	   mem_after,(double)(mem_after-mem_before)/(double)clients);
+  }
+  else {
+    printf(" mem_total_kb=- mem_per_client_kb=-");
+  }
+  printf(" first_byte_avg_ms=%.3f first_byte_p99_ms=%.3f"
+	 " first_byte_max_ms=%.3f\n",
+	 total/(double)clients,
+	 latencies.at((latencies.size()*99)/100),
+	 latencies.last());
+  fflush(stdout);
+
+  for(int i=0;i<socks.size();i++) {
+    close(socks.at(i));
+  }
+
+  //
+  // Give the server time to reap the connections
+  //
+  sleep(1);
+
+  return true;
+}
+
+
+int MainObject::Connect(double *msecs) const
+{
+  int sock=-1;
+  struct sockaddr_in sa;
+  struct pollfd pfd;
+  char data[1500];
+  QByteArray probe;
+  QElapsedTimer timer;
+  QHostAddress addr(test_hostname);
+
+  if(addr.isNull()) {
+    QHostInfo info=QHostInfo::fromName(test_hostname);
+    for(int i=0;i<info.addresses().size();i++) {
+      if(info.addresses().at(i).protocol()==QAbstractSocket::IPv4Protocol) {
+	addr=info.addresses().at(i);
+	break;
+      }
+    }
+    if(addr.isNull()) {
+      fprintf(stderr,"protoscaletest: unable to resolve \"%s\"\n",
+	      test_hostname.toUtf8().constData());
+      return -1;
+    }
+  }
+  if(test_protocol=="d") {
+    probe="Ping\r\n";
+  }
+  else {
+    probe="Login protoscaletest\r\n";
+  }
+
+  memset(&sa,0,sizeof(sa));
+  sa.sin_family=AF_INET;
+  sa.sin_port=htons(test_port);
+  sa.sin_addr.s_addr=htonl(addr.toIPv4Address());
+
+  timer.start();
+  if((sock=socket(AF_INET,SOCK_STREAM,0))<0) {
+    fprintf(stderr,"protoscaletest: socket() failed [%s]\n",strerror(errno));
+    return -1;
+  }
+  if(::connect(sock,(struct sockaddr *)(&sa),sizeof(sa))<0) {
+    fprintf(stderr,"protoscaletest: connect() failed [%s]\n",strerror(errno));
+    close(sock);
+    return -1;
+  }
+  if(write(sock,probe.constData(),probe.size())!=probe.size()) {
+    fprintf(stderr,"protoscaletest: write() failed [%s]\n",strerror(errno));
+    close(sock);
+    return -1;
+  }
+  pfd.fd=sock;
+  pfd.events=POLLIN;
+  pfd.revents=0;
+  if((poll(&pfd,1,5000)!=1)||(read(sock,data,1500)<=0)) {
+    fprintf(stderr,"protoscaletest: no reply from server\n");
+    close(sock);
+    return -1;
+  }
+  *msecs=(double)timer.nsecsElapsed()/1000000.0;
+
+  return sock;
+}
+
+
+qint64 MainObject::ProtocolMemory() const
+{
+  //
+  // Sum the proportional set size of every dprotod(8) process serving
+  // the protocol under test, so that pages shared between forked
+  // children are not counted more than once.
+  //
+  qint64 ret=-1;
+  QString arg="--protocol-"+test_protocol;
+  QDir dir("/proc");
+  QStringList pids=dir.entryList(QDir::Dirs|QDir::NoDotAndDotDot);
+
+  for(int i=0;i<pids.size();i++) {
+    bool ok=false;
+    pids.at(i).toInt(&ok);
+    if(!ok) {
+      continue;
+    }
+    QFile cmdline("/proc/"+pids.at(i)+"/cmdline");
+    if(!cmdline.open(QIODevice::ReadOnly)) {
+      continue;
+    }
+    QList<QByteArray> args=cmdline.readAll().split(0);
+    cmdline.close();
+    if(args.isEmpty()||(!args.at(0).endsWith("dprotod"))||
+       (!args.contains(arg.toUtf8()))) {
+      continue;
+    }
+    QFile smaps("/proc/"+pids.at(i)+"/smaps_rollup");
+    if(!smaps.open(QIODevice::ReadOnly)) {
+      continue;
+    }
+    while(!smaps.atEnd()) {
+      QString line=QString::fromUtf8(smaps.readLine()).simplified();
+      if(line.startsWith("Pss:")) {
+	if(ret<0) {
+	  ret=0;
+	}
+	ret+=line.split(" ").value(1).toLongLong();
+      }
+    }
+    smaps.close();
+  }
+
+  return ret;
+}
+
+
+int main(int argc,char *argv[])
+{
+  QCoreApplication a(argc,argv);
+  new MainObject();
+  return a.exec();
+}
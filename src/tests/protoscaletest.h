@@ -0,0 +1,47 @@
+// protoscaletest.h
+//
+// Benchmark connection scaling of the dprotod(8) protocol servers
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef PROTOSCALETEST_H
+#define PROTOSCALETEST_H
+
+#include <QList>
+#include <QObject>
+#include <QString>
+
+#define PROTOSCALETEST_USAGE "[options]\n\nOpen increasing numbers of simultaneous client connections to a\ndprotod(8) protocol server, reporting the memory used per connection\nand the latency from connect() to the first byte of the reply.\nMemory figures are only meaningful when run on the Drouter host.\n\nOptions are:\n--hostname=<host>\n     Drouter server (default \"localhost\")\n\n--protocol=d|sa\n     Protocol to test (default \"d\")\n\n--port=<port>\n     TCP port (default 23883 for Protocol D, 9500 for SA)\n\n--clients=<num>[,<num>...]\n     Connection counts to test (default \"1,100,1000\")\n\n"
+
+class MainObject : public QObject
+{
+  Q_OBJECT;
+ public:
+  MainObject(QObject *parent=0);
+
+ private:
+  bool RunLevel(int clients);
+  int Connect(double *msecs) const;
+  qint64 ProtocolMemory() const;
+  QString test_hostname;
+  QString test_protocol;
+  uint16_t test_port;
+  QList<int> test_levels;
+};
+
+
+#endif  // PROTOSCALETEST_H
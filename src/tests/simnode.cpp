@@ -0,0 +1,510 @@
+// simnode.cpp
+//
+// Simulated LWRP node
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "simnode.h"
+
+SimNode::SimNode(int num,const QHostAddress &addr,int slot_quan,
+		 int gpio_quan,QObject *parent)
+  : QObject(parent)
+{
+  node_num=num;
+  node_host_address=addr;
+  node_advt_socket=-1;
+  node_next_id=0;
+
+  for(int i=0;i<slot_quan;i++) {
+    node_src_addresses.push_back(streamAddress(num*slot_quan+i+1));
+    node_src_names.push_back(QString::asprintf("Sim %d-%d",num+1,i+1));
+    node_dst_addresses.push_back(QHostAddress("0.0.0.0"));
+    node_dst_names.push_back(QString::asprintf("Sim %d-%d",num+1,i+1));
+  }
+  for(int i=0;i<gpio_quan;i++) {
+    node_gpi_codes.push_back("hhhhh");
+    node_gpo_codes.push_back("hhhhh");
+    node_gpo_source_addresses.push_back("");
+  }
+
+  node_server=new QTcpServer(this);
+  connect(node_server,SIGNAL(newConnection()),this,SLOT(newConnectionData()));
+  node_ready_mapper=new QSignalMapper(this);
+  connect(node_ready_mapper,SIGNAL(mapped(int)),this,SLOT(readyReadData(int)));
+  node_disconnected_mapper=new QSignalMapper(this);
+  connect(node_disconnected_mapper,SIGNAL(mapped(int)),
+	  this,SLOT(disconnectedData(int)));
+}
+
+
+SimNode::~SimNode()
+{
+  if(node_advt_socket>=0) {
+    close(node_advt_socket);
+  }
+}
+
+
+QHostAddress SimNode::hostAddress() const
+{
+  return node_host_address;
+}
+
+
+QString SimNode::hostName() const
+{
+  return QString::asprintf("simnode%d",node_num+1);
+}
+
+
+int SimNode::slotQuantity() const
+{
+  return node_src_addresses.size();
+}
+
+
+int SimNode::clientQuantity() const
+{
+  return node_sockets.size();
+}
+
+
+bool SimNode::listen(uint16_t port,QString *err_msg)
+{
+  if(!node_server->listen(node_host_address,port)) {
+    *err_msg=node_server->errorString();
+    return false;
+  }
+  return true;
+}
+
+
+bool SimNode::sendAdvertisement(const QHostAddress &iface_addr,
+				const QHostAddress &group_addr,uint16_t port)
+{
+  struct sockaddr_in sa;
+  struct in_addr iface;
+  int opt=1;
+
+  //
+  // drouterd(8) keys only on the source address of the datagram, so
+  // the payload is not a full Livewire advertisement.
+  //
+  if(node_advt_socket<0) {
+    if((node_advt_socket=socket(AF_INET,SOCK_DGRAM,0))<0) {
+      return false;
+    }
+    memset(&sa,0,sizeof(sa));
+    sa.sin_family=AF_INET;
+    sa.sin_addr.s_addr=htonl(node_host_address.toIPv4Address());
+    if(bind(node_advt_socket,(struct sockaddr *)&sa,sizeof(sa))<0) {
+      close(node_advt_socket);
+      node_advt_socket=-1;
+      return false;
+    }
+    memset(&iface,0,sizeof(iface));
+    iface.s_addr=htonl(iface_addr.toIPv4Address());
+    setsockopt(node_advt_socket,IPPROTO_IP,IP_MULTICAST_IF,
+	       &iface,sizeof(iface));
+    setsockopt(node_advt_socket,IPPROTO_IP,IP_MULTICAST_LOOP,&opt,sizeof(opt));
+    setsockopt(node_advt_socket,IPPROTO_IP,IP_MULTICAST_TTL,&opt,sizeof(opt));
+  }
+  QByteArray data=("LWRPSIM "+hostName()).toUtf8();
+  memset(&sa,0,sizeof(sa));
+  sa.sin_family=AF_INET;
+  sa.sin_port=htons(port);
+  sa.sin_addr.s_addr=htonl(group_addr.toIPv4Address());
+
+  return sendto(node_advt_socket,data.constData(),data.size(),0,
+		(struct sockaddr *)&sa,sizeof(sa))==data.size();
+}
+
+
+QHostAddress SimNode::srcAddress(int slot) const
+{
+  return node_src_addresses.at(slot);
+}
+
+
+QString SimNode::srcName(int slot) const
+{
+  return node_src_names.at(slot);
+}
+
+
+void SimNode::setSrcName(int slot,const QString &str)
+{
+  node_src_names[slot]=str;
+  Broadcast(SrcLine(slot));
+}
+
+
+QHostAddress SimNode::dstAddress(int slot) const
+{
+  return node_dst_addresses.at(slot);
+}
+
+
+void SimNode::setDstAddress(int slot,const QHostAddress &addr)
+{
+  node_dst_addresses[slot]=addr;
+  Broadcast(DstLine(slot));
+}
+
+
+void SimNode::setGpiCode(int slot,const QString &code)
+{
+  node_gpi_codes[slot]=code;
+  Broadcast(GpiLine(slot));
+}
+
+
+QHostAddress SimNode::streamAddress(int srcnum)
+{
+  return QHostAddress((239u<<24)+(192u<<16)+(0xFFFF&(uint32_t)srcnum));
+}
+
+
+void SimNode::newConnectionData()
+{
+  QTcpSocket *sock=node_server->nextPendingConnection();
+  int id=node_next_id++;
+
+  node_sockets[id]=sock;
+  node_accums[id]=QString();
+  connect(sock,SIGNAL(readyRead()),node_ready_mapper,SLOT(map()));
+  node_ready_mapper->setMapping(sock,id);
+  connect(sock,SIGNAL(disconnected()),node_disconnected_mapper,SLOT(map()));
+  node_disconnected_mapper->setMapping(sock,id);
+}
+
+
+void SimNode::readyReadData(int id)
+{
+  QTcpSocket *sock=node_sockets.value(id);
+  QByteArray data;
+
+  if(sock==NULL) {
+    return;
+  }
+  data=sock->readAll();
+  for(int i=0;i<data.length();i++) {
+    switch(0xFF&data[i]) {
+    case 13:
+      break;
+
+    case 10:
+      ProcessCommand(id,node_accums.value(id).trimmed());
+      node_accums[id]="";
+      break;
+
+    default:
+      node_accums[id]+=data[i];
+      break;
+    }
+  }
+}
+
+
+void SimNode::disconnectedData(int id)
+{
+  QTcpSocket *sock=node_sockets.take(id);
+
+  node_accums.remove(id);
+  if(sock!=NULL) {
+    node_ready_mapper->removeMappings(sock);
+    node_disconnected_mapper->removeMappings(sock);
+    sock->deleteLater();
+  }
+}
+
+
+void SimNode::ProcessCommand(int id,const QString &cmd)
+{
+  QStringList cmds=cmd.split(" ",QString::SkipEmptyParts);
+  QString verb;
+  bool ok=false;
+  int slot=-1;
+
+  if(cmds.size()==0) {
+    return;
+  }
+  verb=cmds.at(0).toUpper();
+  if(cmds.size()>=2) {
+    slot=cmds.at(1).toInt(&ok)-1;
+    if(!ok) {
+      slot=-1;
+    }
+  }
+
+  if(verb=="LOGIN") {
+    return;
+  }
+
+  if(verb=="VER") {
+    Send(id,VerLine());
+    return;
+  }
+
+  if(verb=="IP") {
+    Send(id,IpLine());
+    return;
+  }
+
+  if(verb=="SRC") {
+    if(cmds.size()==1) {
+      for(int i=0;i<node_src_addresses.size();i++) {
+	Send(id,SrcLine(i));
+      }
+      return;
+    }
+    if((slot>=0)&&(slot<node_src_addresses.size())) {
+      QMap<QString,QString> params=Parameters(cmd);
+      if(params.contains("PSNM")) {
+	node_src_names[slot]=params.value("PSNM");
+      }
+      if(params.contains("RTPA")) {
+	node_src_addresses[slot]=QHostAddress(params.value("RTPA"));
+      }
+      if(params.size()>0) {
+	Broadcast(SrcLine(slot));
+      }
+      else {
+	Send(id,SrcLine(slot));
+      }
+      return;
+    }
+  }
+
+  if(verb=="DST") {
+    if(cmds.size()==1) {
+      for(int i=0;i<node_dst_addresses.size();i++) {
+	Send(id,DstLine(i));
+      }
+      return;
+    }
+    if((slot>=0)&&(slot<node_dst_addresses.size())) {
+      QMap<QString,QString> params=Parameters(cmd);
+      if(params.contains("NAME")) {
+	node_dst_names[slot]=params.value("NAME");
+      }
+      if(params.contains("ADDR")) {
+	node_dst_addresses[slot]=QHostAddress(params.value("ADDR"));
+	if(node_dst_addresses.at(slot).isNull()) {
+	  node_dst_addresses[slot]=QHostAddress("0.0.0.0");
+	}
+      }
+      if(params.size()>0) {
+	Broadcast(DstLine(slot));
+      }
+      else {
+	Send(id,DstLine(slot));
+      }
+      return;
+    }
+  }
+
+  if(verb=="GPI") {
+    if(cmds.size()==1) {
+      for(int i=0;i<node_gpi_codes.size();i++) {
+	Send(id,GpiLine(i));
+      }
+      return;
+    }
+    if((slot>=0)&&(slot<node_gpi_codes.size())) {
+      if(cmds.size()>=3) {
+	node_gpi_codes[slot]=cmds.at(2).toLower();
+	Broadcast(GpiLine(slot));
+      }
+      else {
+	Send(id,GpiLine(slot));
+      }
+      return;
+    }
+  }
+
+  if(verb=="GPO") {
+    if(cmds.size()==1) {
+      for(int i=0;i<node_gpo_codes.size();i++) {
+	Send(id,GpoLine(i));
+      }
+      return;
+    }
+    if((slot>=0)&&(slot<node_gpo_codes.size())) {
+      if(cmds.size()>=3) {
+	node_gpo_codes[slot]=cmds.at(2).toLower();
+	Broadcast(GpoLine(slot));
+      }
+      else {
+	Send(id,GpoLine(slot));
+      }
+      return;
+    }
+  }
+
+  if((verb=="CFG")&&(cmds.size()>=2)&&(cmds.at(1).toUpper()=="GPO")) {
+    if(cmds.size()==2) {
+      for(int i=0;i<node_gpo_codes.size();i++) {
+	Send(id,CfgGpoLine(i));
+      }
+      return;
+    }
+    slot=cmds.at(2).toInt(&ok)-1;
+    if(ok&&(slot>=0)&&(slot<node_gpo_codes.size())) {
+      QMap<QString,QString> params=Parameters(cmd);
+      if(params.contains("SRCA")) {
+	node_gpo_source_addresses[slot]=params.value("SRCA");
+	Broadcast(CfgGpoLine(slot));
+      }
+      else {
+	Send(id,CfgGpoLine(slot));
+      }
+      return;
+    }
+  }
+
+  //
+  // Subscriptions and metering are accepted silently
+  //
+  if((verb=="ADD")||(verb=="DEL")||(verb=="MTR")||(verb=="LVL")) {
+    return;
+  }
+
+  Send(id,"ERROR 1000 bad command");
+}
+
+
+QString SimNode::VerLine() const
+{
+  return QString("VER LWRP:1.4.3 DEVN:\"LWRPSIM\" SYSV:1.0.0")+
+    QString::asprintf(" NSRC:%d NDST:%d NGPI:%d NGPO:%d",
+		      node_src_addresses.size(),node_dst_addresses.size(),
+		      node_gpi_codes.size(),node_gpo_codes.size());
+}
+
+
+QString SimNode::IpLine() const
+{
+  return QString("IP address ")+node_host_address.toString()+
+    " netmask 255.0.0.0 gateway 0.0.0.0 hostname "+hostName();
+}
+
+
+QString SimNode::SrcLine(int slot) const
+{
+  return QString::asprintf("SRC %d PSNM:\"",slot+1)+node_src_names.at(slot)+
+    "\" FASM:1 RTPE:1 RTPA:\""+node_src_addresses.at(slot).toString()+
+    "\" INGN:0 SHAB:0 NCHN:2 RTPP:240";
+}
+
+
+QString SimNode::DstLine(int slot) const
+{
+  return QString::asprintf("DST %d NAME:\"",slot+1)+node_dst_names.at(slot)+
+    "\" ADDR:\""+node_dst_addresses.at(slot).toString()+"\" NCHN:2 LOAD:0";
+}
+
+
+QString SimNode::GpiLine(int slot) const
+{
+  return QString::asprintf("GPI %d ",slot+1)+node_gpi_codes.at(slot);
+}
+
+
+QString SimNode::GpoLine(int slot) const
+{
+  return QString::asprintf("GPO %d ",slot+1)+node_gpo_codes.at(slot);
+}
+
+
+QString SimNode::CfgGpoLine(int slot) const
+{
+  return QString::asprintf("CFG GPO %d SRCA:\"",slot+1)+
+    node_gpo_source_addresses.at(slot)+
+    QString::asprintf("\" FUNC:\"\" NAME:\"Sim GPO %d\"",slot+1);
+}
+
+
+void SimNode::Send(int id,const QString &str)
+{
+  QTcpSocket *sock=node_sockets.value(id);
+
+  if(sock!=NULL) {
+    sock->write((str+"\r\n").toUtf8());
+  }
+}
+
+
+void SimNode::Broadcast(const QString &str)
+{
+  QByteArray data=(str+"\r\n").toUtf8();
+
+  for(QMap<int,QTcpSocket *>::const_iterator it=node_sockets.constBegin();
+      it!=node_sockets.constEnd();it++) {
+    it.value()->write(data);
+  }
+}
+
+
+QMap<QString,QString> SimNode::Parameters(const QString &str)
+{
+  QMap<QString,QString> ret;
+  QString key;
+  QString value;
+  bool quoted=false;
+  bool in_value=false;
+
+  //
+  // KEY:value and KEY:"quoted value" pairs
+  //
+  for(int i=0;i<=str.length();i++) {
+    QChar c=(i<str.length())?str.at(i):QChar(' ');
+    if(in_value) {
+      if(c=='"') {
+	quoted=!quoted;
+	continue;
+      }
+      if((c==' ')&&(!quoted)) {
+	ret[key.toUpper()]=value;
+	key="";
+	value="";
+	in_value=false;
+	continue;
+      }
+      value+=c;
+      continue;
+    }
+    if(c==':') {
+      in_value=true;
+      continue;
+    }
+    if(c==' ') {
+      key="";
+      continue;
+    }
+    key+=c;
+  }
+
+  return ret;
+}
@@ -0,0 +1,99 @@
+// simnode.h
+//
+// Simulated LWRP node
+//
+//   (C) Copyright 2026 Fred Gleason <fredg@paravelsystems.com>
+//
+//   This program is free software; you can redistribute it and/or modify
+//   it under the terms of the GNU General Public License version 2 as
+//   published by the Free Software Foundation.
+//
+//   This program is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//   GNU General Public License for more details.
+//
+//   You should have received a copy of the GNU General Public
+//   License along with this program; if not, write to the Free Software
+//   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//
+
+#ifndef SIMNODE_H
+#define SIMNODE_H
+
+#include <stdint.h>
+
+#include <QHostAddress>
+#include <QMap>
+#include <QObject>
+#include <QSignalMapper>
+#include <QString>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QVector>
+
+//
+// Answers the subset of LWRP that SyLwrpClient uses (VER, IP, SRC, DST,
+// GPI, GPO and CFG GPO), and echoes changes to every connected client
+// the way a real node does.
+//
+class SimNode : public QObject
+{
+  Q_OBJECT;
+ public:
+  SimNode(int num,const QHostAddress &addr,int slot_quan,int gpio_quan,
+	  QObject *parent=0);
+  ~SimNode();
+  QHostAddress hostAddress() const;
+  QString hostName() const;
+  int slotQuantity() const;
+  int clientQuantity() const;
+  bool listen(uint16_t port,QString *err_msg);
+  bool sendAdvertisement(const QHostAddress &iface_addr,
+			 const QHostAddress &group_addr,uint16_t port);
+  QHostAddress srcAddress(int slot) const;
+  QString srcName(int slot) const;
+  void setSrcName(int slot,const QString &str);
+  QHostAddress dstAddress(int slot) const;
+  void setDstAddress(int slot,const QHostAddress &addr);
+  void setGpiCode(int slot,const QString &code);
+  static QHostAddress streamAddress(int srcnum);
+
+ private slots:
+  void newConnectionData();
+  void readyReadData(int id);
+  void disconnectedData(int id);
+
+ private:
+  void ProcessCommand(int id,const QString &cmd);
+  QString VerLine() const;
+  QString IpLine() const;
+  QString SrcLine(int slot) const;
+  QString DstLine(int slot) const;
+  QString GpiLine(int slot) const;
+  QString GpoLine(int slot) const;
+  QString CfgGpoLine(int slot) const;
+  void Send(int id,const QString &str);
+  void Broadcast(const QString &str);
+  static QMap<QString,QString> Parameters(const QString &str);
+  int node_num;
+  QHostAddress node_host_address;
+  int node_advt_socket;
+  QTcpServer *node_server;
+  QMap<int,QTcpSocket *> node_sockets;
+  QMap<int,QString> node_accums;
+  QSignalMapper *node_ready_mapper;
+  QSignalMapper *node_disconnected_mapper;
+  int node_next_id;
+  QVector<QHostAddress> node_src_addresses;
+  QVector<QString> node_src_names;
+  QVector<QHostAddress> node_dst_addresses;
+  QVector<QString> node_dst_names;
+  QVector<QString> node_gpi_codes;
+  QVector<QString> node_gpo_codes;
+  QVector<QString> node_gpo_source_addresses;
+};
+
+
+#endif  // SIMNODE_H